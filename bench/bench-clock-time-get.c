@@ -0,0 +1,74 @@
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ITERATIONS 10000000
+
+static void bench_clock(uvwasi_t* uvwasi,
+                        const char* name,
+                        uvwasi_clockid_t clock_id,
+                        uvwasi_timestamp_t precision) {
+  uvwasi_timestamp_t time;
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_clock_time_get(uvwasi, clock_id, precision, &time);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+}
+
+static void bench_clock_res(uvwasi_t* uvwasi,
+                            const char* name,
+                            uvwasi_clockid_t clock_id) {
+  uvwasi_timestamp_t res;
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_clock_res_get(uvwasi, clock_id, &res);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+
+  uvwasi_options_init(&init_options);
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_clock(&uvwasi, "clock_time_get/realtime", UVWASI_CLOCK_REALTIME, 1);
+  bench_clock(&uvwasi,
+              "clock_time_get/realtime_10ms",
+              UVWASI_CLOCK_REALTIME,
+              10000000);
+  bench_clock(&uvwasi, "clock_time_get/monotonic", UVWASI_CLOCK_MONOTONIC, 1);
+  bench_clock(&uvwasi,
+              "clock_time_get/monotonic_10ms",
+              UVWASI_CLOCK_MONOTONIC,
+              10000000);
+  bench_clock(&uvwasi,
+              "clock_time_get/process_cputime",
+              UVWASI_CLOCK_PROCESS_CPUTIME_ID,
+              1);
+  bench_clock(&uvwasi,
+              "clock_time_get/thread_cputime",
+              UVWASI_CLOCK_THREAD_CPUTIME_ID,
+              1);
+  bench_clock_res(&uvwasi,
+                  "clock_res_get/thread_cputime",
+                  UVWASI_CLOCK_THREAD_CPUTIME_ID);
+
+  uvwasi_destroy(&uvwasi);
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+/* Creates sandboxes with the same args, env and preopens, as a host does for
+   every request it serves, with uvwasi_init() and with uvwasi_clone() from a
+   template. */
+#define ITERATIONS 20000
+#define ARGC 8
+#define ENVC 32
+#define PREOPENC 4
+
+static void bench_init(uvwasi_options_t* options) {
+  uvwasi_t uvwasi;
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_init(&uvwasi, options);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    uvwasi_destroy(&uvwasi);
+  }
+
+  bench_report("uvwasi_init+uvwasi_destroy",
+               ITERATIONS,
+               uv_hrtime() - start);
+}
+
+static void bench_clone(uvwasi_options_t* options) {
+  uvwasi_t template;
+  uvwasi_t uvwasi;
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  err = uvwasi_init(&template, options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_clone(&uvwasi, &template);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    uvwasi_destroy(&uvwasi);
+  }
+
+  bench_report("uvwasi_clone+uvwasi_destroy",
+               ITERATIONS,
+               uv_hrtime() - start);
+  uvwasi_destroy(&template);
+}
+
+int main(void) {
+  uvwasi_options_t options;
+  const char* argv[ARGC];
+  const char* envp[ENVC + 1];
+  char env_bufs[ENVC][32];
+  uv_fs_t req;
+  int r;
+  int i;
+
+  r = uv_fs_mkdir(NULL, &req, "./out", 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+  r = uv_fs_mkdir(NULL, &req, BENCH_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+
+  for (i = 0; i < ARGC; i++)
+    argv[i] = "--option=value";
+  for (i = 0; i < ENVC; i++) {
+    snprintf(env_bufs[i], sizeof(env_bufs[i]), "VARIABLE_%d=some value", i);
+    envp[i] = env_bufs[i];
+  }
+  envp[ENVC] = NULL;
+
+  uvwasi_options_init(&options);
+  options.fd_table_size = 64;
+  options.argc = ARGC;
+  options.argv = argv;
+  options.envp = envp;
+  options.preopenc = PREOPENC;
+  options.preopens = calloc(PREOPENC, sizeof(uvwasi_preopen_t));
+  BENCH_CHECK(options.preopens != NULL);
+  for (i = 0; i < PREOPENC; i++) {
+    options.preopens[i].mapped_path = "/bench";
+    options.preopens[i].real_path = BENCH_TMP_DIR;
+  }
+
+  bench_init(&options);
+  bench_clone(&options);
+  free(options.preopens);
+  return 0;
+}
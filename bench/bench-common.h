@@ -0,0 +1,98 @@
+#ifndef __UVWASI_BENCH_COMMON_H__
+#define __UVWASI_BENCH_COMMON_H__
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "uv.h"
+#include "uvwasi.h"
+
+/* Benchmarks are normally built with NDEBUG, so they check results with this
+   instead of assert(). */
+#define BENCH_CHECK(expr)                                                     \
+  do {                                                                        \
+    if (!(expr)) {                                                            \
+      fprintf(stderr,                                                         \
+              "%s:%d: check failed: %s\n",                                    \
+              __FILE__,                                                       \
+              __LINE__,                                                       \
+              #expr);                                                         \
+      abort();                                                                \
+    }                                                                         \
+  } while (0)
+
+/* Scratch directory for benchmarks that touch the file system. It is relative
+   to the working directory, like the test suite's ./out/tmp. */
+#define BENCH_TMP_DIR "./out/bench-tmp"
+
+/* Benchmark results are printed as one JSON object per line so that they can
+   be collected and compared by scripts. Benchmarks that move data also report
+   the number of bytes transferred. */
+static inline void bench_report_bytes(const char* name,
+                                      uint64_t ops,
+                                      uint64_t bytes,
+                                      uint64_t elapsed_ns) {
+  double ops_per_sec;
+
+  ops_per_sec = elapsed_ns == 0 ? 0 : (double) ops * 1e9 / (double) elapsed_ns;
+  printf("{\"name\": \"%s\", \"ops\": %" PRIu64 ", \"ns\": %" PRIu64
+         ", \"ns_per_op\": %.1f, \"ops_per_sec\": %.0f",
+         name,
+         ops,
+         elapsed_ns,
+         ops == 0 ? 0 : (double) elapsed_ns / (double) ops,
+         ops_per_sec);
+
+  if (bytes != 0) {
+    printf(", \"bytes\": %" PRIu64 ", \"bytes_per_sec\": %.0f",
+           bytes,
+           elapsed_ns == 0 ? 0 : (double) bytes * 1e9 / (double) elapsed_ns);
+  }
+
+  printf("}\n");
+  fflush(stdout);
+}
+
+static inline void bench_report(const char* name,
+                                uint64_t ops,
+                                uint64_t elapsed_ns) {
+  bench_report_bytes(name, ops, 0, elapsed_ns);
+}
+
+/* Creates BENCH_TMP_DIR and initializes a sandbox with it preopened as fd 3
+   under /bench. */
+static inline void bench_init_sandbox(uvwasi_t* uvwasi,
+                                      uvwasi_options_t* options) {
+  uv_fs_t req;
+  uvwasi_errno_t err;
+  int r;
+
+  r = uv_fs_mkdir(NULL, &req, "./out", 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+  r = uv_fs_mkdir(NULL, &req, BENCH_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+
+  options->preopenc = 1;
+  options->preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  BENCH_CHECK(options->preopens != NULL);
+  options->preopens[0].mapped_path = "/bench";
+  options->preopens[0].real_path = BENCH_TMP_DIR;
+
+  err = uvwasi_init(uvwasi, options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+}
+
+static inline void bench_destroy_sandbox(uvwasi_t* uvwasi,
+                                         uvwasi_options_t* options) {
+  uvwasi_destroy(uvwasi);
+  free(options->preopens);
+  free(options->immutable_preopens);
+  free(options->preopen_vfs);
+  options->preopens = NULL;
+  options->immutable_preopens = NULL;
+  options->preopen_vfs = NULL;
+}
+
+#endif /* __UVWASI_BENCH_COMMON_H__ */
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+#include "../test/test-common.h"
+
+#define ITERATIONS 200000
+#define MAX_OPEN 64
+
+/* Measures open/close churn through path_open()/fd_close() and counts the
+   calls made to the sandbox's allocator per open/close pair. Each round keeps
+   `open` files open at a time. */
+
+static counting_counts_t counts;
+
+static void bench_churn(uvwasi_t* uvwasi, const char* path, int open) {
+  uvwasi_fd_t fds[MAX_OPEN];
+  uvwasi_errno_t err;
+  uint64_t calls;
+  uint64_t start;
+  uint64_t elapsed;
+  char name[64];
+  int i;
+  int j;
+
+  calls = counts.calls;
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i += open) {
+    for (j = 0; j < open; j++) {
+      err = uvwasi_path_open(uvwasi,
+                             3,
+                             0,
+                             path,
+                             strlen(path) + 1,
+                             0,
+                             UVWASI_RIGHT_FD_READ,
+                             0,
+                             0,
+                             &fds[j]);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+    }
+
+    for (j = 0; j < open; j++) {
+      err = uvwasi_fd_close(uvwasi, fds[j]);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+    }
+  }
+
+  elapsed = uv_hrtime() - start;
+  calls = counts.calls - calls;
+  snprintf(name, sizeof(name), "fd_churn/open_%d", open);
+  printf("{\"name\": \"%s\", \"ops\": %d, \"ns\": %" PRIu64
+         ", \"ns_per_op\": %.1f, \"allocator_calls_per_op\": %.2f}\n",
+         name,
+         ITERATIONS,
+         elapsed,
+         (double) elapsed / ITERATIONS,
+         (double) calls / ITERATIONS);
+  fflush(stdout);
+}
+
+int main(void) {
+  const char* path = "fd-churn.txt";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_mem_t allocator;
+  uvwasi_fd_t fd;
+  int open;
+
+  counting_allocator_init(&allocator, &counts);
+  uvwasi_options_init(&init_options);
+  init_options.allocator = &allocator;
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_READ,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  for (open = 1; open <= MAX_OPEN; open *= 4)
+    bench_churn(&uvwasi, path, open);
+
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
@@ -0,0 +1,202 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define OPS_PER_THREAD 20000
+#define MAX_THREADS 64
+#define FILE_SIZE 4096
+#define READ_SIZE 256
+#define MAX_PROBE_FD 1024
+
+/* Runs a mix of system calls from N threads against a single uvwasi_t to
+   measure how the fd table's rwlock and the per-fd mutexes scale. Out of every
+   eight operations, six are fd_pread() calls on one fd shared by all threads,
+   one is a path_open()/fd_close() pair, and one replaces the thread's own fd
+   using path_open() and fd_renumber(). Every read is checked against the file
+   contents, and the fd table is checked for leaks after each round. */
+
+typedef struct bench_thread_s {
+  uvwasi_t* uvwasi;
+  uvwasi_fd_t shared_fd;
+  uvwasi_fd_t own_fd;
+  unsigned int seed;
+} bench_thread_t;
+
+static const char* path = "fd-contention.txt";
+static char expected[FILE_SIZE];
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         0,
+                         UVWASI_RIGHT_FD_READ |
+                           UVWASI_RIGHT_FD_SEEK |
+                           UVWASI_RIGHT_FD_FILESTAT_GET,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  return fd;
+}
+
+static void check_pread(bench_thread_t* t) {
+  uvwasi_errno_t err;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  uvwasi_filesize_t offset;
+  char buf[READ_SIZE];
+
+  /* A simple LCG is enough to spread reads across the file. */
+  t->seed = t->seed * 1103515245 + 12345;
+  offset = (t->seed >> 8) % (FILE_SIZE - READ_SIZE);
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  err = uvwasi_fd_pread(t->uvwasi,
+                        t->shared_fd,
+                        &iov,
+                        1,
+                        offset,
+                        &nread);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  BENCH_CHECK(nread == sizeof(buf));
+  BENCH_CHECK(0 == memcmp(buf, expected + offset, sizeof(buf)));
+}
+
+static void thread_main(void* arg) {
+  bench_thread_t* t = arg;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  int i;
+
+  for (i = 0; i < OPS_PER_THREAD; i++) {
+    switch (i % 8) {
+      case 6:
+        fd = open_file(t->uvwasi);
+        err = uvwasi_fd_close(t->uvwasi, fd);
+        BENCH_CHECK(err == UVWASI_ESUCCESS);
+        break;
+      case 7:
+        fd = open_file(t->uvwasi);
+        err = uvwasi_fd_renumber(t->uvwasi, fd, t->own_fd);
+        BENCH_CHECK(err == UVWASI_ESUCCESS);
+        break;
+      default:
+        check_pread(t);
+    }
+  }
+}
+
+/* Counts the open fds in the table by probing it, since the table itself is
+   not part of the public API. */
+static int count_fds(uvwasi_t* uvwasi) {
+  uvwasi_fdstat_t stat;
+  uvwasi_fd_t fd;
+  int count;
+
+  count = 0;
+  for (fd = 0; fd < MAX_PROBE_FD; fd++) {
+    if (uvwasi_fd_fdstat_get(uvwasi, fd, &stat) == UVWASI_ESUCCESS)
+      count++;
+  }
+
+  return count;
+}
+
+static void bench_threads(uvwasi_t* uvwasi,
+                          uvwasi_fd_t shared_fd,
+                          int nthreads) {
+  static bench_thread_t args[MAX_THREADS];
+  static uv_thread_t threads[MAX_THREADS];
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uint64_t elapsed;
+  uint64_t start;
+  char name[64];
+  int baseline;
+  int i;
+
+  baseline = count_fds(uvwasi);
+  for (i = 0; i < nthreads; i++) {
+    args[i].uvwasi = uvwasi;
+    args[i].shared_fd = shared_fd;
+    args[i].own_fd = open_file(uvwasi);
+    args[i].seed = (unsigned int) i + 1;
+  }
+
+  start = uv_hrtime();
+  for (i = 0; i < nthreads; i++)
+    BENCH_CHECK(0 == uv_thread_create(&threads[i], thread_main, &args[i]));
+
+  for (i = 0; i < nthreads; i++)
+    BENCH_CHECK(0 == uv_thread_join(&threads[i]));
+  elapsed = uv_hrtime() - start;
+
+  /* Each thread must still own exactly one usable fd, and nothing else may
+     have leaked. */
+  BENCH_CHECK(count_fds(uvwasi) == baseline + nthreads);
+  for (i = 0; i < nthreads; i++) {
+    err = uvwasi_fd_filestat_get(uvwasi, args[i].own_fd, &stat);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    BENCH_CHECK(stat.st_size == FILE_SIZE);
+    err = uvwasi_fd_close(uvwasi, args[i].own_fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+  BENCH_CHECK(count_fds(uvwasi) == baseline);
+
+  snprintf(name, sizeof(name), "fd_contention/mixed/threads_%d", nthreads);
+  bench_report(name, (uint64_t) nthreads * OPS_PER_THREAD, elapsed);
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_ciovec_t iov;
+  uvwasi_errno_t err;
+  uvwasi_size_t nwritten;
+  uvwasi_fd_t fd;
+  int nthreads;
+  int i;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  for (i = 0; i < FILE_SIZE; i++)
+    expected[i] = (char) (i * 31 + 7);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  iov.buf = expected;
+  iov.buf_len = sizeof(expected);
+  err = uvwasi_fd_write(&uvwasi, fd, &iov, 1, &nwritten);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  BENCH_CHECK(nwritten == sizeof(expected));
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  fd = open_file(&uvwasi);
+  for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2)
+    bench_threads(&uvwasi, fd, nthreads);
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define FILE_SIZE (64 * 1024 * 1024)
+#define CHUNK_SIZE (64 * 1024)
+#define ITERATIONS 16
+
+/* Measures copying a file into another one through a buffer in guest memory
+   and with uvwasi_fd_copy(). */
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_oflags_t oflags,
+                             uvwasi_rights_t rights) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         oflags,
+                         rights,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  return fd;
+}
+
+int main(void) {
+  const char* src_path = "fd-copy-src.bin";
+  const char* dst_path = "fd-copy-dst.bin";
+  uvwasi_options_t init_options;
+  uvwasi_filesize_t copied;
+  uvwasi_filesize_t pos;
+  uvwasi_ciovec_t ciov;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t src;
+  uvwasi_fd_t dst;
+  uint64_t start;
+  uint32_t i;
+  uint32_t j;
+  char* buf;
+
+  buf = malloc(CHUNK_SIZE);
+  BENCH_CHECK(buf != NULL);
+  memset(buf, 'x', CHUNK_SIZE);
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+  src = open_file(&uvwasi,
+                  src_path,
+                  UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                  UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_WRITE |
+                  UVWASI_RIGHT_FD_SEEK);
+  ciov.buf = buf;
+  ciov.buf_len = CHUNK_SIZE;
+  for (i = 0; i < FILE_SIZE / CHUNK_SIZE; i++) {
+    err = uvwasi_fd_write(&uvwasi, src, &ciov, 1, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == CHUNK_SIZE);
+  }
+  dst = open_file(&uvwasi,
+                  dst_path,
+                  UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                  UVWASI_RIGHT_FD_WRITE | UVWASI_RIGHT_FD_SEEK);
+
+  iov.buf = buf;
+  iov.buf_len = CHUNK_SIZE;
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_fd_seek(&uvwasi, src, 0, UVWASI_WHENCE_SET, &pos);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_seek(&uvwasi, dst, 0, UVWASI_WHENCE_SET, &pos);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    for (j = 0; j < FILE_SIZE / CHUNK_SIZE; j++) {
+      err = uvwasi_fd_read(&uvwasi, src, &iov, 1, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == CHUNK_SIZE);
+      err = uvwasi_fd_write(&uvwasi, dst, &ciov, 1, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == CHUNK_SIZE);
+    }
+  }
+  bench_report_bytes("fd_copy/file/read_write",
+                     ITERATIONS,
+                     (uint64_t) ITERATIONS * FILE_SIZE,
+                     uv_hrtime() - start);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_fd_seek(&uvwasi, dst, 0, UVWASI_WHENCE_SET, &pos);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_copy(&uvwasi, src, dst, 0, FILE_SIZE, &copied);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && copied == FILE_SIZE);
+  }
+  bench_report_bytes("fd_copy/file/fd_copy",
+                     ITERATIONS,
+                     (uint64_t) ITERATIONS * FILE_SIZE,
+                     uv_hrtime() - start);
+
+  err = uvwasi_fd_close(&uvwasi, dst);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_fd_close(&uvwasi, src);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, src_path, strlen(src_path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, dst_path, strlen(dst_path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  free(buf);
+  return 0;
+}
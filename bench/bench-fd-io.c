@@ -0,0 +1,147 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+/* Each size moves roughly this many bytes, within the iteration limits. */
+#define TARGET_BYTES (256 * 1024 * 1024)
+#define MIN_ITERATIONS 1000
+#define MAX_ITERATIONS 1000000
+#define FILE_SIZE (16 * 1024 * 1024)
+
+static const uvwasi_size_t sizes[] = { 64, 4096, 65536, 1048576 };
+
+static uint64_t iterations_for(uvwasi_size_t size) {
+  uint64_t n;
+
+  n = TARGET_BYTES / size;
+  if (n < MIN_ITERATIONS)
+    n = MIN_ITERATIONS;
+  if (n > MAX_ITERATIONS)
+    n = MAX_ITERATIONS;
+  return n;
+}
+
+static void rewind_fd(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+  uvwasi_filesize_t pos;
+  uvwasi_errno_t err;
+
+  err = uvwasi_fd_seek(uvwasi, fd, 0, UVWASI_WHENCE_SET, &pos);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+}
+
+static void bench_size(uvwasi_t* uvwasi, uvwasi_fd_t fd, uvwasi_size_t size) {
+  uvwasi_ciovec_t ciov;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_filesize_t offset;
+  uint64_t iterations;
+  uint64_t start;
+  uint64_t i;
+  char name[64];
+  char* buf;
+
+  buf = malloc(size);
+  BENCH_CHECK(buf != NULL);
+  memset(buf, 'x', size);
+  ciov.buf = buf;
+  ciov.buf_len = size;
+  iov.buf = buf;
+  iov.buf_len = size;
+  iterations = iterations_for(size);
+
+  /* Sequential writes, wrapping around at FILE_SIZE. */
+  rewind_fd(uvwasi, fd);
+  offset = 0;
+  start = uv_hrtime();
+  for (i = 0; i < iterations; i++) {
+    if (offset + size > FILE_SIZE) {
+      rewind_fd(uvwasi, fd);
+      offset = 0;
+    }
+    err = uvwasi_fd_write(uvwasi, fd, &ciov, 1, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+    offset += size;
+  }
+  snprintf(name, sizeof(name), "fd_write/%u", (unsigned) size);
+  bench_report_bytes(name, iterations, iterations * size, uv_hrtime() - start);
+
+  /* Sequential reads of the same region. */
+  rewind_fd(uvwasi, fd);
+  offset = 0;
+  start = uv_hrtime();
+  for (i = 0; i < iterations; i++) {
+    if (offset + size > FILE_SIZE) {
+      rewind_fd(uvwasi, fd);
+      offset = 0;
+    }
+    err = uvwasi_fd_read(uvwasi, fd, &iov, 1, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+    offset += size;
+  }
+  snprintf(name, sizeof(name), "fd_read/%u", (unsigned) size);
+  bench_report_bytes(name, iterations, iterations * size, uv_hrtime() - start);
+
+  offset = 0;
+  start = uv_hrtime();
+  for (i = 0; i < iterations; i++) {
+    if (offset + size > FILE_SIZE)
+      offset = 0;
+    err = uvwasi_fd_pwrite(uvwasi, fd, &ciov, 1, offset, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+    offset += size;
+  }
+  snprintf(name, sizeof(name), "fd_pwrite/%u", (unsigned) size);
+  bench_report_bytes(name, iterations, iterations * size, uv_hrtime() - start);
+
+  offset = 0;
+  start = uv_hrtime();
+  for (i = 0; i < iterations; i++) {
+    if (offset + size > FILE_SIZE)
+      offset = 0;
+    err = uvwasi_fd_pread(uvwasi, fd, &iov, 1, offset, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+    offset += size;
+  }
+  snprintf(name, sizeof(name), "fd_pread/%u", (unsigned) size);
+  bench_report_bytes(name, iterations, iterations * size, uv_hrtime() - start);
+
+  free(buf);
+}
+
+int main(void) {
+  const char* path = "fd-io.bin";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  size_t i;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_READ |
+                           UVWASI_RIGHT_FD_WRITE |
+                           UVWASI_RIGHT_FD_SEEK,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    bench_size(&uvwasi, fd, sizes[i]);
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
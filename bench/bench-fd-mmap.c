@@ -0,0 +1,146 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define FILE_SIZE (64 * 1024 * 1024)
+#define ITERATIONS 1000000
+#define WINDOW_SIZE (16 * 1024 * 1024)
+
+/* Measures small random preads and sequential reads of a read-only file, with
+   and without uvwasi_options_t.mmap_window_size. */
+
+static const uvwasi_size_t sizes[] = { 64, 4096 };
+
+static void create_file(uvwasi_t* uvwasi, const char* path) {
+  uvwasi_ciovec_t ciov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint32_t i;
+  char* buf;
+
+  buf = malloc(1024 * 1024);
+  BENCH_CHECK(buf != NULL);
+  memset(buf, 'x', 1024 * 1024);
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  ciov.buf = buf;
+  ciov.buf_len = 1024 * 1024;
+  for (i = 0; i < FILE_SIZE / (1024 * 1024); i++) {
+    err = uvwasi_fd_write(uvwasi, fd, &ciov, 1, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == ciov.buf_len);
+  }
+  err = uvwasi_fd_close(uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  free(buf);
+}
+
+static void bench_reads(const char* path, uvwasi_size_t window) {
+  uvwasi_options_t init_options;
+  uvwasi_filesize_t offset;
+  uvwasi_filesize_t pos;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  uint64_t seed;
+  uint64_t i;
+  size_t s;
+  char name[64];
+  char buf[4096];
+
+  uvwasi_options_init(&init_options);
+  init_options.mmap_window_size = window;
+  bench_init_sandbox(&uvwasi, &init_options);
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         0,
+                         UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_SEEK,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    iov.buf = buf;
+    iov.buf_len = sizes[s];
+
+    seed = 88172645463325252ULL;
+    start = uv_hrtime();
+    for (i = 0; i < ITERATIONS; i++) {
+      seed ^= seed << 13;
+      seed ^= seed >> 7;
+      seed ^= seed << 17;
+      offset = seed % (FILE_SIZE - sizes[s]);
+      err = uvwasi_fd_pread(&uvwasi, fd, &iov, 1, offset, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == sizes[s]);
+    }
+    snprintf(name,
+             sizeof(name),
+             "fd_pread/random/%u/%s",
+             (unsigned) sizes[s],
+             window == 0 ? "read" : "mmap");
+    bench_report_bytes(name,
+                       ITERATIONS,
+                       ITERATIONS * sizes[s],
+                       uv_hrtime() - start);
+
+    err = uvwasi_fd_seek(&uvwasi, fd, 0, UVWASI_WHENCE_SET, &pos);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    start = uv_hrtime();
+    for (i = 0; i < ITERATIONS; i++) {
+      err = uvwasi_fd_read(&uvwasi, fd, &iov, 1, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+      if (n < sizes[s]) {
+        err = uvwasi_fd_seek(&uvwasi, fd, 0, UVWASI_WHENCE_SET, &pos);
+        BENCH_CHECK(err == UVWASI_ESUCCESS);
+      }
+    }
+    snprintf(name,
+             sizeof(name),
+             "fd_read/sequential/%u/%s",
+             (unsigned) sizes[s],
+             window == 0 ? "read" : "mmap");
+    bench_report_bytes(name,
+                       ITERATIONS,
+                       ITERATIONS * sizes[s],
+                       uv_hrtime() - start);
+  }
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_destroy_sandbox(&uvwasi, &init_options);
+}
+
+int main(void) {
+  const char* path = "fd-mmap.bin";
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_t uvwasi;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+  create_file(&uvwasi, path);
+
+  bench_reads(path, 0);
+  bench_reads(path, WINDOW_SIZE);
+
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
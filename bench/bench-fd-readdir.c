@@ -0,0 +1,119 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ENTRIES 10000
+#define ITERATIONS 50
+#define BUFFER_SIZE (64 * 1024)
+
+static void make_entries(uvwasi_t* uvwasi, uvwasi_fd_t dirfd, int create) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  char name[32];
+  int i;
+
+  for (i = 0; i < ENTRIES; i++) {
+    snprintf(name, sizeof(name), "entry-%05d", i);
+    if (create) {
+      err = uvwasi_path_open(uvwasi,
+                             dirfd,
+                             0,
+                             name,
+                             strlen(name) + 1,
+                             UVWASI_O_CREAT,
+                             UVWASI_RIGHT_FD_WRITE,
+                             0,
+                             0,
+                             &fd);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+      err = uvwasi_fd_close(uvwasi, fd);
+    } else {
+      err = uvwasi_path_unlink_file(uvwasi, dirfd, name, strlen(name) + 1);
+    }
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+}
+
+int main(void) {
+  const char* dir = "readdir";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_fd_t dirfd;
+  uvwasi_dircookie_t cookie;
+  uvwasi_dirent_t dirent;
+  uvwasi_size_t bufused;
+  uvwasi_size_t pos;
+  uint64_t entries;
+  uint64_t calls;
+  uint64_t start;
+  uint64_t elapsed;
+  char* buf;
+  int i;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  err = uvwasi_path_create_directory(&uvwasi, 3, dir, strlen(dir) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS || err == UVWASI_EEXIST);
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         dir,
+                         strlen(dir) + 1,
+                         UVWASI_O_DIRECTORY,
+                         UVWASI_RIGHT_FD_READDIR |
+                           UVWASI_RIGHT_PATH_CREATE_FILE |
+                           UVWASI_RIGHT_PATH_OPEN |
+                           UVWASI_RIGHT_PATH_UNLINK_FILE,
+                         UVWASI_RIGHT_FD_WRITE | UVWASI_RIGHT_FD_SEEK,
+                         0,
+                         &dirfd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  make_entries(&uvwasi, dirfd, 1);
+
+  buf = malloc(BUFFER_SIZE);
+  BENCH_CHECK(buf != NULL);
+  entries = 0;
+  calls = 0;
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    cookie = UVWASI_DIRCOOKIE_START;
+    do {
+      err = uvwasi_fd_readdir(&uvwasi,
+                              dirfd,
+                              buf,
+                              BUFFER_SIZE,
+                              cookie,
+                              &bufused);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+      calls++;
+
+      /* Resume after the last complete entry in the buffer. */
+      pos = 0;
+      while (pos + sizeof(dirent) <= bufused) {
+        memcpy(&dirent, buf + pos, sizeof(dirent));
+        if (pos + sizeof(dirent) + dirent.d_namlen > bufused)
+          break;
+        cookie = dirent.d_next;
+        pos += sizeof(dirent) + dirent.d_namlen;
+        entries++;
+      }
+    } while (bufused == BUFFER_SIZE);
+  }
+
+  BENCH_CHECK(entries == (uint64_t) ITERATIONS * ENTRIES);
+  elapsed = uv_hrtime() - start;
+  bench_report("fd_readdir/list_10000", ITERATIONS, elapsed);
+  bench_report("fd_readdir/call_64k", calls, elapsed);
+
+  free(buf);
+  make_entries(&uvwasi, dirfd, 0);
+  err = uvwasi_fd_close(&uvwasi, dirfd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_remove_directory(&uvwasi, 3, dir, strlen(dir) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ITERATIONS 1000000
+#define CHURN_ITERATIONS 100000
+#define MAX_THREADS 8
+
+/* fd table lookups go through fd_fdstat_get(), which takes the table lock and
+   the fd's mutex and does no I/O. Inserts and removals go through
+   path_open()/fd_close(). */
+
+typedef struct bench_thread_s {
+  uvwasi_t* uvwasi;
+  uvwasi_fd_t fd;
+  int churn;
+} bench_thread_t;
+
+static void lookup_loop(uvwasi_t* uvwasi, uvwasi_fd_t fd, int iterations) {
+  uvwasi_fdstat_t stat;
+  uvwasi_errno_t err;
+  int i;
+
+  for (i = 0; i < iterations; i++) {
+    err = uvwasi_fd_fdstat_get(uvwasi, fd, &stat);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+}
+
+static void churn_loop(uvwasi_t* uvwasi, int iterations) {
+  const char* path = "fd-table.txt";
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  int i;
+
+  for (i = 0; i < iterations; i++) {
+    err = uvwasi_path_open(uvwasi,
+                           3,
+                           0,
+                           path,
+                           strlen(path) + 1,
+                           0,
+                           UVWASI_RIGHT_FD_READ,
+                           0,
+                           0,
+                           &fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_close(uvwasi, fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+}
+
+static void thread_main(void* arg) {
+  bench_thread_t* t = arg;
+
+  if (t->churn)
+    churn_loop(t->uvwasi, CHURN_ITERATIONS);
+  else
+    lookup_loop(t->uvwasi, t->fd, ITERATIONS);
+}
+
+static void bench_threads(uvwasi_t* uvwasi,
+                          const char* kind,
+                          int nthreads,
+                          const uvwasi_fd_t* fds,
+                          int churn) {
+  bench_thread_t args[MAX_THREADS];
+  uv_thread_t threads[MAX_THREADS];
+  uint64_t start;
+  uint64_t ops;
+  char name[64];
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < nthreads; i++) {
+    args[i].uvwasi = uvwasi;
+    args[i].fd = fds[i];
+    args[i].churn = churn;
+    BENCH_CHECK(0 == uv_thread_create(&threads[i], thread_main, &args[i]));
+  }
+
+  for (i = 0; i < nthreads; i++)
+    BENCH_CHECK(0 == uv_thread_join(&threads[i]));
+
+  ops = (uint64_t) nthreads * (churn ? CHURN_ITERATIONS : ITERATIONS);
+  snprintf(name, sizeof(name), "fd_table/%s/threads_%d", kind, nthreads);
+  bench_report(name, ops, uv_hrtime() - start);
+}
+
+int main(void) {
+  const char* path = "fd-table.txt";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_fd_t shared[MAX_THREADS];
+  uvwasi_fd_t own[MAX_THREADS];
+  uvwasi_errno_t err;
+  int nthreads;
+  int i;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  for (i = 0; i < MAX_THREADS; i++) {
+    err = uvwasi_path_open(&uvwasi,
+                           3,
+                           0,
+                           path,
+                           strlen(path) + 1,
+                           UVWASI_O_CREAT,
+                           UVWASI_RIGHT_FD_READ,
+                           0,
+                           0,
+                           &own[i]);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    shared[i] = own[0];
+  }
+
+  for (nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+    bench_threads(&uvwasi, "get_shared_fd", nthreads, shared, 0);
+    bench_threads(&uvwasi, "get_own_fd", nthreads, own, 0);
+    bench_threads(&uvwasi, "insert_remove", nthreads, own, 1);
+  }
+
+  for (i = 0; i < MAX_THREADS; i++) {
+    err = uvwasi_fd_close(&uvwasi, own[i]);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
@@ -0,0 +1,255 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+/* Compares the in-memory file system with a host tmpfs directory. /dev/shm
+   is used when it exists, and BENCH_TMP_DIR otherwise. */
+#define TMPFS_DIR "/dev/shm/uvwasi-bench-memfs"
+#define ITERATIONS 100000
+#define IO_ITERATIONS 20000
+#define FILE_SIZE (16 * 1024 * 1024)
+
+static const uvwasi_size_t io_sizes[] = { 64, 4096, 65536 };
+
+static void bench_small_files(uvwasi_t* uvwasi, const char* backend) {
+  const char* path = "small.txt";
+  uvwasi_ciovec_t ciov;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  char name[64];
+  char buf[1024];
+  int i;
+
+  memset(buf, 'x', sizeof(buf));
+  ciov.buf = buf;
+  ciov.buf_len = sizeof(buf);
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_path_open(uvwasi,
+                           3,
+                           0,
+                           path,
+                           strlen(path) + 1,
+                           UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                           UVWASI_RIGHT_FD_READ |
+                             UVWASI_RIGHT_FD_WRITE |
+                             UVWASI_RIGHT_FD_SEEK,
+                           0,
+                           0,
+                           &fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_write(uvwasi, fd, &ciov, 1, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == sizeof(buf));
+    err = uvwasi_fd_pread(uvwasi, fd, &iov, 1, 0, &n);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && n == sizeof(buf));
+    err = uvwasi_fd_close(uvwasi, fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_path_unlink_file(uvwasi, 3, path, strlen(path) + 1);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  snprintf(name, sizeof(name), "%s/create_write_read_unlink", backend);
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+}
+
+static void bench_metadata(uvwasi_t* uvwasi, const char* backend) {
+  const char* dir = "meta";
+  const char* file = "meta/file.txt";
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  char name[64];
+  int i;
+
+  err = uvwasi_path_create_directory(uvwasi, 3, dir, strlen(dir) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS || err == UVWASI_EEXIST);
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         file,
+                         strlen(file) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_fd_close(uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_path_filestat_get(uvwasi,
+                                   3,
+                                   0,
+                                   file,
+                                   strlen(file) + 1,
+                                   &stat);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  snprintf(name, sizeof(name), "%s/path_filestat_get", backend);
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_path_open(uvwasi,
+                           3,
+                           0,
+                           file,
+                           strlen(file) + 1,
+                           0,
+                           UVWASI_RIGHT_FD_READ,
+                           0,
+                           0,
+                           &fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_close(uvwasi, fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  snprintf(name, sizeof(name), "%s/path_open+fd_close", backend);
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+
+  err = uvwasi_path_unlink_file(uvwasi, 3, file, strlen(file) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_remove_directory(uvwasi, 3, dir, strlen(dir) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+}
+
+static void bench_io(uvwasi_t* uvwasi, const char* backend) {
+  const char* path = "io.bin";
+  uvwasi_filesize_t offset;
+  uvwasi_ciovec_t ciov;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t size;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  size_t s;
+  char name[64];
+  char* buf;
+  int i;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_READ |
+                             UVWASI_RIGHT_FD_WRITE |
+                             UVWASI_RIGHT_FD_SEEK,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  for (s = 0; s < sizeof(io_sizes) / sizeof(io_sizes[0]); s++) {
+    size = io_sizes[s];
+    buf = malloc(size);
+    BENCH_CHECK(buf != NULL);
+    memset(buf, 'x', size);
+    ciov.buf = buf;
+    ciov.buf_len = size;
+    iov.buf = buf;
+    iov.buf_len = size;
+
+    offset = 0;
+    start = uv_hrtime();
+    for (i = 0; i < IO_ITERATIONS; i++) {
+      if (offset + size > FILE_SIZE)
+        offset = 0;
+      err = uvwasi_fd_pwrite(uvwasi, fd, &ciov, 1, offset, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+      offset += size;
+    }
+    snprintf(name, sizeof(name), "%s/fd_pwrite/%u", backend, (unsigned) size);
+    bench_report_bytes(name,
+                       IO_ITERATIONS,
+                       (uint64_t) IO_ITERATIONS * size,
+                       uv_hrtime() - start);
+
+    offset = 0;
+    start = uv_hrtime();
+    for (i = 0; i < IO_ITERATIONS; i++) {
+      if (offset + size > FILE_SIZE)
+        offset = 0;
+      err = uvwasi_fd_pread(uvwasi, fd, &iov, 1, offset, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == size);
+      offset += size;
+    }
+    snprintf(name, sizeof(name), "%s/fd_pread/%u", backend, (unsigned) size);
+    bench_report_bytes(name,
+                       IO_ITERATIONS,
+                       (uint64_t) IO_ITERATIONS * size,
+                       uv_hrtime() - start);
+    free(buf);
+  }
+
+  err = uvwasi_fd_close(uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_path_unlink_file(uvwasi, 3, path, strlen(path) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+}
+
+static void bench_all(uvwasi_t* uvwasi, const char* backend) {
+  bench_small_files(uvwasi, backend);
+  bench_metadata(uvwasi, backend);
+  bench_io(uvwasi, backend);
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_memfs_t* memfs;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+
+  /* The host side, preferring a real tmpfs. */
+  uvwasi_options_init(&init_options);
+  r = uv_fs_mkdir(NULL, &req, TMPFS_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r == 0 || r == UV_EEXIST) {
+    init_options.preopenc = 1;
+    init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+    BENCH_CHECK(init_options.preopens != NULL);
+    init_options.preopens[0].mapped_path = "/bench";
+    init_options.preopens[0].real_path = TMPFS_DIR;
+    err = uvwasi_init(&uvwasi, &init_options);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    bench_all(&uvwasi, "tmpfs");
+    bench_destroy_sandbox(&uvwasi, &init_options);
+    uv_fs_rmdir(NULL, &req, TMPFS_DIR, NULL);
+    uv_fs_req_cleanup(&req);
+  } else {
+    bench_init_sandbox(&uvwasi, &init_options);
+    bench_all(&uvwasi, "host");
+    bench_destroy_sandbox(&uvwasi, &init_options);
+  }
+
+  err = uvwasi_memfs_new(NULL, 0, &memfs);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  uvwasi_options_init(&init_options);
+  init_options.preopen_vfsc = 1;
+  init_options.preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  BENCH_CHECK(init_options.preopen_vfs != NULL);
+  init_options.preopen_vfs[0].mapped_path = "/bench";
+  init_options.preopen_vfs[0].vfs = uvwasi_memfs_vfs(memfs);
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_all(&uvwasi, "memfs");
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  err = uvwasi_memfs_free(memfs);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  return 0;
+}
@@ -0,0 +1,215 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+/* Opens and reads every file of a flat tree of small files, as a guest does
+   when it loads its standard library, from the host and from a packed image
+   of the same files. */
+#define FILE_COUNT 1000
+#define FILE_SIZE 512
+#define ROUNDS 20
+#define SRC_DIR BENCH_TMP_DIR "/pack-src"
+#define IMAGE BENCH_TMP_DIR "/pack.img"
+#define NAME_LEN 9
+
+static char contents[FILE_SIZE];
+
+static void file_name(char* name, int i) {
+  snprintf(name, 16, "f%04d.txt", i);
+}
+
+static void write_file(const char* path, const void* data, size_t size) {
+  FILE* f;
+
+  f = fopen(path, "wb");
+  BENCH_CHECK(f != NULL);
+  BENCH_CHECK(fwrite(data, 1, size, f) == size);
+  BENCH_CHECK(fclose(f) == 0);
+}
+
+static void create_tree(void) {
+  uv_fs_t req;
+  char path[64];
+  char name[16];
+  int r;
+  int i;
+
+  r = uv_fs_mkdir(NULL, &req, SRC_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+  for (i = 0; i < FILE_COUNT; i++) {
+    file_name(name, i);
+    snprintf(path, sizeof(path), "%s/%s", SRC_DIR, name);
+    write_file(path, contents, sizeof(contents));
+  }
+}
+
+static void remove_tree(void) {
+  uv_fs_t req;
+  char path[64];
+  char name[16];
+  int i;
+
+  for (i = 0; i < FILE_COUNT; i++) {
+    file_name(name, i);
+    snprintf(path, sizeof(path), "%s/%s", SRC_DIR, name);
+    uv_fs_unlink(NULL, &req, path, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  uv_fs_rmdir(NULL, &req, SRC_DIR, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+/* Lays the tree out as uvwasi-pack would: the root, its children in name
+   order, their names, and then their contents. */
+static void create_image(void) {
+  uvwasi_pack_header_t* header;
+  uvwasi_pack_node_t* nodes;
+  uint64_t names;
+  uint64_t data;
+  size_t size;
+  char* image;
+  char name[16];
+  int i;
+
+  names = sizeof(*header) + (FILE_COUNT + 1) * sizeof(*nodes);
+  data = names + FILE_COUNT * NAME_LEN;
+  size = (size_t) data + FILE_COUNT * FILE_SIZE;
+  image = calloc(1, size);
+  BENCH_CHECK(image != NULL);
+
+  header = (uvwasi_pack_header_t*) image;
+  memcpy(header->magic, UVWASI_PACK_MAGIC, sizeof(header->magic));
+  header->version = UVWASI_PACK_VERSION;
+  header->node_count = FILE_COUNT + 1;
+  nodes = (uvwasi_pack_node_t*) (header + 1);
+  nodes[0].type = UVWASI_FILETYPE_DIRECTORY;
+  nodes[0].offset = 1;
+  nodes[0].size = FILE_COUNT;
+  nodes[0].name_offset = (uint32_t) names;
+  for (i = 0; i < FILE_COUNT; i++) {
+    file_name(name, i);
+    nodes[i + 1].type = UVWASI_FILETYPE_REGULAR_FILE;
+    nodes[i + 1].name_offset = (uint32_t) (names + i * NAME_LEN);
+    nodes[i + 1].name_len = NAME_LEN;
+    nodes[i + 1].offset = data + (uint64_t) i * FILE_SIZE;
+    nodes[i + 1].size = FILE_SIZE;
+    memcpy(image + nodes[i + 1].name_offset, name, NAME_LEN);
+    memcpy(image + nodes[i + 1].offset, contents, FILE_SIZE);
+  }
+
+  write_file(IMAGE, image, size);
+  free(image);
+}
+
+static void bench_tree(uvwasi_t* uvwasi, const char* backend) {
+  uvwasi_filestat_t stat;
+  uvwasi_iovec_t iov;
+  uvwasi_size_t n;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  char name[64];
+  char buf[FILE_SIZE];
+  int round;
+  int i;
+
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  start = uv_hrtime();
+  for (round = 0; round < ROUNDS; round++) {
+    for (i = 0; i < FILE_COUNT; i++) {
+      file_name(name, i);
+      err = uvwasi_path_open(uvwasi,
+                             3,
+                             0,
+                             name,
+                             strlen(name) + 1,
+                             0,
+                             UVWASI_RIGHT_FD_READ,
+                             0,
+                             0,
+                             &fd);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+      err = uvwasi_fd_read(uvwasi, fd, &iov, 1, &n);
+      BENCH_CHECK(err == UVWASI_ESUCCESS && n == FILE_SIZE);
+      err = uvwasi_fd_close(uvwasi, fd);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+    }
+  }
+
+  snprintf(name, sizeof(name), "%s/path_open+fd_read+fd_close", backend);
+  bench_report_bytes(name,
+                     ROUNDS * FILE_COUNT,
+                     (uint64_t) ROUNDS * FILE_COUNT * FILE_SIZE,
+                     uv_hrtime() - start);
+
+  start = uv_hrtime();
+  for (round = 0; round < ROUNDS; round++) {
+    for (i = 0; i < FILE_COUNT; i++) {
+      file_name(name, i);
+      err = uvwasi_path_filestat_get(uvwasi,
+                                     3,
+                                     0,
+                                     name,
+                                     strlen(name) + 1,
+                                     &stat);
+      BENCH_CHECK(err == UVWASI_ESUCCESS);
+    }
+  }
+
+  snprintf(name, sizeof(name), "%s/path_filestat_get", backend);
+  bench_report(name, ROUNDS * FILE_COUNT, uv_hrtime() - start);
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_pack_t* pack;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+
+  memset(contents, 'x', sizeof(contents));
+  r = uv_fs_mkdir(NULL, &req, "./out", 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+  r = uv_fs_mkdir(NULL, &req, BENCH_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  BENCH_CHECK(r == 0 || r == UV_EEXIST);
+  create_tree();
+  create_image();
+
+  uvwasi_options_init(&init_options);
+  init_options.immutable_preopenc = 1;
+  init_options.immutable_preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  BENCH_CHECK(init_options.immutable_preopens != NULL);
+  init_options.immutable_preopens[0].mapped_path = "/lib";
+  init_options.immutable_preopens[0].real_path = SRC_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_tree(&uvwasi, "host");
+  bench_destroy_sandbox(&uvwasi, &init_options);
+
+  err = uvwasi_pack_open(IMAGE, NULL, &pack);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  uvwasi_options_init(&init_options);
+  init_options.preopen_vfsc = 1;
+  init_options.preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  BENCH_CHECK(init_options.preopen_vfs != NULL);
+  init_options.preopen_vfs[0].mapped_path = "/lib";
+  init_options.preopen_vfs[0].vfs = uvwasi_pack_vfs(pack);
+  init_options.preopen_vfs[0].immutable = 1;
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  bench_tree(&uvwasi, "pack");
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  err = uvwasi_pack_free(pack);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  remove_tree();
+  uv_fs_unlink(NULL, &req, IMAGE, NULL);
+  uv_fs_req_cleanup(&req);
+  return 0;
+}
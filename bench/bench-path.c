@@ -0,0 +1,110 @@
+#include <string.h>
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ITERATIONS 200000
+
+static void bench_open_close(uvwasi_t* uvwasi, const char* path) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uint64_t start;
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_path_open(uvwasi,
+                           3,
+                           0,
+                           path,
+                           strlen(path) + 1,
+                           0,
+                           UVWASI_RIGHT_FD_READ,
+                           0,
+                           0,
+                           &fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+    err = uvwasi_fd_close(uvwasi, fd);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_report("path_open+fd_close", ITERATIONS, uv_hrtime() - start);
+}
+
+static void bench_filestat(uvwasi_t* uvwasi,
+                           const char* name,
+                           const char* path,
+                           uvwasi_lookupflags_t flags) {
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_path_filestat_get(uvwasi,
+                                   3,
+                                   flags,
+                                   path,
+                                   strlen(path) + 1,
+                                   &stat);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+}
+
+int main(void) {
+  const char* dirs[] = { "path-a", "path-a/b", "path-a/b/c" };
+  const char* file = "path-a/b/c/file.txt";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  int i;
+
+  uvwasi_options_init(&init_options);
+  bench_init_sandbox(&uvwasi, &init_options);
+
+  for (i = 0; i < 3; i++) {
+    err = uvwasi_path_create_directory(&uvwasi,
+                                       3,
+                                       dirs[i],
+                                       strlen(dirs[i]) + 1);
+    BENCH_CHECK(err == UVWASI_ESUCCESS || err == UVWASI_EEXIST);
+  }
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         file,
+                         strlen(file) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  err = uvwasi_fd_close(&uvwasi, fd);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  bench_open_close(&uvwasi, file);
+  bench_filestat(&uvwasi, "path_filestat_get/dir", dirs[0], 0);
+  bench_filestat(&uvwasi, "path_filestat_get/nested", file, 0);
+  bench_filestat(&uvwasi,
+                 "path_filestat_get/nested_follow",
+                 file,
+                 UVWASI_LOOKUP_SYMLINK_FOLLOW);
+
+  err = uvwasi_path_unlink_file(&uvwasi, 3, file, strlen(file) + 1);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+  for (i = 2; i >= 0; i--) {
+    err = uvwasi_path_remove_directory(&uvwasi,
+                                       3,
+                                       dirs[i],
+                                       strlen(dirs[i]) + 1);
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_destroy_sandbox(&uvwasi, &init_options);
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ITERATIONS 20000
+#define MAX_SUBSCRIPTIONS 256
+
+static uvwasi_subscription_t subs[MAX_SUBSCRIPTIONS];
+static uvwasi_event_t events[MAX_SUBSCRIPTIONS];
+
+static void bench_poll(uvwasi_t* uvwasi,
+                       const char* kind,
+                       uvwasi_size_t nsubs) {
+  uvwasi_size_t nevents;
+  uvwasi_errno_t err;
+  uint64_t start;
+  char name[64];
+  int i;
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_poll_oneoff(uvwasi, subs, events, nsubs, &nevents);
+    BENCH_CHECK(err == UVWASI_ESUCCESS && nevents > 0);
+  }
+
+  snprintf(name, sizeof(name), "poll_oneoff/%s_%u", kind, (unsigned) nsubs);
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+}
+
+int main(void) {
+  static const uvwasi_size_t counts[] = { 1, 16, 256 };
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  size_t i;
+  size_t j;
+#ifndef _WIN32
+  uv_file fds[2];
+  uv_fs_t req;
+  int r;
+#endif
+
+  uvwasi_options_init(&init_options);
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  /* Relative clock subscriptions that expire immediately. */
+  for (i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+    subs[i].userdata = i;
+    subs[i].type = UVWASI_EVENTTYPE_CLOCK;
+    subs[i].u.clock.clock_id = UVWASI_CLOCK_MONOTONIC;
+    subs[i].u.clock.timeout = 0;
+    subs[i].u.clock.precision = 1;
+    subs[i].u.clock.flags = 0;
+  }
+
+  for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    bench_poll(&uvwasi, "clock", counts[i]);
+
+#ifndef _WIN32
+  /* Writability of an empty pipe, which is always ready. stdout is remapped to
+     the pipe so that the fd has the required rights. */
+  r = uv_pipe(fds, 0, 0);
+  BENCH_CHECK(r == 0);
+  err = uvwasi_embedder_remap_fd(&uvwasi, 1, fds[1]);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    for (j = 0; j < counts[i]; j++) {
+      subs[j].userdata = j;
+      subs[j].type = UVWASI_EVENTTYPE_FD_WRITE;
+      subs[j].u.fd_readwrite.fd = 1;
+    }
+    bench_poll(&uvwasi, "fd_write", counts[i]);
+  }
+
+  uv_fs_close(NULL, &req, fds[0], NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_close(NULL, &req, fds[1], NULL);
+  uv_fs_req_cleanup(&req);
+#else
+  (void) j;
+#endif
+
+  uvwasi_destroy(&uvwasi);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#include "uvwasi.h"
+#include "bench-common.h"
+
+#define ITERATIONS 1000000
+#define REQUEST_SIZE 16
+
+static void bench_random(const char* name, uvwasi_size_t buffer_size) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  unsigned char buf[REQUEST_SIZE];
+  uvwasi_errno_t err;
+  uint64_t start;
+  int i;
+
+  uvwasi_options_init(&init_options);
+  init_options.random_buffer_size = buffer_size;
+  err = uvwasi_init(&uvwasi, &init_options);
+  BENCH_CHECK(err == UVWASI_ESUCCESS);
+
+  start = uv_hrtime();
+  for (i = 0; i < ITERATIONS; i++) {
+    err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+    BENCH_CHECK(err == UVWASI_ESUCCESS);
+  }
+
+  bench_report(name, ITERATIONS, uv_hrtime() - start);
+  uvwasi_destroy(&uvwasi);
+}
+
+int main(void) {
+  bench_random("random_get/16b_kernel", 0);
+  bench_random("random_get/16b_buffered_1k", 1024);
+  bench_random("random_get/16b_buffered_4k", 4096);
+  return 0;
+}
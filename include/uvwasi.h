@@ -35,7 +35,347 @@ typedef struct uvwasi_mem_s {
   uvwasi_realloc realloc;
 } uvwasi_mem_t;
 
+typedef uvwasi_errno_t (*uvwasi_clock_gettime)(uvwasi_clockid_t clock_id,
+                                               uvwasi_timestamp_t precision,
+                                               uvwasi_timestamp_t* time,
+                                               void* clock_user_data);
+typedef uvwasi_errno_t (*uvwasi_clock_getres)(uvwasi_clockid_t clock_id,
+                                              uvwasi_timestamp_t* resolution,
+                                              void* clock_user_data);
+
+typedef struct uvwasi_clock_s {
+  void* clock_user_data;
+  uvwasi_clock_gettime gettime;
+  uvwasi_clock_getres getres;
+} uvwasi_clock_t;
+
+/* A file system served to the sandbox in place of a host directory, selected
+   per preopen through uvwasi_preopen_vfs_t.vfs. Paths are absolute within the
+   file system, start with '/', and have already been normalized and checked
+   against the sandbox. Files are identified by the handles that open()
+   returns. stat() does not follow a final symbolic link. readdir() stores the
+   entry at position cookie in dirent, except for d_next, and copies at most
+   name_size bytes of its name into name. d_namlen is the full length of the
+   name, and is 0 past the last entry. readlink() copies at most buf_len bytes
+   of the target into buf. fset_times() and set_times() receive
+   UVWASI_FILESTAT_SET_ATIM and UVWASI_FILESTAT_SET_MTIM only, with the
+   current time already filled in where it was asked for, and set_times() does
+   not follow a final symbolic link. open, close and fstat are required. Any
+   other function may be NULL, in which case the operation fails with
+   UVWASI_ENOTSUP. */
+typedef uvwasi_errno_t (*uvwasi_vfs_open)(const char* path,
+                                          uvwasi_oflags_t oflags,
+                                          uvwasi_fdflags_t fdflags,
+                                          int writable,
+                                          void** file,
+                                          void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_close)(void* file, void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_fstat)(void* file,
+                                           uvwasi_filestat_t* buf,
+                                           void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_stat)(const char* path,
+                                          uvwasi_filestat_t* buf,
+                                          void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_pread)(void* file,
+                                           const uvwasi_iovec_t* iovs,
+                                           uvwasi_size_t iovs_len,
+                                           uvwasi_filesize_t offset,
+                                           uvwasi_size_t* nread,
+                                           void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_pwrite)(void* file,
+                                            const uvwasi_ciovec_t* iovs,
+                                            uvwasi_size_t iovs_len,
+                                            uvwasi_filesize_t offset,
+                                            uvwasi_size_t* nwritten,
+                                            void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_set_size)(void* file,
+                                              uvwasi_filesize_t size,
+                                              void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_readdir)(void* file,
+                                             uvwasi_dircookie_t cookie,
+                                             uvwasi_dirent_t* dirent,
+                                             char* name,
+                                             uvwasi_size_t name_size,
+                                             void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_path_op)(const char* path,
+                                             void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_rename)(const char* old_path,
+                                            const char* new_path,
+                                            void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_readlink)(const char* path,
+                                              char* buf,
+                                              uvwasi_size_t buf_len,
+                                              uvwasi_size_t* bufused,
+                                              void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_symlink)(const char* target,
+                                             const char* path,
+                                             void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_fset_times)(void* file,
+                                                uvwasi_timestamp_t atim,
+                                                uvwasi_timestamp_t mtim,
+                                                uvwasi_fstflags_t fst_flags,
+                                                void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_set_times)(const char* path,
+                                               uvwasi_timestamp_t atim,
+                                               uvwasi_timestamp_t mtim,
+                                               uvwasi_fstflags_t fst_flags,
+                                               void* vfs_user_data);
+typedef uvwasi_errno_t (*uvwasi_vfs_link)(const char* old_path,
+                                          const char* new_path,
+                                          void* vfs_user_data);
+
+typedef struct uvwasi_vfs_s {
+  void* vfs_user_data;
+  uvwasi_vfs_open open;
+  uvwasi_vfs_close close;
+  uvwasi_vfs_fstat fstat;
+  uvwasi_vfs_stat stat;
+  uvwasi_vfs_pread pread;
+  uvwasi_vfs_pwrite pwrite;
+  uvwasi_vfs_set_size set_size;
+  uvwasi_vfs_readdir readdir;
+  uvwasi_vfs_path_op mkdir;
+  uvwasi_vfs_path_op rmdir;
+  uvwasi_vfs_path_op unlink;
+  uvwasi_vfs_rename rename;
+  uvwasi_vfs_readlink readlink;
+  uvwasi_vfs_symlink symlink;
+  uvwasi_vfs_fset_times fset_times;
+  uvwasi_vfs_set_times set_times;
+  uvwasi_vfs_link link;
+} uvwasi_vfs_t;
+
+/* All WASI system calls implemented by uvwasi, in the order of the WASI
+   specification. */
+#define UVWASI_SYSCALL_MAP(XX)                                                \
+  XX(ARGS_GET, args_get)                                                      \
+  XX(ARGS_SIZES_GET, args_sizes_get)                                          \
+  XX(CLOCK_RES_GET, clock_res_get)                                            \
+  XX(CLOCK_TIME_GET, clock_time_get)                                          \
+  XX(ENVIRON_GET, environ_get)                                                \
+  XX(ENVIRON_SIZES_GET, environ_sizes_get)                                    \
+  XX(FD_ADVISE, fd_advise)                                                    \
+  XX(FD_ALLOCATE, fd_allocate)                                                \
+  XX(FD_CLOSE, fd_close)                                                      \
+  XX(FD_DATASYNC, fd_datasync)                                                \
+  XX(FD_FDSTAT_GET, fd_fdstat_get)                                            \
+  XX(FD_FDSTAT_SET_FLAGS, fd_fdstat_set_flags)                                \
+  XX(FD_FDSTAT_SET_RIGHTS, fd_fdstat_set_rights)                              \
+  XX(FD_FILESTAT_GET, fd_filestat_get)                                        \
+  XX(FD_FILESTAT_SET_SIZE, fd_filestat_set_size)                              \
+  XX(FD_FILESTAT_SET_TIMES, fd_filestat_set_times)                            \
+  XX(FD_PREAD, fd_pread)                                                      \
+  XX(FD_PRESTAT_GET, fd_prestat_get)                                          \
+  XX(FD_PRESTAT_DIR_NAME, fd_prestat_dir_name)                                \
+  XX(FD_PWRITE, fd_pwrite)                                                    \
+  XX(FD_READ, fd_read)                                                        \
+  XX(FD_READDIR, fd_readdir)                                                  \
+  XX(FD_RENUMBER, fd_renumber)                                                \
+  XX(FD_SEEK, fd_seek)                                                        \
+  XX(FD_SYNC, fd_sync)                                                        \
+  XX(FD_TELL, fd_tell)                                                        \
+  XX(FD_WRITE, fd_write)                                                      \
+  XX(PATH_CREATE_DIRECTORY, path_create_directory)                            \
+  XX(PATH_FILESTAT_GET, path_filestat_get)                                    \
+  XX(PATH_FILESTAT_SET_TIMES, path_filestat_set_times)                        \
+  XX(PATH_LINK, path_link)                                                    \
+  XX(PATH_OPEN, path_open)                                                    \
+  XX(PATH_READLINK, path_readlink)                                            \
+  XX(PATH_REMOVE_DIRECTORY, path_remove_directory)                            \
+  XX(PATH_RENAME, path_rename)                                                \
+  XX(PATH_SYMLINK, path_symlink)                                              \
+  XX(PATH_UNLINK_FILE, path_unlink_file)                                      \
+  XX(POLL_ONEOFF, poll_oneoff)                                                \
+  XX(PROC_EXIT, proc_exit)                                                    \
+  XX(PROC_RAISE, proc_raise)                                                  \
+  XX(RANDOM_GET, random_get)                                                  \
+  XX(SCHED_YIELD, sched_yield)                                                \
+  XX(SOCK_ACCEPT, sock_accept)                                                \
+  XX(SOCK_RECV, sock_recv)                                                    \
+  XX(SOCK_SEND, sock_send)                                                    \
+  XX(SOCK_SHUTDOWN, sock_shutdown)                                            \
+
+typedef enum {
+#define XX(uc, lc) UVWASI_SYSCALL_##uc,
+  UVWASI_SYSCALL_MAP(XX)
+#undef XX
+  UVWASI_SYSCALL_MAX
+} uvwasi_syscall_t;
+
+/* Bucket i of a latency histogram counts calls that took [2^i, 2^(i+1))
+   nanoseconds. The first bucket also counts calls under 1ns and the last
+   bucket counts everything above. */
+#define UVWASI_STATS_LATENCY_BUCKETS 32
+
+typedef struct uvwasi_syscall_stats_s {
+  uint64_t calls;
+  uint64_t errors;
+  uint64_t bytes;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t latency[UVWASI_STATS_LATENCY_BUCKETS];
+} uvwasi_syscall_stats_t;
+
+typedef struct uvwasi_stats_s {
+  uvwasi_syscall_stats_t syscalls[UVWASI_SYSCALL_MAX];
+} uvwasi_stats_t;
+
+/* A single traced system call. fd is UVWASI_TRACE_NO_FD for calls that do not
+   take a file descriptor. arg holds the call's most significant scalar
+   argument (a length, offset, flag set or clock id), and result holds its
+   scalar output on success (bytes transferred, a new fd or offset, a time).
+   thread identifies the recording thread within the sandbox. */
+#define UVWASI_TRACE_NO_FD ((uvwasi_fd_t) -1)
+
+typedef struct uvwasi_trace_event_s {
+  uint64_t start_ns;
+  uint64_t end_ns;
+  uint64_t arg;
+  uint64_t result;
+  uvwasi_fd_t fd;
+  uint32_t thread;
+  uint16_t syscall;
+  uint16_t error;
+  uint32_t reserved;
+} uvwasi_trace_event_t;
+
+/* Header for trace files written by embedders and read by the
+   uvwasi-trace-decode tool. It is followed by event_size byte events in the
+   host's byte order. */
+#define UVWASI_TRACE_MAGIC "UVWTRACE"
+#define UVWASI_TRACE_VERSION 1
+
+typedef struct uvwasi_trace_header_s {
+  char magic[8];
+  uint32_t version;
+  uint32_t event_size;
+} uvwasi_trace_header_t;
+
+/* Recordings written by uvwasi_record_start() and replayed by the
+   uvwasi-replay tool start with a header, followed by one
+   (fd uint64_t, mapped path) pair per preopened directory and then one entry
+   per system call, all in the host's byte order. Each entry is followed by
+   size bytes of arguments, stored in parameter order. Scalars are stored as
+   uint64_t, input buffers such as paths and data to write as a uint32_t
+   length followed by the bytes, output buffers as a uint64_t length, and
+   iovec arrays as a uint64_t count followed by each buffer. Preopen paths use
+   the input buffer encoding, and poll_oneoff() subscriptions are stored as one
+   input buffer. Output-only arguments are not stored. start_ns is relative to
+   the start of the recording, and result holds the same value as
+   uvwasi_trace_event_t.result. */
+#define UVWASI_RECORD_MAGIC "UVWASREC"
+#define UVWASI_RECORD_VERSION 1
+
+typedef struct uvwasi_record_header_s {
+  char magic[8];
+  uint32_t version;
+  uint32_t preopenc;
+} uvwasi_record_header_t;
+
+typedef struct uvwasi_record_entry_s {
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint64_t result;
+  uint16_t syscall;
+  uint16_t error;
+  uint32_t size;
+} uvwasi_record_entry_t;
+
+/* Packed images read by uvwasi_pack_open() and written by the uvwasi-pack
+   tool, in the host's byte order. A header is followed by node_count nodes
+   and then by the names and contents they refer to. Node 0 is the root
+   directory. The children of a directory are the nodes offset to
+   offset + size - 1, sorted by name in byte order, and come after it. For
+   regular files and symbolic links, offset and size locate the contents or
+   the link target in the image. name_offset and name_len locate the name in
+   the image, and parent is the index of the directory holding the node. */
+#define UVWASI_PACK_MAGIC "UVWASPAK"
+#define UVWASI_PACK_VERSION 1
+
+typedef struct uvwasi_pack_header_s {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_count;
+} uvwasi_pack_header_t;
+
+typedef struct uvwasi_pack_node_s {
+  uint64_t offset;
+  uint64_t size;
+  uvwasi_timestamp_t mtim;
+  uint32_t name_offset;
+  uint32_t name_len;
+  uint32_t parent;
+  uvwasi_filetype_t type;
+  uint8_t reserved[3];
+} uvwasi_pack_node_t;
+
+/* Lock contention statistics. An acquisition is contended when the lock could
+   not be taken immediately, and wait_ns is the time spent waiting for it.
+   hot_fds holds up to UVWASI_LOCK_STATS_HOT_FDS open fds with contended
+   acquisitions, in descending order of wait time. */
+#define UVWASI_LOCK_STATS_HOT_FDS 8
+
+typedef struct uvwasi_lock_class_stats_s {
+  uint64_t acquisitions;
+  uint64_t contended;
+  uint64_t wait_ns;
+  uint64_t max_wait_ns;
+} uvwasi_lock_class_stats_t;
+
+typedef struct uvwasi_fd_lock_stats_s {
+  uint64_t contended;
+  uint64_t wait_ns;
+  uvwasi_fd_t fd;
+  uint32_t reserved;
+} uvwasi_fd_lock_stats_t;
+
+typedef struct uvwasi_lock_stats_s {
+  uvwasi_lock_class_stats_t fd_table;
+  uvwasi_lock_class_stats_t fd;
+  uvwasi_size_t hot_fd_count;
+  uvwasi_fd_lock_stats_t hot_fds[UVWASI_LOCK_STATS_HOT_FDS];
+} uvwasi_lock_stats_t;
+
+/* Memory held by a sandbox. Byte counts are the sizes requested by uvwasi and
+   do not include allocator overhead. allocations counts every allocation
+   made, live_allocations those not yet freed, and failures those refused
+   because they would have exceeded the sandbox's memory limit. */
+typedef struct uvwasi_mem_stats_s {
+  uint64_t current_bytes;
+  uint64_t peak_bytes;
+  uint64_t allocations;
+  uint64_t live_allocations;
+  uint64_t failures;
+} uvwasi_mem_stats_t;
+
+/* A process-wide cache of the contents of read-only files, shared by the
+   sandboxes that are given it in uvwasi_options_t.file_cache. */
+typedef struct uvwasi_file_cache_s uvwasi_file_cache_t;
+
+/* A file system held in process memory, for use as a uvwasi_vfs_t. */
+typedef struct uvwasi_memfs_s uvwasi_memfs_t;
+
+/* A read-only file system served from a packed image, for use as a
+   uvwasi_vfs_t. */
+typedef struct uvwasi_pack_s uvwasi_pack_t;
+
+/* entries and bytes describe the files currently cached. hits and misses
+   count the opens that found, or did not find, their file in the cache, and
+   evictions the files dropped to stay within the cache's size limit. */
+typedef struct uvwasi_file_cache_stats_s {
+  uint64_t entries;
+  uint64_t bytes;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} uvwasi_file_cache_stats_t;
+
 struct uvwasi_fd_table_t;
+struct uvwasi_mem_account_t;
+struct uvwasi_record_t;
+struct uvwasi_rng_t;
+struct uvwasi_stdio_t;
+struct uvwasi_trace_t;
 
 typedef struct uvwasi_s {
   struct uvwasi_fd_table_t* fds;
@@ -47,8 +387,24 @@ typedef struct uvwasi_s {
   char** env;
   char* env_buf;
   uvwasi_size_t env_buf_size;
+  struct uvwasi_args_t* args;
   const uvwasi_mem_t* allocator;
+  struct uvwasi_mem_account_t* mem_account;
+  const uvwasi_clock_t* clock;
   uv_loop_t* loop;
+  uvwasi_timestamp_t clock_res[4];
+  uvwasi_timestamp_t coarse_clock_res[2];
+  uvwasi_timestamp_t monotonic_last;
+  uint32_t monotonic_coarse_used;
+  struct uvwasi_rng_t* rng;
+  uvwasi_stats_t* stats;
+  struct uvwasi_trace_t* trace;
+  struct uvwasi_record_t* record;
+  int filestat_dont_sync;
+  uvwasi_timestamp_t filestat_cache_ttl;
+  uvwasi_size_t mmap_window_size;
+  uvwasi_file_cache_t* file_cache;
+  struct uvwasi_stdio_t* stdio;
 } uvwasi_t;
 
 typedef struct uvwasi_preopen_s {
@@ -56,6 +412,12 @@ typedef struct uvwasi_preopen_s {
   const char* real_path;
 } uvwasi_preopen_t;
 
+typedef struct uvwasi_preopen_vfs_s {
+  const char* mapped_path;
+  const uvwasi_vfs_t* vfs;
+  int immutable;
+} uvwasi_preopen_vfs_t;
+
 typedef struct uvwasi_preopen_socket_s {
   const char* address;
   int port;
@@ -67,6 +429,10 @@ typedef struct uvwasi_options_s {
   uvwasi_preopen_t* preopens;
   uvwasi_size_t preopen_socketc;
   uvwasi_preopen_socket_t* preopen_sockets;
+  uvwasi_size_t immutable_preopenc;
+  uvwasi_preopen_t* immutable_preopens;
+  uvwasi_size_t preopen_vfsc;
+  uvwasi_preopen_vfs_t* preopen_vfs;
   uvwasi_size_t argc;
   const char** argv;
   const char** envp;
@@ -74,6 +440,22 @@ typedef struct uvwasi_options_s {
   uvwasi_fd_t out;
   uvwasi_fd_t err;
   const uvwasi_mem_t* allocator;
+  const uvwasi_clock_t* clock;
+  uvwasi_size_t random_buffer_size;
+  int enable_stats;
+  uvwasi_size_t trace_buffer_size;
+  int enable_record;
+  int enable_lock_stats;
+  int enable_mem_stats;
+  uint64_t mem_limit;
+  int filestat_dont_sync;
+  uvwasi_timestamp_t filestat_cache_ttl;
+  uvwasi_size_t mmap_window_size;
+  uvwasi_file_cache_t* file_cache;
+  uvwasi_size_t stdio_buffer_size;
+  int stdio_line_buffered;
+  int stdio_ordered;
+  uvwasi_timestamp_t stdio_flush_interval;
 } uvwasi_options_t;
 
 /* Embedder API. */
@@ -82,6 +464,8 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options);
 UVWASI_EXPORT
 void uvwasi_destroy(uvwasi_t* uvwasi);
 UVWASI_EXPORT
+uvwasi_errno_t uvwasi_clone(uvwasi_t* dst, const uvwasi_t* src);
+UVWASI_EXPORT
 void uvwasi_options_init(uvwasi_options_t* options);
 /* Use int instead of uv_file to avoid needing uv.h */
 UVWASI_EXPORT
@@ -90,6 +474,69 @@ uvwasi_errno_t uvwasi_embedder_remap_fd(uvwasi_t* uvwasi,
                                         int new_host_fd);
 UVWASI_EXPORT
 const char* uvwasi_embedder_err_code_to_string(uvwasi_errno_t code);
+UVWASI_EXPORT
+const char* uvwasi_embedder_syscall_name(uvwasi_syscall_t syscall);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_stats_get(const uvwasi_t* uvwasi, uvwasi_stats_t* stats);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_stats_reset(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_trace_enable(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_trace_disable(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_trace_drain(uvwasi_t* uvwasi,
+                                  uvwasi_trace_event_t* events,
+                                  uvwasi_size_t nevents,
+                                  uvwasi_size_t* ndrained);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_trace_dropped(const uvwasi_t* uvwasi, uint64_t* dropped);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_record_start(uvwasi_t* uvwasi, const char* path);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_record_stop(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_lock_stats_get(const uvwasi_t* uvwasi,
+                                     uvwasi_lock_stats_t* stats);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_lock_stats_reset(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_mem_stats_get(const uvwasi_t* uvwasi,
+                                    uvwasi_mem_stats_t* stats);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_file_cache_new(uint64_t size_limit,
+                                     const uvwasi_mem_t* allocator,
+                                     uvwasi_file_cache_t** cache);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_file_cache_free(uvwasi_file_cache_t* cache);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_file_cache_stats_get(uvwasi_file_cache_t* cache,
+                                           uvwasi_file_cache_stats_t* stats);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_memfs_new(const uvwasi_mem_t* allocator,
+                                uint64_t size_limit,
+                                uvwasi_memfs_t** memfs);
+UVWASI_EXPORT
+const uvwasi_vfs_t* uvwasi_memfs_vfs(uvwasi_memfs_t* memfs);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_memfs_free(uvwasi_memfs_t* memfs);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_pack_open(const char* path,
+                                const uvwasi_mem_t* allocator,
+                                uvwasi_pack_t** pack);
+UVWASI_EXPORT
+const uvwasi_vfs_t* uvwasi_pack_vfs(uvwasi_pack_t* pack);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_pack_free(uvwasi_pack_t* pack);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_stdio_flush(uvwasi_t* uvwasi);
+UVWASI_EXPORT
+uvwasi_errno_t uvwasi_fd_copy(uvwasi_t* uvwasi,
+                              uvwasi_fd_t in_fd,
+                              uvwasi_fd_t out_fd,
+                              uvwasi_filesize_t offset,
+                              uvwasi_filesize_t len,
+                              uvwasi_filesize_t* copied);
 
 
 /* WASI system call API. */
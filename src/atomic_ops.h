@@ -0,0 +1,97 @@
+#ifndef __UVWASI_ATOMIC_OPS_H__
+#define __UVWASI_ATOMIC_OPS_H__
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+# include <intrin.h>
+#endif
+
+/* Relaxed atomics for statistics counters and flags, plus acquire/release
+   loads and stores for single producer, single consumer ring buffers. Relaxed
+   operations imply no ordering with other memory operations. The acq_rel
+   decrement returns the new value, for reference counts whose last release
+   frees what they count. */
+
+#if defined(__GNUC__) || defined(__clang__)
+
+# define uvwasi__atomic_add_u64(p, v)                                         \
+    ((void) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED))
+# define uvwasi__atomic_sub_u64(p, v)                                         \
+    ((void) __atomic_fetch_sub((p), (v), __ATOMIC_RELAXED))
+# define uvwasi__atomic_load_u64(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+# define uvwasi__atomic_store_u64(p, v)                                       \
+    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+# define uvwasi__atomic_cas_u64(p, expected, desired)                         \
+    __atomic_compare_exchange_n((p),                                          \
+                                (expected),                                   \
+                                (desired),                                    \
+                                1,                                            \
+                                __ATOMIC_RELAXED,                             \
+                                __ATOMIC_RELAXED)
+# define uvwasi__atomic_load_acquire_u64(p)                                   \
+    __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define uvwasi__atomic_store_release_u64(p, v)                               \
+    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+# define uvwasi__atomic_sub_fetch_acq_rel_u64(p, v)                           \
+    __atomic_sub_fetch((p), (v), __ATOMIC_ACQ_REL)
+# define uvwasi__atomic_load_u32(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+# define uvwasi__atomic_store_u32(p, v)                                       \
+    __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+#elif defined(_MSC_VER)
+
+# define uvwasi__atomic_add_u64(p, v)                                         \
+    ((void) _InterlockedExchangeAdd64((volatile __int64*) (p), (__int64) (v)))
+# define uvwasi__atomic_sub_u64(p, v)                                         \
+    ((void) _InterlockedExchangeAdd64((volatile __int64*) (p),                \
+                                      -(__int64) (v)))
+# define uvwasi__atomic_load_u64(p)                                           \
+    ((uint64_t) _InterlockedOr64((volatile __int64*) (p), 0))
+# define uvwasi__atomic_store_u64(p, v)                                       \
+    ((void) _InterlockedExchange64((volatile __int64*) (p), (__int64) (v)))
+/* The interlocked intrinsics are full barriers. */
+# define uvwasi__atomic_load_acquire_u64(p) uvwasi__atomic_load_u64(p)
+# define uvwasi__atomic_store_release_u64(p, v) uvwasi__atomic_store_u64(p, v)
+# define uvwasi__atomic_sub_fetch_acq_rel_u64(p, v)                           \
+    ((uint64_t) _InterlockedExchangeAdd64((volatile __int64*) (p),            \
+                                          -(__int64) (v)) - (v))
+# define uvwasi__atomic_load_u32(p)                                           \
+    ((uint32_t) _InterlockedOr((volatile long*) (p), 0))
+# define uvwasi__atomic_store_u32(p, v)                                       \
+    ((void) _InterlockedExchange((volatile long*) (p), (long) (v)))
+
+static __inline int uvwasi__atomic_cas_u64(uint64_t* p,
+                                           uint64_t* expected,
+                                           uint64_t desired) {
+  uint64_t prev;
+
+  prev = (uint64_t) _InterlockedCompareExchange64((volatile __int64*) p,
+                                                  (__int64) desired,
+                                                  (__int64) *expected);
+  if (prev == *expected)
+    return 1;
+
+  *expected = prev;
+  return 0;
+}
+
+#else
+
+/* Without compiler support concurrent updates may be lost. */
+# define uvwasi__atomic_add_u64(p, v) ((void) (*(p) += (v)))
+# define uvwasi__atomic_sub_u64(p, v) ((void) (*(p) -= (v)))
+# define uvwasi__atomic_load_u64(p) (*(p))
+# define uvwasi__atomic_store_u64(p, v) ((void) (*(p) = (v)))
+# define uvwasi__atomic_cas_u64(p, expected, desired)                         \
+    (*(p) == *(expected) ? (*(p) = (desired), 1) : (*(expected) = *(p), 0))
+# define uvwasi__atomic_load_acquire_u64(p) (*(volatile uint64_t*) (p))
+# define uvwasi__atomic_store_release_u64(p, v)                               \
+    ((void) (*(volatile uint64_t*) (p) = (v)))
+# define uvwasi__atomic_sub_fetch_acq_rel_u64(p, v) (*(p) -= (v))
+# define uvwasi__atomic_load_u32(p) (*(p))
+# define uvwasi__atomic_store_u32(p, v) ((void) (*(p) = (v)))
+
+#endif
+
+#endif /* __UVWASI_ATOMIC_OPS_H__ */
@@ -5,10 +5,52 @@
 # include <time.h>
 #endif /* _WIN32 */
 
+#if defined(__APPLE__)
+# include <AvailabilityMacros.h>
+#endif /* defined(__APPLE__) */
+
 #include "uv.h"
+#include "uvwasi.h"
 #include "clocks.h"
 #include "wasi_types.h"
 #include "uv_mapping.h"
+#include "atomic_ops.h"
+
+
+/* Coarse clocks are served from the last timer tick instead of reading the
+   clocksource, which makes them much cheaper to query at the cost of a
+   resolution of one tick (typically 1-4 ms). */
+#if defined(CLOCK_REALTIME_COARSE) && defined(CLOCK_MONOTONIC_COARSE)
+# define UVWASI__CLOCK_REALTIME_COARSE CLOCK_REALTIME_COARSE
+# define UVWASI__CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC_COARSE
+#elif defined(CLOCK_REALTIME_FAST) && defined(CLOCK_MONOTONIC_FAST)
+# define UVWASI__CLOCK_REALTIME_COARSE CLOCK_REALTIME_FAST
+# define UVWASI__CLOCK_MONOTONIC_COARSE CLOCK_MONOTONIC_FAST
+#endif
+
+
+/* clock_gettime() is much cheaper than getrusage() for the CPU time clocks, and
+   has better resolution. Some platforms (such as SmartOS) define the clock ids
+   without supporting them, so they are also probed once at runtime. macOS only
+   provides clock_gettime() starting with 10.12. */
+#if defined(CLOCK_PROCESS_CPUTIME_ID) &&                                      \
+    (!defined(__APPLE__) ||                                                   \
+     (defined(MAC_OS_X_VERSION_MIN_REQUIRED) &&                               \
+      MAC_OS_X_VERSION_MIN_REQUIRED >= 101200))
+# define UVWASI__HAVE_PROCESS_CPUTIME_CLOCK 1
+#endif
+
+#if defined(CLOCK_THREAD_CPUTIME_ID) && \
+    !defined(__APPLE__)               && \
+    !defined(__PASE__)
+# define UVWASI__HAVE_THREAD_CPUTIME_CLOCK 1
+#endif
+
+#if !defined(_WIN32)
+static uv_once_t uvwasi__cputime_clock_once = UV_ONCE_INIT;
+static int uvwasi__process_cputime_clock_ok = 0;
+static int uvwasi__thread_cputime_clock_ok = 0;
+#endif /* !defined(_WIN32) */
 
 
 #define UVWASI__WIN_TIME_AND_RETURN(handle, get_times, time)                  \
@@ -107,6 +149,201 @@
   } while (0)
 
 
+#if defined(UVWASI__CLOCK_REALTIME_COARSE)
+static uvwasi_timestamp_t uvwasi__clock_getres_coarse(clockid_t clk) {
+  struct timespec ts;
+
+  /* A resolution of zero disables the coarse clock. */
+  if (0 != clock_getres(clk, &ts))
+    return 0;
+
+  return ((uvwasi_timestamp_t)(ts.tv_sec) * NANOS_PER_SEC) + ts.tv_nsec;
+}
+#endif /* defined(UVWASI__CLOCK_REALTIME_COARSE) */
+
+
+#if !defined(_WIN32)
+static void uvwasi__probe_cputime_clocks(void) {
+  struct timespec ts;
+
+#if defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK)
+  uvwasi__process_cputime_clock_ok =
+    0 == clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+#endif /* defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK) */
+#if defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK)
+  uvwasi__thread_cputime_clock_ok =
+    0 == clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+#endif /* defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK) */
+  (void) ts;
+}
+#endif /* !defined(_WIN32) */
+
+
+void uvwasi__clocks_init(uvwasi_t* uvwasi) {
+  uvwasi_timestamp_t res;
+
+#if !defined(_WIN32)
+  uv_once(&uvwasi__cputime_clock_once, uvwasi__probe_cputime_clocks);
+#endif /* !defined(_WIN32) */
+
+  /* Clock resolutions are constant, so cache them for uvwasi_clock_res_get().
+     A resolution of zero marks a clock as unsupported. */
+  uvwasi->clock_res[UVWASI_CLOCK_REALTIME] = 1;  /* Nanosecond precision. */
+  uvwasi->clock_res[UVWASI_CLOCK_MONOTONIC] = 1;
+  if (uvwasi__clock_getres_process_cputime(&res) != UVWASI_ESUCCESS)
+    res = 0;
+  uvwasi->clock_res[UVWASI_CLOCK_PROCESS_CPUTIME_ID] = res;
+  if (uvwasi__clock_getres_thread_cputime(&res) != UVWASI_ESUCCESS)
+    res = 0;
+  uvwasi->clock_res[UVWASI_CLOCK_THREAD_CPUTIME_ID] = res;
+
+  /* The coarse clock resolutions do not change at runtime, so decide once per
+     instance which precisions can be served by a coarse clock. */
+#if defined(UVWASI__CLOCK_REALTIME_COARSE)
+  uvwasi->coarse_clock_res[UVWASI_CLOCK_REALTIME] =
+    uvwasi__clock_getres_coarse(UVWASI__CLOCK_REALTIME_COARSE);
+  uvwasi->coarse_clock_res[UVWASI_CLOCK_MONOTONIC] =
+    uvwasi__clock_getres_coarse(UVWASI__CLOCK_MONOTONIC_COARSE);
+#else
+  uvwasi->coarse_clock_res[UVWASI_CLOCK_REALTIME] = 0;
+  uvwasi->coarse_clock_res[UVWASI_CLOCK_MONOTONIC] = 0;
+#endif /* defined(UVWASI__CLOCK_REALTIME_COARSE) */
+  uvwasi->monotonic_last = 0;
+  uvwasi->monotonic_coarse_used = 0;
+}
+
+
+/* Raises the last monotonic value to now and returns the larger of the two. */
+static uvwasi_timestamp_t uvwasi__clock_monotonic_raise(
+                                                      uvwasi_t* uvwasi,
+                                                      uvwasi_timestamp_t now) {
+  uvwasi_timestamp_t prev;
+
+  prev = uvwasi__atomic_load_u64(&uvwasi->monotonic_last);
+  while (now > prev) {
+    if (uvwasi__atomic_cas_u64(&uvwasi->monotonic_last, &prev, now))
+      break;
+  }
+
+  return now > prev ? now : prev;
+}
+
+
+/* The coarse monotonic clock lags the precise one by up to a tick. Once an
+   instance has served a coarse read, every read is raised to the largest value
+   returned so far so that the clock never goes backwards. Until then precise
+   reads go straight to uv_hrtime() and touch no shared state. */
+static uvwasi_errno_t uvwasi__clock_gettime_monotonic(
+                                              uvwasi_t* uvwasi,
+                                              uvwasi_timestamp_t precision,
+                                              uvwasi_timestamp_t* time) {
+  uvwasi_timestamp_t now;
+  uvwasi_errno_t err;
+
+  if (uvwasi->coarse_clock_res[UVWASI_CLOCK_MONOTONIC] == 0) {
+    *time = uv_hrtime();
+    return UVWASI_ESUCCESS;
+  }
+
+  if (precision >= uvwasi->coarse_clock_res[UVWASI_CLOCK_MONOTONIC]) {
+    if (uvwasi__atomic_load_u32(&uvwasi->monotonic_coarse_used) == 0) {
+      /* Precise reads served so far were not recorded, so seed the last value
+         with a precise read taken after the flag is published. */
+      uvwasi__atomic_store_u32(&uvwasi->monotonic_coarse_used, 1);
+      uvwasi__clock_monotonic_raise(uvwasi, uv_hrtime());
+    }
+
+    err = uvwasi__clock_gettime_coarse(UVWASI_CLOCK_MONOTONIC, &now);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  } else {
+    now = uv_hrtime();
+    if (uvwasi__atomic_load_u32(&uvwasi->monotonic_coarse_used) == 0) {
+      *time = now;
+      return UVWASI_ESUCCESS;
+    }
+  }
+
+  *time = uvwasi__clock_monotonic_raise(uvwasi, now);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__clock_gettime(uvwasi_t* uvwasi,
+                                     uvwasi_clockid_t clock_id,
+                                     uvwasi_timestamp_t precision,
+                                     uvwasi_timestamp_t* time) {
+  switch (clock_id) {
+    case UVWASI_CLOCK_MONOTONIC:
+    case UVWASI_CLOCK_REALTIME:
+      /* Embedder supplied clocks replace both wall clocks. */
+      if (uvwasi->clock != NULL) {
+        return uvwasi->clock->gettime(clock_id,
+                                      precision,
+                                      time,
+                                      uvwasi->clock->clock_user_data);
+      }
+
+      if (clock_id == UVWASI_CLOCK_MONOTONIC)
+        return uvwasi__clock_gettime_monotonic(uvwasi, precision, time);
+
+      if (uvwasi->coarse_clock_res[clock_id] != 0 &&
+          precision >= uvwasi->coarse_clock_res[clock_id]) {
+        return uvwasi__clock_gettime_coarse(clock_id, time);
+      }
+
+      return uvwasi__clock_gettime_realtime(time);
+    case UVWASI_CLOCK_PROCESS_CPUTIME_ID:
+      return uvwasi__clock_gettime_process_cputime(time);
+    case UVWASI_CLOCK_THREAD_CPUTIME_ID:
+      return uvwasi__clock_gettime_thread_cputime(time);
+    default:
+      return UVWASI_EINVAL;
+  }
+}
+
+
+uvwasi_errno_t uvwasi__clock_getres(const uvwasi_t* uvwasi,
+                                    uvwasi_clockid_t clock_id,
+                                    uvwasi_timestamp_t* resolution) {
+  switch (clock_id) {
+    case UVWASI_CLOCK_MONOTONIC:
+    case UVWASI_CLOCK_REALTIME:
+      if (uvwasi->clock != NULL && uvwasi->clock->getres != NULL) {
+        return uvwasi->clock->getres(clock_id,
+                                     resolution,
+                                     uvwasi->clock->clock_user_data);
+      }
+
+      /* Fall through. */
+    case UVWASI_CLOCK_PROCESS_CPUTIME_ID:
+    case UVWASI_CLOCK_THREAD_CPUTIME_ID:
+      /* Resolutions are looked up once by uvwasi__clocks_init(). */
+      if (uvwasi->clock_res[clock_id] == 0)
+        return UVWASI_ENOSYS;
+
+      *resolution = uvwasi->clock_res[clock_id];
+      return UVWASI_ESUCCESS;
+    default:
+      return UVWASI_EINVAL;
+  }
+}
+
+
+uvwasi_errno_t uvwasi__clock_gettime_coarse(uvwasi_clockid_t clock_id,
+                                            uvwasi_timestamp_t* time) {
+#if defined(UVWASI__CLOCK_REALTIME_COARSE)
+  if (clock_id == UVWASI_CLOCK_REALTIME)
+    UVWASI__CLOCK_GETTIME_AND_RETURN(UVWASI__CLOCK_REALTIME_COARSE, *time);
+
+  if (clock_id == UVWASI_CLOCK_MONOTONIC)
+    UVWASI__CLOCK_GETTIME_AND_RETURN(UVWASI__CLOCK_MONOTONIC_COARSE, *time);
+#endif /* defined(UVWASI__CLOCK_REALTIME_COARSE) */
+
+  return UVWASI_ENOSYS;
+}
+
+
 uvwasi_errno_t uvwasi__clock_gettime_realtime(uvwasi_timestamp_t* time) {
   uv_timeval64_t tv;
   int r;
@@ -123,11 +360,11 @@ uvwasi_errno_t uvwasi__clock_gettime_realtime(uvwasi_timestamp_t* time) {
 uvwasi_errno_t uvwasi__clock_gettime_process_cputime(uvwasi_timestamp_t* time) {
 #if defined(_WIN32)
   UVWASI__WIN_TIME_AND_RETURN(GetCurrentProcess(), GetProcessTimes, *time);
-#elif defined(CLOCK_PROCESS_CPUTIME_ID) && \
-      !defined(__APPLE__)               && \
-      !defined(__sun)
-  UVWASI__CLOCK_GETTIME_AND_RETURN(CLOCK_PROCESS_CPUTIME_ID, *time);
 #else
+# if defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK)
+  if (uvwasi__process_cputime_clock_ok)
+    UVWASI__CLOCK_GETTIME_AND_RETURN(CLOCK_PROCESS_CPUTIME_ID, *time);
+# endif /* defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK) */
   UVWASI__GETRUSAGE_AND_RETURN(RUSAGE_SELF, *time);
 #endif
 }
@@ -138,9 +375,11 @@ uvwasi_errno_t uvwasi__clock_gettime_thread_cputime(uvwasi_timestamp_t* time) {
   UVWASI__WIN_TIME_AND_RETURN(GetCurrentThread(), GetThreadTimes, *time);
 #elif defined(__APPLE__)
   UVWASI__OSX_THREADTIME_AND_RETURN(*time);
-#elif defined(CLOCK_THREAD_CPUTIME_ID) && !defined(__sun) && !defined(__PASE__)
-  UVWASI__CLOCK_GETTIME_AND_RETURN(CLOCK_THREAD_CPUTIME_ID, *time);
 #else
+# if defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK)
+  if (uvwasi__thread_cputime_clock_ok)
+    UVWASI__CLOCK_GETTIME_AND_RETURN(CLOCK_THREAD_CPUTIME_ID, *time);
+# endif /* defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK) */
 # if defined(RUSAGE_LWP)
   UVWASI__GETRUSAGE_AND_RETURN(RUSAGE_LWP, *time);
 # elif defined(RUSAGE_THREAD)
@@ -155,11 +394,11 @@ uvwasi_errno_t uvwasi__clock_gettime_thread_cputime(uvwasi_timestamp_t* time) {
 uvwasi_errno_t uvwasi__clock_getres_process_cputime(uvwasi_timestamp_t* time) {
 #if defined(_WIN32)
   UVWASI__WIN_GETRES_AND_RETURN(*time);
-#elif defined(CLOCK_PROCESS_CPUTIME_ID) && \
-      !defined(__APPLE__)               && \
-      !defined(__sun)
-  UVWASI__CLOCK_GETRES_AND_RETURN(CLOCK_PROCESS_CPUTIME_ID, *time);
 #else
+# if defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK)
+  if (uvwasi__process_cputime_clock_ok)
+    UVWASI__CLOCK_GETRES_AND_RETURN(CLOCK_PROCESS_CPUTIME_ID, *time);
+# endif /* defined(UVWASI__HAVE_PROCESS_CPUTIME_CLOCK) */
   UVWASI__SLOW_GETRES_AND_RETURN(*time);
 #endif
 }
@@ -170,11 +409,15 @@ uvwasi_errno_t uvwasi__clock_getres_thread_cputime(uvwasi_timestamp_t* time) {
   UVWASI__WIN_GETRES_AND_RETURN(*time);
 #elif defined(__APPLE__)
   UVWASI__SLOW_GETRES_AND_RETURN(*time);
-#elif defined(CLOCK_THREAD_CPUTIME_ID) && !defined(__sun) && !defined(__PASE__)
-  UVWASI__CLOCK_GETTIME_AND_RETURN(CLOCK_THREAD_CPUTIME_ID, *time);
-#elif defined(RUSAGE_THREAD) || defined(RUSAGE_LWP)
-  UVWASI__SLOW_GETRES_AND_RETURN(*time);
 #else
+# if defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK)
+  if (uvwasi__thread_cputime_clock_ok)
+    UVWASI__CLOCK_GETRES_AND_RETURN(CLOCK_THREAD_CPUTIME_ID, *time);
+# endif /* defined(UVWASI__HAVE_THREAD_CPUTIME_CLOCK) */
+# if defined(RUSAGE_THREAD) || defined(RUSAGE_LWP)
+  UVWASI__SLOW_GETRES_AND_RETURN(*time);
+# else
   return UVWASI_ENOSYS;
+# endif /* defined(RUSAGE_THREAD) || defined(RUSAGE_LWP) */
 #endif
 }
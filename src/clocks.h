@@ -3,7 +3,21 @@
 
 #include "wasi_types.h"
 
+struct uvwasi_s;
+
+void uvwasi__clocks_init(struct uvwasi_s* uvwasi);
+
+uvwasi_errno_t uvwasi__clock_gettime(struct uvwasi_s* uvwasi,
+                                     uvwasi_clockid_t clock_id,
+                                     uvwasi_timestamp_t precision,
+                                     uvwasi_timestamp_t* time);
+uvwasi_errno_t uvwasi__clock_getres(const struct uvwasi_s* uvwasi,
+                                    uvwasi_clockid_t clock_id,
+                                    uvwasi_timestamp_t* resolution);
+
 uvwasi_errno_t uvwasi__clock_gettime_realtime(uvwasi_timestamp_t* time);
+uvwasi_errno_t uvwasi__clock_gettime_coarse(uvwasi_clockid_t clock_id,
+                                            uvwasi_timestamp_t* time);
 uvwasi_errno_t uvwasi__clock_gettime_process_cputime(uvwasi_timestamp_t* time);
 uvwasi_errno_t uvwasi__clock_gettime_thread_cputime(uvwasi_timestamp_t* time);
 
@@ -0,0 +1,373 @@
+#ifndef _WIN32
+# include <errno.h>
+# include <sys/mman.h>
+# include <sys/types.h>
+# include <unistd.h>
+#endif /* _WIN32 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "fd_mmap.h"
+#include "fd_table.h"
+#include "filestat.h"
+#include "uv_mapping.h"
+#include "atomic_ops.h"
+
+#ifdef _WIN32
+
+void uvwasi__fd_mmap_invalidate(struct uvwasi_fd_wrap_t* wrap) {
+}
+
+
+void uvwasi__fd_mmap_enable(const uvwasi_t* uvwasi,
+                            struct uvwasi_fd_wrap_t* wrap,
+                            int flags) {
+}
+
+
+uvwasi_errno_t uvwasi__fd_mmap_read(const uvwasi_t* uvwasi,
+                                    struct uvwasi_fd_wrap_t* wrap,
+                                    const uvwasi_iovec_t* iovs,
+                                    uvwasi_size_t iovs_len,
+                                    uint64_t pos,
+                                    uvwasi_size_t* nread) {
+  return UVWASI_ENOTSUP;
+}
+
+
+void uvwasi__fd_mmap_release(struct uvwasi_fd_cold_t* cold) {
+}
+
+#else /* _WIN32 */
+
+#define UVWASI__FD_MAP_FILE_BUCKETS 64
+
+/* A file that is mapped by some fd in the process, by (dev, ino). Sandboxes
+   may have the same file open, so these are shared by all of them. generation
+   counts the writes made to the file through fds that hold the entry. */
+struct uvwasi__fd_map_file_t {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t generation;
+  uint64_t refs;
+  struct uvwasi__fd_map_file_t* next;
+};
+
+static uv_once_t uvwasi__fd_map_once = UV_ONCE_INIT;
+static int uvwasi__fd_map_ok = 0;
+/* Guards the buckets and the entries' refs. */
+static uv_mutex_t uvwasi__fd_map_mutex;
+static struct uvwasi__fd_map_file_t*
+  uvwasi__fd_map_files[UVWASI__FD_MAP_FILE_BUCKETS];
+/* Number of fds in the process with mapping enabled. While it is zero, writes
+   do not look for mappings to invalidate. */
+static uint64_t uvwasi__fd_map_count;
+
+
+static void uvwasi__fd_map_init(void) {
+  uvwasi__fd_map_ok = uv_mutex_init(&uvwasi__fd_map_mutex) == 0;
+}
+
+
+/* Returns the entry for fd's file, taking a reference, or NULL. */
+static struct uvwasi__fd_map_file_t* uvwasi__fd_map_file_get(uv_file fd) {
+  struct uvwasi__fd_map_file_t* file;
+  uint64_t dev;
+  uint64_t ino;
+  uv_fs_t req;
+  uint32_t bucket;
+  int r;
+
+  r = uv_fs_fstat(NULL, &req, fd, NULL);
+  dev = req.statbuf.st_dev;
+  ino = req.statbuf.st_ino;
+  uv_fs_req_cleanup(&req);
+  if (r != 0)
+    return NULL;
+
+  bucket = (uint32_t) ((dev * 31 + ino) % UVWASI__FD_MAP_FILE_BUCKETS);
+  uv_mutex_lock(&uvwasi__fd_map_mutex);
+  for (file = uvwasi__fd_map_files[bucket]; file != NULL; file = file->next) {
+    if (file->dev == dev && file->ino == ino)
+      break;
+  }
+
+  if (file == NULL) {
+    /* This outlives any one sandbox, so it is not charged to one. */
+    file = calloc(1, sizeof(*file));
+    if (file != NULL) {
+      file->dev = dev;
+      file->ino = ino;
+      file->next = uvwasi__fd_map_files[bucket];
+      uvwasi__fd_map_files[bucket] = file;
+    }
+  }
+
+  if (file != NULL)
+    file->refs++;
+  uv_mutex_unlock(&uvwasi__fd_map_mutex);
+  return file;
+}
+
+
+static void uvwasi__fd_map_file_put(struct uvwasi__fd_map_file_t* file) {
+  struct uvwasi__fd_map_file_t** link;
+  uint32_t bucket;
+
+  bucket = (uint32_t) ((file->dev * 31 + file->ino) %
+                       UVWASI__FD_MAP_FILE_BUCKETS);
+  uv_mutex_lock(&uvwasi__fd_map_mutex);
+  if (--file->refs == 0) {
+    link = &uvwasi__fd_map_files[bucket];
+    while (*link != file)
+      link = &(*link)->next;
+    *link = file->next;
+    free(file);
+  }
+  uv_mutex_unlock(&uvwasi__fd_map_mutex);
+}
+
+
+void uvwasi__fd_mmap_enable(const uvwasi_t* uvwasi,
+                            struct uvwasi_fd_wrap_t* wrap,
+                            int flags) {
+  struct uvwasi_fd_cold_t* cold;
+
+  if (uvwasi->mmap_window_size == 0 ||
+      wrap->type != UVWASI_FILETYPE_REGULAR_FILE ||
+      (flags & (UV_FS_O_WRONLY | UV_FS_O_RDWR)) != 0) {
+    return;
+  }
+
+  uv_once(&uvwasi__fd_map_once, uvwasi__fd_map_init);
+  if (!uvwasi__fd_map_ok)
+    return;
+
+  /* Counted before the file's size is first read, so that a write made after
+     that read sees the count. */
+  cold = wrap->cold;
+  uvwasi__atomic_add_u64(&uvwasi__fd_map_count, 1);
+  cold->map_file = uvwasi__fd_map_file_get(wrap->fd);
+  if (cold->map_file == NULL) {
+    uvwasi__atomic_sub_u64(&uvwasi__fd_map_count, 1);
+    return;
+  }
+
+  cold->map_enabled = 1;
+}
+
+
+void uvwasi__fd_mmap_invalidate(struct uvwasi_fd_wrap_t* wrap) {
+  struct uvwasi_fd_cold_t* cold;
+
+  if (wrap->type != UVWASI_FILETYPE_REGULAR_FILE ||
+      uvwasi__atomic_load_u64(&uvwasi__fd_map_count) == 0) {
+    return;
+  }
+
+  /* A writer looks its file up once, the first time it writes while some
+     file is mapped. */
+  cold = wrap->cold;
+  if (cold->vfs != NULL)
+    return;
+
+  if (cold->map_file == NULL) {
+    cold->map_file = uvwasi__fd_map_file_get(wrap->fd);
+    if (cold->map_file == NULL)
+      return;
+  }
+
+  uvwasi__atomic_add_u64(&cold->map_file->generation, 1);
+}
+
+
+static void uvwasi__fd_mmap_unmap(struct uvwasi__fd_map_window_t* window) {
+  if (window->base == NULL)
+    return;
+
+  munmap(window->base, window->len);
+  window->base = NULL;
+}
+
+
+static void uvwasi__fd_mmap_unmap_all(struct uvwasi_fd_cold_t* cold) {
+  int i;
+
+  for (i = 0; i < UVWASI__FD_MAP_WINDOWS; i++)
+    uvwasi__fd_mmap_unmap(&cold->map[i]);
+}
+
+
+/* Stops mapping the file. The fd keeps map_file until it is closed. */
+static void uvwasi__fd_mmap_disable(struct uvwasi_fd_cold_t* cold) {
+  uvwasi__fd_mmap_unmap_all(cold);
+  if (cold->map_enabled) {
+    cold->map_enabled = 0;
+    uvwasi__atomic_sub_u64(&uvwasi__fd_map_count, 1);
+  }
+}
+
+
+void uvwasi__fd_mmap_release(struct uvwasi_fd_cold_t* cold) {
+  uvwasi__fd_mmap_disable(cold);
+  if (cold->map_file != NULL) {
+    uvwasi__fd_map_file_put(cold->map_file);
+    cold->map_file = NULL;
+  }
+}
+
+
+/* Fetches the file's size, dropping the windows that the file no longer
+   covers. */
+static uvwasi_errno_t uvwasi__fd_mmap_refresh(const uvwasi_t* uvwasi,
+                                              struct uvwasi_fd_wrap_t* wrap) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  int i;
+
+  cold = wrap->cold;
+  cold->map_generation = uvwasi__atomic_load_u64(&cold->map_file->generation);
+  err = uvwasi__filestat_fd(uvwasi, wrap->fd, &stat);
+  if (err != UVWASI_ESUCCESS) {
+    cold->map_size_valid = 0;
+    return err;
+  }
+
+  cold->map_size = stat.st_size;
+  cold->map_size_valid = 1;
+  for (i = 0; i < UVWASI__FD_MAP_WINDOWS; i++) {
+    if (cold->map[i].offset + cold->map[i].len > cold->map_size)
+      uvwasi__fd_mmap_unmap(&cold->map[i]);
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Finds the window that holds pos, which must be before the end of the file.
+   If there is none, it is mapped in place of the least recently mapped one.
+   Windows start at multiples of their size so that they do not overlap. */
+static uvwasi_errno_t uvwasi__fd_mmap_window(
+                                  const uvwasi_t* uvwasi,
+                                  struct uvwasi_fd_wrap_t* wrap,
+                                  uint64_t pos,
+                                  struct uvwasi__fd_map_window_t** window) {
+  struct uvwasi__fd_map_window_t* w;
+  struct uvwasi_fd_cold_t* cold;
+  uint64_t page;
+  uint64_t size;
+  uint64_t start;
+  void* base;
+  int i;
+
+  cold = wrap->cold;
+  for (i = 0; i < UVWASI__FD_MAP_WINDOWS; i++) {
+    w = &cold->map[i];
+    if (w->base != NULL && pos >= w->offset && pos - w->offset < w->len) {
+      *window = w;
+      return UVWASI_ESUCCESS;
+    }
+  }
+
+  w = &cold->map[cold->map_next];
+  cold->map_next = (cold->map_next + 1) % UVWASI__FD_MAP_WINDOWS;
+  uvwasi__fd_mmap_unmap(w);
+
+  page = (uint64_t) sysconf(_SC_PAGESIZE);
+  size = ((uint64_t) uvwasi->mmap_window_size + page - 1) / page * page;
+  start = pos - pos % size;
+  if (size > cold->map_size - start)
+    size = cold->map_size - start;
+
+  base = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, wrap->fd, start);
+  if (base == MAP_FAILED)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  w->base = base;
+  w->offset = start;
+  w->len = (size_t) size;
+  *window = w;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__fd_mmap_read(const uvwasi_t* uvwasi,
+                                    struct uvwasi_fd_wrap_t* wrap,
+                                    const uvwasi_iovec_t* iovs,
+                                    uvwasi_size_t iovs_len,
+                                    uint64_t pos,
+                                    uvwasi_size_t* nread) {
+  struct uvwasi__fd_map_window_t* window;
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_errno_t err;
+  uvwasi_size_t total;
+  uvwasi_size_t i;
+  size_t avail;
+  size_t len;
+  size_t n;
+  char* buf;
+  int at_eof;
+
+  cold = wrap->cold;
+  if (!cold->map_size_valid ||
+      cold->map_generation !=
+        uvwasi__atomic_load_u64(&cold->map_file->generation)) {
+    err = uvwasi__fd_mmap_refresh(uvwasi, wrap);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  }
+
+  window = NULL;
+  total = 0;
+  at_eof = 0;
+  for (i = 0; i < iovs_len && !at_eof; i++) {
+    buf = iovs[i].buf;
+    len = iovs[i].buf_len;
+
+    while (len > 0) {
+      /* The file may have been grown by another process. Check before
+         reporting the end of the file. */
+      if (pos >= cold->map_size) {
+        err = uvwasi__fd_mmap_refresh(uvwasi, wrap);
+        if (err != UVWASI_ESUCCESS)
+          goto exit;
+
+        if (pos >= cold->map_size) {
+          at_eof = 1;
+          break;
+        }
+      }
+
+      err = uvwasi__fd_mmap_window(uvwasi, wrap, pos, &window);
+      if (err != UVWASI_ESUCCESS)
+        goto exit;
+
+      avail = (size_t) (window->offset + window->len - pos);
+      n = len < avail ? len : avail;
+      memcpy(buf, window->base + (pos - window->offset), n);
+      buf += n;
+      len -= n;
+      pos += n;
+      total += (uvwasi_size_t) n;
+    }
+  }
+
+  err = UVWASI_ESUCCESS;
+exit:
+  if (err != UVWASI_ESUCCESS) {
+    /* Give up on mapping the file. The caller reads it instead if nothing
+       was read. */
+    uvwasi__fd_mmap_disable(cold);
+    if (total == 0)
+      return UVWASI_ENOTSUP;
+  }
+
+  *nread = total;
+  return UVWASI_ESUCCESS;
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,31 @@
+#ifndef __UVWASI_FD_MMAP_H__
+#define __UVWASI_FD_MMAP_H__
+
+#include "uvwasi.h"
+
+struct uvwasi_fd_wrap_t;
+struct uvwasi_fd_cold_t;
+
+/* Memory-mapped reads, enabled by uvwasi_options_t.mmap_window_size. Regular
+   files opened read-only through uvwasi_path_open() are mapped one window at
+   a time, and fd_read() and fd_pread() copy out of the mapping. Except where
+   noted, these require the fd's mutex to be held. */
+void uvwasi__fd_mmap_enable(const uvwasi_t* uvwasi,
+                            struct uvwasi_fd_wrap_t* wrap,
+                            int flags);
+/* Returns UVWASI_ENOTSUP if the file cannot be mapped, in which case the
+   caller falls back to reading it. */
+uvwasi_errno_t uvwasi__fd_mmap_read(const uvwasi_t* uvwasi,
+                                    struct uvwasi_fd_wrap_t* wrap,
+                                    const uvwasi_iovec_t* iovs,
+                                    uvwasi_size_t iovs_len,
+                                    uint64_t pos,
+                                    uvwasi_size_t* nread);
+/* Called after a file is written or resized through wrap. Mappings of the same
+   file check its size again before they are next used. This does nothing
+   while no fd in the process is mapped. */
+void uvwasi__fd_mmap_invalidate(struct uvwasi_fd_wrap_t* wrap);
+/* Called when an fd is closed. */
+void uvwasi__fd_mmap_release(struct uvwasi_fd_cold_t* cold);
+
+#endif /* __UVWASI_FD_MMAP_H__ */
@@ -0,0 +1,168 @@
+#include <stdint.h>
+
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "fd_table.h"
+#include "fd_pool.h"
+
+/* Number of cold entries carved from each slab. */
+#define UVWASI__FD_POOL_COLDS_PER_SLAB 32
+
+/* Size of the chunk area of each path slab. The largest size class gets one
+   chunk per slab. */
+#define UVWASI__FD_POOL_PATH_SLAB_SIZE                                        \
+  (UVWASI__FD_POOL_MIN_PATH << (UVWASI__FD_POOL_PATH_CLASSES - 1))
+
+/* Every slab starts with a header linking it into the pool's slab list. The
+   union keeps the elements that follow it suitably aligned. */
+typedef union uvwasi__fd_pool_slab_u {
+  struct uvwasi__fd_pool_node_t node;
+  long double align_ld;
+  uint64_t align_u64;
+} uvwasi__fd_pool_slab_t;
+
+
+static int uvwasi__fd_pool_grow(const uvwasi_t* uvwasi,
+                                struct uvwasi_fd_pool_t* pool,
+                                struct uvwasi__fd_pool_node_t** free_list,
+                                size_t elem_size,
+                                size_t count) {
+  struct uvwasi__fd_pool_node_t* node;
+  uvwasi__fd_pool_slab_t* slab;
+  char* elems;
+  size_t i;
+
+  slab = uvwasi__malloc(uvwasi, sizeof(*slab) + elem_size * count);
+  if (slab == NULL)
+    return 0;
+
+  slab->node.next = pool->slabs;
+  pool->slabs = &slab->node;
+
+  /* Push in reverse so that elements are handed out in address order. */
+  elems = (char*) (slab + 1);
+  for (i = count; i > 0; i--) {
+    node = (struct uvwasi__fd_pool_node_t*) (elems + (i - 1) * elem_size);
+    node->next = *free_list;
+    *free_list = node;
+  }
+
+  return 1;
+}
+
+
+static int uvwasi__fd_pool_path_class(size_t size) {
+  int i;
+
+  for (i = 0; i < UVWASI__FD_POOL_PATH_CLASSES; i++) {
+    if (size <= ((size_t) UVWASI__FD_POOL_MIN_PATH << i))
+      return i;
+  }
+
+  return -1;
+}
+
+
+void uvwasi__fd_pool_init(struct uvwasi_fd_pool_t* pool) {
+  int i;
+
+  pool->free_cold = NULL;
+  for (i = 0; i < UVWASI__FD_POOL_PATH_CLASSES; i++)
+    pool->free_paths[i] = NULL;
+  pool->slabs = NULL;
+}
+
+
+void uvwasi__fd_pool_release(const uvwasi_t* uvwasi,
+                             struct uvwasi_fd_pool_t* pool) {
+  struct uvwasi__fd_pool_node_t* slab;
+  struct uvwasi__fd_pool_node_t* next;
+
+  for (slab = pool->slabs; slab != NULL; slab = next) {
+    next = slab->next;
+    uvwasi__free(uvwasi, slab);
+  }
+
+  uvwasi__fd_pool_init(pool);
+}
+
+
+struct uvwasi_fd_cold_t* uvwasi__fd_pool_alloc_cold(
+                                                const uvwasi_t* uvwasi,
+                                                struct uvwasi_fd_pool_t* pool) {
+  struct uvwasi__fd_pool_node_t* node;
+
+  if (pool->free_cold == NULL &&
+      !uvwasi__fd_pool_grow(uvwasi,
+                            pool,
+                            &pool->free_cold,
+                            sizeof(struct uvwasi_fd_cold_t),
+                            UVWASI__FD_POOL_COLDS_PER_SLAB)) {
+    return NULL;
+  }
+
+  node = pool->free_cold;
+  pool->free_cold = node->next;
+  return (struct uvwasi_fd_cold_t*) node;
+}
+
+
+void uvwasi__fd_pool_free_cold(struct uvwasi_fd_pool_t* pool,
+                               struct uvwasi_fd_cold_t* cold) {
+  struct uvwasi__fd_pool_node_t* node;
+
+  node = (struct uvwasi__fd_pool_node_t*) cold;
+  node->next = pool->free_cold;
+  pool->free_cold = node;
+}
+
+
+char* uvwasi__fd_pool_alloc_path(const uvwasi_t* uvwasi,
+                                 struct uvwasi_fd_pool_t* pool,
+                                 size_t size) {
+  struct uvwasi__fd_pool_node_t** free_list;
+  struct uvwasi__fd_pool_node_t* node;
+  size_t chunk_size;
+  int index;
+
+  index = uvwasi__fd_pool_path_class(size);
+  if (index < 0)
+    return uvwasi__malloc(uvwasi, size);
+
+  free_list = &pool->free_paths[index];
+  chunk_size = (size_t) UVWASI__FD_POOL_MIN_PATH << index;
+  if (*free_list == NULL &&
+      !uvwasi__fd_pool_grow(uvwasi,
+                            pool,
+                            free_list,
+                            chunk_size,
+                            UVWASI__FD_POOL_PATH_SLAB_SIZE / chunk_size)) {
+    return NULL;
+  }
+
+  node = *free_list;
+  *free_list = node->next;
+  return (char*) node;
+}
+
+
+void uvwasi__fd_pool_free_path(const uvwasi_t* uvwasi,
+                               struct uvwasi_fd_pool_t* pool,
+                               char* path,
+                               size_t size) {
+  struct uvwasi__fd_pool_node_t* node;
+  int index;
+
+  if (path == NULL)
+    return;
+
+  index = uvwasi__fd_pool_path_class(size);
+  if (index < 0) {
+    uvwasi__free(uvwasi, path);
+    return;
+  }
+
+  node = (struct uvwasi__fd_pool_node_t*) path;
+  node->next = pool->free_paths[index];
+  pool->free_paths[index] = node;
+}
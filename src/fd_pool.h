@@ -0,0 +1,45 @@
+#ifndef __UVWASI_FD_POOL_H__
+#define __UVWASI_FD_POOL_H__
+
+#include <stddef.h>
+#include "uvwasi.h"
+
+struct uvwasi_fd_cold_t;
+
+/* Path storage is carved into chunks of UVWASI__FD_POOL_MIN_PATH bytes,
+   doubling for each of the UVWASI__FD_POOL_PATH_CLASSES size classes. Larger
+   paths are allocated individually. */
+#define UVWASI__FD_POOL_MIN_PATH 32
+#define UVWASI__FD_POOL_PATH_CLASSES 8
+
+struct uvwasi__fd_pool_node_t {
+  struct uvwasi__fd_pool_node_t* next;
+};
+
+/* Recycles the cold state of fd table entries and their path storage. Memory
+   is taken from the allocator in slabs and is only returned by
+   uvwasi__fd_pool_release(). The pool is not thread safe; the fd table calls
+   it with its lock held. */
+struct uvwasi_fd_pool_t {
+  struct uvwasi__fd_pool_node_t* free_cold;
+  struct uvwasi__fd_pool_node_t* free_paths[UVWASI__FD_POOL_PATH_CLASSES];
+  struct uvwasi__fd_pool_node_t* slabs;
+};
+
+void uvwasi__fd_pool_init(struct uvwasi_fd_pool_t* pool);
+void uvwasi__fd_pool_release(const uvwasi_t* uvwasi,
+                             struct uvwasi_fd_pool_t* pool);
+struct uvwasi_fd_cold_t* uvwasi__fd_pool_alloc_cold(
+                                                const uvwasi_t* uvwasi,
+                                                struct uvwasi_fd_pool_t* pool);
+void uvwasi__fd_pool_free_cold(struct uvwasi_fd_pool_t* pool,
+                               struct uvwasi_fd_cold_t* cold);
+char* uvwasi__fd_pool_alloc_path(const uvwasi_t* uvwasi,
+                                 struct uvwasi_fd_pool_t* pool,
+                                 size_t size);
+void uvwasi__fd_pool_free_path(const uvwasi_t* uvwasi,
+                               struct uvwasi_fd_pool_t* pool,
+                               char* path,
+                               size_t size);
+
+#endif /* __UVWASI_FD_POOL_H__ */
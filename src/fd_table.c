@@ -1,9 +1,14 @@
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 #ifndef _WIN32
+# include <fcntl.h>
 # include <sys/types.h>
+# include <unistd.h>
+#else
+# include <io.h>
 #endif /* _WIN32 */
 
 #include "uv.h"
@@ -13,6 +18,178 @@
 #include "wasi_rights.h"
 #include "uv_mapping.h"
 #include "uvwasi_alloc.h"
+#include "atomic_ops.h"
+#include "fd_mmap.h"
+#include "file_cache.h"
+#include "stdio_buffer.h"
+#include "vfs.h"
+
+
+static void uvwasi__lock_stats_record(uvwasi_lock_class_stats_t* stats,
+                                      int contended,
+                                      uint64_t wait_ns) {
+  uint64_t max;
+
+  uvwasi__atomic_add_u64(&stats->acquisitions, 1);
+  if (!contended)
+    return;
+
+  uvwasi__atomic_add_u64(&stats->contended, 1);
+  uvwasi__atomic_add_u64(&stats->wait_ns, wait_ns);
+
+  max = uvwasi__atomic_load_u64(&stats->max_wait_ns);
+  while (wait_ns > max) {
+    if (uvwasi__atomic_cas_u64(&stats->max_wait_ns, &max, wait_ns))
+      break;
+  }
+}
+
+
+/* With lock statistics enabled, locks are first tried without blocking so
+   that contended acquisitions can be counted and timed. */
+static void uvwasi__fd_table_acquire(struct uvwasi_fd_table_t* table,
+                                     int write) {
+  uvwasi_lock_class_stats_t* stats;
+  uint64_t start;
+  int r;
+
+  stats = table->lock_stats;
+  if (stats == NULL) {
+    if (write)
+      uv_rwlock_wrlock(&table->rwlock);
+    else
+      uv_rwlock_rdlock(&table->rwlock);
+    return;
+  }
+
+  if (write)
+    r = uv_rwlock_trywrlock(&table->rwlock);
+  else
+    r = uv_rwlock_tryrdlock(&table->rwlock);
+
+  if (r == 0) {
+    uvwasi__lock_stats_record(&stats[UVWASI__LOCK_FD_TABLE], 0, 0);
+    return;
+  }
+
+  start = uv_hrtime();
+  if (write)
+    uv_rwlock_wrlock(&table->rwlock);
+  else
+    uv_rwlock_rdlock(&table->rwlock);
+  uvwasi__lock_stats_record(&stats[UVWASI__LOCK_FD_TABLE],
+                            1,
+                            uv_hrtime() - start);
+}
+
+
+static void uvwasi__fd_table_wrlock(struct uvwasi_fd_table_t* table) {
+  uvwasi__fd_table_acquire(table, 1);
+}
+
+
+static void uvwasi__fd_lock(struct uvwasi_fd_table_t* table,
+                            struct uvwasi_fd_wrap_t* entry) {
+  uvwasi_lock_class_stats_t* stats;
+  uint64_t start;
+  uint64_t wait_ns;
+
+  stats = table->lock_stats;
+  if (stats == NULL) {
+    uv_mutex_lock(&entry->mutex);
+    return;
+  }
+
+  if (uv_mutex_trylock(&entry->mutex) == 0) {
+    uvwasi__lock_stats_record(&stats[UVWASI__LOCK_FD], 0, 0);
+    return;
+  }
+
+  start = uv_hrtime();
+  uv_mutex_lock(&entry->mutex);
+  wait_ns = uv_hrtime() - start;
+  uvwasi__lock_stats_record(&stats[UVWASI__LOCK_FD], 1, wait_ns);
+
+  /* The query API reads these without holding the fd's mutex. */
+  uvwasi__atomic_add_u64(&entry->cold->lock_contended, 1);
+  uvwasi__atomic_add_u64(&entry->cold->lock_wait_ns, wait_ns);
+}
+
+
+/* Returns an entry's cold state and its paths to the table's pool. The caller
+   must hold the table's write lock. */
+static void uvwasi__fd_table_free_cold(uvwasi_t* uvwasi,
+                                       struct uvwasi_fd_table_t* table,
+                                       struct uvwasi_fd_cold_t* cold) {
+  uvwasi__fd_mmap_release(cold);
+  if (cold->cache_entry != NULL)
+    uvwasi__file_cache_release(cold->cache_entry);
+  if (cold->vfs != NULL)
+    uvwasi__vfs_close(cold);
+  uvwasi__fd_pool_free_path(uvwasi, &table->pool, cold->path, cold->path_size);
+  uvwasi__fd_pool_free_cold(&table->pool, cold);
+}
+
+
+/* Adds slot blocks until the table has room for at least size entries. The
+   table stays consistent if an allocation fails part way. */
+static uvwasi_errno_t uvwasi__fd_table_grow(uvwasi_t* uvwasi,
+                                            struct uvwasi_fd_table_t* table,
+                                            uint32_t size) {
+  struct uvwasi__fd_block_t* blocks;
+  struct uvwasi__fd_block_t* block;
+  struct uvwasi_fd_wrap_t* entry;
+  uintptr_t addr;
+  uint32_t nblocks;
+  uint32_t b;
+  uint32_t i;
+
+  nblocks = (size + UVWASI__FD_BLOCK_SLOTS - 1) >> UVWASI__FD_BLOCK_SHIFT;
+  if (nblocks <= table->size >> UVWASI__FD_BLOCK_SHIFT)
+    return UVWASI_ESUCCESS;
+
+  blocks = uvwasi__realloc(uvwasi, table->blocks, nblocks * sizeof(*blocks));
+  if (blocks == NULL)
+    return UVWASI_ENOMEM;
+
+  table->blocks = blocks;
+  for (b = table->size >> UVWASI__FD_BLOCK_SHIFT; b < nblocks; b++) {
+    block = &blocks[b];
+    block->mem = uvwasi__malloc(uvwasi,
+                                UVWASI__FD_BLOCK_SLOTS * sizeof(*block->slots) +
+                                UVWASI__FD_CACHE_LINE - 1);
+    if (block->mem == NULL)
+      return UVWASI_ENOMEM;
+
+    addr = ((uintptr_t) block->mem + UVWASI__FD_CACHE_LINE - 1) &
+           ~(uintptr_t) (UVWASI__FD_CACHE_LINE - 1);
+    block->slots = (union uvwasi__fd_slot_u*) addr;
+
+    for (i = 0; i < UVWASI__FD_BLOCK_SLOTS; i++) {
+      entry = &block->slots[i].wrap;
+      entry->id = (b << UVWASI__FD_BLOCK_SHIFT) + i;
+      entry->cold = NULL;
+    }
+
+    table->size += UVWASI__FD_BLOCK_SLOTS;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__fd_table_free_blocks(uvwasi_t* uvwasi,
+                                         struct uvwasi_fd_table_t* table) {
+  uint32_t b;
+
+  for (b = 0; b < table->size >> UVWASI__FD_BLOCK_SHIFT; b++)
+    uvwasi__free(uvwasi, table->blocks[b].mem);
+
+  uvwasi__free(uvwasi, table->blocks);
+  table->blocks = NULL;
+  table->size = 0;
+  table->used = 0;
+}
 
 
 static uvwasi_errno_t uvwasi__insert_stdio(uvwasi_t* uvwasi,
@@ -68,11 +245,9 @@ uvwasi_errno_t uvwasi_fd_table_insert(uvwasi_t* uvwasi,
                                       int preopen,
                                       struct uvwasi_fd_wrap_t** wrap) {
   struct uvwasi_fd_wrap_t* entry;
-  struct uvwasi_fd_wrap_t** new_fds;
+  struct uvwasi_fd_cold_t* cold;
   uvwasi_errno_t err;
-  uint32_t new_size;
   uint32_t index;
-  uint32_t i;
   int r;
   size_t mp_len;
   char* mp_copy;
@@ -91,89 +266,104 @@ uvwasi_errno_t uvwasi_fd_table_insert(uvwasi_t* uvwasi,
     np_copy = NULL;
   }
 
-  /* Reserve room for the mapped path, real path, and normalized mapped path. */
-  entry = (struct uvwasi_fd_wrap_t*)
-    uvwasi__malloc(uvwasi, sizeof(*entry) + mp_len + mp_len + rp_len + 3);
-  if (entry == NULL)
-    return UVWASI_ENOMEM;
+  uvwasi__fd_table_wrlock(table);
+
+  /* Find an unused slot. If there isn't one, grow the table. */
+  if (table->used >= table->size) {
+    index = table->size;
+    err = uvwasi__fd_table_grow(uvwasi, table, table->size + 1);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+  } else {
+    for (index = 0; index < table->size; ++index) {
+      if (UVWASI__FD_TABLE_ENTRY(table, index)->cold == NULL)
+        break;
+    }
+
+    /* This should never happen. */
+    if (index == table->size) {
+      err = UVWASI_ENOSPC;
+      goto exit;
+    }
+  }
+
+  cold = uvwasi__fd_pool_alloc_cold(uvwasi, &table->pool);
+  if (cold == NULL) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
 
+  cold->path_size = 0;
   if (type != UVWASI_FILETYPE_SOCKET_STREAM) {
-    mp_copy = (char*)(entry + 1);
+    /* Reserve room for the mapped path, real path, and normalized mapped
+       path. */
+    cold->path_size = mp_len + mp_len + rp_len + 3;
+    mp_copy = uvwasi__fd_pool_alloc_path(uvwasi,
+                                         &table->pool,
+                                         cold->path_size);
+    if (mp_copy == NULL) {
+      uvwasi__fd_pool_free_cold(&table->pool, cold);
+      err = UVWASI_ENOMEM;
+      goto exit;
+    }
+
     rp_copy = mp_copy + mp_len + 1;
     np_copy = rp_copy + rp_len + 1;
     memcpy(mp_copy, mapped_path, mp_len);
     mp_copy[mp_len] = '\0';
     memcpy(rp_copy, real_path, rp_len);
     rp_copy[rp_len] = '\0';
+  }
 
+  cold->sock = sock;
+  cold->path = mp_copy;
+  cold->real_path = rp_copy;
+  cold->normalized_path = np_copy;
+  cold->lock_contended = 0;
+  cold->lock_wait_ns = 0;
+  cold->stat_time = 0;
+  memset(cold->map, 0, sizeof(cold->map));
+  cold->map_file = NULL;
+  cold->map_next = 0;
+  cold->map_enabled = 0;
+  cold->map_size_valid = 0;
+  cold->pos = 0;
+  cold->pos_valid = 0;
+  cold->immutable = 0;
+  cold->cache_entry = NULL;
+  cold->out_buf = NULL;
+  cold->vfs = NULL;
+  cold->vfs_file = NULL;
+  cold->vfs_append = 0;
+
+  if (type != UVWASI_FILETYPE_SOCKET_STREAM) {
     /* Calculate the normalized version of the mapped path, as it will be used for
        any path calculations on this fd. Use the length of the mapped path as an
        upper bound for the normalized path length. */
     err = uvwasi__normalize_path(mp_copy, mp_len, np_copy, mp_len);
     if (err) {
-      uvwasi__free(uvwasi, entry);
+      uvwasi__fd_table_free_cold(uvwasi, table, cold);
       goto exit;
     }
   }
 
-  uv_rwlock_wrlock(&table->rwlock);
-
-  /* Check that there is room for a new item. If there isn't, grow the table. */
-  if (table->used >= table->size) {
-    new_size = table->size * 2;
-    new_fds = uvwasi__realloc(uvwasi, table->fds, new_size * sizeof(*new_fds));
-    if (new_fds == NULL) {
-      uvwasi__free(uvwasi, entry);
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
-
-    for (i = table->size; i < new_size; ++i)
-      new_fds[i] = NULL;
-
-    index = table->size;
-    table->fds = new_fds;
-    table->size = new_size;
-  } else {
-    /* The table is big enough, so find an empty slot for the new data. */
-    int valid_slot = 0;
-    for (i = 0; i < table->size; ++i) {
-      if (table->fds[i] == NULL) {
-        valid_slot = 1;
-        index = i;
-        break;
-      }
-    }
-
-    /* This should never happen. */
-    if (valid_slot == 0) {
-      uvwasi__free(uvwasi, entry);
-      err = UVWASI_ENOSPC;
-      goto exit;
-    }
-  }
-
-  table->fds[index] = entry;
-
+  entry = UVWASI__FD_TABLE_ENTRY(table, index);
   r = uv_mutex_init(&entry->mutex);
   if (r != 0) {
+    uvwasi__fd_table_free_cold(uvwasi, table, cold);
     err = uvwasi__translate_uv_error(r);
     goto exit;
   }
 
-  entry->id = index;
   entry->fd = fd;
-  entry->sock = sock;
-  entry->path = mp_copy;
-  entry->real_path = rp_copy;
-  entry->normalized_path = np_copy;
   entry->type = type;
   entry->rights_base = rights_base;
   entry->rights_inheriting = rights_inheriting;
-  entry->preopen = preopen;
+  entry->preopen = (uint8_t) preopen;
+  entry->cold = cold;
 
   if (wrap != NULL) {
-    uv_mutex_lock(&entry->mutex);
+    uvwasi__fd_lock(table, entry);
     *wrap = entry;
   }
 
@@ -185,38 +375,72 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_table_init(uvwasi_t* uvwasi,
-                                    const uvwasi_options_t* options) {
+/* Allocates an empty table with room for size entries. */
+static uvwasi_errno_t uvwasi__fd_table_new(uvwasi_t* uvwasi,
+                                           uint32_t size,
+                                           int enable_lock_stats,
+                                           struct uvwasi_fd_table_t** out) {
   struct uvwasi_fd_table_t* table;
   uvwasi_errno_t err;
   int r;
 
-  /* Require an initial size of at least three to store the stdio FDs. */
-  if (uvwasi == NULL || options == NULL || options->fd_table_size < 3)
-    return UVWASI_EINVAL;
-
   table = uvwasi__malloc(uvwasi, sizeof(*table));
   if (table == NULL)
     return UVWASI_ENOMEM;
 
+  table->blocks = NULL;
+  table->size = 0;
   table->used = 0;
-  table->size = options->fd_table_size;
-  table->fds = uvwasi__calloc(uvwasi,
-                              options->fd_table_size,
-                              sizeof(struct uvwasi_fd_wrap_t*));
-  if (table->fds == NULL) {
+  uvwasi__fd_pool_init(&table->pool);
+  err = uvwasi__fd_table_grow(uvwasi, table, size);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__fd_table_free_blocks(uvwasi, table);
     uvwasi__free(uvwasi, table);
-    return UVWASI_ENOMEM;
+    return err;
+  }
+
+  table->lock_stats = NULL;
+  if (enable_lock_stats) {
+    table->lock_stats = uvwasi__calloc(uvwasi,
+                                       UVWASI__LOCK_FD + 1,
+                                       sizeof(*table->lock_stats));
+    if (table->lock_stats == NULL) {
+      uvwasi__fd_table_free_blocks(uvwasi, table);
+      uvwasi__free(uvwasi, table);
+      return UVWASI_ENOMEM;
+    }
   }
 
   r = uv_rwlock_init(&table->rwlock);
   if (r != 0) {
     err = uvwasi__translate_uv_error(r);
-    uvwasi__free(uvwasi, table->fds);
+    uvwasi__free(uvwasi, table->lock_stats);
+    uvwasi__fd_table_free_blocks(uvwasi, table);
     uvwasi__free(uvwasi, table);
     return err;
   }
 
+  *out = table;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_init(uvwasi_t* uvwasi,
+                                    const uvwasi_options_t* options) {
+  struct uvwasi_fd_table_t* table;
+  uvwasi_errno_t err;
+
+  /* Require an initial size of at least three to store the stdio FDs. */
+  if (uvwasi == NULL || options == NULL || options->fd_table_size < 3)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__fd_table_new(uvwasi,
+                             options->fd_table_size,
+                             options->enable_lock_stats,
+                             &table);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
   /* Create the stdio FDs. */
   err = uvwasi__insert_stdio(uvwasi, table, options->in, 0, "<stdin>");
   if (err != UVWASI_ESUCCESS)
@@ -238,31 +462,206 @@ error_exit:
 }
 
 
+/* Duplicates a host fd, close-on-exec like the fds that libuv opens. Returns
+   the new fd or a negated uv error. */
+static int uvwasi__fd_dup(uv_file fd) {
+  int r;
+
+#ifdef _WIN32
+  r = _dup(fd);
+  if (r == -1)
+    return errno == EMFILE ? UV_EMFILE : UV_EBADF;
+#else
+# ifdef F_DUPFD_CLOEXEC
+  r = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+# else
+  r = dup(fd);
+  if (r != -1)
+    fcntl(r, F_SETFD, FD_CLOEXEC);
+# endif /* F_DUPFD_CLOEXEC */
+  if (r == -1)
+    return uv_translate_sys_error(errno);
+#endif /* _WIN32 */
+
+  return r;
+}
+
+
+/* Copies src, one of the stdio fds or a preopen, into the same slot of a
+   clone's table. The stdio fds keep sharing the embedder's host fds. Preopen
+   directories get a duplicate of the host fd, and preopens backed by a
+   uvwasi_vfs_t open its root again. The caller holds src's mutex. */
+static uvwasi_errno_t uvwasi__fd_table_clone_entry(
+                                              uvwasi_t* uvwasi,
+                                              struct uvwasi_fd_table_t* table,
+                                              struct uvwasi_fd_wrap_t* src) {
+  struct uvwasi_fd_wrap_t* entry;
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_filetype_t type;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  uv_file fd;
+  void* file;
+  int r;
+
+  if (src->cold->sock != NULL)
+    return UVWASI_ENOTSUP;
+
+  cold = uvwasi__fd_pool_alloc_cold(uvwasi, &table->pool);
+  if (cold == NULL)
+    return UVWASI_ENOMEM;
+
+  /* The three paths share one chunk, so one copy takes them all. */
+  memset(cold, 0, sizeof(*cold));
+  cold->path = uvwasi__fd_pool_alloc_path(uvwasi,
+                                          &table->pool,
+                                          src->cold->path_size);
+  if (cold->path == NULL) {
+    uvwasi__fd_pool_free_cold(&table->pool, cold);
+    return UVWASI_ENOMEM;
+  }
+
+  memcpy(cold->path, src->cold->path, src->cold->path_size);
+  cold->path_size = src->cold->path_size;
+  cold->real_path = cold->path + (src->cold->real_path - src->cold->path);
+  cold->normalized_path =
+      cold->path + (src->cold->normalized_path - src->cold->path);
+  cold->immutable = src->cold->immutable;
+
+  fd = src->fd;
+  if (src->cold->vfs != NULL) {
+    err = uvwasi__vfs_open(src->cold->vfs,
+                           "/",
+                           UVWASI_O_DIRECTORY,
+                           0,
+                           0,
+                           &file,
+                           &type);
+    if (err != UVWASI_ESUCCESS) {
+      uvwasi__fd_table_free_cold(uvwasi, table, cold);
+      return err;
+    }
+
+    cold->vfs = src->cold->vfs;
+    cold->vfs_file = file;
+  } else if (src->preopen) {
+    fd = uvwasi__fd_dup(src->fd);
+    if (fd < 0) {
+      uvwasi__fd_table_free_cold(uvwasi, table, cold);
+      return uvwasi__translate_uv_error(fd);
+    }
+  }
+
+  entry = UVWASI__FD_TABLE_ENTRY(table, src->id);
+  r = uv_mutex_init(&entry->mutex);
+  if (r != 0) {
+    if (fd != src->fd) {
+      uv_fs_close(NULL, &req, fd, NULL);
+      uv_fs_req_cleanup(&req);
+    }
+
+    uvwasi__fd_table_free_cold(uvwasi, table, cold);
+    return uvwasi__translate_uv_error(r);
+  }
+
+  entry->fd = fd;
+  entry->type = src->type;
+  entry->rights_base = src->rights_base;
+  entry->rights_inheriting = src->rights_inheriting;
+  entry->preopen = src->preopen;
+  entry->cold = cold;
+  table->used++;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_clone(uvwasi_t* uvwasi,
+                                     struct uvwasi_fd_table_t* src) {
+  struct uvwasi_fd_table_t* table;
+  struct uvwasi_fd_wrap_t* entry;
+  uvwasi_errno_t err;
+  uint32_t i;
+
+  if (uvwasi == NULL || src == NULL)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__fd_table_new(uvwasi,
+                             src->size,
+                             src->lock_stats != NULL,
+                             &table);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  /* Files that src has opened itself are not carried over. */
+  err = UVWASI_ESUCCESS;
+  uvwasi__fd_table_wrlock(src);
+  for (i = 0; i < src->size; i++) {
+    entry = UVWASI__FD_TABLE_ENTRY(src, i);
+    if (entry->cold == NULL || (i > 2 && !entry->preopen))
+      continue;
+
+    uvwasi__fd_lock(src, entry);
+    err = uvwasi__fd_table_clone_entry(uvwasi, table, entry);
+    uv_mutex_unlock(&entry->mutex);
+    if (err != UVWASI_ESUCCESS)
+      break;
+  }
+
+  uv_rwlock_wrunlock(&src->rwlock);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi_fd_table_free(uvwasi, table);
+    return err;
+  }
+
+  uvwasi->fds = table;
+  return UVWASI_ESUCCESS;
+}
+
+
 void uvwasi_fd_table_free(uvwasi_t* uvwasi, struct uvwasi_fd_table_t* table) {
   struct uvwasi_fd_wrap_t* entry;
+  uv_fs_t req;
   uint32_t i;
 
   if (uvwasi == NULL || table == NULL)
     return;
 
   for (i = 0; i < table->size; i++) {
-    entry = table->fds[i];
+    entry = UVWASI__FD_TABLE_ENTRY(table, i);
 
-    if (entry == NULL)
+    if (entry->cold == NULL)
       continue;
 
+    /* Preopen directories were opened by uvwasi_init() or uvwasi_clone(). */
+    if (entry->preopen &&
+        entry->cold->vfs == NULL &&
+        entry->cold->sock == NULL) {
+      uv_fs_close(NULL, &req, entry->fd, NULL);
+      uv_fs_req_cleanup(&req);
+    }
+
+    /* Cold state is released with the pool below, but paths too long for the
+       pool were allocated individually. */
     uv_mutex_destroy(&entry->mutex);
-    uvwasi__free(uvwasi, entry);
+    uvwasi__fd_mmap_release(entry->cold);
+    if (entry->cold->cache_entry != NULL)
+      uvwasi__file_cache_release(entry->cold->cache_entry);
+    if (entry->cold->vfs != NULL)
+      uvwasi__vfs_close(entry->cold);
+    uvwasi__fd_pool_free_path(uvwasi,
+                              &table->pool,
+                              entry->cold->path,
+                              entry->cold->path_size);
   }
 
-  if (table->fds != NULL) {
-    uvwasi__free(uvwasi, table->fds);
-    table->fds = NULL;
-    table->size = 0;
-    table->used = 0;
+  uvwasi__fd_pool_release(uvwasi, &table->pool);
+
+  if (table->blocks != NULL) {
+    uvwasi__fd_table_free_blocks(uvwasi, table);
     uv_rwlock_destroy(&table->rwlock);
   }
 
+  uvwasi__free(uvwasi, table->lock_stats);
   uvwasi__free(uvwasi, table);
 }
 
@@ -271,7 +670,9 @@ uvwasi_errno_t uvwasi_fd_table_insert_preopen(uvwasi_t* uvwasi,
                                               struct uvwasi_fd_table_t* table,
                                               const uv_file fd,
                                               const char* path,
-                                              const char* real_path) {
+                                              const char* real_path,
+                                              int immutable) {
+  struct uvwasi_fd_wrap_t* wrap;
   uvwasi_filetype_t type;
   uvwasi_rights_t base;
   uvwasi_rights_t inheriting;
@@ -291,17 +692,74 @@ uvwasi_errno_t uvwasi_fd_table_insert_preopen(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  return uvwasi_fd_table_insert(uvwasi,
-                                table,
-                                fd,
-                                NULL,
-                                path,
-                                real_path,
-                                UVWASI_FILETYPE_DIRECTORY,
-                                UVWASI__RIGHTS_DIRECTORY_BASE,
-                                UVWASI__RIGHTS_DIRECTORY_INHERITING,
-                                1,
-                                NULL);
+  err = uvwasi_fd_table_insert(uvwasi,
+                               table,
+                               fd,
+                               NULL,
+                               path,
+                               real_path,
+                               UVWASI_FILETYPE_DIRECTORY,
+                               UVWASI__RIGHTS_DIRECTORY_BASE,
+                               UVWASI__RIGHTS_DIRECTORY_INHERITING,
+                               1,
+                               &wrap);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  wrap->cold->immutable = immutable != 0;
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_insert_preopen_vfs(uvwasi_t* uvwasi,
+                                              struct uvwasi_fd_table_t* table,
+                                              const char* path,
+                                              const uvwasi_vfs_t* vfs,
+                                              int immutable) {
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_filetype_t type;
+  uvwasi_errno_t err;
+  void* file;
+
+  if (table == NULL || path == NULL || vfs == NULL ||
+      vfs->open == NULL || vfs->close == NULL || vfs->fstat == NULL) {
+    return UVWASI_EINVAL;
+  }
+
+  err = uvwasi__vfs_open(vfs,
+                         "/",
+                         UVWASI_O_DIRECTORY,
+                         0,
+                         0,
+                         &file,
+                         &type);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  /* The preopen has no host fd, and its paths resolve against the root of
+     the file system rather than a real path. */
+  err = uvwasi_fd_table_insert(uvwasi,
+                               table,
+                               -1,
+                               NULL,
+                               path,
+                               "",
+                               UVWASI_FILETYPE_DIRECTORY,
+                               UVWASI__RIGHTS_DIRECTORY_BASE,
+                               UVWASI__RIGHTS_DIRECTORY_INHERITING,
+                               1,
+                               &wrap);
+  if (err != UVWASI_ESUCCESS) {
+    vfs->close(file, vfs->vfs_user_data);
+    return err;
+  }
+
+  wrap->cold->immutable = immutable != 0;
+  wrap->cold->vfs = vfs;
+  wrap->cold->vfs_file = file;
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
 }
 
 
@@ -335,7 +793,7 @@ uvwasi_errno_t uvwasi_fd_table_get(struct uvwasi_fd_table_t* table,
   if (table == NULL)
     return UVWASI_EINVAL;
 
-  uv_rwlock_wrlock(&table->rwlock);
+  uvwasi__fd_table_wrlock(table);
   err = uvwasi_fd_table_get_nolock(table,
                                    id,
                                    wrap,
@@ -362,9 +820,9 @@ uvwasi_errno_t uvwasi_fd_table_get_nolock(struct uvwasi_fd_table_t* table,
   if (id >= table->size)
     return UVWASI_EBADF;
 
-  entry = table->fds[id];
+  entry = UVWASI__FD_TABLE_ENTRY(table, id);
 
-  if (entry == NULL || entry->id != id)
+  if (entry->cold == NULL)
     return UVWASI_EBADF;
 
   /* Validate that the fd has the necessary rights. */
@@ -373,7 +831,7 @@ uvwasi_errno_t uvwasi_fd_table_get_nolock(struct uvwasi_fd_table_t* table,
     return UVWASI_ENOTCAPABLE;
   }
 
-  uv_mutex_lock(&entry->mutex);
+  uvwasi__fd_lock(table, entry);
   *wrap = entry;
   return UVWASI_ESUCCESS;
 }
@@ -390,14 +848,14 @@ uvwasi_errno_t uvwasi_fd_table_remove_nolock(uvwasi_t* uvwasi,
   if (id >= table->size)
     return UVWASI_EBADF;
 
-  entry = table->fds[id];
+  entry = UVWASI__FD_TABLE_ENTRY(table, id);
 
-  if (entry == NULL || entry->id != id)
+  if (entry->cold == NULL)
     return UVWASI_EBADF;
 
   uv_mutex_destroy(&entry->mutex);
-  uvwasi__free(uvwasi, entry);
-  table->fds[id] = NULL;
+  uvwasi__fd_table_free_cold(uvwasi, table, entry->cold);
+  entry->cold = NULL;
   table->used--;
   return UVWASI_ESUCCESS;
 }
@@ -419,46 +877,61 @@ uvwasi_errno_t uvwasi_fd_table_renumber(struct uvwasi_s* uvwasi,
   if (dst == src)
     return UVWASI_ESUCCESS;
 
-  uv_rwlock_wrlock(&table->rwlock);
+  uvwasi__fd_table_wrlock(table);
 
   if (dst >= table->size || src >= table->size) {
     err = UVWASI_EBADF;
     goto exit;
   }
 
-  dst_entry = table->fds[dst];
-  src_entry = table->fds[src];
+  dst_entry = UVWASI__FD_TABLE_ENTRY(table, dst);
+  src_entry = UVWASI__FD_TABLE_ENTRY(table, src);
 
-  if (dst_entry == NULL || dst_entry->id != dst ||
-      src_entry == NULL || src_entry->id != src) {
+  if (dst_entry->cold == NULL || src_entry->cold == NULL) {
     err = UVWASI_EBADF;
     goto exit;
   }
 
-  uv_mutex_lock(&dst_entry->mutex);
-  uv_mutex_lock(&src_entry->mutex);
+  uvwasi__fd_lock(table, dst_entry);
+  uvwasi__fd_lock(table, src_entry);
 
   /* Close the existing destination descriptor. */
-  r = uv_fs_close(NULL, &req, dst_entry->fd, NULL);
-  uv_fs_req_cleanup(&req);
-  if (r != 0) {
+  if (dst_entry->cold->out_buf != NULL)
+    uvwasi__stdio_flush(uvwasi, dst_entry->cold->out_buf);
+
+  if (dst_entry->cold->vfs != NULL) {
+    err = uvwasi__vfs_close(dst_entry->cold);
+  } else {
+    r = uv_fs_close(NULL, &req, dst_entry->fd, NULL);
+    uv_fs_req_cleanup(&req);
+    err = r == 0 ? UVWASI_ESUCCESS : uvwasi__translate_uv_error(r);
+  }
+
+  if (err != UVWASI_ESUCCESS) {
     uv_mutex_unlock(&src_entry->mutex);
     uv_mutex_unlock(&dst_entry->mutex);
-    err = uvwasi__translate_uv_error(r);
     goto exit;
   }
 
-  /* Move the source entry to the destination slot in the table. */
-  table->fds[dst] = table->fds[src];
-  table->fds[dst]->id = dst;
-  uv_mutex_unlock(&table->fds[dst]->mutex);
-  table->fds[src] = NULL;
-  table->used--;
-
-  /* Clean up what's left of the old destination entry. */
+  if (dst_entry->cold->out_buf != NULL)
+    uvwasi__stdio_retarget(uvwasi, dst_entry->cold->out_buf, -1);
+
+  /* Entries do not move, so copy the source entry into the destination slot
+     and release what's left of the old destination entry. */
+  uvwasi__fd_table_free_cold(uvwasi, table, dst_entry->cold);
+  dst_entry->fd = src_entry->fd;
+  dst_entry->type = src_entry->type;
+  dst_entry->rights_base = src_entry->rights_base;
+  dst_entry->rights_inheriting = src_entry->rights_inheriting;
+  dst_entry->preopen = src_entry->preopen;
+  dst_entry->cold = src_entry->cold;
   uv_mutex_unlock(&dst_entry->mutex);
-  uv_mutex_destroy(&dst_entry->mutex);
-  uvwasi__free(uvwasi, dst_entry);
+
+  /* Clean up what's left of the source slot. */
+  src_entry->cold = NULL;
+  uv_mutex_unlock(&src_entry->mutex);
+  uv_mutex_destroy(&src_entry->mutex);
+  table->used--;
 
   err = UVWASI_ESUCCESS;
 exit:
@@ -471,7 +944,7 @@ uvwasi_errno_t uvwasi_fd_table_lock(struct uvwasi_fd_table_t* table) {
   if (table == NULL)
     return UVWASI_EINVAL;
 
-  uv_rwlock_wrlock(&table->rwlock);
+  uvwasi__fd_table_wrlock(table);
   return UVWASI_ESUCCESS;
 }
 
@@ -483,3 +956,121 @@ uvwasi_errno_t uvwasi_fd_table_unlock(struct uvwasi_fd_table_t* table) {
   uv_rwlock_wrunlock(&table->rwlock);
   return UVWASI_ESUCCESS;
 }
+
+
+uvwasi_errno_t uvwasi_fd_table_rdlock(struct uvwasi_fd_table_t* table) {
+  if (table == NULL)
+    return UVWASI_EINVAL;
+
+  uvwasi__fd_table_acquire(table, 0);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_rdunlock(struct uvwasi_fd_table_t* table) {
+  if (table == NULL)
+    return UVWASI_EINVAL;
+
+  uv_rwlock_rdunlock(&table->rwlock);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_lock_stats_get(const uvwasi_t* uvwasi,
+                                     uvwasi_lock_stats_t* stats) {
+  struct uvwasi_fd_table_t* table;
+  struct uvwasi_fd_wrap_t* entry;
+  uvwasi_fd_lock_stats_t hot;
+  uint64_t* src;
+  uint64_t* dst;
+  uvwasi_size_t n;
+  uvwasi_size_t j;
+  uint32_t i;
+
+  if (uvwasi == NULL || stats == NULL)
+    return UVWASI_EINVAL;
+
+  table = uvwasi->fds;
+  if (table == NULL || table->lock_stats == NULL)
+    return UVWASI_ENOTSUP;
+
+  memset(stats, 0, sizeof(*stats));
+  src = (uint64_t*) &table->lock_stats[UVWASI__LOCK_FD_TABLE];
+  dst = (uint64_t*) &stats->fd_table;
+  for (i = 0; i < sizeof(stats->fd_table) / sizeof(uint64_t); i++)
+    dst[i] = uvwasi__atomic_load_u64(&src[i]);
+
+  src = (uint64_t*) &table->lock_stats[UVWASI__LOCK_FD];
+  dst = (uint64_t*) &stats->fd;
+  for (i = 0; i < sizeof(stats->fd) / sizeof(uint64_t); i++)
+    dst[i] = uvwasi__atomic_load_u64(&src[i]);
+
+  /* Keep the fds with the most wait time in descending order. The table lock
+     is taken directly so that the query itself is not counted. */
+  n = 0;
+  uv_rwlock_wrlock(&table->rwlock);
+  for (i = 0; i < table->size; i++) {
+    entry = UVWASI__FD_TABLE_ENTRY(table, i);
+    if (entry->cold == NULL)
+      continue;
+
+    hot.contended = uvwasi__atomic_load_u64(&entry->cold->lock_contended);
+    if (hot.contended == 0)
+      continue;
+
+    hot.wait_ns = uvwasi__atomic_load_u64(&entry->cold->lock_wait_ns);
+    hot.fd = entry->id;
+    hot.reserved = 0;
+
+    if (n == UVWASI_LOCK_STATS_HOT_FDS) {
+      if (hot.wait_ns <= stats->hot_fds[n - 1].wait_ns)
+        continue;
+      n--;
+    }
+
+    for (j = n; j > 0 && stats->hot_fds[j - 1].wait_ns < hot.wait_ns; j--)
+      stats->hot_fds[j] = stats->hot_fds[j - 1];
+
+    stats->hot_fds[j] = hot;
+    n++;
+  }
+  uv_rwlock_wrunlock(&table->rwlock);
+
+  stats->hot_fd_count = n;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_lock_stats_reset(uvwasi_t* uvwasi) {
+  struct uvwasi_fd_table_t* table;
+  struct uvwasi_fd_wrap_t* entry;
+  uint64_t* counters;
+  size_t ncounters;
+  uint32_t i;
+
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  table = uvwasi->fds;
+  if (table == NULL || table->lock_stats == NULL)
+    return UVWASI_ENOTSUP;
+
+  counters = (uint64_t*) table->lock_stats;
+  ncounters = (UVWASI__LOCK_FD + 1) * sizeof(*table->lock_stats) /
+              sizeof(uint64_t);
+  for (i = 0; i < ncounters; i++)
+    uvwasi__atomic_store_u64(&counters[i], 0);
+
+  uv_rwlock_wrlock(&table->rwlock);
+  for (i = 0; i < table->size; i++) {
+    entry = UVWASI__FD_TABLE_ENTRY(table, i);
+    if (entry->cold == NULL)
+      continue;
+
+    uvwasi__atomic_store_u64(&entry->cold->lock_contended, 0);
+    uvwasi__atomic_store_u64(&entry->cold->lock_wait_ns, 0);
+  }
+  uv_rwlock_wrunlock(&table->rwlock);
+
+  return UVWASI_ESUCCESS;
+}
@@ -4,35 +4,134 @@
 #include <stdint.h>
 #include "uv.h"
 #include "wasi_types.h"
+#include "uvwasi.h"
+#include "fd_pool.h"
 
 struct uvwasi_s;
 struct uvwasi_options_s;
+struct uvwasi_lock_class_stats_s;
+struct uvwasi__file_cache_entry_s;
+struct uvwasi__stdio_buf_t;
+struct uvwasi__fd_map_file_t;
 
-struct uvwasi_fd_wrap_t {
-  uvwasi_fd_t id;
-  uv_file fd;
+#define UVWASI__FD_MAP_WINDOWS 4
+
+/* A mapped window of a file, unused while base is NULL. */
+struct uvwasi__fd_map_window_t {
+  char* base;
+  uint64_t offset;
+  size_t len;
+};
+
+/* Per-fd state that lookups do not need. */
+struct uvwasi_fd_cold_t {
   uv_tcp_t* sock;
   char* path;
   char* real_path;
   char* normalized_path;
-  uvwasi_filetype_t type;
+  /* Size of the pool chunk holding the three paths. */
+  size_t path_size;
+  /* Contention on the fd's mutex, kept when lock statistics are enabled. */
+  uint64_t lock_contended;
+  uint64_t lock_wait_ns;
+  /* Attributes cached by fd_filestat_get(), valid while stat_time is
+     non-zero. stat_append is 1 if writes append, 0 if they do not, and -1 if
+     that is unknown. Guarded by the fd's mutex. */
+  uvwasi_filestat_t stat;
+  uint64_t stat_time;
+  int stat_append;
+  /* Windows of the file mapped for reading while map_enabled is set. map_size
+     is the file's size as of map_generation, a count of the writes to the
+     file kept in map_file. Writers that share a file with a mapping hold
+     map_file too. Guarded by the fd's mutex. */
+  struct uvwasi__fd_map_window_t map[UVWASI__FD_MAP_WINDOWS];
+  struct uvwasi__fd_map_file_t* map_file;
+  uint64_t map_size;
+  uint64_t map_generation;
+  uint8_t map_next;
+  uint8_t map_enabled;
+  uint8_t map_size_valid;
+  /* Reads that do not go through the host track the file position
+     themselves. While pos_valid is set, pos is the file position and the
+     host's may be behind it. Guarded by the fd's mutex. */
+  uint64_t pos;
+  uint8_t pos_valid;
+  /* Set for preopens that the embedder marked immutable and for everything
+     opened beneath them. */
+  uint8_t immutable;
+  /* Shared cache entry holding the file's contents, or NULL. */
+  struct uvwasi__file_cache_entry_s* cache_entry;
+  /* Output buffer of the stdout or stderr fd, or NULL. */
+  struct uvwasi__stdio_buf_t* out_buf;
+  /* For fds beneath a preopen backed by a uvwasi_vfs_t, the file system and
+     the open file, which is NULL once closed. Such fds have no host fd and
+     their file position is always pos. vfs_append is set for fds opened with
+     UVWASI_FDFLAG_APPEND. */
+  const uvwasi_vfs_t* vfs;
+  void* vfs_file;
+  uint8_t vfs_append;
+};
+
+/* fd table entries are stored inline in the table's slot blocks. A lookup
+   checks cold and the rights and then takes mutex, so those come first and
+   the rest of the state lives in cold. id is the entry's slot and cold is
+   NULL while the slot is unused. */
+struct uvwasi_fd_wrap_t {
   uvwasi_rights_t rights_base;
   uvwasi_rights_t rights_inheriting;
-  int preopen;
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_fd_t id;
+  uv_file fd;
+  uvwasi_filetype_t type;
+  uint8_t preopen;
   uv_mutex_t mutex;
 };
 
+/* Slots are padded to a multiple of the cache line size and blocks are
+   aligned to it, so that no two entries share a line. Blocks never move once
+   allocated, which keeps entry pointers valid without the table lock. */
+#define UVWASI__FD_CACHE_LINE 64
+#define UVWASI__FD_SLOT_SIZE 128
+#define UVWASI__FD_BLOCK_SHIFT 6
+#define UVWASI__FD_BLOCK_SLOTS (1 << UVWASI__FD_BLOCK_SHIFT)
+
+union uvwasi__fd_slot_u {
+  struct uvwasi_fd_wrap_t wrap;
+  char pad[UVWASI__FD_SLOT_SIZE];
+};
+
+struct uvwasi__fd_block_t {
+  union uvwasi__fd_slot_u* slots;
+  void* mem;
+};
+
+#define UVWASI__FD_TABLE_ENTRY(table, id)                                     \
+  (&(table)->blocks[(id) >> UVWASI__FD_BLOCK_SHIFT]                           \
+      .slots[(id) & (UVWASI__FD_BLOCK_SLOTS - 1)].wrap)
+
+#define UVWASI__LOCK_FD_TABLE 0
+#define UVWASI__LOCK_FD 1
+
 struct uvwasi_fd_table_t {
-  struct uvwasi_fd_wrap_t** fds;
+  struct uvwasi__fd_block_t* blocks;
+  /* Number of slots, always a multiple of UVWASI__FD_BLOCK_SLOTS. */
   uint32_t size;
   uint32_t used;
   uv_rwlock_t rwlock;
+  /* Per lock class statistics, or NULL if lock statistics are disabled. */
+  struct uvwasi_lock_class_stats_s* lock_stats;
+  /* Storage for the entries' cold state, guarded by rwlock. */
+  struct uvwasi_fd_pool_t pool;
 };
 
 uvwasi_errno_t uvwasi_fd_table_init(struct uvwasi_s* uvwasi,
                                     const struct uvwasi_options_s* options);
 void uvwasi_fd_table_free(struct uvwasi_s* uvwasi,
                           struct uvwasi_fd_table_t* table);
+/* Gives uvwasi a table holding copies of the stdio fds and preopens of src,
+   under the same numbers. */
+uvwasi_errno_t uvwasi_fd_table_clone(struct uvwasi_s* uvwasi,
+                                     struct uvwasi_fd_table_t* src);
 uvwasi_errno_t uvwasi_fd_table_insert(struct uvwasi_s* uvwasi,
                                       struct uvwasi_fd_table_t* table,
                                       uv_file fd,
@@ -48,7 +147,13 @@ uvwasi_errno_t uvwasi_fd_table_insert_preopen(struct uvwasi_s* uvwasi,
                                               struct uvwasi_fd_table_t* table,
                                               const uv_file fd,
                                               const char* path,
-                                              const char* real_path);
+                                              const char* real_path,
+                                              int immutable);
+uvwasi_errno_t uvwasi_fd_table_insert_preopen_vfs(struct uvwasi_s* uvwasi,
+                                              struct uvwasi_fd_table_t* table,
+                                              const char* path,
+                                              const uvwasi_vfs_t* vfs,
+                                              int immutable);
 uvwasi_errno_t uvwasi_fd_table_insert_preopen_socket(struct uvwasi_s* uvwasi,
                                               struct uvwasi_fd_table_t* table,
                                               uv_tcp_t* sock);
@@ -71,5 +176,7 @@ uvwasi_errno_t uvwasi_fd_table_renumber(struct uvwasi_s* uvwasi,
                                         const uvwasi_fd_t src);
 uvwasi_errno_t uvwasi_fd_table_lock(struct uvwasi_fd_table_t* table);
 uvwasi_errno_t uvwasi_fd_table_unlock(struct uvwasi_fd_table_t* table);
+uvwasi_errno_t uvwasi_fd_table_rdlock(struct uvwasi_fd_table_t* table);
+uvwasi_errno_t uvwasi_fd_table_rdunlock(struct uvwasi_fd_table_t* table);
 
 #endif /* __UVWASI_FD_TABLE_H__ */
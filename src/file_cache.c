@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "file_cache.h"
+#include "filestat.h"
+#include "uv_mapping.h"
+#include "uvwasi_alloc.h"
+
+#define UVWASI__FILE_CACHE_BUCKETS 256
+
+/* A cached file is identified by its device, inode, modification time, and
+   size, so a file that is replaced or modified gets a new entry. The old one
+   ages out once it is unreferenced. */
+struct uvwasi__file_cache_entry_s {
+  uvwasi_file_cache_t* cache;
+  struct uvwasi__file_cache_entry_s* hash_next;
+  /* Neighbours in the cache's LRU list, which holds the entries whose refs is
+     zero. */
+  struct uvwasi__file_cache_entry_s* lru_prev;
+  struct uvwasi__file_cache_entry_s* lru_next;
+  uvwasi_device_t dev;
+  uvwasi_inode_t ino;
+  uvwasi_timestamp_t mtim;
+  uvwasi_filesize_t size;
+  uint64_t refs;
+  char* data;
+};
+
+struct uvwasi_file_cache_s {
+  uv_mutex_t mutex;
+  const uvwasi_mem_t* allocator;
+  uint64_t size_limit;
+  uvwasi_file_cache_stats_t stats;
+  struct uvwasi__file_cache_entry_s* buckets[UVWASI__FILE_CACHE_BUCKETS];
+  /* Least recently used first. lru_bytes is the size of the entries in the
+     list, which is what eviction can free. */
+  struct uvwasi__file_cache_entry_s* lru_head;
+  struct uvwasi__file_cache_entry_s* lru_tail;
+  uint64_t lru_bytes;
+};
+
+
+static uint32_t uvwasi__file_cache_hash(uvwasi_device_t dev,
+                                        uvwasi_inode_t ino) {
+  uint64_t h;
+
+  h = (ino ^ (dev << 32) ^ (dev >> 32)) * 0x9E3779B97F4A7C15ULL;
+  return (uint32_t) (h >> 32) % UVWASI__FILE_CACHE_BUCKETS;
+}
+
+
+static struct uvwasi__file_cache_entry_s* uvwasi__file_cache_find(
+                                            uvwasi_file_cache_t* cache,
+                                            const uvwasi_filestat_t* stat) {
+  struct uvwasi__file_cache_entry_s* entry;
+
+  entry = cache->buckets[uvwasi__file_cache_hash(stat->st_dev, stat->st_ino)];
+  for (; entry != NULL; entry = entry->hash_next) {
+    if (entry->dev == stat->st_dev &&
+        entry->ino == stat->st_ino &&
+        entry->mtim == stat->st_mtim &&
+        entry->size == stat->st_size) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+
+static void uvwasi__file_cache_lru_remove(
+                                    uvwasi_file_cache_t* cache,
+                                    struct uvwasi__file_cache_entry_s* entry) {
+  if (entry->lru_prev != NULL)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    cache->lru_head = entry->lru_next;
+
+  if (entry->lru_next != NULL)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    cache->lru_tail = entry->lru_prev;
+
+  entry->lru_prev = NULL;
+  entry->lru_next = NULL;
+  cache->lru_bytes -= entry->size;
+}
+
+
+/* Takes a reference to entry. The caller holds the cache's mutex. */
+static void uvwasi__file_cache_ref(uvwasi_file_cache_t* cache,
+                                   struct uvwasi__file_cache_entry_s* entry) {
+  if (entry->refs == 0)
+    uvwasi__file_cache_lru_remove(cache, entry);
+
+  entry->refs++;
+}
+
+
+/* Drops the least recently used unreferenced entry. The caller holds the
+   cache's mutex. Returns 0 if there is none. */
+static int uvwasi__file_cache_evict(uvwasi_file_cache_t* cache) {
+  struct uvwasi__file_cache_entry_s** link;
+  struct uvwasi__file_cache_entry_s* entry;
+
+  entry = cache->lru_head;
+  if (entry == NULL)
+    return 0;
+
+  uvwasi__file_cache_lru_remove(cache, entry);
+  link = &cache->buckets[uvwasi__file_cache_hash(entry->dev, entry->ino)];
+  while (*link != entry)
+    link = &(*link)->hash_next;
+  *link = entry->hash_next;
+
+  cache->stats.entries--;
+  cache->stats.bytes -= entry->size;
+  cache->stats.evictions++;
+  cache->allocator->free(entry, cache->allocator->mem_user_data);
+  return 1;
+}
+
+
+/* Reads the whole file into entry->data. Fails if the file no longer matches
+   the attributes the entry was created with. */
+static uvwasi_errno_t uvwasi__file_cache_load(
+                                    const uvwasi_t* uvwasi,
+                                    uv_file fd,
+                                    struct uvwasi__file_cache_entry_s* entry) {
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uv_buf_t buf;
+  uv_fs_t req;
+  uint64_t pos;
+  int r;
+
+  pos = 0;
+  while (pos < entry->size) {
+    buf = uv_buf_init(entry->data + pos, (unsigned int) (entry->size - pos));
+    r = uv_fs_read(NULL, &req, fd, &buf, 1, (int64_t) pos, NULL);
+    uv_fs_req_cleanup(&req);
+    if (r < 0)
+      return uvwasi__translate_uv_error(r);
+    if (r == 0)
+      return UVWASI_ENOTSUP;
+
+    pos += (uint64_t) r;
+  }
+
+  err = uvwasi__filestat_fd(uvwasi, fd, &stat);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (stat.st_mtim != entry->mtim || stat.st_size != entry->size)
+    return UVWASI_ENOTSUP;
+
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__file_cache_acquire(
+                                    uvwasi_file_cache_t* cache,
+                                    const uvwasi_t* uvwasi,
+                                    uv_file fd,
+                                    struct uvwasi__file_cache_entry_s** entry) {
+  struct uvwasi__file_cache_entry_s* found;
+  struct uvwasi__file_cache_entry_s* e;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uint32_t bucket;
+
+  err = uvwasi__filestat_fd(uvwasi, fd, &stat);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (stat.st_filetype != UVWASI_FILETYPE_REGULAR_FILE)
+    return UVWASI_ENOTSUP;
+
+  uv_mutex_lock(&cache->mutex);
+  found = uvwasi__file_cache_find(cache, &stat);
+  if (found != NULL) {
+    uvwasi__file_cache_ref(cache, found);
+    cache->stats.hits++;
+    uv_mutex_unlock(&cache->mutex);
+    *entry = found;
+    return UVWASI_ESUCCESS;
+  }
+
+  cache->stats.misses++;
+  uv_mutex_unlock(&cache->mutex);
+
+  if (stat.st_size > cache->size_limit ||
+      stat.st_size > (size_t) -1 - sizeof(*e) ||
+      stat.st_size > UINT32_MAX) {
+    return UVWASI_ENOTSUP;
+  }
+
+  /* Load the file without holding the mutex, so that other sandboxes are not
+     held up by it. */
+  e = cache->allocator->malloc(sizeof(*e) + (size_t) stat.st_size,
+                               cache->allocator->mem_user_data);
+  if (e == NULL)
+    return UVWASI_ENOMEM;
+
+  e->cache = cache;
+  e->lru_prev = NULL;
+  e->lru_next = NULL;
+  e->dev = stat.st_dev;
+  e->ino = stat.st_ino;
+  e->mtim = stat.st_mtim;
+  e->size = stat.st_size;
+  e->refs = 1;
+  e->data = (char*) (e + 1);
+  err = uvwasi__file_cache_load(uvwasi, fd, e);
+  if (err != UVWASI_ESUCCESS) {
+    cache->allocator->free(e, cache->allocator->mem_user_data);
+    return err;
+  }
+
+  uv_mutex_lock(&cache->mutex);
+
+  /* Another sandbox may have loaded the same file in the meantime. */
+  found = uvwasi__file_cache_find(cache, &stat);
+  if (found != NULL) {
+    uvwasi__file_cache_ref(cache, found);
+    uv_mutex_unlock(&cache->mutex);
+    cache->allocator->free(e, cache->allocator->mem_user_data);
+    *entry = found;
+    return UVWASI_ESUCCESS;
+  }
+
+  /* Nothing is evicted for an entry that would not fit anyway. */
+  if (cache->stats.bytes - cache->lru_bytes + e->size > cache->size_limit) {
+    uv_mutex_unlock(&cache->mutex);
+    cache->allocator->free(e, cache->allocator->mem_user_data);
+    return UVWASI_ENOTSUP;
+  }
+
+  while (cache->stats.bytes + e->size > cache->size_limit) {
+    if (!uvwasi__file_cache_evict(cache)) {
+      uv_mutex_unlock(&cache->mutex);
+      cache->allocator->free(e, cache->allocator->mem_user_data);
+      return UVWASI_ENOTSUP;
+    }
+  }
+
+  bucket = uvwasi__file_cache_hash(e->dev, e->ino);
+  e->hash_next = cache->buckets[bucket];
+  cache->buckets[bucket] = e;
+  cache->stats.entries++;
+  cache->stats.bytes += e->size;
+  uv_mutex_unlock(&cache->mutex);
+  *entry = e;
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__file_cache_release(struct uvwasi__file_cache_entry_s* entry) {
+  uvwasi_file_cache_t* cache;
+
+  cache = entry->cache;
+  uv_mutex_lock(&cache->mutex);
+  entry->refs--;
+  if (entry->refs == 0) {
+    entry->lru_prev = cache->lru_tail;
+    entry->lru_next = NULL;
+    if (cache->lru_tail != NULL)
+      cache->lru_tail->lru_next = entry;
+    else
+      cache->lru_head = entry;
+    cache->lru_tail = entry;
+    cache->lru_bytes += entry->size;
+  }
+  uv_mutex_unlock(&cache->mutex);
+}
+
+
+uvwasi_errno_t uvwasi__file_cache_read(
+                                const struct uvwasi__file_cache_entry_s* entry,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                uint64_t pos,
+                                uvwasi_size_t* nread) {
+  uvwasi_size_t total;
+  uvwasi_size_t i;
+  uint64_t avail;
+  size_t n;
+
+  total = 0;
+  for (i = 0; i < iovs_len && pos < entry->size; i++) {
+    avail = entry->size - pos;
+    n = iovs[i].buf_len < avail ? iovs[i].buf_len : (size_t) avail;
+    memcpy(iovs[i].buf, entry->data + pos, n);
+    pos += n;
+    total += (uvwasi_size_t) n;
+  }
+
+  *nread = total;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_file_cache_new(uint64_t size_limit,
+                                     const uvwasi_mem_t* allocator,
+                                     uvwasi_file_cache_t** cache) {
+  uvwasi_file_cache_t* c;
+
+  if (cache == NULL)
+    return UVWASI_EINVAL;
+
+  if (allocator == NULL)
+    allocator = &uvwasi__default_allocator;
+
+  c = allocator->calloc(1, sizeof(*c), allocator->mem_user_data);
+  if (c == NULL)
+    return UVWASI_ENOMEM;
+
+  if (uv_mutex_init(&c->mutex) != 0) {
+    allocator->free(c, allocator->mem_user_data);
+    return UVWASI_ENOMEM;
+  }
+
+  c->allocator = allocator;
+  c->size_limit = size_limit;
+  *cache = c;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_file_cache_free(uvwasi_file_cache_t* cache) {
+  const uvwasi_mem_t* allocator;
+
+  if (cache == NULL)
+    return UVWASI_EINVAL;
+
+  /* Every entry is unreferenced, and therefore evictable, once no sandbox
+     has a cached file open. */
+  uv_mutex_lock(&cache->mutex);
+  while (uvwasi__file_cache_evict(cache))
+    ;
+
+  if (cache->stats.entries != 0) {
+    uv_mutex_unlock(&cache->mutex);
+    return UVWASI_EBUSY;
+  }
+
+  uv_mutex_unlock(&cache->mutex);
+  uv_mutex_destroy(&cache->mutex);
+  allocator = cache->allocator;
+  allocator->free(cache, allocator->mem_user_data);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_file_cache_stats_get(uvwasi_file_cache_t* cache,
+                                           uvwasi_file_cache_stats_t* stats) {
+  if (cache == NULL || stats == NULL)
+    return UVWASI_EINVAL;
+
+  uv_mutex_lock(&cache->mutex);
+  *stats = cache->stats;
+  uv_mutex_unlock(&cache->mutex);
+  return UVWASI_ESUCCESS;
+}
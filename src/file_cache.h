@@ -0,0 +1,27 @@
+#ifndef __UVWASI_FILE_CACHE_H__
+#define __UVWASI_FILE_CACHE_H__
+
+#include "uv.h"
+#include "uvwasi.h"
+
+struct uvwasi__file_cache_entry_s;
+
+/* Looks up the contents of the open regular file fd, loading them into the
+   cache if they are missing. On success the caller holds a reference to
+   *entry. Returns UVWASI_ENOTSUP if the file cannot be cached. */
+uvwasi_errno_t uvwasi__file_cache_acquire(
+                                    uvwasi_file_cache_t* cache,
+                                    const uvwasi_t* uvwasi,
+                                    uv_file fd,
+                                    struct uvwasi__file_cache_entry_s** entry);
+void uvwasi__file_cache_release(struct uvwasi__file_cache_entry_s* entry);
+/* Copies the cached contents starting at pos. Needs no lock, since contents
+   never change while they are referenced. */
+uvwasi_errno_t uvwasi__file_cache_read(
+                                const struct uvwasi__file_cache_entry_s* entry,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                uint64_t pos,
+                                uvwasi_size_t* nread);
+
+#endif /* __UVWASI_FILE_CACHE_H__ */
@@ -0,0 +1,243 @@
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+#endif /* _WIN32 */
+
+#if defined(__linux__)
+# include <sys/stat.h>
+# include <sys/sysmacros.h>
+#endif /* defined(__linux__) */
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "filestat.h"
+#include "fd_table.h"
+#include "clocks.h"
+#include "uv_mapping.h"
+#include "atomic_ops.h"
+
+/* statx() lets the kernel skip attributes that uvwasi_filestat_t does not
+   hold, such as the owner and block counts. This matters on network and FUSE
+   file systems, where every attribute can cost a round trip. */
+#if defined(__linux__) && defined(STATX_TYPE) && defined(AT_STATX_DONT_SYNC)
+# define UVWASI__HAVE_STATX 1
+#endif
+
+#ifdef UVWASI__HAVE_STATX
+# define UVWASI__STATX_MASK                                                   \
+  (STATX_TYPE | STATX_INO | STATX_NLINK | STATX_SIZE |                        \
+   STATX_ATIME | STATX_MTIME | STATX_CTIME)
+
+/* Set once statx() has failed with ENOSYS or EPERM, which happens on old
+   kernels and under some seccomp filters. libuv is used from then on. */
+static uint32_t uvwasi__statx_unavailable;
+
+
+static uvwasi_timestamp_t uvwasi__statx_timestamp(
+                                          const struct statx_timestamp* ts) {
+  return (uvwasi_timestamp_t) ts->tv_sec * NANOS_PER_SEC + ts->tv_nsec;
+}
+
+
+/* Returns 0 on success, a negated uv error, or 1 if statx() is unavailable. */
+static int uvwasi__statx(const struct uvwasi_s* uvwasi,
+                         int dirfd,
+                         const char* path,
+                         int flags,
+                         uvwasi_filestat_t* buf) {
+  struct statx stx;
+  uv_stat_t mode;
+
+  if (uvwasi__atomic_load_u32(&uvwasi__statx_unavailable))
+    return 1;
+
+  if (uvwasi->filestat_dont_sync)
+    flags |= AT_STATX_DONT_SYNC;
+
+  if (statx(dirfd, path, flags, UVWASI__STATX_MASK, &stx) != 0) {
+    if (errno == ENOSYS || errno == EPERM) {
+      uvwasi__atomic_store_u32(&uvwasi__statx_unavailable, 1);
+      return 1;
+    }
+
+    return uv_translate_sys_error(errno);
+  }
+
+  /* Derive st_dev the same way libuv does so that both paths agree. */
+  mode.st_mode = stx.stx_mode;
+  buf->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+  buf->st_ino = stx.stx_ino;
+  buf->st_nlink = stx.stx_nlink;
+  buf->st_size = stx.stx_size;
+  buf->st_filetype = uvwasi__stat_to_filetype(&mode);
+  buf->st_atim = uvwasi__statx_timestamp(&stx.stx_atime);
+  buf->st_mtim = uvwasi__statx_timestamp(&stx.stx_mtime);
+  buf->st_ctim = uvwasi__statx_timestamp(&stx.stx_ctime);
+  return 0;
+}
+#endif /* UVWASI__HAVE_STATX */
+
+
+uvwasi_errno_t uvwasi__filestat_fd(const struct uvwasi_s* uvwasi,
+                                   uv_file fd,
+                                   uvwasi_filestat_t* buf) {
+  uv_fs_t req;
+  int r;
+
+#ifdef UVWASI__HAVE_STATX
+  r = uvwasi__statx(uvwasi, fd, "", AT_EMPTY_PATH, buf);
+  if (r <= 0)
+    return r == 0 ? UVWASI_ESUCCESS : uvwasi__translate_uv_error(r);
+#endif /* UVWASI__HAVE_STATX */
+
+  r = uv_fs_fstat(NULL, &req, fd, NULL);
+  if (r == 0)
+    uvwasi__stat_to_filestat(&req.statbuf, buf);
+
+  uv_fs_req_cleanup(&req);
+  return r == 0 ? UVWASI_ESUCCESS : uvwasi__translate_uv_error(r);
+}
+
+
+uvwasi_errno_t uvwasi__filestat_path(const struct uvwasi_s* uvwasi,
+                                     const char* path,
+                                     uvwasi_filestat_t* buf) {
+  uv_fs_t req;
+  int r;
+
+#ifdef UVWASI__HAVE_STATX
+  r = uvwasi__statx(uvwasi, AT_FDCWD, path, AT_SYMLINK_NOFOLLOW, buf);
+  if (r <= 0)
+    return r == 0 ? UVWASI_ESUCCESS : uvwasi__translate_uv_error(r);
+#endif /* UVWASI__HAVE_STATX */
+
+  r = uv_fs_lstat(NULL, &req, path, NULL);
+  if (r == 0)
+    uvwasi__stat_to_filestat(&req.statbuf, buf);
+
+  uv_fs_req_cleanup(&req);
+  return r == 0 ? UVWASI_ESUCCESS : uvwasi__translate_uv_error(r);
+}
+
+
+/* Returns the cached attributes of wrap while they are younger than the
+   configured TTL, and refreshes them otherwise. The caller holds the fd's
+   mutex. */
+uvwasi_errno_t uvwasi__filestat_fd_cached(const struct uvwasi_s* uvwasi,
+                                          struct uvwasi_fd_wrap_t* wrap,
+                                          uvwasi_filestat_t* buf) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_errno_t err;
+  uint64_t now;
+#ifndef _WIN32
+  int flags;
+#endif /* _WIN32 */
+
+  if (uvwasi->filestat_cache_ttl == 0)
+    return uvwasi__filestat_fd(uvwasi, wrap->fd, buf);
+
+  cold = wrap->cold;
+  now = uv_hrtime();
+  if (cold->stat_time != 0 &&
+      now - cold->stat_time < uvwasi->filestat_cache_ttl) {
+    *buf = cold->stat;
+    return UVWASI_ESUCCESS;
+  }
+
+  err = uvwasi__filestat_fd(uvwasi, wrap->fd, &cold->stat);
+  if (err != UVWASI_ESUCCESS) {
+    cold->stat_time = 0;
+    return err;
+  }
+
+  /* Writes can only be accounted for if it is known whether they append. */
+  cold->stat_append = -1;
+#ifndef _WIN32
+  if (cold->stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE) {
+    flags = fcntl(wrap->fd, F_GETFL);
+    if (flags != -1)
+      cold->stat_append = (flags & O_APPEND) != 0;
+  }
+#endif /* _WIN32 */
+
+  cold->stat_time = now;
+  *buf = cold->stat;
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__filestat_cache_invalidate(struct uvwasi_fd_wrap_t* wrap) {
+  wrap->cold->stat_time = 0;
+}
+
+
+/* Cached changes take their timestamps from the realtime clock, which can
+   differ slightly from what the file system records. */
+static void uvwasi__filestat_cache_touch(struct uvwasi_fd_cold_t* cold) {
+  uvwasi_timestamp_t now;
+
+  if (uvwasi__clock_gettime_realtime(&now) != UVWASI_ESUCCESS) {
+    cold->stat_time = 0;
+    return;
+  }
+
+  cold->stat.st_mtim = now;
+  cold->stat.st_ctim = now;
+}
+
+
+void uvwasi__filestat_cache_wrote(struct uvwasi_fd_wrap_t* wrap,
+                                  int64_t offset,
+                                  uvwasi_filesize_t nwritten) {
+  struct uvwasi_fd_cold_t* cold;
+
+  cold = wrap->cold;
+  if (cold->stat_time == 0 || nwritten == 0)
+    return;
+
+  /* Appending writes ignore the offset. Otherwise the file position is not
+     tracked, so a write at it drops the cached attributes. */
+  if (cold->stat_append == 1) {
+    cold->stat.st_size += nwritten;
+  } else if (cold->stat_append == 0 && offset >= 0) {
+    if ((uvwasi_filesize_t) offset + nwritten > cold->stat.st_size)
+      cold->stat.st_size = (uvwasi_filesize_t) offset + nwritten;
+  } else {
+    cold->stat_time = 0;
+    return;
+  }
+
+  uvwasi__filestat_cache_touch(cold);
+}
+
+
+void uvwasi__filestat_cache_resized(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t size,
+                                    int grow_only) {
+  struct uvwasi_fd_cold_t* cold;
+
+  cold = wrap->cold;
+  if (cold->stat_time == 0)
+    return;
+
+  if (grow_only && size <= cold->stat.st_size)
+    return;
+
+  cold->stat.st_size = size;
+  uvwasi__filestat_cache_touch(cold);
+}
+
+
+void uvwasi__filestat_cache_set_times(struct uvwasi_fd_wrap_t* wrap,
+                                      uvwasi_timestamp_t atim,
+                                      uvwasi_timestamp_t mtim) {
+  struct uvwasi_fd_cold_t* cold;
+
+  cold = wrap->cold;
+  if (cold->stat_time == 0)
+    return;
+
+  uvwasi__filestat_cache_touch(cold);
+  cold->stat.st_atim = atim;
+  cold->stat.st_mtim = mtim;
+}
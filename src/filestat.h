@@ -0,0 +1,38 @@
+#ifndef __UVWASI_FILESTAT_H__
+#define __UVWASI_FILESTAT_H__
+
+#include "uv.h"
+#include "wasi_types.h"
+
+struct uvwasi_s;
+struct uvwasi_fd_wrap_t;
+
+/* Fill in a uvwasi_filestat_t for an open file or, without following a final
+   symbolic link, for a host path. Only the attributes that uvwasi_filestat_t
+   holds are requested where the platform allows it. */
+uvwasi_errno_t uvwasi__filestat_fd(const struct uvwasi_s* uvwasi,
+                                   uv_file fd,
+                                   uvwasi_filestat_t* buf);
+uvwasi_errno_t uvwasi__filestat_path(const struct uvwasi_s* uvwasi,
+                                     const char* path,
+                                     uvwasi_filestat_t* buf);
+
+/* Per-fd attribute cache, enabled by uvwasi_options_t.filestat_cache_ttl.
+   Calls that change a file through the same fd update its cached attributes
+   in place. All of these require the fd's mutex to be held. */
+uvwasi_errno_t uvwasi__filestat_fd_cached(const struct uvwasi_s* uvwasi,
+                                          struct uvwasi_fd_wrap_t* wrap,
+                                          uvwasi_filestat_t* buf);
+void uvwasi__filestat_cache_invalidate(struct uvwasi_fd_wrap_t* wrap);
+/* offset is -1 for writes at the current file position. */
+void uvwasi__filestat_cache_wrote(struct uvwasi_fd_wrap_t* wrap,
+                                  int64_t offset,
+                                  uvwasi_filesize_t nwritten);
+void uvwasi__filestat_cache_resized(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t size,
+                                    int grow_only);
+void uvwasi__filestat_cache_set_times(struct uvwasi_fd_wrap_t* wrap,
+                                      uvwasi_timestamp_t atim,
+                                      uvwasi_timestamp_t mtim);
+
+#endif /* __UVWASI_FILESTAT_H__ */
@@ -0,0 +1,1184 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "clocks.h"
+#include "uvwasi_alloc.h"
+
+/* Symbolic links followed while looking up a single path. */
+#define UVWASI__MEMFS_MAX_LINKS 32
+#define UVWASI__MEMFS_MIN_CAPACITY 64
+
+typedef struct uvwasi__memfs_node_s uvwasi__memfs_node_t;
+
+struct uvwasi__memfs_entry_s {
+  char* name;
+  size_t name_len;
+  uvwasi__memfs_node_t* node;
+};
+
+/* Files, directories and symbolic links. A node is freed once no directory
+   entry refers to it and no handle to it is open. */
+struct uvwasi__memfs_node_s {
+  uvwasi_filetype_t type;
+  uvwasi_inode_t ino;
+  uvwasi_linkcount_t nlink;
+  uint64_t refs;
+  uvwasi_timestamp_t atim;
+  uvwasi_timestamp_t mtim;
+  uvwasi_timestamp_t ctim;
+  /* Contents of regular files, and targets of symbolic links. */
+  char* data;
+  uvwasi_filesize_t size;
+  size_t capacity;
+  /* Entries of directories, in creation order. parent is NULL for the root
+     and for directories that have been removed. */
+  struct uvwasi__memfs_entry_s* entries;
+  uint32_t entry_count;
+  uint32_t entry_capacity;
+  uvwasi__memfs_node_t* parent;
+};
+
+/* Every operation holds mutex for its whole duration. used_bytes is the
+   memory held by the tree: nodes, entry arrays, names, and the capacity held
+   by the contents of files and links. size_limit caps it unless it is zero. */
+struct uvwasi_memfs_s {
+  uvwasi_vfs_t vfs;
+  uv_mutex_t mutex;
+  const uvwasi_mem_t* allocator;
+  uint64_t size_limit;
+  uint64_t used_bytes;
+  uvwasi__memfs_node_t* root;
+  uvwasi_inode_t next_ino;
+  uint64_t open_files;
+};
+
+
+static void uvwasi__memfs_free_mem(uvwasi_memfs_t* memfs, void* ptr) {
+  memfs->allocator->free(ptr, memfs->allocator->mem_user_data);
+}
+
+
+/* Returns whether size more bytes fit within the size limit. */
+static int uvwasi__memfs_fits(const uvwasi_memfs_t* memfs, uint64_t size) {
+  return memfs->size_limit == 0 ||
+         (memfs->used_bytes <= memfs->size_limit &&
+          size <= memfs->size_limit - memfs->used_bytes);
+}
+
+
+static uvwasi_timestamp_t uvwasi__memfs_now(void) {
+  uvwasi_timestamp_t now;
+
+  if (uvwasi__clock_gettime_realtime(&now) != UVWASI_ESUCCESS)
+    return 0;
+
+  return now;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_node_new(uvwasi_memfs_t* memfs,
+                                              uvwasi_filetype_t type,
+                                              uvwasi__memfs_node_t** out) {
+  const uvwasi_mem_t* allocator;
+  uvwasi__memfs_node_t* node;
+
+  if (!uvwasi__memfs_fits(memfs, sizeof(*node)))
+    return UVWASI_ENOSPC;
+
+  allocator = memfs->allocator;
+  node = allocator->calloc(1, sizeof(*node), allocator->mem_user_data);
+  if (node == NULL)
+    return UVWASI_ENOMEM;
+
+  memfs->used_bytes += sizeof(*node);
+  node->type = type;
+  node->ino = ++memfs->next_ino;
+  node->atim = uvwasi__memfs_now();
+  node->mtim = node->atim;
+  node->ctim = node->atim;
+  *out = node;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__memfs_node_free(uvwasi_memfs_t* memfs,
+                                    uvwasi__memfs_node_t* node) {
+  memfs->used_bytes -= sizeof(*node) + node->capacity +
+                       node->entry_capacity * sizeof(*node->entries);
+  uvwasi__memfs_free_mem(memfs, node->data);
+  uvwasi__memfs_free_mem(memfs, node->entries);
+  uvwasi__memfs_free_mem(memfs, node);
+}
+
+
+/* Frees a directory and everything that is only reachable through it. */
+static void uvwasi__memfs_tree_free(uvwasi_memfs_t* memfs,
+                                    uvwasi__memfs_node_t* dir) {
+  uvwasi__memfs_node_t* node;
+  uint32_t i;
+
+  for (i = 0; i < dir->entry_count; i++) {
+    node = dir->entries[i].node;
+    memfs->used_bytes -= dir->entries[i].name_len + 1;
+    uvwasi__memfs_free_mem(memfs, dir->entries[i].name);
+    if (--node->nlink != 0)
+      continue;
+
+    if (node->type == UVWASI_FILETYPE_DIRECTORY)
+      uvwasi__memfs_tree_free(memfs, node);
+    else
+      uvwasi__memfs_node_free(memfs, node);
+  }
+
+  uvwasi__memfs_node_free(memfs, dir);
+}
+
+
+static void uvwasi__memfs_release(uvwasi_memfs_t* memfs,
+                                  uvwasi__memfs_node_t* node) {
+  if (node->nlink == 0 && node->refs == 0)
+    uvwasi__memfs_node_free(memfs, node);
+}
+
+
+/* Makes room for size bytes of data, zero filling any bytes added past the
+   current size. Growth is capped at what is left of the size limit, and
+   fails with ENOSPC once even size bytes would exceed it. */
+static uvwasi_errno_t uvwasi__memfs_reserve(uvwasi_memfs_t* memfs,
+                                            uvwasi__memfs_node_t* node,
+                                            uvwasi_filesize_t size) {
+  const uvwasi_mem_t* allocator;
+  size_t capacity;
+  char* data;
+
+  if (size > SIZE_MAX)
+    return UVWASI_EFBIG;
+
+  if (size > node->capacity) {
+    capacity = node->capacity;
+    if (capacity < UVWASI__MEMFS_MIN_CAPACITY)
+      capacity = UVWASI__MEMFS_MIN_CAPACITY;
+    while (capacity < size && capacity <= SIZE_MAX / 2)
+      capacity *= 2;
+    if (capacity < size)
+      capacity = (size_t) size;
+
+    if (!uvwasi__memfs_fits(memfs, capacity - node->capacity)) {
+      if (!uvwasi__memfs_fits(memfs, size - node->capacity))
+        return UVWASI_ENOSPC;
+
+      capacity = (size_t) size;
+    }
+
+    allocator = memfs->allocator;
+    data = allocator->realloc(node->data, capacity, allocator->mem_user_data);
+    if (data == NULL)
+      return UVWASI_ENOMEM;
+
+    memfs->used_bytes += capacity - node->capacity;
+    node->data = data;
+    node->capacity = capacity;
+  }
+
+  if (size > node->size)
+    memset(node->data + node->size, 0, (size_t) (size - node->size));
+
+  return UVWASI_ESUCCESS;
+}
+
+
+static struct uvwasi__memfs_entry_s* uvwasi__memfs_find(
+                                              uvwasi__memfs_node_t* dir,
+                                              const char* name,
+                                              size_t name_len) {
+  struct uvwasi__memfs_entry_s* entry;
+  uint32_t i;
+
+  for (i = 0; i < dir->entry_count; i++) {
+    entry = &dir->entries[i];
+    if (entry->name_len == name_len &&
+        memcmp(entry->name, name, name_len) == 0) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+
+/* Follows path from dir. Symbolic links are followed in every component but
+   the last, and in the last one too when follow is set or the path ends in a
+   slash. Their targets must be relative, since the file system does not know
+   where the sandbox has mapped it. */
+static uvwasi_errno_t uvwasi__memfs_walk(uvwasi__memfs_node_t* dir,
+                                         const char* path,
+                                         size_t len,
+                                         int follow,
+                                         uint32_t* links,
+                                         uvwasi__memfs_node_t** node) {
+  struct uvwasi__memfs_entry_s* entry;
+  uvwasi__memfs_node_t* child;
+  uvwasi_errno_t err;
+  size_t start;
+  size_t i;
+
+  i = 0;
+  while (i < len) {
+    while (i < len && path[i] == '/')
+      i++;
+    if (i == len)
+      break;
+
+    start = i;
+    while (i < len && path[i] != '/')
+      i++;
+
+    if (dir->type != UVWASI_FILETYPE_DIRECTORY)
+      return UVWASI_ENOTDIR;
+
+    if (i - start == 1 && path[start] == '.')
+      continue;
+
+    if (i - start == 2 && path[start] == '.' && path[start + 1] == '.') {
+      if (dir->parent != NULL)
+        dir = dir->parent;
+      continue;
+    }
+
+    entry = uvwasi__memfs_find(dir, path + start, i - start);
+    if (entry == NULL)
+      return UVWASI_ENOENT;
+
+    child = entry->node;
+    if (child->type == UVWASI_FILETYPE_SYMBOLIC_LINK && (follow || i < len)) {
+      if (++*links > UVWASI__MEMFS_MAX_LINKS)
+        return UVWASI_ELOOP;
+
+      if (child->size > 0 && child->data[0] == '/')
+        return UVWASI_ENOTCAPABLE;
+
+      err = uvwasi__memfs_walk(dir,
+                               child->data,
+                               (size_t) child->size,
+                               1,
+                               links,
+                               &child);
+      if (err != UVWASI_ESUCCESS)
+        return err;
+    }
+
+    dir = child;
+  }
+
+  if (len > 0 && path[len - 1] == '/' &&
+      dir->type != UVWASI_FILETYPE_DIRECTORY) {
+    return UVWASI_ENOTDIR;
+  }
+
+  *node = dir;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_lookup(uvwasi_memfs_t* memfs,
+                                           const char* path,
+                                           int follow,
+                                           uvwasi__memfs_node_t** node) {
+  uint32_t links;
+
+  links = 0;
+  return uvwasi__memfs_walk(memfs->root,
+                            path,
+                            strlen(path),
+                            follow,
+                            &links,
+                            node);
+}
+
+
+/* Finds the directory that holds the last component of path. name_len is 0
+   for the root. */
+static uvwasi_errno_t uvwasi__memfs_lookup_parent(uvwasi_memfs_t* memfs,
+                                                  const char* path,
+                                                  uvwasi__memfs_node_t** dir,
+                                                  const char** name,
+                                                  size_t* name_len) {
+  uvwasi_errno_t err;
+  uint32_t links;
+  size_t len;
+  size_t end;
+
+  len = strlen(path);
+  while (len > 1 && path[len - 1] == '/')
+    len--;
+
+  end = len;
+  while (end > 0 && path[end - 1] != '/')
+    end--;
+
+  links = 0;
+  err = uvwasi__memfs_walk(memfs->root, path, end, 1, &links, dir);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if ((*dir)->type != UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_ENOTDIR;
+
+  *name = path + end;
+  *name_len = len - end;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_reserve_entry(uvwasi_memfs_t* memfs,
+                                                  uvwasi__memfs_node_t* dir) {
+  const uvwasi_mem_t* allocator;
+  struct uvwasi__memfs_entry_s* entries;
+  uint32_t capacity;
+
+  if (dir->entry_count < dir->entry_capacity)
+    return UVWASI_ESUCCESS;
+
+  if (dir->entry_capacity >= UINT32_MAX / 2)
+    return UVWASI_ENOSPC;
+
+  capacity = dir->entry_capacity == 0 ? 8 : dir->entry_capacity * 2;
+  if (!uvwasi__memfs_fits(memfs,
+                          (uint64_t) (capacity - dir->entry_capacity) *
+                            sizeof(*entries))) {
+    return UVWASI_ENOSPC;
+  }
+
+  allocator = memfs->allocator;
+  entries = allocator->realloc(dir->entries,
+                               capacity * sizeof(*entries),
+                               allocator->mem_user_data);
+  if (entries == NULL)
+    return UVWASI_ENOMEM;
+
+  memfs->used_bytes += (uint64_t) (capacity - dir->entry_capacity) *
+                       sizeof(*entries);
+  dir->entries = entries;
+  dir->entry_capacity = capacity;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Adds node to dir under a copy of name. */
+static uvwasi_errno_t uvwasi__memfs_add_entry(uvwasi_memfs_t* memfs,
+                                              uvwasi__memfs_node_t* dir,
+                                              const char* name,
+                                              size_t name_len,
+                                              uvwasi__memfs_node_t* node) {
+  const uvwasi_mem_t* allocator;
+  struct uvwasi__memfs_entry_s* entry;
+  uvwasi_errno_t err;
+  char* copy;
+
+  err = uvwasi__memfs_reserve_entry(memfs, dir);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (!uvwasi__memfs_fits(memfs, name_len + 1))
+    return UVWASI_ENOSPC;
+
+  allocator = memfs->allocator;
+  copy = allocator->malloc(name_len + 1, allocator->mem_user_data);
+  if (copy == NULL)
+    return UVWASI_ENOMEM;
+
+  memfs->used_bytes += name_len + 1;
+  memcpy(copy, name, name_len);
+  copy[name_len] = '\0';
+  entry = &dir->entries[dir->entry_count++];
+  entry->name = copy;
+  entry->name_len = name_len;
+  entry->node = node;
+  node->nlink++;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    node->parent = dir;
+
+  dir->mtim = uvwasi__memfs_now();
+  dir->ctim = dir->mtim;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Removes entry from dir, keeping the order of the remaining entries so that
+   directory cookies stay meaningful. The caller releases the node. */
+static void uvwasi__memfs_remove_entry(uvwasi_memfs_t* memfs,
+                                       uvwasi__memfs_node_t* dir,
+                                       struct uvwasi__memfs_entry_s* entry) {
+  uvwasi__memfs_node_t* node;
+  uint32_t index;
+
+  node = entry->node;
+  index = (uint32_t) (entry - dir->entries);
+  memfs->used_bytes -= entry->name_len + 1;
+  uvwasi__memfs_free_mem(memfs, entry->name);
+  memmove(entry,
+          entry + 1,
+          (dir->entry_count - index - 1) * sizeof(*entry));
+  dir->entry_count--;
+  node->nlink--;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    node->parent = NULL;
+
+  dir->mtim = uvwasi__memfs_now();
+  dir->ctim = dir->mtim;
+  node->ctim = dir->mtim;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_open(const char* path,
+                                         uvwasi_oflags_t oflags,
+                                         uvwasi_fdflags_t fdflags,
+                                         int writable,
+                                         void** file,
+                                         void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  const char* name;
+  size_t name_len;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup(memfs, path, 0, &node);
+  if (err == UVWASI_ENOENT && (oflags & UVWASI_O_CREAT) != 0 &&
+      (oflags & UVWASI_O_DIRECTORY) == 0) {
+    err = uvwasi__memfs_lookup_parent(memfs, path, &dir, &name, &name_len);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+
+    err = uvwasi__memfs_node_new(memfs, UVWASI_FILETYPE_REGULAR_FILE, &node);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+
+    err = uvwasi__memfs_add_entry(memfs, dir, name, name_len, node);
+    if (err != UVWASI_ESUCCESS) {
+      uvwasi__memfs_node_free(memfs, node);
+      goto exit;
+    }
+  } else if (err != UVWASI_ESUCCESS) {
+    goto exit;
+  } else if ((oflags & (UVWASI_O_CREAT | UVWASI_O_EXCL)) ==
+             (UVWASI_O_CREAT | UVWASI_O_EXCL)) {
+    err = UVWASI_EEXIST;
+    goto exit;
+  } else if (node->type == UVWASI_FILETYPE_SYMBOLIC_LINK) {
+    err = UVWASI_ELOOP;
+    goto exit;
+  } else if (node->type == UVWASI_FILETYPE_DIRECTORY && writable) {
+    err = UVWASI_EISDIR;
+    goto exit;
+  } else if ((oflags & UVWASI_O_TRUNC) != 0 && node->size != 0) {
+    node->size = 0;
+    node->mtim = uvwasi__memfs_now();
+    node->ctim = node->mtim;
+  }
+
+  node->refs++;
+  memfs->open_files++;
+  *file = node;
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_close(void* file, void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+
+  memfs = vfs_user_data;
+  node = file;
+  uv_mutex_lock(&memfs->mutex);
+  node->refs--;
+  memfs->open_files--;
+  uvwasi__memfs_release(memfs, node);
+  uv_mutex_unlock(&memfs->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__memfs_stat_node(uvwasi_memfs_t* memfs,
+                                    uvwasi__memfs_node_t* node,
+                                    uvwasi_filestat_t* buf) {
+  buf->st_dev = (uvwasi_device_t) (uintptr_t) memfs;
+  buf->st_ino = node->ino;
+  buf->st_filetype = node->type;
+  buf->st_nlink = node->nlink;
+  buf->st_size =
+      node->type == UVWASI_FILETYPE_DIRECTORY ? 0 : node->size;
+  buf->st_atim = node->atim;
+  buf->st_mtim = node->mtim;
+  buf->st_ctim = node->ctim;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_fstat(void* file,
+                                          uvwasi_filestat_t* buf,
+                                          void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  uvwasi__memfs_stat_node(memfs, file, buf);
+  uv_mutex_unlock(&memfs->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_stat(const char* path,
+                                         uvwasi_filestat_t* buf,
+                                         void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup(memfs, path, 0, &node);
+  if (err == UVWASI_ESUCCESS)
+    uvwasi__memfs_stat_node(memfs, node, buf);
+
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+/* Reads do not update the access time, as with the relatime and noatime
+   mount options. */
+static uvwasi_errno_t uvwasi__memfs_pread(void* file,
+                                          const uvwasi_iovec_t* iovs,
+                                          uvwasi_size_t iovs_len,
+                                          uvwasi_filesize_t offset,
+                                          uvwasi_size_t* nread,
+                                          void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_filesize_t n;
+  uvwasi_size_t total;
+  uvwasi_size_t i;
+
+  memfs = vfs_user_data;
+  node = file;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_EISDIR;
+
+  total = 0;
+  uv_mutex_lock(&memfs->mutex);
+  for (i = 0; i < iovs_len && offset < node->size; i++) {
+    n = node->size - offset;
+    if (n > iovs[i].buf_len)
+      n = iovs[i].buf_len;
+
+    memcpy(iovs[i].buf, node->data + offset, (size_t) n);
+    offset += n;
+    total += (uvwasi_size_t) n;
+  }
+
+  uv_mutex_unlock(&memfs->mutex);
+  *nread = total;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_pwrite(void* file,
+                                           const uvwasi_ciovec_t* iovs,
+                                           uvwasi_size_t iovs_len,
+                                           uvwasi_filesize_t offset,
+                                           uvwasi_size_t* nwritten,
+                                           void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_filesize_t end;
+  uvwasi_errno_t err;
+  uvwasi_size_t total;
+  uvwasi_size_t i;
+
+  memfs = vfs_user_data;
+  node = file;
+  total = 0;
+  for (i = 0; i < iovs_len; i++) {
+    if (iovs[i].buf_len > UINT32_MAX - total)
+      return UVWASI_EINVAL;
+    total += iovs[i].buf_len;
+  }
+
+  end = offset + total;
+  if (end < offset || end > INT64_MAX)
+    return UVWASI_EFBIG;
+
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_reserve(memfs, node, end);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  for (i = 0; i < iovs_len; i++) {
+    memcpy(node->data + offset, iovs[i].buf, iovs[i].buf_len);
+    offset += iovs[i].buf_len;
+  }
+
+  if (end > node->size)
+    node->size = end;
+
+  if (total != 0) {
+    node->mtim = uvwasi__memfs_now();
+    node->ctim = node->mtim;
+  }
+
+  *nwritten = total;
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_set_size(void* file,
+                                             uvwasi_filesize_t size,
+                                             void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  node = file;
+  if (node->type != UVWASI_FILETYPE_REGULAR_FILE)
+    return UVWASI_EINVAL;
+
+  if (size > INT64_MAX)
+    return UVWASI_EFBIG;
+
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_reserve(memfs, node, size);
+  if (err == UVWASI_ESUCCESS) {
+    node->size = size;
+    node->mtim = uvwasi__memfs_now();
+    node->ctim = node->mtim;
+  }
+
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_readdir(void* file,
+                                            uvwasi_dircookie_t cookie,
+                                            uvwasi_dirent_t* dirent,
+                                            char* name,
+                                            uvwasi_size_t name_size,
+                                            void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  struct uvwasi__memfs_entry_s* entry;
+
+  memfs = vfs_user_data;
+  dir = file;
+  if (dir->type != UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_ENOTDIR;
+
+  uv_mutex_lock(&memfs->mutex);
+  if (cookie >= dir->entry_count) {
+    dirent->d_namlen = 0;
+  } else {
+    entry = &dir->entries[cookie];
+    dirent->d_ino = entry->node->ino;
+    dirent->d_type = entry->node->type;
+    dirent->d_namlen = (uint32_t) entry->name_len;
+    memcpy(name,
+           entry->name,
+           entry->name_len < name_size ? entry->name_len : name_size);
+  }
+
+  uv_mutex_unlock(&memfs->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_mkdir(const char* path,
+                                          void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  const char* name;
+  size_t name_len;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup_parent(memfs, path, &dir, &name, &name_len);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (name_len == 0 || uvwasi__memfs_find(dir, name, name_len) != NULL) {
+    err = UVWASI_EEXIST;
+    goto exit;
+  }
+
+  err = uvwasi__memfs_node_new(memfs, UVWASI_FILETYPE_DIRECTORY, &node);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  err = uvwasi__memfs_add_entry(memfs, dir, name, name_len, node);
+  if (err != UVWASI_ESUCCESS)
+    uvwasi__memfs_node_free(memfs, node);
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+/* Looks up the entry for the last component of path, without following it. */
+static uvwasi_errno_t uvwasi__memfs_lookup_entry(
+                                      uvwasi_memfs_t* memfs,
+                                      const char* path,
+                                      uvwasi__memfs_node_t** dir,
+                                      struct uvwasi__memfs_entry_s** entry) {
+  const char* name;
+  size_t name_len;
+  uvwasi_errno_t err;
+
+  err = uvwasi__memfs_lookup_parent(memfs, path, dir, &name, &name_len);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (name_len == 0)
+    return UVWASI_EBUSY;
+
+  *entry = uvwasi__memfs_find(*dir, name, name_len);
+  return *entry == NULL ? UVWASI_ENOENT : UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_rmdir(const char* path,
+                                          void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  struct uvwasi__memfs_entry_s* entry;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup_entry(memfs, path, &dir, &entry);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  node = entry->node;
+  if (node->type != UVWASI_FILETYPE_DIRECTORY) {
+    err = UVWASI_ENOTDIR;
+    goto exit;
+  }
+
+  if (node->entry_count != 0) {
+    err = UVWASI_ENOTEMPTY;
+    goto exit;
+  }
+
+  uvwasi__memfs_remove_entry(memfs, dir, entry);
+  uvwasi__memfs_release(memfs, node);
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_unlink(const char* path,
+                                           void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  struct uvwasi__memfs_entry_s* entry;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup_entry(memfs, path, &dir, &entry);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  node = entry->node;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY) {
+    err = UVWASI_EISDIR;
+    goto exit;
+  }
+
+  uvwasi__memfs_remove_entry(memfs, dir, entry);
+  uvwasi__memfs_release(memfs, node);
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_rename(const char* old_path,
+                                           const char* new_path,
+                                           void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* old_dir;
+  uvwasi__memfs_node_t* new_dir;
+  uvwasi__memfs_node_t* node;
+  uvwasi__memfs_node_t* replaced;
+  uvwasi__memfs_node_t* ancestor;
+  struct uvwasi__memfs_entry_s* entry;
+  struct uvwasi__memfs_entry_s* new_entry;
+  const uvwasi_mem_t* allocator;
+  const char* name;
+  size_t name_len;
+  uvwasi_errno_t err;
+  uint32_t index;
+  char* copy;
+
+  memfs = vfs_user_data;
+  allocator = memfs->allocator;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup_entry(memfs, old_path, &old_dir, &entry);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  err = uvwasi__memfs_lookup_parent(memfs,
+                                    new_path,
+                                    &new_dir,
+                                    &name,
+                                    &name_len);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (name_len == 0) {
+    err = UVWASI_EBUSY;
+    goto exit;
+  }
+
+  node = entry->node;
+  new_entry = uvwasi__memfs_find(new_dir, name, name_len);
+  replaced = new_entry == NULL ? NULL : new_entry->node;
+  if (replaced == node)
+    goto exit;
+
+  if (node->type == UVWASI_FILETYPE_DIRECTORY) {
+    for (ancestor = new_dir; ancestor != NULL; ancestor = ancestor->parent) {
+      if (ancestor == node) {
+        err = UVWASI_EINVAL;
+        goto exit;
+      }
+    }
+  }
+
+  if (replaced != NULL) {
+    if (node->type == UVWASI_FILETYPE_DIRECTORY) {
+      if (replaced->type != UVWASI_FILETYPE_DIRECTORY) {
+        err = UVWASI_ENOTDIR;
+        goto exit;
+      }
+
+      if (replaced->entry_count != 0) {
+        err = UVWASI_ENOTEMPTY;
+        goto exit;
+      }
+    } else if (replaced->type == UVWASI_FILETYPE_DIRECTORY) {
+      err = UVWASI_EISDIR;
+      goto exit;
+    }
+  }
+
+  /* Everything that can fail happens before the tree is changed. Making room
+     in new_dir can move the entries of old_dir. */
+  index = (uint32_t) (entry - old_dir->entries);
+  err = uvwasi__memfs_reserve_entry(memfs, new_dir);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (!uvwasi__memfs_fits(memfs, name_len + 1)) {
+    err = UVWASI_ENOSPC;
+    goto exit;
+  }
+
+  copy = allocator->malloc(name_len + 1, allocator->mem_user_data);
+  if (copy == NULL) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
+
+  memfs->used_bytes += name_len + 1;
+
+  memcpy(copy, name, name_len);
+  copy[name_len] = '\0';
+
+  /* The node is taken out of its old directory without being released. */
+  node->nlink++;
+  uvwasi__memfs_remove_entry(memfs, old_dir, &old_dir->entries[index]);
+  if (replaced != NULL) {
+    uvwasi__memfs_remove_entry(memfs,
+                               new_dir,
+                               uvwasi__memfs_find(new_dir, name, name_len));
+    uvwasi__memfs_release(memfs, replaced);
+  }
+
+  new_entry = &new_dir->entries[new_dir->entry_count++];
+  new_entry->name = copy;
+  new_entry->name_len = name_len;
+  new_entry->node = node;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    node->parent = new_dir;
+
+  new_dir->mtim = uvwasi__memfs_now();
+  new_dir->ctim = new_dir->mtim;
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_readlink(const char* path,
+                                             char* buf,
+                                             uvwasi_size_t buf_len,
+                                             uvwasi_size_t* bufused,
+                                             void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_errno_t err;
+  uvwasi_size_t n;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup(memfs, path, 0, &node);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (node->type != UVWASI_FILETYPE_SYMBOLIC_LINK) {
+    err = UVWASI_EINVAL;
+    goto exit;
+  }
+
+  n = node->size < buf_len ? (uvwasi_size_t) node->size : buf_len;
+  memcpy(buf, node->data, n);
+  *bufused = n;
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_symlink(const char* target,
+                                            const char* path,
+                                            void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  const char* name;
+  size_t name_len;
+  size_t target_len;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup_parent(memfs, path, &dir, &name, &name_len);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (name_len == 0 || uvwasi__memfs_find(dir, name, name_len) != NULL) {
+    err = UVWASI_EEXIST;
+    goto exit;
+  }
+
+  err = uvwasi__memfs_node_new(memfs, UVWASI_FILETYPE_SYMBOLIC_LINK, &node);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  target_len = strlen(target);
+  err = uvwasi__memfs_reserve(memfs, node, target_len);
+  if (err == UVWASI_ESUCCESS) {
+    memcpy(node->data, target, target_len);
+    node->size = target_len;
+    err = uvwasi__memfs_add_entry(memfs, dir, name, name_len, node);
+  }
+
+  if (err != UVWASI_ESUCCESS)
+    uvwasi__memfs_node_free(memfs, node);
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static void uvwasi__memfs_set_node_times(uvwasi__memfs_node_t* node,
+                                         uvwasi_timestamp_t atim,
+                                         uvwasi_timestamp_t mtim,
+                                         uvwasi_fstflags_t fst_flags) {
+  if ((fst_flags & UVWASI_FILESTAT_SET_ATIM) != 0)
+    node->atim = atim;
+  if ((fst_flags & UVWASI_FILESTAT_SET_MTIM) != 0)
+    node->mtim = mtim;
+
+  node->ctim = uvwasi__memfs_now();
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_fset_times(void* file,
+                                               uvwasi_timestamp_t atim,
+                                               uvwasi_timestamp_t mtim,
+                                               uvwasi_fstflags_t fst_flags,
+                                               void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  uvwasi__memfs_set_node_times(file, atim, mtim, fst_flags);
+  uv_mutex_unlock(&memfs->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_set_times(const char* path,
+                                              uvwasi_timestamp_t atim,
+                                              uvwasi_timestamp_t mtim,
+                                              uvwasi_fstflags_t fst_flags,
+                                              void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* node;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup(memfs, path, 0, &node);
+  if (err == UVWASI_ESUCCESS)
+    uvwasi__memfs_set_node_times(node, atim, mtim, fst_flags);
+
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__memfs_link(const char* old_path,
+                                         const char* new_path,
+                                         void* vfs_user_data) {
+  uvwasi_memfs_t* memfs;
+  uvwasi__memfs_node_t* dir;
+  uvwasi__memfs_node_t* node;
+  const char* name;
+  size_t name_len;
+  uvwasi_errno_t err;
+
+  memfs = vfs_user_data;
+  uv_mutex_lock(&memfs->mutex);
+  err = uvwasi__memfs_lookup(memfs, old_path, 0, &node);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (node->type == UVWASI_FILETYPE_DIRECTORY) {
+    err = UVWASI_EPERM;
+    goto exit;
+  }
+
+  err = uvwasi__memfs_lookup_parent(memfs, new_path, &dir, &name, &name_len);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (name_len == 0 || uvwasi__memfs_find(dir, name, name_len) != NULL) {
+    err = UVWASI_EEXIST;
+    goto exit;
+  }
+
+  err = uvwasi__memfs_add_entry(memfs, dir, name, name_len, node);
+  if (err == UVWASI_ESUCCESS)
+    node->ctim = dir->mtim;
+
+exit:
+  uv_mutex_unlock(&memfs->mutex);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi_memfs_new(const uvwasi_mem_t* allocator,
+                                uint64_t size_limit,
+                                uvwasi_memfs_t** memfs) {
+  uvwasi_memfs_t* m;
+
+  if (memfs == NULL)
+    return UVWASI_EINVAL;
+
+  if (allocator == NULL)
+    allocator = &uvwasi__default_allocator;
+
+  m = allocator->calloc(1, sizeof(*m), allocator->mem_user_data);
+  if (m == NULL)
+    return UVWASI_ENOMEM;
+
+  m->allocator = allocator;
+  if (uvwasi__memfs_node_new(m, UVWASI_FILETYPE_DIRECTORY, &m->root) !=
+      UVWASI_ESUCCESS) {
+    allocator->free(m, allocator->mem_user_data);
+    return UVWASI_ENOMEM;
+  }
+
+  /* The root counts towards the limit, but always fits. */
+  m->size_limit = size_limit;
+
+  /* The root is never unlinked. */
+  m->root->nlink = 1;
+  if (uv_mutex_init(&m->mutex) != 0) {
+    uvwasi__memfs_node_free(m, m->root);
+    allocator->free(m, allocator->mem_user_data);
+    return UVWASI_ENOMEM;
+  }
+
+  m->vfs.vfs_user_data = m;
+  m->vfs.open = uvwasi__memfs_open;
+  m->vfs.close = uvwasi__memfs_close;
+  m->vfs.fstat = uvwasi__memfs_fstat;
+  m->vfs.stat = uvwasi__memfs_stat;
+  m->vfs.pread = uvwasi__memfs_pread;
+  m->vfs.pwrite = uvwasi__memfs_pwrite;
+  m->vfs.set_size = uvwasi__memfs_set_size;
+  m->vfs.readdir = uvwasi__memfs_readdir;
+  m->vfs.mkdir = uvwasi__memfs_mkdir;
+  m->vfs.rmdir = uvwasi__memfs_rmdir;
+  m->vfs.unlink = uvwasi__memfs_unlink;
+  m->vfs.rename = uvwasi__memfs_rename;
+  m->vfs.readlink = uvwasi__memfs_readlink;
+  m->vfs.symlink = uvwasi__memfs_symlink;
+  m->vfs.fset_times = uvwasi__memfs_fset_times;
+  m->vfs.set_times = uvwasi__memfs_set_times;
+  m->vfs.link = uvwasi__memfs_link;
+  *memfs = m;
+  return UVWASI_ESUCCESS;
+}
+
+
+const uvwasi_vfs_t* uvwasi_memfs_vfs(uvwasi_memfs_t* memfs) {
+  return memfs == NULL ? NULL : &memfs->vfs;
+}
+
+
+uvwasi_errno_t uvwasi_memfs_free(uvwasi_memfs_t* memfs) {
+  const uvwasi_mem_t* allocator;
+
+  if (memfs == NULL)
+    return UVWASI_EINVAL;
+
+  uv_mutex_lock(&memfs->mutex);
+  if (memfs->open_files != 0) {
+    uv_mutex_unlock(&memfs->mutex);
+    return UVWASI_EBUSY;
+  }
+
+  uv_mutex_unlock(&memfs->mutex);
+  uv_mutex_destroy(&memfs->mutex);
+  uvwasi__memfs_tree_free(memfs, memfs->root);
+  allocator = memfs->allocator;
+  allocator->free(memfs, allocator->mem_user_data);
+  return UVWASI_ESUCCESS;
+}
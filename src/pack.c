@@ -0,0 +1,631 @@
+#ifndef _WIN32
+# include <errno.h>
+# include <sys/mman.h>
+#endif /* _WIN32 */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "uv_mapping.h"
+#include "uvwasi_alloc.h"
+#include "atomic_ops.h"
+
+/* Symbolic links followed while looking up a single path. */
+#define UVWASI__PACK_MAX_LINKS 32
+
+/* The image is mapped once and never changes, so lookups and reads need no
+   locking. open_files only guards against freeing a pack that is in use. */
+struct uvwasi_pack_s {
+  uvwasi_vfs_t vfs;
+  const uvwasi_mem_t* allocator;
+  const char* base;
+  uint64_t size;
+  const uvwasi_pack_node_t* nodes;
+  uint32_t node_count;
+  uint64_t open_files;
+};
+
+
+static int uvwasi__pack_compare(const uvwasi_pack_t* pack,
+                                const uvwasi_pack_node_t* node,
+                                const char* name,
+                                size_t name_len) {
+  size_t len;
+  int r;
+
+  len = node->name_len < name_len ? node->name_len : name_len;
+  r = memcmp(pack->base + node->name_offset, name, len);
+  if (r != 0)
+    return r;
+
+  if (node->name_len == name_len)
+    return 0;
+
+  return node->name_len < name_len ? -1 : 1;
+}
+
+
+static const uvwasi_pack_node_t* uvwasi__pack_find(
+                                          const uvwasi_pack_t* pack,
+                                          const uvwasi_pack_node_t* dir,
+                                          const char* name,
+                                          size_t name_len) {
+  const uvwasi_pack_node_t* children;
+  uint64_t low;
+  uint64_t high;
+  uint64_t mid;
+  int r;
+
+  children = pack->nodes + dir->offset;
+  low = 0;
+  high = dir->size;
+  while (low < high) {
+    mid = low + (high - low) / 2;
+    r = uvwasi__pack_compare(pack, &children[mid], name, name_len);
+    if (r == 0)
+      return &children[mid];
+
+    if (r < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return NULL;
+}
+
+
+/* Follows path from dir. Symbolic links are followed in every component but
+   the last, and in the last one too when follow is set or the path ends in a
+   slash. Their targets must be relative, since the image does not know where
+   the sandbox has mapped it. */
+static uvwasi_errno_t uvwasi__pack_walk(const uvwasi_pack_t* pack,
+                                        const uvwasi_pack_node_t* dir,
+                                        const char* path,
+                                        size_t len,
+                                        int follow,
+                                        uint32_t* links,
+                                        const uvwasi_pack_node_t** node) {
+  const uvwasi_pack_node_t* child;
+  uvwasi_errno_t err;
+  size_t start;
+  size_t i;
+
+  i = 0;
+  while (i < len) {
+    while (i < len && path[i] == '/')
+      i++;
+    if (i == len)
+      break;
+
+    start = i;
+    while (i < len && path[i] != '/')
+      i++;
+
+    if (dir->type != UVWASI_FILETYPE_DIRECTORY)
+      return UVWASI_ENOTDIR;
+
+    if (i - start == 1 && path[start] == '.')
+      continue;
+
+    if (i - start == 2 && path[start] == '.' && path[start + 1] == '.') {
+      dir = pack->nodes + dir->parent;
+      continue;
+    }
+
+    child = uvwasi__pack_find(pack, dir, path + start, i - start);
+    if (child == NULL)
+      return UVWASI_ENOENT;
+
+    if (child->type == UVWASI_FILETYPE_SYMBOLIC_LINK && (follow || i < len)) {
+      if (++*links > UVWASI__PACK_MAX_LINKS)
+        return UVWASI_ELOOP;
+
+      if (child->size > 0 && pack->base[child->offset] == '/')
+        return UVWASI_ENOTCAPABLE;
+
+      err = uvwasi__pack_walk(pack,
+                              dir,
+                              pack->base + child->offset,
+                              (size_t) child->size,
+                              1,
+                              links,
+                              &child);
+      if (err != UVWASI_ESUCCESS)
+        return err;
+    }
+
+    dir = child;
+  }
+
+  if (len > 0 && path[len - 1] == '/' &&
+      dir->type != UVWASI_FILETYPE_DIRECTORY) {
+    return UVWASI_ENOTDIR;
+  }
+
+  *node = dir;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_lookup(const uvwasi_pack_t* pack,
+                                          const char* path,
+                                          const uvwasi_pack_node_t** node) {
+  uint32_t links;
+
+  links = 0;
+  return uvwasi__pack_walk(pack,
+                           pack->nodes,
+                           path,
+                           strlen(path),
+                           0,
+                           &links,
+                           node);
+}
+
+
+static uvwasi_errno_t uvwasi__pack_open(const char* path,
+                                        uvwasi_oflags_t oflags,
+                                        uvwasi_fdflags_t fdflags,
+                                        int writable,
+                                        void** file,
+                                        void* vfs_user_data) {
+  uvwasi_pack_t* pack;
+  const uvwasi_pack_node_t* node;
+  uvwasi_errno_t err;
+
+  pack = vfs_user_data;
+  err = uvwasi__pack_lookup(pack, path, &node);
+  if (err == UVWASI_ENOENT && (oflags & UVWASI_O_CREAT) != 0)
+    return UVWASI_EROFS;
+
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if ((oflags & (UVWASI_O_CREAT | UVWASI_O_EXCL)) ==
+      (UVWASI_O_CREAT | UVWASI_O_EXCL)) {
+    return UVWASI_EEXIST;
+  }
+
+  if (node->type == UVWASI_FILETYPE_SYMBOLIC_LINK)
+    return UVWASI_ELOOP;
+
+  if (node->type == UVWASI_FILETYPE_DIRECTORY && writable)
+    return UVWASI_EISDIR;
+
+  if (writable || (oflags & UVWASI_O_TRUNC) != 0)
+    return UVWASI_EROFS;
+
+  uvwasi__atomic_add_u64(&pack->open_files, 1);
+  *file = (void*) node;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_close(void* file, void* vfs_user_data) {
+  uvwasi_pack_t* pack;
+
+  pack = vfs_user_data;
+  uvwasi__atomic_sub_u64(&pack->open_files, 1);
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__pack_stat_node(const uvwasi_pack_t* pack,
+                                   const uvwasi_pack_node_t* node,
+                                   uvwasi_filestat_t* buf) {
+  buf->st_dev = (uvwasi_device_t) (uintptr_t) pack;
+  buf->st_ino = (uvwasi_inode_t) (node - pack->nodes) + 1;
+  buf->st_filetype = node->type;
+  buf->st_nlink = 1;
+  buf->st_size = node->type == UVWASI_FILETYPE_DIRECTORY ? 0 : node->size;
+  buf->st_atim = node->mtim;
+  buf->st_mtim = node->mtim;
+  buf->st_ctim = node->mtim;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_fstat(void* file,
+                                         uvwasi_filestat_t* buf,
+                                         void* vfs_user_data) {
+  uvwasi__pack_stat_node(vfs_user_data, file, buf);
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_stat(const char* path,
+                                        uvwasi_filestat_t* buf,
+                                        void* vfs_user_data) {
+  const uvwasi_pack_node_t* node;
+  uvwasi_errno_t err;
+
+  err = uvwasi__pack_lookup(vfs_user_data, path, &node);
+  if (err == UVWASI_ESUCCESS)
+    uvwasi__pack_stat_node(vfs_user_data, node, buf);
+
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_pread(void* file,
+                                         const uvwasi_iovec_t* iovs,
+                                         uvwasi_size_t iovs_len,
+                                         uvwasi_filesize_t offset,
+                                         uvwasi_size_t* nread,
+                                         void* vfs_user_data) {
+  const uvwasi_pack_t* pack;
+  const uvwasi_pack_node_t* node;
+  uvwasi_filesize_t n;
+  uvwasi_size_t total;
+  uvwasi_size_t i;
+
+  pack = vfs_user_data;
+  node = file;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_EISDIR;
+
+  total = 0;
+  for (i = 0; i < iovs_len && offset < node->size; i++) {
+    n = node->size - offset;
+    if (n > iovs[i].buf_len)
+      n = iovs[i].buf_len;
+
+    memcpy(iovs[i].buf, pack->base + node->offset + offset, (size_t) n);
+    offset += n;
+    total += (uvwasi_size_t) n;
+  }
+
+  *nread = total;
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_readdir(void* file,
+                                           uvwasi_dircookie_t cookie,
+                                           uvwasi_dirent_t* dirent,
+                                           char* name,
+                                           uvwasi_size_t name_size,
+                                           void* vfs_user_data) {
+  const uvwasi_pack_t* pack;
+  const uvwasi_pack_node_t* dir;
+  const uvwasi_pack_node_t* child;
+
+  pack = vfs_user_data;
+  dir = file;
+  if (dir->type != UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_ENOTDIR;
+
+  if (cookie >= dir->size) {
+    dirent->d_namlen = 0;
+    return UVWASI_ESUCCESS;
+  }
+
+  child = pack->nodes + dir->offset + cookie;
+  dirent->d_ino = (uvwasi_inode_t) (child - pack->nodes) + 1;
+  dirent->d_type = child->type;
+  dirent->d_namlen = child->name_len;
+  memcpy(name,
+         pack->base + child->name_offset,
+         child->name_len < name_size ? child->name_len : name_size);
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_readlink(const char* path,
+                                            char* buf,
+                                            uvwasi_size_t buf_len,
+                                            uvwasi_size_t* bufused,
+                                            void* vfs_user_data) {
+  const uvwasi_pack_t* pack;
+  const uvwasi_pack_node_t* node;
+  uvwasi_errno_t err;
+  uvwasi_size_t n;
+
+  pack = vfs_user_data;
+  err = uvwasi__pack_lookup(pack, path, &node);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (node->type != UVWASI_FILETYPE_SYMBOLIC_LINK)
+    return UVWASI_EINVAL;
+
+  n = node->size < buf_len ? (uvwasi_size_t) node->size : buf_len;
+  memcpy(buf, pack->base + node->offset, n);
+  *bufused = n;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Changes are refused with UVWASI_EROFS rather than left unsupported. */
+static uvwasi_errno_t uvwasi__pack_path_op(const char* path,
+                                           void* vfs_user_data) {
+  return UVWASI_EROFS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_two_path_op(const char* old_path,
+                                               const char* new_path,
+                                               void* vfs_user_data) {
+  return UVWASI_EROFS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_set_times(const char* path,
+                                             uvwasi_timestamp_t atim,
+                                             uvwasi_timestamp_t mtim,
+                                             uvwasi_fstflags_t fst_flags,
+                                             void* vfs_user_data) {
+  return UVWASI_EROFS;
+}
+
+
+static uvwasi_errno_t uvwasi__pack_fset_times(void* file,
+                                              uvwasi_timestamp_t atim,
+                                              uvwasi_timestamp_t mtim,
+                                              uvwasi_fstflags_t fst_flags,
+                                              void* vfs_user_data) {
+  return UVWASI_EROFS;
+}
+
+
+static int uvwasi__pack_in_image(const uvwasi_pack_t* pack,
+                                 uint64_t offset,
+                                 uint64_t len) {
+  return offset <= pack->size && len <= pack->size - offset;
+}
+
+
+/* Checks everything that lookups and reads rely on, so that a damaged image
+   cannot make them read outside of it or loop. */
+static uvwasi_errno_t uvwasi__pack_validate(const uvwasi_pack_t* pack) {
+  const uvwasi_pack_node_t* node;
+  const uvwasi_pack_node_t* child;
+  const char* name;
+  uint64_t i;
+  uint64_t j;
+
+  for (i = 0; i < pack->node_count; i++) {
+    node = &pack->nodes[i];
+    if (!uvwasi__pack_in_image(pack, node->name_offset, node->name_len))
+      return UVWASI_EINVAL;
+
+    name = pack->base + node->name_offset;
+    if (i != 0 &&
+        (node->name_len == 0 ||
+         memchr(name, '/', node->name_len) != NULL ||
+         memchr(name, '\0', node->name_len) != NULL ||
+         (node->name_len == 1 && name[0] == '.') ||
+         (node->name_len == 2 && name[0] == '.' && name[1] == '.'))) {
+      return UVWASI_EINVAL;
+    }
+
+    switch (node->type) {
+      case UVWASI_FILETYPE_DIRECTORY:
+        if (node->size == 0)
+          break;
+
+        if (node->offset <= i || node->offset > pack->node_count ||
+            node->size > pack->node_count - node->offset) {
+          return UVWASI_EINVAL;
+        }
+
+        for (j = 0; j < node->size; j++) {
+          child = &pack->nodes[node->offset + j];
+          if (child->parent != i)
+            return UVWASI_EINVAL;
+
+          if (j > 0 &&
+              uvwasi__pack_compare(pack,
+                                   child - 1,
+                                   pack->base + child->name_offset,
+                                   child->name_len) >= 0) {
+            return UVWASI_EINVAL;
+          }
+        }
+        break;
+      case UVWASI_FILETYPE_REGULAR_FILE:
+      case UVWASI_FILETYPE_SYMBOLIC_LINK:
+        if (i == 0 || !uvwasi__pack_in_image(pack, node->offset, node->size))
+          return UVWASI_EINVAL;
+        break;
+      default:
+        return UVWASI_EINVAL;
+    }
+
+    /* Every node but the root is a child of the directory it names. The
+       checks on directories above make that directory's range hold it. */
+    if (i != 0 &&
+        (node->parent >= i ||
+         pack->nodes[node->parent].type != UVWASI_FILETYPE_DIRECTORY ||
+         i < pack->nodes[node->parent].offset ||
+         i - pack->nodes[node->parent].offset >=
+             pack->nodes[node->parent].size)) {
+      return UVWASI_EINVAL;
+    }
+  }
+
+  if (pack->nodes[0].type != UVWASI_FILETYPE_DIRECTORY ||
+      pack->nodes[0].parent != 0) {
+    return UVWASI_EINVAL;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+#ifdef _WIN32
+
+/* Without mmap() the image is read into memory from the allocator. */
+static uvwasi_errno_t uvwasi__pack_map(uvwasi_pack_t* pack, uv_file fd) {
+  const uvwasi_mem_t* allocator;
+  uv_buf_t buf;
+  uv_fs_t req;
+  uint64_t pos;
+  char* base;
+  int r;
+
+  if (pack->size > SIZE_MAX)
+    return UVWASI_EFBIG;
+
+  allocator = pack->allocator;
+  base = allocator->malloc((size_t) pack->size, allocator->mem_user_data);
+  if (base == NULL)
+    return UVWASI_ENOMEM;
+
+  for (pos = 0; pos < pack->size; pos += r) {
+    buf = uv_buf_init(base + pos,
+                      pack->size - pos > UINT32_MAX ?
+                          UINT32_MAX : (unsigned int) (pack->size - pos));
+    r = uv_fs_read(NULL, &req, fd, &buf, 1, pos, NULL);
+    uv_fs_req_cleanup(&req);
+    if (r <= 0) {
+      allocator->free(base, allocator->mem_user_data);
+      return r == 0 ? UVWASI_EIO : uvwasi__translate_uv_error(r);
+    }
+  }
+
+  pack->base = base;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__pack_unmap(uvwasi_pack_t* pack) {
+  pack->allocator->free((void*) pack->base, pack->allocator->mem_user_data);
+}
+
+#else /* _WIN32 */
+
+static uvwasi_errno_t uvwasi__pack_map(uvwasi_pack_t* pack, uv_file fd) {
+  void* base;
+
+  if (pack->size > SIZE_MAX)
+    return UVWASI_EFBIG;
+
+  base = mmap(NULL, (size_t) pack->size, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  pack->base = base;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__pack_unmap(uvwasi_pack_t* pack) {
+  munmap((void*) pack->base, (size_t) pack->size);
+}
+
+#endif /* _WIN32 */
+
+
+uvwasi_errno_t uvwasi_pack_open(const char* path,
+                                const uvwasi_mem_t* allocator,
+                                uvwasi_pack_t** pack) {
+  const uvwasi_pack_header_t* header;
+  uvwasi_pack_t* p;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  uv_file fd;
+  int r;
+
+  if (path == NULL || pack == NULL)
+    return UVWASI_EINVAL;
+
+  if (allocator == NULL)
+    allocator = &uvwasi__default_allocator;
+
+  p = allocator->calloc(1, sizeof(*p), allocator->mem_user_data);
+  if (p == NULL)
+    return UVWASI_ENOMEM;
+
+  p->allocator = allocator;
+  r = uv_fs_open(NULL, &req, path, UV_FS_O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r < 0) {
+    allocator->free(p, allocator->mem_user_data);
+    return uvwasi__translate_uv_error(r);
+  }
+
+  fd = r;
+  r = uv_fs_fstat(NULL, &req, fd, NULL);
+  p->size = req.statbuf.st_size;
+  uv_fs_req_cleanup(&req);
+  if (r != 0) {
+    err = uvwasi__translate_uv_error(r);
+    goto exit;
+  }
+
+  if (p->size < sizeof(*header)) {
+    err = UVWASI_EINVAL;
+    goto exit;
+  }
+
+  err = uvwasi__pack_map(p, fd);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  header = (const uvwasi_pack_header_t*) p->base;
+  p->nodes = (const uvwasi_pack_node_t*) (header + 1);
+  p->node_count = header->node_count;
+  if (memcmp(header->magic, UVWASI_PACK_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != UVWASI_PACK_VERSION ||
+      p->node_count == 0 ||
+      (p->size - sizeof(*header)) / sizeof(*p->nodes) < p->node_count) {
+    err = UVWASI_EINVAL;
+  } else {
+    err = uvwasi__pack_validate(p);
+  }
+
+  if (err != UVWASI_ESUCCESS)
+    uvwasi__pack_unmap(p);
+
+exit:
+  /* The mapping stays valid once the file is closed. */
+  uv_fs_close(NULL, &req, fd, NULL);
+  uv_fs_req_cleanup(&req);
+  if (err != UVWASI_ESUCCESS) {
+    allocator->free(p, allocator->mem_user_data);
+    return err;
+  }
+
+  p->vfs.vfs_user_data = p;
+  p->vfs.open = uvwasi__pack_open;
+  p->vfs.close = uvwasi__pack_close;
+  p->vfs.fstat = uvwasi__pack_fstat;
+  p->vfs.stat = uvwasi__pack_stat;
+  p->vfs.pread = uvwasi__pack_pread;
+  p->vfs.readdir = uvwasi__pack_readdir;
+  p->vfs.mkdir = uvwasi__pack_path_op;
+  p->vfs.rmdir = uvwasi__pack_path_op;
+  p->vfs.unlink = uvwasi__pack_path_op;
+  p->vfs.rename = uvwasi__pack_two_path_op;
+  p->vfs.readlink = uvwasi__pack_readlink;
+  p->vfs.symlink = uvwasi__pack_two_path_op;
+  p->vfs.fset_times = uvwasi__pack_fset_times;
+  p->vfs.set_times = uvwasi__pack_set_times;
+  p->vfs.link = uvwasi__pack_two_path_op;
+  *pack = p;
+  return UVWASI_ESUCCESS;
+}
+
+
+const uvwasi_vfs_t* uvwasi_pack_vfs(uvwasi_pack_t* pack) {
+  return pack == NULL ? NULL : &pack->vfs;
+}
+
+
+uvwasi_errno_t uvwasi_pack_free(uvwasi_pack_t* pack) {
+  const uvwasi_mem_t* allocator;
+
+  if (pack == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi__atomic_load_u64(&pack->open_files) != 0)
+    return UVWASI_EBUSY;
+
+  uvwasi__pack_unmap(pack);
+  allocator = pack->allocator;
+  allocator->free(pack, allocator->mem_user_data);
+  return UVWASI_ESUCCESS;
+}
@@ -5,8 +5,10 @@
 #include "uvwasi_alloc.h"
 #include "uv_mapping.h"
 #include "path_resolver.h"
+#include "probes.h"
 
 #define UVWASI__MAX_SYMLINK_FOLLOWS 32
+#define UVWASI__VFS_MAX_LINK 4096
 
 #ifndef _WIN32
 # define IS_SLASH(c) ((c) == '/')
@@ -255,8 +257,8 @@ static uvwasi_errno_t uvwasi__normalize_absolute_path(
   /* Once the input is normalized, ensure that it is still sandboxed. */
   if (0 == uvwasi__is_path_sandboxed(abs_path,
                                      path_len,
-                                     fd->normalized_path,
-                                     strlen(fd->normalized_path))) {
+                                     fd->cold->normalized_path,
+                                     strlen(fd->cold->normalized_path))) {
     err = UVWASI_ENOTCAPABLE;
     goto exit;
   }
@@ -292,10 +294,10 @@ static uvwasi_errno_t uvwasi__normalize_relative_path(
   *normalized_path = NULL;
   *normalized_len = 0;
 
-  fd_path_len = strlen(fd->normalized_path);
+  fd_path_len = strlen(fd->cold->normalized_path);
 
   err = uvwasi__combine_paths(uvwasi,
-                              fd->normalized_path,
+                              fd->cold->normalized_path,
                               fd_path_len,
                               path,
                               path_len,
@@ -322,7 +324,7 @@ static uvwasi_errno_t uvwasi__normalize_relative_path(
   /* Once the path is normalized, ensure that it is still sandboxed. */
   if (0 == uvwasi__is_path_sandboxed(normalized,
                                      norm_len,
-                                     fd->normalized_path,
+                                     fd->cold->normalized_path,
                                      fd_path_len)) {
     err = UVWASI_ENOTCAPABLE;
     goto exit;
@@ -360,14 +362,14 @@ static uvwasi_errno_t uvwasi__resolve_path_to_host(
   uvwasi_size_t i;
 #endif /* _WIN32 */
 
-  real_path_len = strlen(fd->real_path);
-  fake_path_len = strlen(fd->normalized_path);
+  real_path_len = strlen(fd->cold->real_path);
+  fake_path_len = strlen(fd->cold->normalized_path);
 
   /* If the fake path is '.' just ignore it. */
-  if ((fake_path_len == 1 && fd->normalized_path[0] == '.')
+  if ((fake_path_len == 1 && fd->cold->normalized_path[0] == '.')
       || (fake_path_len == 2
-          && fd->normalized_path[0] == '.'
-          && fd->normalized_path[1] == '/')
+          && fd->cold->normalized_path[0] == '.'
+          && fd->cold->normalized_path[1] == '/')
   ) {
     fake_path_len = 0;
   }
@@ -385,7 +387,7 @@ static uvwasi_errno_t uvwasi__resolve_path_to_host(
 
   res_path = *resolved_path;
   stripped_path = (char*) path + fake_path_len;
-  memcpy(res_path, fd->real_path, real_path_len);
+  memcpy(res_path, fd->cold->real_path, real_path_len);
   res_path += real_path_len;
 
   if (stripped_len > 1 ||
@@ -399,10 +401,20 @@ static uvwasi_errno_t uvwasi__resolve_path_to_host(
     res_path += stripped_len;
   }
 
+  /* Paths in a uvwasi_vfs_t are absolute, so the root is '/' rather than the
+     empty real path of its preopen. */
+  if (fd->cold->vfs != NULL && res_path == *resolved_path) {
+    *res_path = '/';
+    res_path++;
+  }
+
   *res_path = '\0';
 
 #ifdef _WIN32
   /* Replace / with \ on Windows. */
+  if (fd->cold->vfs != NULL)
+    return UVWASI_ESUCCESS;
+
   res_path = *resolved_path;
   for (i = real_path_len; i < *resolved_len; i++) {
     if (res_path[i] == '/')
@@ -414,6 +426,46 @@ static uvwasi_errno_t uvwasi__resolve_path_to_host(
 }
 
 
+/* Reads the target of a symbolic link in a uvwasi_vfs_t. *target is left NULL
+   if path does not exist or is not a symbolic link. */
+static uvwasi_errno_t uvwasi__read_vfs_link(const uvwasi_t* uvwasi,
+                                            const uvwasi_vfs_t* vfs,
+                                            const char* path,
+                                            char** target) {
+  uvwasi_errno_t err;
+  uvwasi_size_t len;
+  char* buf;
+
+  *target = NULL;
+  if (vfs->readlink == NULL)
+    return UVWASI_ESUCCESS;
+
+  buf = uvwasi__malloc(uvwasi, UVWASI__VFS_MAX_LINK);
+  if (buf == NULL)
+    return UVWASI_ENOMEM;
+
+  err = vfs->readlink(path,
+                      buf,
+                      UVWASI__VFS_MAX_LINK,
+                      &len,
+                      vfs->vfs_user_data);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__free(uvwasi, buf);
+    return err == UVWASI_EINVAL || err == UVWASI_ENOENT ? UVWASI_ESUCCESS : err;
+  }
+
+  /* A target that fills the buffer may have been truncated. */
+  if (len >= UVWASI__VFS_MAX_LINK) {
+    uvwasi__free(uvwasi, buf);
+    return UVWASI_ENAMETOOLONG;
+  }
+
+  buf[len] = '\0';
+  *target = buf;
+  return UVWASI_ESUCCESS;
+}
+
+
 uvwasi_errno_t uvwasi__resolve_path(const uvwasi_t* uvwasi,
                                     const struct uvwasi_fd_wrap_t* fd,
                                     const char* path,
@@ -445,8 +497,11 @@ uvwasi_errno_t uvwasi__resolve_path(const uvwasi_t* uvwasi,
   normalized_parent = NULL;
   resolved_link_target = NULL;
 
+  UVWASI__PROBE_RESOLVE_PATH_ENTRY(uvwasi, fd->id, path, path_len, flags);
+
   if (uvwasi__is_absolute_path(input, input_len)) {
     *resolved_path = NULL;
+    UVWASI__PROBE_RESOLVE_PATH_RETURN(uvwasi, UVWASI_ENOTCAPABLE, NULL);
     return UVWASI_ENOTCAPABLE;
   }
 
@@ -489,55 +544,68 @@ start:
     goto exit;
 
   if ((flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) == UVWASI_LOOKUP_SYMLINK_FOLLOW) {
-    r = uv_fs_readlink(NULL, &req, host_path, NULL);
+    uvwasi__free(uvwasi, link_target);
+    link_target = NULL;
+
+    if (fd->cold->vfs != NULL) {
+      err = uvwasi__read_vfs_link(uvwasi,
+                                  fd->cold->vfs,
+                                  host_path,
+                                  &link_target);
+      if (err != UVWASI_ESUCCESS || link_target == NULL)
+        goto exit;
+    } else {
+      r = uv_fs_readlink(NULL, &req, host_path, NULL);
 
-    if (r != 0) {
+      if (r != 0) {
 #ifdef _WIN32
-      /* uv_fs_readlink() returns UV__UNKNOWN on Windows. Try to get a better
-         error using uv_fs_stat(). */
-      if (r == UV__UNKNOWN) {
-        uv_fs_req_cleanup(&req);
-        r = uv_fs_stat(NULL, &req, host_path, NULL);
-
-        if (r == 0) {
-          if (uvwasi__stat_to_filetype(&req.statbuf) !=
-              UVWASI_FILETYPE_SYMBOLIC_LINK) {
-            r = UV_EINVAL;
+        /* uv_fs_readlink() returns UV__UNKNOWN on Windows. Try to get a better
+           error using uv_fs_stat(). */
+        if (r == UV__UNKNOWN) {
+          uv_fs_req_cleanup(&req);
+          r = uv_fs_stat(NULL, &req, host_path, NULL);
+
+          if (r == 0) {
+            if (uvwasi__stat_to_filetype(&req.statbuf) !=
+                UVWASI_FILETYPE_SYMBOLIC_LINK) {
+              r = UV_EINVAL;
+            }
           }
+
+          /* Fall through. */
         }
+#endif /* _WIN32 */
 
-        /* Fall through. */
+        /* Don't report UV_EINVAL or UV_ENOENT. They mean that either the file
+           does not exist, or it is not a symlink. Both are OK. */
+        if (r != UV_EINVAL && r != UV_ENOENT)
+          err = uvwasi__translate_uv_error(r);
+
+        uv_fs_req_cleanup(&req);
+        goto exit;
       }
-#endif /* _WIN32 */
 
-      /* Don't report UV_EINVAL or UV_ENOENT. They mean that either the file
-          does not exist, or it is not a symlink. Both are OK. */
-      if (r != UV_EINVAL && r != UV_ENOENT)
-        err = uvwasi__translate_uv_error(r);
+      link_target_len = strlen(req.ptr);
+      link_target = uvwasi__malloc(uvwasi, link_target_len + 1);
+      if (link_target == NULL) {
+        uv_fs_req_cleanup(&req);
+        err = UVWASI_ENOMEM;
+        goto exit;
+      }
 
+      memcpy(link_target, req.ptr, link_target_len + 1);
       uv_fs_req_cleanup(&req);
-      goto exit;
     }
 
-    /* Clean up memory and follow the link, unless it's time to return ELOOP. */
+    /* Follow the link, unless it's time to return ELOOP. */
     follow_count++;
     if (follow_count >= UVWASI__MAX_SYMLINK_FOLLOWS) {
-      uv_fs_req_cleanup(&req);
       err = UVWASI_ELOOP;
       goto exit;
     }
 
-    link_target_len = strlen(req.ptr);
-    uvwasi__free(uvwasi, link_target);
-    link_target = uvwasi__malloc(uvwasi, link_target_len + 1);
-    if (link_target == NULL) {
-      uv_fs_req_cleanup(&req);
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
-
-    memcpy(link_target, req.ptr, link_target_len + 1);
-    uv_fs_req_cleanup(&req);
+    link_target_len = strlen(link_target);
+    UVWASI__PROBE_RESOLVE_PATH_SYMLINK(uvwasi, link_target, follow_count);
 
     if (1 == uvwasi__is_absolute_path(link_target, link_target_len)) {
       input = link_target;
@@ -584,5 +652,6 @@ exit:
   uvwasi__free(uvwasi, normalized_parent);
   uvwasi__free(uvwasi, resolved_link_target);
 
+  UVWASI__PROBE_RESOLVE_PATH_RETURN(uvwasi, err, *resolved_path);
   return err;
 }
@@ -1,5 +1,6 @@
 #include "uv.h"
 #include "poll_oneoff.h"
+#include "probes.h"
 #include "uv_mapping.h"
 #include "uvwasi_alloc.h"
 
@@ -250,12 +251,19 @@ poll_config_done:
 uvwasi_errno_t uvwasi__poll_oneoff_run(
                                       struct uvwasi_poll_oneoff_state_t* state
                                     ) {
+  uvwasi_errno_t err;
   int r;
 
+  UVWASI__PROBE_POLL_RUN_ENTRY(state->has_timer == 1 ?
+                                 (int64_t) state->timeout : (int64_t) -1,
+                               state->fdevent_cnt);
+
   if (state->has_timer == 1) {
     r = uv_timer_start(&state->timer, timeout_cb, state->timeout, 0);
-    if (r != 0)
-      return uvwasi__translate_uv_error(r);
+    if (r != 0) {
+      err = uvwasi__translate_uv_error(r);
+      goto exit;
+    }
 
     if (state->fdevent_cnt > 0)
       uv_unref((uv_handle_t*) &state->timer);
@@ -263,7 +271,11 @@ uvwasi_errno_t uvwasi__poll_oneoff_run(
 
   r = uv_run(&state->loop, UV_RUN_DEFAULT);
   if (r != 0)
-    return uvwasi__translate_uv_error(r);
+    err = uvwasi__translate_uv_error(r);
+  else
+    err = UVWASI_ESUCCESS;
 
-  return UVWASI_ESUCCESS;
+exit:
+  UVWASI__PROBE_POLL_RUN_RETURN(err);
+  return err;
 }
@@ -0,0 +1,55 @@
+#ifndef __UVWASI_PROBES_H__
+#define __UVWASI_PROBES_H__
+
+/* Statically defined tracepoints for tools such as bpftrace, perf and
+   SystemTap, compatible with sys/sdt.h. They are only compiled in when
+   UVWASI_ENABLE_USDT is defined, and each probe site is then a single nop
+   until a tracer attaches. Probes use the "uvwasi" provider:
+
+   syscall__entry(uvwasi_t*, uvwasi_syscall_t)
+   syscall__return(uvwasi_t*, uvwasi_syscall_t, errno, fd, arg, result)
+     Fired by every public system call. fd, arg and result match the fields of
+     uvwasi_trace_event_t.
+   resolve__path__entry(uvwasi_t*, fd, const char* path, path_len, flags)
+   resolve__path__symlink(uvwasi_t*, const char* target, follow_count)
+   resolve__path__return(uvwasi_t*, errno, const char* host_path)
+     Fired by uvwasi__resolve_path(). host_path is NULL on failure.
+   poll__run__entry(timeout_ms, fdevent_count)
+   poll__run__return(errno)
+     Fired around the event loop run by poll_oneoff. timeout_ms is -1 when
+     there is no clock subscription. */
+
+#if defined(UVWASI_ENABLE_USDT)
+# include <sys/sdt.h>
+
+# define UVWASI__PROBE_SYSCALL_ENTRY(uvwasi, syscall)                         \
+    DTRACE_PROBE2(uvwasi, syscall__entry, uvwasi, syscall)
+# define UVWASI__PROBE_SYSCALL_RETURN(uvwasi, syscall, err, fd, arg, result)  \
+    DTRACE_PROBE6(uvwasi, syscall__return, uvwasi, syscall, err, fd, arg,     \
+                  result)
+# define UVWASI__PROBE_RESOLVE_PATH_ENTRY(uvwasi, fd, path, path_len, flags)  \
+    DTRACE_PROBE5(uvwasi, resolve__path__entry, uvwasi, fd, path, path_len,   \
+                  flags)
+# define UVWASI__PROBE_RESOLVE_PATH_SYMLINK(uvwasi, target, follow_count)     \
+    DTRACE_PROBE3(uvwasi, resolve__path__symlink, uvwasi, target,             \
+                  follow_count)
+# define UVWASI__PROBE_RESOLVE_PATH_RETURN(uvwasi, err, host_path)            \
+    DTRACE_PROBE3(uvwasi, resolve__path__return, uvwasi, err, host_path)
+# define UVWASI__PROBE_POLL_RUN_ENTRY(timeout, fdevent_count)                 \
+    DTRACE_PROBE2(uvwasi, poll__run__entry, timeout, fdevent_count)
+# define UVWASI__PROBE_POLL_RUN_RETURN(err)                                   \
+    DTRACE_PROBE1(uvwasi, poll__run__return, err)
+#else
+# define UVWASI__PROBE_SYSCALL_ENTRY(uvwasi, syscall) ((void) 0)
+# define UVWASI__PROBE_SYSCALL_RETURN(uvwasi, syscall, err, fd, arg, result)  \
+    ((void) 0)
+# define UVWASI__PROBE_RESOLVE_PATH_ENTRY(uvwasi, fd, path, path_len, flags)  \
+    ((void) 0)
+# define UVWASI__PROBE_RESOLVE_PATH_SYMLINK(uvwasi, target, follow_count)     \
+    ((void) 0)
+# define UVWASI__PROBE_RESOLVE_PATH_RETURN(uvwasi, err, host_path) ((void) 0)
+# define UVWASI__PROBE_POLL_RUN_ENTRY(timeout, fdevent_count) ((void) 0)
+# define UVWASI__PROBE_POLL_RUN_RETURN(err) ((void) 0)
+#endif /* defined(UVWASI_ENABLE_USDT) */
+
+#endif /* __UVWASI_PROBES_H__ */
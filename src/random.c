@@ -0,0 +1,259 @@
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "uv_mapping.h"
+#include "random.h"
+
+/* Requests larger than this are always read from the kernel. Small requests
+   are the common case (hash seeds, UUIDs) and are where the syscall overhead
+   dominates. */
+#define UVWASI__RNG_MAX_BUFFERED 256
+
+/* Fresh kernel entropy is mixed into the key after this many bytes have been
+   handed out. */
+#define UVWASI__RNG_RESEED_BYTES (1024 * 1024)
+
+#define UVWASI__CHACHA_BLOCK_SIZE 64
+#define UVWASI__CHACHA_KEY_SIZE 32
+
+
+/* ChaCha20 keystream generator using fast key erasure: every refill of the
+   buffer begins with a block whose output replaces the key, and bytes are
+   wiped from the buffer as soon as they are handed out. A later compromise of
+   the state therefore reveals nothing about earlier output. */
+struct uvwasi_rng_t {
+  uv_mutex_t mutex;
+  uint32_t key[8];
+  uint64_t counter;
+  uint64_t reseed_remaining;
+  unsigned char* buf;
+  uvwasi_size_t size;
+  uvwasi_size_t pos;
+};
+
+
+#define UVWASI__ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define UVWASI__CHACHA_QR(a, b, c, d)                                         \
+  do {                                                                        \
+    a += b; d ^= a; d = UVWASI__ROTL32(d, 16);                                \
+    c += d; b ^= c; b = UVWASI__ROTL32(b, 12);                                \
+    a += b; d ^= a; d = UVWASI__ROTL32(d, 8);                                 \
+    c += d; b ^= c; b = UVWASI__ROTL32(b, 7);                                 \
+  } while (0)
+
+
+static uint32_t uvwasi__load32_le(const unsigned char* p) {
+  return (uint32_t) p[0] |
+         ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) |
+         ((uint32_t) p[3] << 24);
+}
+
+
+static void uvwasi__store32_le(unsigned char* p, uint32_t v) {
+  p[0] = (unsigned char) v;
+  p[1] = (unsigned char) (v >> 8);
+  p[2] = (unsigned char) (v >> 16);
+  p[3] = (unsigned char) (v >> 24);
+}
+
+
+static void uvwasi__chacha20_block(const uint32_t key[8],
+                                   uint64_t counter,
+                                   unsigned char out[64]) {
+  uint32_t input[16];
+  uint32_t x[16];
+  int i;
+
+  /* "expand 32-byte k" */
+  input[0] = 0x61707865;
+  input[1] = 0x3320646e;
+  input[2] = 0x79622d32;
+  input[3] = 0x6b206574;
+  for (i = 0; i < 8; i++)
+    input[4 + i] = key[i];
+  input[12] = (uint32_t) counter;
+  input[13] = (uint32_t) (counter >> 32);
+  input[14] = 0;
+  input[15] = 0;
+
+  memcpy(x, input, sizeof(x));
+  for (i = 0; i < 10; i++) {
+    UVWASI__CHACHA_QR(x[0], x[4], x[8], x[12]);
+    UVWASI__CHACHA_QR(x[1], x[5], x[9], x[13]);
+    UVWASI__CHACHA_QR(x[2], x[6], x[10], x[14]);
+    UVWASI__CHACHA_QR(x[3], x[7], x[11], x[15]);
+    UVWASI__CHACHA_QR(x[0], x[5], x[10], x[15]);
+    UVWASI__CHACHA_QR(x[1], x[6], x[11], x[12]);
+    UVWASI__CHACHA_QR(x[2], x[7], x[8], x[13]);
+    UVWASI__CHACHA_QR(x[3], x[4], x[9], x[14]);
+  }
+
+  for (i = 0; i < 16; i++)
+    uvwasi__store32_le(out + i * 4, x[i] + input[i]);
+}
+
+
+static void uvwasi__rng_wipe(void* p, size_t len) {
+  volatile unsigned char* v = p;
+
+  while (len--)
+    *v++ = 0;
+}
+
+
+static uvwasi_errno_t uvwasi__rng_reseed(struct uvwasi_rng_t* rng) {
+  unsigned char seed[UVWASI__CHACHA_KEY_SIZE];
+  int i;
+  int r;
+
+  r = uv_random(NULL, NULL, seed, sizeof(seed), 0, NULL);
+  if (r != 0)
+    return uvwasi__translate_uv_error(r);
+
+  for (i = 0; i < 8; i++)
+    rng->key[i] ^= uvwasi__load32_le(seed + i * 4);
+
+  uvwasi__rng_wipe(seed, sizeof(seed));
+  rng->reseed_remaining = UVWASI__RNG_RESEED_BYTES;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__rng_refill(struct uvwasi_rng_t* rng) {
+  uvwasi_size_t off;
+  int i;
+
+  for (off = 0; off < rng->size; off += UVWASI__CHACHA_BLOCK_SIZE)
+    uvwasi__chacha20_block(rng->key, rng->counter++, rng->buf + off);
+
+  /* The first 32 bytes of output become the next key and are never served. */
+  for (i = 0; i < 8; i++)
+    rng->key[i] = uvwasi__load32_le(rng->buf + i * 4);
+
+  uvwasi__rng_wipe(rng->buf, UVWASI__CHACHA_KEY_SIZE);
+  rng->pos = UVWASI__CHACHA_KEY_SIZE;
+}
+
+
+uvwasi_errno_t uvwasi__rng_init(uvwasi_t* uvwasi,
+                                struct uvwasi_rng_t** rng,
+                                uvwasi_size_t buffer_size) {
+  struct uvwasi_rng_t* r;
+  uvwasi_errno_t err;
+
+  /* The buffer holds whole blocks and always has room for the next key plus
+     at least one full block of output. Output past a reseed would be thrown
+     away, so the buffer is never larger than that, which also keeps the
+     rounding below from overflowing. */
+  if (buffer_size > UVWASI__RNG_RESEED_BYTES)
+    buffer_size = UVWASI__RNG_RESEED_BYTES;
+  if (buffer_size < 2 * UVWASI__CHACHA_BLOCK_SIZE)
+    buffer_size = 2 * UVWASI__CHACHA_BLOCK_SIZE;
+  buffer_size = (buffer_size + UVWASI__CHACHA_BLOCK_SIZE - 1) &
+                ~(uvwasi_size_t) (UVWASI__CHACHA_BLOCK_SIZE - 1);
+
+  r = uvwasi__calloc(uvwasi, 1, sizeof(*r));
+  if (r == NULL)
+    return UVWASI_ENOMEM;
+
+  r->buf = uvwasi__malloc(uvwasi, buffer_size);
+  if (r->buf == NULL) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
+
+  r->size = buffer_size;
+  r->counter = 0;
+
+  err = uvwasi__rng_reseed(r);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (uv_mutex_init(&r->mutex) != 0) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
+
+  uvwasi__rng_refill(r);
+  *rng = r;
+  return UVWASI_ESUCCESS;
+
+exit:
+  uvwasi__rng_wipe(r->key, sizeof(r->key));
+  uvwasi__free(uvwasi, r->buf);
+  uvwasi__free(uvwasi, r);
+  return err;
+}
+
+
+void uvwasi__rng_free(uvwasi_t* uvwasi, struct uvwasi_rng_t* rng) {
+  if (rng == NULL)
+    return;
+
+  uv_mutex_destroy(&rng->mutex);
+  uvwasi__rng_wipe(rng->buf, rng->size);
+  uvwasi__rng_wipe(rng->key, sizeof(rng->key));
+  uvwasi__free(uvwasi, rng->buf);
+  uvwasi__free(uvwasi, rng);
+}
+
+
+uvwasi_size_t uvwasi__rng_buffer_size(const struct uvwasi_rng_t* rng) {
+  return rng->size;
+}
+
+
+uvwasi_errno_t uvwasi__rng_get(struct uvwasi_rng_t* rng,
+                               void* buf,
+                               uvwasi_size_t buf_len) {
+  unsigned char* out;
+  uvwasi_size_t avail;
+  uvwasi_errno_t err;
+  int r;
+
+  if (buf_len > UVWASI__RNG_MAX_BUFFERED) {
+    r = uv_random(NULL, NULL, buf, buf_len, 0, NULL);
+    if (r != 0)
+      return uvwasi__translate_uv_error(r);
+
+    return UVWASI_ESUCCESS;
+  }
+
+  out = buf;
+  err = UVWASI_ESUCCESS;
+  uv_mutex_lock(&rng->mutex);
+
+  if (rng->reseed_remaining < buf_len) {
+    err = uvwasi__rng_reseed(rng);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+
+    /* Output buffered under the old key must not outlive a reseed. */
+    uvwasi__rng_refill(rng);
+  }
+
+  rng->reseed_remaining -= buf_len;
+
+  while (buf_len > 0) {
+    if (rng->pos == rng->size)
+      uvwasi__rng_refill(rng);
+
+    avail = rng->size - rng->pos;
+    if (avail > buf_len)
+      avail = buf_len;
+
+    memcpy(out, rng->buf + rng->pos, avail);
+    uvwasi__rng_wipe(rng->buf + rng->pos, avail);
+    rng->pos += avail;
+    out += avail;
+    buf_len -= avail;
+  }
+
+exit:
+  uv_mutex_unlock(&rng->mutex);
+  return err;
+}
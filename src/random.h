@@ -0,0 +1,18 @@
+#ifndef __UVWASI_RANDOM_H__
+#define __UVWASI_RANDOM_H__
+
+#include "wasi_types.h"
+
+struct uvwasi_s;
+struct uvwasi_rng_t;
+
+uvwasi_errno_t uvwasi__rng_init(struct uvwasi_s* uvwasi,
+                                struct uvwasi_rng_t** rng,
+                                uvwasi_size_t buffer_size);
+void uvwasi__rng_free(struct uvwasi_s* uvwasi, struct uvwasi_rng_t* rng);
+uvwasi_size_t uvwasi__rng_buffer_size(const struct uvwasi_rng_t* rng);
+uvwasi_errno_t uvwasi__rng_get(struct uvwasi_rng_t* rng,
+                               void* buf,
+                               uvwasi_size_t buf_len);
+
+#endif /* __UVWASI_RANDOM_H__ */
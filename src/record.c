@@ -0,0 +1,435 @@
+#include <stdarg.h>
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "uv_mapping.h"
+#include "fd_table.h"
+#include "atomic_ops.h"
+#include "record.h"
+
+/* Entries are collected in a buffer of this size and written out when it
+   fills up, when the recording stops, and before proc_exit(). */
+#define UVWASI__RECORD_BUFFER_SIZE (64 * 1024)
+
+
+static uvwasi_errno_t uvwasi__record_write_file(struct uvwasi_record_t* rec,
+                                                const char* data,
+                                                size_t len) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int r;
+
+  while (len > 0) {
+    buf = uv_buf_init((char*) data, (unsigned int) len);
+    r = uv_fs_write(NULL, &req, rec->file, &buf, 1, -1, NULL);
+    uv_fs_req_cleanup(&req);
+    if (r < 0)
+      return uvwasi__translate_uv_error(r);
+
+    data += r;
+    len -= r;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__record_flush(struct uvwasi_record_t* rec) {
+  uvwasi_errno_t err;
+
+  if (rec->buf_len == 0 || rec->error != UVWASI_ESUCCESS)
+    return;
+
+  err = uvwasi__record_write_file(rec, rec->buf, rec->buf_len);
+  if (err != UVWASI_ESUCCESS)
+    rec->error = err;
+
+  rec->buf_len = 0;
+}
+
+
+static void uvwasi__record_write(struct uvwasi_record_t* rec,
+                                 const void* data,
+                                 size_t len) {
+  uvwasi_errno_t err;
+
+  if (rec->error != UVWASI_ESUCCESS)
+    return;
+
+  if (rec->buf_len + len > UVWASI__RECORD_BUFFER_SIZE)
+    uvwasi__record_flush(rec);
+
+  if (len >= UVWASI__RECORD_BUFFER_SIZE) {
+    err = uvwasi__record_write_file(rec, data, len);
+    if (err != UVWASI_ESUCCESS)
+      rec->error = err;
+    return;
+  }
+
+  memcpy(rec->buf + rec->buf_len, data, len);
+  rec->buf_len += len;
+}
+
+
+static void uvwasi__record_write_path(struct uvwasi_record_t* rec,
+                                      uvwasi_fd_t fd,
+                                      const char* path) {
+  uint64_t value;
+  uint32_t len;
+
+  value = fd;
+  len = (uint32_t) strlen(path);
+  uvwasi__record_write(rec, &value, sizeof(value));
+  uvwasi__record_write(rec, &len, sizeof(len));
+  uvwasi__record_write(rec, path, len);
+}
+
+
+/* Writes the header and the preopened directories, which the replay tool maps
+   onto its scratch directory. Other open fds are not described, so recordings
+   are best started before the guest opens any files. */
+static void uvwasi__record_write_header(uvwasi_t* uvwasi,
+                                        struct uvwasi_record_t* rec) {
+  struct uvwasi_fd_table_t* table;
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_record_header_t header;
+  uint32_t i;
+  int pass;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, UVWASI_RECORD_MAGIC, sizeof(header.magic));
+  header.version = UVWASI_RECORD_VERSION;
+
+  table = uvwasi->fds;
+  uvwasi_fd_table_rdlock(table);
+
+  /* The first pass counts the preopens and the second writes them. */
+  for (pass = 0; pass < 2; pass++) {
+    if (pass == 1)
+      uvwasi__record_write(rec, &header, sizeof(header));
+
+    for (i = 0; i < table->size; i++) {
+      wrap = UVWASI__FD_TABLE_ENTRY(table, i);
+      if (wrap->cold == NULL || wrap->preopen == 0 || wrap->cold->sock != NULL)
+        continue;
+
+      if (pass == 0)
+        header.preopenc++;
+      else
+        uvwasi__record_write_path(rec, wrap->id, wrap->cold->path);
+    }
+  }
+
+  uvwasi_fd_table_rdunlock(table);
+}
+
+
+uvwasi_errno_t uvwasi__record_init(uvwasi_t* uvwasi) {
+  struct uvwasi_record_t* rec;
+
+  rec = uvwasi__calloc(uvwasi, 1, sizeof(*rec));
+  if (rec == NULL)
+    return UVWASI_ENOMEM;
+
+  rec->file = -1;
+
+  if (uv_mutex_init(&rec->mutex) != 0) {
+    uvwasi__free(uvwasi, rec);
+    return UVWASI_ENOMEM;
+  }
+
+  uvwasi->record = rec;
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__record_free(uvwasi_t* uvwasi) {
+  struct uvwasi_record_t* rec;
+
+  rec = uvwasi->record;
+  if (rec == NULL)
+    return;
+
+  uvwasi_record_stop(uvwasi);
+  uv_mutex_destroy(&rec->mutex);
+  uvwasi__free(uvwasi, rec);
+  uvwasi->record = NULL;
+}
+
+
+static int uvwasi__record_begin(uvwasi_t* uvwasi) {
+  struct uvwasi_record_t* rec;
+
+  if (uvwasi == NULL || !uvwasi__record_is_enabled(uvwasi->record))
+    return 0;
+
+  rec = uvwasi->record;
+  uv_mutex_lock(&rec->mutex);
+
+  /* The recording may have stopped while the call was running. */
+  if (rec->file < 0) {
+    uv_mutex_unlock(&rec->mutex);
+    return 0;
+  }
+
+  rec->args_len = 0;
+  return 1;
+}
+
+
+static char* uvwasi__record_reserve(uvwasi_t* uvwasi, size_t len) {
+  struct uvwasi_record_t* rec;
+  size_t size;
+  char* args;
+
+  rec = uvwasi->record;
+  if (rec->error != UVWASI_ESUCCESS)
+    return NULL;
+
+  if (rec->args_len + len > rec->args_size) {
+    size = rec->args_size == 0 ? 256 : rec->args_size;
+    while (size < rec->args_len + len)
+      size *= 2;
+
+    args = uvwasi__realloc(uvwasi, rec->args, size);
+    if (args == NULL) {
+      rec->error = UVWASI_ENOMEM;
+      return NULL;
+    }
+
+    rec->args = args;
+    rec->args_size = size;
+  }
+
+  args = rec->args + rec->args_len;
+  rec->args_len += len;
+  return args;
+}
+
+
+static void uvwasi__record_u64(uvwasi_t* uvwasi, uint64_t value) {
+  char* p;
+
+  p = uvwasi__record_reserve(uvwasi, sizeof(value));
+  if (p != NULL)
+    memcpy(p, &value, sizeof(value));
+}
+
+
+static void uvwasi__record_buf(uvwasi_t* uvwasi, const void* buf, size_t len) {
+  uint32_t len32;
+  char* p;
+
+  if (buf == NULL)
+    len = 0;
+
+  len32 = (uint32_t) len;
+  p = uvwasi__record_reserve(uvwasi, sizeof(len32) + len);
+  if (p == NULL)
+    return;
+
+  memcpy(p, &len32, sizeof(len32));
+  if (len > 0)
+    memcpy(p + sizeof(len32), buf, len);
+}
+
+
+static void uvwasi__record_iovs(uvwasi_t* uvwasi,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len) {
+  uvwasi_size_t i;
+
+  if (iovs == NULL)
+    iovs_len = 0;
+
+  uvwasi__record_u64(uvwasi, iovs_len);
+  for (i = 0; i < iovs_len; i++)
+    uvwasi__record_u64(uvwasi, iovs[i].buf_len);
+}
+
+
+static void uvwasi__record_ciovs(uvwasi_t* uvwasi,
+                                 const uvwasi_ciovec_t* iovs,
+                                 uvwasi_size_t iovs_len) {
+  uvwasi_size_t i;
+
+  if (iovs == NULL)
+    iovs_len = 0;
+
+  uvwasi__record_u64(uvwasi, iovs_len);
+  for (i = 0; i < iovs_len; i++)
+    uvwasi__record_buf(uvwasi, iovs[i].buf, iovs[i].buf_len);
+}
+
+
+static void uvwasi__record_end(uvwasi_t* uvwasi,
+                               uvwasi_syscall_t syscall,
+                               uint64_t start_ns,
+                               uvwasi_errno_t err,
+                               uint64_t result) {
+  struct uvwasi_record_t* rec;
+  uvwasi_record_entry_t entry;
+  uint64_t now;
+
+  rec = uvwasi->record;
+  now = uv_hrtime();
+
+  /* start_ns is zero if recording started while the call was running. */
+  if (start_ns == 0 || start_ns < rec->base_ns)
+    start_ns = now;
+
+  entry.start_ns = start_ns - rec->base_ns;
+  entry.duration_ns = now - start_ns;
+  entry.result = result;
+  entry.syscall = (uint16_t) syscall;
+  entry.error = err;
+  entry.size = (uint32_t) rec->args_len;
+  uvwasi__record_write(rec, &entry, sizeof(entry));
+  uvwasi__record_write(rec, rec->args, rec->args_len);
+
+  /* proc_exit() does not return, so nothing recorded so far can be lost. */
+  if (syscall == UVWASI_SYSCALL_PROC_EXIT)
+    uvwasi__record_flush(rec);
+
+  uv_mutex_unlock(&rec->mutex);
+}
+
+
+void uvwasi__record_syscall(uvwasi_t* uvwasi,
+                            uvwasi_syscall_t syscall,
+                            uint64_t start_ns,
+                            uvwasi_errno_t err,
+                            uint64_t result,
+                            const char* fmt,
+                            va_list ap) {
+  const uvwasi_ciovec_t* ciovs;
+  const uvwasi_iovec_t* iovs;
+  const void* buf;
+  uvwasi_size_t len;
+
+  if (!uvwasi__record_begin(uvwasi))
+    return;
+
+  for (; *fmt != '\0'; fmt++) {
+    switch (*fmt) {
+      case 'u':
+        uvwasi__record_u64(uvwasi, va_arg(ap, uint64_t));
+        break;
+      case 'b':
+        buf = va_arg(ap, const void*);
+        len = va_arg(ap, uvwasi_size_t);
+        uvwasi__record_buf(uvwasi, buf, len);
+        break;
+      case 'i':
+        iovs = va_arg(ap, const uvwasi_iovec_t*);
+        len = va_arg(ap, uvwasi_size_t);
+        uvwasi__record_iovs(uvwasi, iovs, len);
+        break;
+      case 'c':
+        ciovs = va_arg(ap, const uvwasi_ciovec_t*);
+        len = va_arg(ap, uvwasi_size_t);
+        uvwasi__record_ciovs(uvwasi, ciovs, len);
+        break;
+    }
+  }
+
+  uvwasi__record_end(uvwasi, syscall, start_ns, err, result);
+}
+
+
+uvwasi_errno_t uvwasi_record_start(uvwasi_t* uvwasi, const char* path) {
+  struct uvwasi_record_t* rec;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+
+  if (uvwasi == NULL || path == NULL)
+    return UVWASI_EINVAL;
+
+  rec = uvwasi->record;
+  if (rec == NULL)
+    return UVWASI_ENOTSUP;
+
+  uv_mutex_lock(&rec->mutex);
+
+  if (rec->file >= 0) {
+    err = UVWASI_EBUSY;
+    goto exit;
+  }
+
+  rec->buf = uvwasi__malloc(uvwasi, UVWASI__RECORD_BUFFER_SIZE);
+  if (rec->buf == NULL) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
+
+  r = uv_fs_open(NULL,
+                 &req,
+                 path,
+                 UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                 0666,
+                 NULL);
+  uv_fs_req_cleanup(&req);
+  if (r < 0) {
+    uvwasi__free(uvwasi, rec->buf);
+    rec->buf = NULL;
+    err = uvwasi__translate_uv_error(r);
+    goto exit;
+  }
+
+  rec->file = r;
+  rec->error = UVWASI_ESUCCESS;
+  rec->buf_len = 0;
+  rec->base_ns = uv_hrtime();
+  uvwasi__record_write_header(uvwasi, rec);
+  uvwasi__atomic_store_u32(&rec->enabled, 1);
+  err = UVWASI_ESUCCESS;
+
+exit:
+  uv_mutex_unlock(&rec->mutex);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi_record_stop(uvwasi_t* uvwasi) {
+  struct uvwasi_record_t* rec;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  rec = uvwasi->record;
+  if (rec == NULL)
+    return UVWASI_ENOTSUP;
+
+  uv_mutex_lock(&rec->mutex);
+
+  if (rec->file < 0) {
+    err = UVWASI_EINVAL;
+    goto exit;
+  }
+
+  uvwasi__atomic_store_u32(&rec->enabled, 0);
+  uvwasi__record_flush(rec);
+  err = rec->error;
+
+  r = uv_fs_close(NULL, &req, rec->file, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r < 0 && err == UVWASI_ESUCCESS)
+    err = uvwasi__translate_uv_error(r);
+
+  rec->file = -1;
+  uvwasi__free(uvwasi, rec->buf);
+  rec->buf = NULL;
+  uvwasi__free(uvwasi, rec->args);
+  rec->args = NULL;
+  rec->args_size = 0;
+
+exit:
+  uv_mutex_unlock(&rec->mutex);
+  return err;
+}
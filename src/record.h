@@ -0,0 +1,43 @@
+#ifndef __UVWASI_RECORD_H__
+#define __UVWASI_RECORD_H__
+
+#include <stdarg.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "atomic_ops.h"
+
+struct uvwasi_record_t {
+  uint32_t enabled;
+  uvwasi_errno_t error;
+  uv_file file;
+  uint64_t base_ns;
+  /* Serializes entries. It is held from uvwasi__record_begin() until the
+     matching uvwasi__record_end(). */
+  uv_mutex_t mutex;
+  char* args;
+  size_t args_len;
+  size_t args_size;
+  char* buf;
+  size_t buf_len;
+};
+
+#define uvwasi__record_is_enabled(record)                                     \
+  ((record) != NULL && uvwasi__atomic_load_u32(&(record)->enabled) != 0)
+
+uvwasi_errno_t uvwasi__record_init(uvwasi_t* uvwasi);
+void uvwasi__record_free(uvwasi_t* uvwasi);
+
+/* Records a completed system call. fmt has one character per argument, in
+   parameter order, and each is followed by its values in ap: 'u' takes a
+   uint64_t, 'b' a buffer and its uvwasi_size_t length, and 'i' and 'c' an
+   iovec or ciovec array and its uvwasi_size_t length. */
+void uvwasi__record_syscall(uvwasi_t* uvwasi,
+                            uvwasi_syscall_t syscall,
+                            uint64_t start_ns,
+                            uvwasi_errno_t err,
+                            uint64_t result,
+                            const char* fmt,
+                            va_list ap);
+
+#endif /* __UVWASI_RECORD_H__ */
@@ -0,0 +1,143 @@
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "atomic_ops.h"
+#include "stats.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+# include <intrin.h>
+# pragma intrinsic(_BitScanReverse64)
+#endif
+
+
+/* uvwasi_stats_t consists only of uint64_t counters, so it can be walked as a
+   flat array when taking snapshots or resetting. */
+#define UVWASI__STATS_COUNTERS (sizeof(uvwasi_stats_t) / sizeof(uint64_t))
+
+
+static unsigned int uvwasi__log2_u64(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return v == 0 ? 0 : 63 - __builtin_clzll(v);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long index;
+
+  if (!_BitScanReverse64(&index, v))
+    return 0;
+
+  return (unsigned int) index;
+#else
+  unsigned int r;
+
+  r = 0;
+  while (v >>= 1)
+    r++;
+
+  return r;
+#endif
+}
+
+
+/* Only data transfer calls report their result as a byte count. */
+static int uvwasi__stats_counts_bytes(uvwasi_syscall_t syscall) {
+  switch (syscall) {
+    case UVWASI_SYSCALL_FD_PREAD:
+    case UVWASI_SYSCALL_FD_PWRITE:
+    case UVWASI_SYSCALL_FD_READ:
+    case UVWASI_SYSCALL_FD_READDIR:
+    case UVWASI_SYSCALL_FD_WRITE:
+    case UVWASI_SYSCALL_PATH_READLINK:
+    case UVWASI_SYSCALL_RANDOM_GET:
+    case UVWASI_SYSCALL_SOCK_RECV:
+    case UVWASI_SYSCALL_SOCK_SEND:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+
+uvwasi_errno_t uvwasi__stats_init(uvwasi_t* uvwasi) {
+  uvwasi->stats = uvwasi__calloc(uvwasi, 1, sizeof(*uvwasi->stats));
+  if (uvwasi->stats == NULL)
+    return UVWASI_ENOMEM;
+
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__stats_free(uvwasi_t* uvwasi) {
+  uvwasi__free(uvwasi, uvwasi->stats);
+  uvwasi->stats = NULL;
+}
+
+
+void uvwasi__stats_record(uvwasi_stats_t* stats,
+                          uvwasi_syscall_t syscall,
+                          uvwasi_errno_t err,
+                          uint64_t result,
+                          uint64_t elapsed_ns) {
+  uvwasi_syscall_stats_t* s;
+  uint64_t max;
+  unsigned int bucket;
+
+  s = &stats->syscalls[syscall];
+  uvwasi__atomic_add_u64(&s->calls, 1);
+  uvwasi__atomic_add_u64(&s->total_ns, elapsed_ns);
+
+  if (err != UVWASI_ESUCCESS)
+    uvwasi__atomic_add_u64(&s->errors, 1);
+
+  if (result != 0 && uvwasi__stats_counts_bytes(syscall))
+    uvwasi__atomic_add_u64(&s->bytes, result);
+
+  bucket = uvwasi__log2_u64(elapsed_ns);
+  if (bucket >= UVWASI_STATS_LATENCY_BUCKETS)
+    bucket = UVWASI_STATS_LATENCY_BUCKETS - 1;
+
+  uvwasi__atomic_add_u64(&s->latency[bucket], 1);
+
+  max = uvwasi__atomic_load_u64(&s->max_ns);
+  while (elapsed_ns > max) {
+    if (uvwasi__atomic_cas_u64(&s->max_ns, &max, elapsed_ns))
+      break;
+  }
+}
+
+
+uvwasi_errno_t uvwasi_stats_get(const uvwasi_t* uvwasi, uvwasi_stats_t* stats) {
+  uint64_t* src;
+  uint64_t* dst;
+  size_t i;
+
+  if (uvwasi == NULL || stats == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->stats == NULL)
+    return UVWASI_ENOTSUP;
+
+  /* Counters are read individually, so a snapshot taken while other threads
+     are making calls may be slightly inconsistent across fields. */
+  src = (uint64_t*) uvwasi->stats;
+  dst = (uint64_t*) stats;
+  for (i = 0; i < UVWASI__STATS_COUNTERS; i++)
+    dst[i] = uvwasi__atomic_load_u64(&src[i]);
+
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_stats_reset(uvwasi_t* uvwasi) {
+  uint64_t* counters;
+  size_t i;
+
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->stats == NULL)
+    return UVWASI_ENOTSUP;
+
+  counters = (uint64_t*) uvwasi->stats;
+  for (i = 0; i < UVWASI__STATS_COUNTERS; i++)
+    uvwasi__atomic_store_u64(&counters[i], 0);
+
+  return UVWASI_ESUCCESS;
+}
@@ -0,0 +1,14 @@
+#ifndef __UVWASI_STATS_H__
+#define __UVWASI_STATS_H__
+
+#include "uvwasi.h"
+
+uvwasi_errno_t uvwasi__stats_init(uvwasi_t* uvwasi);
+void uvwasi__stats_free(uvwasi_t* uvwasi);
+void uvwasi__stats_record(uvwasi_stats_t* stats,
+                          uvwasi_syscall_t syscall,
+                          uvwasi_errno_t err,
+                          uint64_t result,
+                          uint64_t elapsed_ns);
+
+#endif /* __UVWASI_STATS_H__ */
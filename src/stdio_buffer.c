@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "stdio_buffer.h"
+#include "fd_table.h"
+#include "uv_mapping.h"
+
+
+/* Writes all of data to the host. The caller holds the stdio mutex. */
+static uvwasi_errno_t uvwasi__stdio_write_all(uv_file fd,
+                                              const char* data,
+                                              size_t len) {
+  uv_buf_t buf;
+  uv_fs_t req;
+  int r;
+
+  while (len > 0) {
+    buf = uv_buf_init((char*) data, (unsigned int) len);
+    r = uv_fs_write(NULL, &req, fd, &buf, 1, -1, NULL);
+    uv_fs_req_cleanup(&req);
+    if (r < 0)
+      return uvwasi__translate_uv_error(r);
+
+    data += r;
+    len -= (size_t) r;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Writes out buf's contents. They are dropped even if that fails, so that a
+   broken pipe does not keep failing later writes. The caller holds the stdio
+   mutex. */
+static uvwasi_errno_t uvwasi__stdio_flush_locked(
+                                            struct uvwasi__stdio_buf_t* buf) {
+  uvwasi_errno_t err;
+
+  if (buf->len == 0)
+    return UVWASI_ESUCCESS;
+
+  err = UVWASI_ESUCCESS;
+  if (buf->fd != -1)
+    err = uvwasi__stdio_write_all(buf->fd, buf->data, buf->len);
+
+  buf->len = 0;
+  return err;
+}
+
+
+/* Flushes every buffer other than except, which may be NULL. The caller holds
+   the stdio mutex. */
+static uvwasi_errno_t uvwasi__stdio_flush_others(
+                                          struct uvwasi_stdio_t* stdio,
+                                          struct uvwasi__stdio_buf_t* except) {
+  uvwasi_errno_t err;
+  uvwasi_errno_t r;
+  int i;
+
+  err = UVWASI_ESUCCESS;
+  for (i = 0; i < 2; i++) {
+    if (&stdio->bufs[i] == except)
+      continue;
+
+    r = uvwasi__stdio_flush_locked(&stdio->bufs[i]);
+    if (r != UVWASI_ESUCCESS)
+      err = r;
+  }
+
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi__stdio_init(uvwasi_t* uvwasi,
+                                  const uvwasi_options_t* options) {
+  struct uvwasi_fd_wrap_t* wrap;
+  struct uvwasi_stdio_t* stdio;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  size_t size;
+  int r;
+
+  uvwasi->stdio = NULL;
+  if (options->stdio_buffer_size == 0)
+    return UVWASI_ESUCCESS;
+
+  size = sizeof(*stdio) + 2 * (size_t) options->stdio_buffer_size;
+  stdio = uvwasi__calloc(uvwasi, 1, size);
+  if (stdio == NULL)
+    return UVWASI_ENOMEM;
+
+  r = uv_mutex_init(&stdio->mutex);
+  if (r != 0) {
+    uvwasi__free(uvwasi, stdio);
+    return uvwasi__translate_uv_error(r);
+  }
+
+  stdio->size = options->stdio_buffer_size;
+  stdio->line_buffered = options->stdio_line_buffered;
+  stdio->ordered = options->stdio_ordered;
+  stdio->flush_interval = options->stdio_flush_interval;
+  for (fd = 1; fd <= 2; fd++) {
+    err = uvwasi_fd_table_get(uvwasi->fds, fd, &wrap, 0, 0);
+    if (err != UVWASI_ESUCCESS) {
+      uv_mutex_destroy(&stdio->mutex);
+      uvwasi__free(uvwasi, stdio);
+      return err;
+    }
+
+    stdio->bufs[fd - 1].fd = wrap->fd;
+    stdio->bufs[fd - 1].data = (char*) (stdio + 1) + (fd - 1) * stdio->size;
+    wrap->cold->out_buf = &stdio->bufs[fd - 1];
+    uv_mutex_unlock(&wrap->mutex);
+  }
+
+  uvwasi->stdio = stdio;
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__stdio_free(uvwasi_t* uvwasi) {
+  struct uvwasi_stdio_t* stdio;
+
+  stdio = uvwasi->stdio;
+  if (stdio == NULL)
+    return;
+
+  uv_mutex_lock(&stdio->mutex);
+  uvwasi__stdio_flush_others(stdio, NULL);
+  uv_mutex_unlock(&stdio->mutex);
+  uv_mutex_destroy(&stdio->mutex);
+  uvwasi__free(uvwasi, stdio);
+  uvwasi->stdio = NULL;
+}
+
+
+uvwasi_errno_t uvwasi__stdio_write(uvwasi_t* uvwasi,
+                                   struct uvwasi__stdio_buf_t* buf,
+                                   const uvwasi_ciovec_t* iovs,
+                                   uvwasi_size_t iovs_len,
+                                   uvwasi_size_t* nwritten) {
+  struct uvwasi_stdio_t* stdio;
+  uvwasi_errno_t err;
+  uint64_t total;
+  uvwasi_size_t i;
+  int newline;
+
+  stdio = uvwasi->stdio;
+  total = 0;
+  for (i = 0; i < iovs_len; i++)
+    total += iovs[i].buf_len;
+
+  uv_mutex_lock(&stdio->mutex);
+
+  /* Keep the streams' output in the order it was written. */
+  if (stdio->ordered) {
+    err = uvwasi__stdio_flush_others(stdio, buf);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+  }
+
+  if (total > stdio->size - buf->len) {
+    err = uvwasi__stdio_flush_locked(buf);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+  }
+
+  newline = 0;
+  if (total > stdio->size) {
+    /* Too large to buffer. Write it straight through. */
+    for (i = 0; i < iovs_len; i++) {
+      err = uvwasi__stdio_write_all(buf->fd, iovs[i].buf, iovs[i].buf_len);
+      if (err != UVWASI_ESUCCESS)
+        goto exit;
+    }
+  } else {
+    if (buf->len == 0)
+      buf->first_time = uv_hrtime();
+
+    for (i = 0; i < iovs_len; i++) {
+      memcpy(buf->data + buf->len, iovs[i].buf, iovs[i].buf_len);
+      buf->len += iovs[i].buf_len;
+      if (stdio->line_buffered &&
+          memchr(iovs[i].buf, '\n', iovs[i].buf_len) != NULL) {
+        newline = 1;
+      }
+    }
+  }
+
+  err = UVWASI_ESUCCESS;
+  if (newline ||
+      (buf->len != 0 &&
+       stdio->flush_interval != 0 &&
+       uv_hrtime() - buf->first_time >= stdio->flush_interval)) {
+    err = uvwasi__stdio_flush_locked(buf);
+  }
+
+exit:
+  uv_mutex_unlock(&stdio->mutex);
+  if (err == UVWASI_ESUCCESS)
+    *nwritten = (uvwasi_size_t) total;
+
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi__stdio_flush(uvwasi_t* uvwasi,
+                                   struct uvwasi__stdio_buf_t* buf) {
+  uvwasi_errno_t err;
+
+  uv_mutex_lock(&uvwasi->stdio->mutex);
+  if (buf == NULL)
+    err = uvwasi__stdio_flush_others(uvwasi->stdio, NULL);
+  else
+    err = uvwasi__stdio_flush_locked(buf);
+  uv_mutex_unlock(&uvwasi->stdio->mutex);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi__stdio_retarget(uvwasi_t* uvwasi,
+                                      struct uvwasi__stdio_buf_t* buf,
+                                      uv_file fd) {
+  uvwasi_errno_t err;
+
+  uv_mutex_lock(&uvwasi->stdio->mutex);
+  err = uvwasi__stdio_flush_locked(buf);
+  buf->fd = fd;
+  uv_mutex_unlock(&uvwasi->stdio->mutex);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi_stdio_flush(uvwasi_t* uvwasi) {
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->stdio == NULL)
+    return UVWASI_ESUCCESS;
+
+  return uvwasi__stdio_flush(uvwasi, NULL);
+}
@@ -0,0 +1,45 @@
+#ifndef __UVWASI_STDIO_BUFFER_H__
+#define __UVWASI_STDIO_BUFFER_H__
+
+#include "uv.h"
+#include "uvwasi.h"
+
+/* Output buffered for one of the stdio fds. fd is the host fd, or -1 once the
+   sandbox's fd has been closed. */
+struct uvwasi__stdio_buf_t {
+  uv_file fd;
+  uint32_t len;
+  uint64_t first_time;
+  char* data;
+};
+
+/* Output buffers for stdout and stderr, enabled by
+   uvwasi_options_t.stdio_buffer_size. Both are guarded by mutex, which is
+   taken after any fd mutex. */
+struct uvwasi_stdio_t {
+  uv_mutex_t mutex;
+  uint32_t size;
+  int line_buffered;
+  int ordered;
+  uvwasi_timestamp_t flush_interval;
+  struct uvwasi__stdio_buf_t bufs[2];
+};
+
+uvwasi_errno_t uvwasi__stdio_init(uvwasi_t* uvwasi,
+                                  const uvwasi_options_t* options);
+/* Flushes and frees the buffers. */
+void uvwasi__stdio_free(uvwasi_t* uvwasi);
+uvwasi_errno_t uvwasi__stdio_write(uvwasi_t* uvwasi,
+                                   struct uvwasi__stdio_buf_t* buf,
+                                   const uvwasi_ciovec_t* iovs,
+                                   uvwasi_size_t iovs_len,
+                                   uvwasi_size_t* nwritten);
+uvwasi_errno_t uvwasi__stdio_flush(uvwasi_t* uvwasi,
+                                   struct uvwasi__stdio_buf_t* buf);
+/* Flushes buf and points it at a new host fd, or at -1 before the fd is
+   closed. */
+uvwasi_errno_t uvwasi__stdio_retarget(uvwasi_t* uvwasi,
+                                      struct uvwasi__stdio_buf_t* buf,
+                                      uv_file fd);
+
+#endif /* __UVWASI_STDIO_BUFFER_H__ */
@@ -0,0 +1,385 @@
+#include <stdlib.h>
+
+#ifndef _WIN32
+# include <pthread.h>
+#endif /* _WIN32 */
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "uvwasi_alloc.h"
+#include "atomic_ops.h"
+#include "trace.h"
+
+#define UVWASI__CACHE_LINE 64
+
+
+/* Each thread that makes system calls on a traced sandbox gets its own ring,
+   so producers never contend with each other. head is only written by the
+   producing thread and tail only by the consumer holding the trace mutex. */
+struct uvwasi__trace_ring_t {
+  uint64_t head;
+  char pad0[UVWASI__CACHE_LINE - sizeof(uint64_t)];
+  uint64_t tail;
+  char pad1[UVWASI__CACHE_LINE - sizeof(uint64_t)];
+  struct uvwasi__trace_ring_t* next;
+  uvwasi_trace_event_t* events;
+  uint64_t mask;
+  uint32_t thread;
+  /* Links into the producing thread's list, guarded by owner->mutex. owner
+     is cleared, under uvwasi__trace_threads_mutex, when the thread exits. */
+  const struct uvwasi_trace_t* trace;
+  struct uvwasi__trace_thread_t* owner;
+  struct uvwasi__trace_ring_t* thread_prev;
+  struct uvwasi__trace_ring_t* thread_next;
+};
+
+/* The rings of one thread, one per traced sandbox it has made calls on, most
+   recently used first. A single process-wide key points each thread at its
+   list, so the number of traced sandboxes is not bounded by the number of
+   keys. The mutex is only contended while a sandbox is being destroyed or the
+   thread is exiting. libuv keys have no destructor, so the native ones are
+   used to free the list when its thread exits. */
+struct uvwasi__trace_thread_t {
+  uv_mutex_t mutex;
+  struct uvwasi__trace_ring_t* rings;
+};
+
+static uv_once_t uvwasi__trace_key_once = UV_ONCE_INIT;
+static int uvwasi__trace_key_ok = 0;
+/* Taken before an owner's mutex, by the cold paths that may race with the
+   owner's thread exiting. */
+static uv_mutex_t uvwasi__trace_threads_mutex;
+#if defined(_WIN32)
+static DWORD uvwasi__trace_key;
+#else
+static pthread_key_t uvwasi__trace_key;
+#endif /* defined(_WIN32) */
+
+
+#if defined(_WIN32)
+static void NTAPI uvwasi__trace_thread_exit(void* data) {
+#else
+static void uvwasi__trace_thread_exit(void* data) {
+#endif /* defined(_WIN32) */
+  struct uvwasi__trace_thread_t* owner;
+  struct uvwasi__trace_ring_t* ring;
+
+  owner = data;
+  if (owner == NULL)
+    return;
+
+  /* The rings belong to their sandboxes, which free them. */
+  uv_mutex_lock(&uvwasi__trace_threads_mutex);
+  uv_mutex_lock(&owner->mutex);
+  for (ring = owner->rings; ring != NULL; ring = ring->thread_next)
+    ring->owner = NULL;
+  uv_mutex_unlock(&owner->mutex);
+  uv_mutex_unlock(&uvwasi__trace_threads_mutex);
+
+  uv_mutex_destroy(&owner->mutex);
+  free(owner);
+}
+
+
+static void uvwasi__trace_key_init(void) {
+  if (uv_mutex_init(&uvwasi__trace_threads_mutex) != 0)
+    return;
+
+#if defined(_WIN32)
+  uvwasi__trace_key = FlsAlloc(uvwasi__trace_thread_exit);
+  uvwasi__trace_key_ok = uvwasi__trace_key != FLS_OUT_OF_INDEXES;
+#else
+  uvwasi__trace_key_ok =
+      pthread_key_create(&uvwasi__trace_key, uvwasi__trace_thread_exit) == 0;
+#endif /* defined(_WIN32) */
+}
+
+
+uvwasi_errno_t uvwasi__trace_init(uvwasi_t* uvwasi, uvwasi_size_t ring_size) {
+  struct uvwasi_trace_t* trace;
+  uvwasi_size_t size;
+
+  /* Rings are indexed with a mask, so round up to a power of two. */
+  size = 2;
+  while (size < ring_size) {
+    if (size > ((uvwasi_size_t) -1) / 2)
+      return UVWASI_EINVAL;
+    size <<= 1;
+  }
+
+  /* A ring and its events share one allocation, whose size must not wrap. */
+  if ((uint64_t) size * sizeof(uvwasi_trace_event_t) >
+      ((size_t) -1) - sizeof(struct uvwasi__trace_ring_t)) {
+    return UVWASI_EINVAL;
+  }
+
+  uv_once(&uvwasi__trace_key_once, uvwasi__trace_key_init);
+  if (!uvwasi__trace_key_ok)
+    return UVWASI_ENOMEM;
+
+  trace = uvwasi__calloc(uvwasi, 1, sizeof(*trace));
+  if (trace == NULL)
+    return UVWASI_ENOMEM;
+
+  trace->ring_size = size;
+
+  if (uv_mutex_init(&trace->mutex) != 0) {
+    uvwasi__free(uvwasi, trace);
+    return UVWASI_ENOMEM;
+  }
+
+  uvwasi->trace = trace;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__trace_thread_unlink(struct uvwasi__trace_ring_t* ring) {
+  if (ring->thread_prev != NULL)
+    ring->thread_prev->thread_next = ring->thread_next;
+  else
+    ring->owner->rings = ring->thread_next;
+
+  if (ring->thread_next != NULL)
+    ring->thread_next->thread_prev = ring->thread_prev;
+
+  ring->thread_prev = NULL;
+  ring->thread_next = NULL;
+}
+
+
+void uvwasi__trace_free(uvwasi_t* uvwasi) {
+  struct uvwasi__trace_ring_t* ring;
+  struct uvwasi__trace_ring_t* next;
+  struct uvwasi__trace_thread_t* owner;
+  struct uvwasi_trace_t* trace;
+
+  trace = uvwasi->trace;
+  if (trace == NULL)
+    return;
+
+  /* Take each ring out of its thread's list before freeing it, so that a
+     later sandbox at the same address never finds it. */
+  uv_mutex_lock(&uvwasi__trace_threads_mutex);
+  for (ring = trace->rings; ring != NULL; ring = next) {
+    next = ring->next;
+    owner = ring->owner;
+    if (owner != NULL) {
+      uv_mutex_lock(&owner->mutex);
+      uvwasi__trace_thread_unlink(ring);
+      uv_mutex_unlock(&owner->mutex);
+    }
+    uvwasi__free(uvwasi, ring);
+  }
+  uv_mutex_unlock(&uvwasi__trace_threads_mutex);
+
+  uv_mutex_destroy(&trace->mutex);
+  uvwasi__free(uvwasi, trace);
+  uvwasi->trace = NULL;
+}
+
+
+static struct uvwasi__trace_thread_t* uvwasi__trace_thread_get(void) {
+  struct uvwasi__trace_thread_t* owner;
+
+#if defined(_WIN32)
+  owner = FlsGetValue(uvwasi__trace_key);
+#else
+  owner = pthread_getspecific(uvwasi__trace_key);
+#endif /* defined(_WIN32) */
+  if (owner != NULL)
+    return owner;
+
+  /* This outlives any one sandbox, so it is not charged to one. */
+  owner = calloc(1, sizeof(*owner));
+  if (owner == NULL)
+    return NULL;
+
+  if (uv_mutex_init(&owner->mutex) != 0) {
+    free(owner);
+    return NULL;
+  }
+
+#if defined(_WIN32)
+  if (!FlsSetValue(uvwasi__trace_key, owner)) {
+#else
+  if (pthread_setspecific(uvwasi__trace_key, owner) != 0) {
+#endif /* defined(_WIN32) */
+    uv_mutex_destroy(&owner->mutex);
+    free(owner);
+    return NULL;
+  }
+
+  return owner;
+}
+
+
+static struct uvwasi__trace_ring_t* uvwasi__trace_thread_ring(
+    const uvwasi_t* uvwasi) {
+  struct uvwasi__trace_ring_t* ring;
+  struct uvwasi__trace_thread_t* owner;
+  struct uvwasi_trace_t* trace;
+
+  trace = uvwasi->trace;
+  owner = uvwasi__trace_thread_get();
+  if (owner == NULL)
+    return NULL;
+
+  uv_mutex_lock(&owner->mutex);
+  for (ring = owner->rings; ring != NULL; ring = ring->thread_next) {
+    if (ring->trace == trace)
+      break;
+  }
+
+  if (ring != NULL) {
+    /* Move to the front, so the sandbox a thread is serving is found first. */
+    if (ring != owner->rings) {
+      uvwasi__trace_thread_unlink(ring);
+      goto link;
+    }
+
+    uv_mutex_unlock(&owner->mutex);
+    return ring;
+  }
+
+  /* The ring and its events share one allocation. */
+  ring = uvwasi__calloc(uvwasi,
+                        1,
+                        sizeof(*ring) +
+                          trace->ring_size * sizeof(uvwasi_trace_event_t));
+  if (ring == NULL) {
+    uv_mutex_unlock(&owner->mutex);
+    return NULL;
+  }
+
+  ring->events = (uvwasi_trace_event_t*) (ring + 1);
+  ring->mask = trace->ring_size - 1;
+  ring->trace = trace;
+  ring->owner = owner;
+
+  uv_mutex_lock(&trace->mutex);
+  ring->thread = trace->nthreads++;
+  ring->next = trace->rings;
+  trace->rings = ring;
+  uv_mutex_unlock(&trace->mutex);
+
+link:
+  ring->thread_next = owner->rings;
+  if (owner->rings != NULL)
+    owner->rings->thread_prev = ring;
+  owner->rings = ring;
+  uv_mutex_unlock(&owner->mutex);
+  return ring;
+}
+
+
+void uvwasi__trace_record(const uvwasi_t* uvwasi,
+                          uvwasi_syscall_t syscall,
+                          uvwasi_errno_t err,
+                          uvwasi_fd_t fd,
+                          uint64_t arg,
+                          uint64_t result,
+                          uint64_t start_ns,
+                          uint64_t end_ns) {
+  struct uvwasi__trace_ring_t* ring;
+  uvwasi_trace_event_t* event;
+  uint64_t head;
+  uint64_t tail;
+
+  ring = uvwasi__trace_thread_ring(uvwasi);
+  if (ring == NULL) {
+    uvwasi__atomic_add_u64(&uvwasi->trace->dropped, 1);
+    return;
+  }
+
+  head = ring->head;
+  tail = uvwasi__atomic_load_acquire_u64(&ring->tail);
+  if (head - tail > ring->mask) {
+    uvwasi__atomic_add_u64(&uvwasi->trace->dropped, 1);
+    return;
+  }
+
+  event = &ring->events[head & ring->mask];
+  event->start_ns = start_ns;
+  event->end_ns = end_ns;
+  event->arg = arg;
+  event->result = result;
+  event->fd = fd;
+  event->thread = ring->thread;
+  event->syscall = (uint16_t) syscall;
+  event->error = err;
+  event->reserved = 0;
+  uvwasi__atomic_store_release_u64(&ring->head, head + 1);
+}
+
+
+uvwasi_errno_t uvwasi_trace_enable(uvwasi_t* uvwasi) {
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->trace == NULL)
+    return UVWASI_ENOTSUP;
+
+  uvwasi__atomic_store_u32(&uvwasi->trace->enabled, 1);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_trace_disable(uvwasi_t* uvwasi) {
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->trace == NULL)
+    return UVWASI_ENOTSUP;
+
+  uvwasi__atomic_store_u32(&uvwasi->trace->enabled, 0);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_trace_drain(uvwasi_t* uvwasi,
+                                  uvwasi_trace_event_t* events,
+                                  uvwasi_size_t nevents,
+                                  uvwasi_size_t* ndrained) {
+  struct uvwasi__trace_ring_t* ring;
+  struct uvwasi_trace_t* trace;
+  uvwasi_size_t n;
+  uint64_t head;
+  uint64_t tail;
+
+  if (uvwasi == NULL || (events == NULL && nevents > 0) || ndrained == NULL)
+    return UVWASI_EINVAL;
+
+  trace = uvwasi->trace;
+  if (trace == NULL)
+    return UVWASI_ENOTSUP;
+
+  /* Events are returned grouped by thread and in order within a thread. */
+  n = 0;
+  uv_mutex_lock(&trace->mutex);
+
+  for (ring = trace->rings; ring != NULL && n < nevents; ring = ring->next) {
+    tail = ring->tail;
+    head = uvwasi__atomic_load_acquire_u64(&ring->head);
+
+    while (tail != head && n < nevents)
+      events[n++] = ring->events[tail++ & ring->mask];
+
+    uvwasi__atomic_store_release_u64(&ring->tail, tail);
+  }
+
+  uv_mutex_unlock(&trace->mutex);
+  *ndrained = n;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_trace_dropped(const uvwasi_t* uvwasi, uint64_t* dropped) {
+  if (uvwasi == NULL || dropped == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->trace == NULL)
+    return UVWASI_ENOTSUP;
+
+  *dropped = uvwasi__atomic_load_u64(&uvwasi->trace->dropped);
+  return UVWASI_ESUCCESS;
+}
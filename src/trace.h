@@ -0,0 +1,35 @@
+#ifndef __UVWASI_TRACE_H__
+#define __UVWASI_TRACE_H__
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "atomic_ops.h"
+
+struct uvwasi__trace_ring_t;
+
+struct uvwasi_trace_t {
+  uint32_t enabled;
+  uint32_t nthreads;
+  uint64_t dropped;
+  uvwasi_size_t ring_size;
+  /* Guards the ring list and serializes consumers. Producers only take it the
+     first time a thread records an event. */
+  uv_mutex_t mutex;
+  struct uvwasi__trace_ring_t* rings;
+};
+
+#define uvwasi__trace_is_enabled(trace)                                       \
+  ((trace) != NULL && uvwasi__atomic_load_u32(&(trace)->enabled) != 0)
+
+uvwasi_errno_t uvwasi__trace_init(uvwasi_t* uvwasi, uvwasi_size_t ring_size);
+void uvwasi__trace_free(uvwasi_t* uvwasi);
+void uvwasi__trace_record(const uvwasi_t* uvwasi,
+                          uvwasi_syscall_t syscall,
+                          uvwasi_errno_t err,
+                          uvwasi_fd_t fd,
+                          uint64_t arg,
+                          uint64_t result,
+                          uint64_t start_ns,
+                          uint64_t end_ns);
+
+#endif /* __UVWASI_TRACE_H__ */
@@ -1,3 +1,4 @@
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -13,8 +14,19 @@
 # include <io.h>
 #endif /* _WIN32 */
 
+#if defined(__linux__)
+# include <errno.h>
+# include <sys/sendfile.h>
+# include <sys/syscall.h>
+#endif /* defined(__linux__) */
+
 #define UVWASI__READDIR_NUM_ENTRIES 1
 
+/* Largest chunk handed to the kernel, and the size of the bounce buffer used
+   when the kernel cannot copy between two fds itself. */
+#define UVWASI__FD_COPY_MAX_CHUNK (1 << 30)
+#define UVWASI__FD_COPY_BUFFER_SIZE (64 * 1024)
+
 #if !defined(_WIN32)
 # define UVWASI_FD_READDIR_SUPPORTED 1
 #endif
@@ -28,9 +40,20 @@
 #include "uv.h"
 #include "uv_mapping.h"
 #include "fd_table.h"
+#include "filestat.h"
+#include "fd_mmap.h"
+#include "file_cache.h"
+#include "stdio_buffer.h"
+#include "vfs.h"
 #include "clocks.h"
 #include "path_resolver.h"
 #include "poll_oneoff.h"
+#include "probes.h"
+#include "random.h"
+#include "stats.h"
+#include "trace.h"
+#include "record.h"
+#include "atomic_ops.h"
 #include "sync_helpers.h"
 #include "wasi_rights.h"
 #include "wasi_serdes.h"
@@ -132,30 +155,153 @@ static void* default_realloc(void* ptr, size_t size, void* mem_user_data) {
   return realloc(ptr, size);
 }
 
+/* With memory accounting enabled, every allocation is preceded by a header
+   that records its size, so that frees and reallocations can be accounted
+   for. The union keeps the memory after the header suitably aligned. */
+struct uvwasi_mem_account_t {
+  uvwasi_mem_stats_t stats;
+  uint64_t limit;
+};
+
+typedef union uvwasi__mem_header_u {
+  size_t size;
+  long double align_ld;
+  uint64_t align_u64;
+  void* align_ptr;
+} uvwasi__mem_header_t;
+
+static int uvwasi__mem_reserve(struct uvwasi_mem_account_t* mem,
+                               size_t size) {
+  uint64_t current;
+  uint64_t next;
+  uint64_t peak;
+
+  current = uvwasi__atomic_load_u64(&mem->stats.current_bytes);
+  do {
+    next = current + size;
+    if (mem->limit != 0 && next > mem->limit) {
+      uvwasi__atomic_add_u64(&mem->stats.failures, 1);
+      return 0;
+    }
+  } while (!uvwasi__atomic_cas_u64(&mem->stats.current_bytes, &current, next));
+
+  peak = uvwasi__atomic_load_u64(&mem->stats.peak_bytes);
+  while (next > peak) {
+    if (uvwasi__atomic_cas_u64(&mem->stats.peak_bytes, &peak, next))
+      break;
+  }
+
+  return 1;
+}
+
+/* Completes an allocation reserved with uvwasi__mem_reserve(), or returns the
+   reservation if the allocator failed. */
+static void* uvwasi__mem_commit(struct uvwasi_mem_account_t* mem,
+                                uvwasi__mem_header_t* header,
+                                size_t size) {
+  if (header == NULL) {
+    uvwasi__atomic_sub_u64(&mem->stats.current_bytes, size);
+    return NULL;
+  }
+
+  uvwasi__atomic_add_u64(&mem->stats.allocations, 1);
+  uvwasi__atomic_add_u64(&mem->stats.live_allocations, 1);
+  header->size = size;
+  return header + 1;
+}
+
 void* uvwasi__malloc(const uvwasi_t* uvwasi, size_t size) {
-  return uvwasi->allocator->malloc(size, uvwasi->allocator->mem_user_data);
+  uvwasi__mem_header_t* header;
+  const uvwasi_mem_t* a;
+
+  a = uvwasi->allocator;
+  if (uvwasi->mem_account == NULL)
+    return a->malloc(size, a->mem_user_data);
+
+  if (size > (size_t) -1 - sizeof(*header) ||
+      !uvwasi__mem_reserve(uvwasi->mem_account, size)) {
+    return NULL;
+  }
+
+  header = a->malloc(sizeof(*header) + size, a->mem_user_data);
+  return uvwasi__mem_commit(uvwasi->mem_account, header, size);
 }
 
 void uvwasi__free(const uvwasi_t* uvwasi, void* ptr) {
+  uvwasi__mem_header_t* header;
+  struct uvwasi_mem_account_t* mem;
+
   if (ptr == NULL)
     return;
 
+  mem = uvwasi->mem_account;
+  if (mem != NULL) {
+    header = (uvwasi__mem_header_t*) ptr - 1;
+    uvwasi__atomic_sub_u64(&mem->stats.current_bytes, header->size);
+    uvwasi__atomic_sub_u64(&mem->stats.live_allocations, 1);
+    ptr = header;
+  }
+
   uvwasi->allocator->free(ptr, uvwasi->allocator->mem_user_data);
 }
 
 void* uvwasi__calloc(const uvwasi_t* uvwasi, size_t nmemb, size_t size) {
-  return uvwasi->allocator->calloc(nmemb,
-                                   size,
-                                   uvwasi->allocator->mem_user_data);
+  uvwasi__mem_header_t* header;
+  const uvwasi_mem_t* a;
+  size_t total;
+
+  a = uvwasi->allocator;
+  if (uvwasi->mem_account == NULL)
+    return a->calloc(nmemb, size, a->mem_user_data);
+
+  if (size != 0 && nmemb > ((size_t) -1 - sizeof(*header)) / size)
+    return NULL;
+
+  total = nmemb * size;
+  if (!uvwasi__mem_reserve(uvwasi->mem_account, total))
+    return NULL;
+
+  header = a->calloc(1, sizeof(*header) + total, a->mem_user_data);
+  return uvwasi__mem_commit(uvwasi->mem_account, header, total);
 }
 
 void* uvwasi__realloc(const uvwasi_t* uvwasi, void* ptr, size_t size) {
-  return uvwasi->allocator->realloc(ptr,
-                                    size,
-                                    uvwasi->allocator->mem_user_data);
+  uvwasi__mem_header_t* header;
+  struct uvwasi_mem_account_t* mem;
+  const uvwasi_mem_t* a;
+  size_t old_size;
+
+  a = uvwasi->allocator;
+  mem = uvwasi->mem_account;
+  if (mem == NULL)
+    return a->realloc(ptr, size, a->mem_user_data);
+
+  if (ptr == NULL)
+    return uvwasi__malloc(uvwasi, size);
+
+  if (size > (size_t) -1 - sizeof(*header))
+    return NULL;
+
+  header = (uvwasi__mem_header_t*) ptr - 1;
+  old_size = header->size;
+  if (size > old_size && !uvwasi__mem_reserve(mem, size - old_size))
+    return NULL;
+
+  header = a->realloc(header, sizeof(*header) + size, a->mem_user_data);
+  if (header == NULL) {
+    if (size > old_size)
+      uvwasi__atomic_sub_u64(&mem->stats.current_bytes, size - old_size);
+    return NULL;
+  }
+
+  if (size < old_size)
+    uvwasi__atomic_sub_u64(&mem->stats.current_bytes, old_size - size);
+
+  header->size = size;
+  return header + 1;
 }
 
-static const uvwasi_mem_t default_allocator = {
+const uvwasi_mem_t uvwasi__default_allocator = {
   NULL,
   default_malloc,
   default_free,
@@ -198,6 +344,91 @@ static uvwasi_errno_t uvwasi__lseek(uv_file fd,
 }
 
 
+/* Writes out any output buffered for wrap. The caller holds the fd's mutex. */
+static uvwasi_errno_t uvwasi__fd_flush_output(uvwasi_t* uvwasi,
+                                              struct uvwasi_fd_wrap_t* wrap) {
+  if (wrap->cold->out_buf == NULL)
+    return UVWASI_ESUCCESS;
+
+  return uvwasi__stdio_flush(uvwasi, wrap->cold->out_buf);
+}
+
+
+/* Moves the host file position to where reads that bypass the host left it.
+   The caller holds the fd's mutex. */
+static uvwasi_errno_t uvwasi__fd_pos_sync(struct uvwasi_fd_wrap_t* wrap) {
+  uvwasi_filesize_t newoffset;
+
+  if (!wrap->cold->pos_valid)
+    return UVWASI_ESUCCESS;
+
+  wrap->cold->pos_valid = 0;
+  return uvwasi__lseek(wrap->fd,
+                       (uvwasi_filedelta_t) wrap->cold->pos,
+                       UVWASI_WHENCE_SET,
+                       &newoffset);
+}
+
+
+/* Reads from the shared file cache or a memory mapping, if the fd has either.
+   offset is -1 to read at, and advance, the file position. Returns
+   UVWASI_ENOTSUP if the file has to be read from the host. The caller holds
+   the fd's mutex. */
+static uvwasi_errno_t uvwasi__fd_read_fast(const uvwasi_t* uvwasi,
+                                           struct uvwasi_fd_wrap_t* wrap,
+                                           const uvwasi_iovec_t* iovs,
+                                           uvwasi_size_t iovs_len,
+                                           int64_t offset,
+                                           uvwasi_size_t* nread) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_errno_t err;
+  uint64_t pos;
+
+  cold = wrap->cold;
+  if (cold->cache_entry == NULL && !cold->map_enabled)
+    return UVWASI_ENOTSUP;
+
+  if (offset >= 0) {
+    pos = (uint64_t) offset;
+  } else {
+    if (!cold->pos_valid) {
+      err = uvwasi__lseek(wrap->fd, 0, UVWASI_WHENCE_CUR, &cold->pos);
+      if (err != UVWASI_ESUCCESS)
+        return err;
+
+      cold->pos_valid = 1;
+    }
+
+    pos = cold->pos;
+  }
+
+  if (cold->cache_entry != NULL) {
+    err = uvwasi__file_cache_read(cold->cache_entry,
+                                  iovs,
+                                  iovs_len,
+                                  pos,
+                                  nread);
+  } else {
+    err = uvwasi__fd_mmap_read(uvwasi, wrap, iovs, iovs_len, pos, nread);
+  }
+
+  if (err == UVWASI_ENOTSUP) {
+    if (offset < 0) {
+      err = uvwasi__fd_pos_sync(wrap);
+      if (err == UVWASI_ESUCCESS)
+        err = UVWASI_ENOTSUP;
+    }
+
+    return err;
+  }
+
+  if (err == UVWASI_ESUCCESS && offset < 0)
+    cold->pos += *nread;
+
+  return err;
+}
+
+
 static uvwasi_errno_t uvwasi__setup_iovs(const uvwasi_t* uvwasi,
                                          uv_buf_t** buffers,
                                          const uvwasi_iovec_t* iovs,
@@ -241,6 +472,62 @@ static uvwasi_errno_t uvwasi__setup_ciovs(const uvwasi_t* uvwasi,
   return UVWASI_ESUCCESS;
 }
 
+/* Statistics, tracing and recording all need the call's start time. When
+   none of them is active, the clock is not read and start is zero. */
+static uint64_t uvwasi__syscall_enter(const uvwasi_t* uvwasi,
+                                     uvwasi_syscall_t syscall) {
+  UVWASI__PROBE_SYSCALL_ENTRY(uvwasi, syscall);
+
+  if (uvwasi == NULL ||
+      (uvwasi->stats == NULL &&
+       !uvwasi__trace_is_enabled(uvwasi->trace) &&
+       !uvwasi__record_is_enabled(uvwasi->record))) {
+    return 0;
+  }
+
+  return uv_hrtime();
+}
+
+
+/* The arguments after fmt describe the call for the recording, as documented
+   for uvwasi__record_syscall(). */
+static uvwasi_errno_t uvwasi__syscall_exit(uvwasi_t* uvwasi,
+                                           uvwasi_syscall_t syscall,
+                                           uint64_t start,
+                                           uvwasi_errno_t err,
+                                           uvwasi_fd_t fd,
+                                           uint64_t arg,
+                                           uint64_t result,
+                                           const char* fmt,
+                                           ...) {
+  va_list ap;
+  uint64_t end;
+
+  UVWASI__PROBE_SYSCALL_RETURN(uvwasi, syscall, err, fd, arg, result);
+
+  /* A recording may have started while the call was running, in which case
+     start is zero but the call is still recorded. */
+  if (uvwasi != NULL && uvwasi__record_is_enabled(uvwasi->record)) {
+    va_start(ap, fmt);
+    uvwasi__record_syscall(uvwasi, syscall, start, err, result, fmt, ap);
+    va_end(ap);
+  }
+
+  if (start == 0)
+    return err;
+
+  end = uv_hrtime();
+
+  if (uvwasi->stats != NULL)
+    uvwasi__stats_record(uvwasi->stats, syscall, err, result, end - start);
+
+  if (uvwasi__trace_is_enabled(uvwasi->trace))
+    uvwasi__trace_record(uvwasi, syscall, err, fd, arg, result, start, end);
+
+  return err;
+}
+
+
 typedef struct new_connection_data_s {
   int done;
 } new_connection_data_t;
@@ -249,21 +536,19 @@ void on_new_connection(uv_stream_t *server, int status) {
   // just do nothing
 }
 
-uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
-  uv_fs_t realpath_req;
-  uv_fs_t open_req;
-  uvwasi_errno_t err;
-  uvwasi_size_t args_size;
-  uvwasi_size_t size;
-  uvwasi_size_t offset;
-  uvwasi_size_t env_count;
-  uvwasi_size_t env_buf_size;
-  uvwasi_size_t i;
-  int r;
-  struct sockaddr_in addr;
+/* argv and env, and the strings they point to, are kept in one allocation
+   after this header so that clones can share them. It comes straight from
+   the allocator, as it may outlive the instance that created it, and so is
+   neither counted in mem stats nor held to mem_limit. */
+struct uvwasi_args_t {
+  uint64_t refs;
+};
 
-  if (uvwasi == NULL || options == NULL || options->fd_table_size == 0)
-    return UVWASI_EINVAL;
+
+/* Sets up everything that does not depend on the args, env or preopens. */
+static uvwasi_errno_t uvwasi__init_common(uvwasi_t* uvwasi,
+                                          const uvwasi_options_t* options) {
+  uvwasi_errno_t err;
 
   // loop is only needed if there were pre-open sockets
   uvwasi->loop = NULL;
@@ -271,43 +556,96 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
   uvwasi->allocator = options->allocator;
 
   if (uvwasi->allocator == NULL)
-    uvwasi->allocator = &default_allocator;
-
+    uvwasi->allocator = &uvwasi__default_allocator;
+
+  uvwasi->mem_account = NULL;
+  uvwasi->clock = NULL;
+  uvwasi->rng = NULL;
+  uvwasi->stats = NULL;
+  uvwasi->trace = NULL;
+  uvwasi->record = NULL;
+  uvwasi->filestat_dont_sync = options->filestat_dont_sync;
+  uvwasi->filestat_cache_ttl = options->filestat_cache_ttl;
+  uvwasi->mmap_window_size = options->mmap_window_size;
+  uvwasi->file_cache = options->file_cache;
+  uvwasi->stdio = NULL;
+
+  uvwasi->argc = 0;
+  uvwasi->argv_buf_size = 0;
+  uvwasi->envc = 0;
+  uvwasi->env_buf_size = 0;
   uvwasi->argv_buf = NULL;
   uvwasi->argv = NULL;
   uvwasi->env_buf = NULL;
   uvwasi->env = NULL;
+  uvwasi->args = NULL;
   uvwasi->fds = NULL;
 
-  args_size = 0;
-  for (i = 0; i < options->argc; ++i)
-    args_size += strlen(options->argv[i]) + 1;
+  /* Accounting has to be set up before anything is allocated. The account
+     itself comes straight from the allocator. */
+  if (options->enable_mem_stats || options->mem_limit != 0) {
+    uvwasi->mem_account =
+      uvwasi->allocator->calloc(1,
+                                sizeof(*uvwasi->mem_account),
+                                uvwasi->allocator->mem_user_data);
+    if (uvwasi->mem_account == NULL)
+      return UVWASI_ENOMEM;
 
-  uvwasi->argc = options->argc;
-  uvwasi->argv_buf_size = args_size;
+    uvwasi->mem_account->limit = options->mem_limit;
+  }
 
-  if (args_size > 0) {
-    uvwasi->argv_buf = uvwasi__malloc(uvwasi, args_size);
-    if (uvwasi->argv_buf == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
+  uvwasi__clocks_init(uvwasi);
 
-    uvwasi->argv = uvwasi__calloc(uvwasi, options->argc, sizeof(char*));
-    if (uvwasi->argv == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
+  if (options->clock != NULL) {
+    if (options->clock->gettime == NULL)
+      return UVWASI_EINVAL;
 
-    offset = 0;
-    for (i = 0; i < options->argc; ++i) {
-      size = strlen(options->argv[i]) + 1;
-      memcpy(uvwasi->argv_buf + offset, options->argv[i], size);
-      uvwasi->argv[i] = uvwasi->argv_buf + offset;
-      offset += size;
-    }
+    uvwasi->clock = options->clock;
+  }
+
+  if (options->enable_stats) {
+    err = uvwasi__stats_init(uvwasi);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  }
+
+  if (options->trace_buffer_size > 0) {
+    err = uvwasi__trace_init(uvwasi, options->trace_buffer_size);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  }
+
+  if (options->enable_record) {
+    err = uvwasi__record_init(uvwasi);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  }
+
+  if (options->random_buffer_size > 0) {
+    err = uvwasi__rng_init(uvwasi, &uvwasi->rng, options->random_buffer_size);
+    if (err != UVWASI_ESUCCESS)
+      return err;
   }
 
+  return UVWASI_ESUCCESS;
+}
+
+
+static uvwasi_errno_t uvwasi__args_init(uvwasi_t* uvwasi,
+                                        const uvwasi_options_t* options) {
+  struct uvwasi_args_t* args;
+  uvwasi_size_t args_size;
+  uvwasi_size_t env_count;
+  uvwasi_size_t env_buf_size;
+  uvwasi_size_t size;
+  uvwasi_size_t i;
+  char** ptrs;
+  char* buf;
+
+  args_size = 0;
+  for (i = 0; i < options->argc; ++i)
+    args_size += strlen(options->argv[i]) + 1;
+
   env_count = 0;
   env_buf_size = 0;
   if (options->envp != NULL) {
@@ -317,31 +655,118 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
     }
   }
 
+  uvwasi->argc = options->argc;
+  uvwasi->argv_buf_size = args_size;
   uvwasi->envc = env_count;
   uvwasi->env_buf_size = env_buf_size;
 
-  if (env_buf_size > 0) {
-    uvwasi->env_buf = uvwasi__malloc(uvwasi, env_buf_size);
-    if (uvwasi->env_buf == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
+  if (args_size == 0 && env_buf_size == 0)
+    return UVWASI_ESUCCESS;
 
-    uvwasi->env = uvwasi__calloc(uvwasi, env_count, sizeof(char*));
-    if (uvwasi->env == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
+  args = uvwasi->allocator->malloc(sizeof(*args) +
+                                   (options->argc + env_count) *
+                                       sizeof(char*) +
+                                   args_size +
+                                   env_buf_size,
+                                   uvwasi->allocator->mem_user_data);
+  if (args == NULL)
+    return UVWASI_ENOMEM;
+
+  args->refs = 1;
+  uvwasi->args = args;
+  ptrs = (char**) (args + 1);
+  buf = (char*) (ptrs + options->argc + env_count);
+
+  if (args_size > 0) {
+    uvwasi->argv = ptrs;
+    uvwasi->argv_buf = buf;
+    for (i = 0; i < options->argc; ++i) {
+      size = strlen(options->argv[i]) + 1;
+      memcpy(buf, options->argv[i], size);
+      uvwasi->argv[i] = buf;
+      buf += size;
     }
+  }
 
-    offset = 0;
+  if (env_buf_size > 0) {
+    uvwasi->env = ptrs + options->argc;
+    uvwasi->env_buf = buf;
     for (i = 0; i < env_count; ++i) {
       size = strlen(options->envp[i]) + 1;
-      memcpy(uvwasi->env_buf + offset, options->envp[i], size);
-      uvwasi->env[i] = uvwasi->env_buf + offset;
-      offset += size;
+      memcpy(buf, options->envp[i], size);
+      uvwasi->env[i] = buf;
+      buf += size;
     }
   }
 
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__args_release(uvwasi_t* uvwasi) {
+  struct uvwasi_args_t* args;
+
+  args = uvwasi->args;
+  if (args == NULL)
+    return;
+
+  if (uvwasi__atomic_sub_fetch_acq_rel_u64(&args->refs, 1) == 0)
+    uvwasi->allocator->free(args, uvwasi->allocator->mem_user_data);
+
+  uvwasi->args = NULL;
+}
+
+
+static uvwasi_errno_t uvwasi__preopen_host(uvwasi_t* uvwasi,
+                                           const uvwasi_preopen_t* preopen,
+                                           int immutable) {
+  uv_fs_t realpath_req;
+  uv_fs_t open_req;
+  uvwasi_errno_t err;
+  int r;
+
+  r = uv_fs_realpath(NULL, &realpath_req, preopen->real_path, NULL);
+  if (r != 0) {
+    uv_fs_req_cleanup(&realpath_req);
+    return uvwasi__translate_uv_error(r);
+  }
+
+  r = uv_fs_open(NULL, &open_req, realpath_req.ptr, 0, 0666, NULL);
+  if (r < 0) {
+    uv_fs_req_cleanup(&realpath_req);
+    uv_fs_req_cleanup(&open_req);
+    return uvwasi__translate_uv_error(r);
+  }
+
+  err = uvwasi_fd_table_insert_preopen(uvwasi,
+                                       uvwasi->fds,
+                                       open_req.result,
+                                       preopen->mapped_path,
+                                       realpath_req.ptr,
+                                       immutable);
+  uv_fs_req_cleanup(&realpath_req);
+  uv_fs_req_cleanup(&open_req);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
+  uvwasi_errno_t err;
+  uvwasi_size_t i;
+  int r;
+  struct sockaddr_in addr;
+
+  if (uvwasi == NULL || options == NULL || options->fd_table_size == 0)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__init_common(uvwasi, options);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  err = uvwasi__args_init(uvwasi, options);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
   for (i = 0; i < options->preopenc; ++i) {
     if (options->preopens[i].real_path == NULL ||
         options->preopens[i].mapped_path == NULL) {
@@ -350,6 +775,22 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
     }
   }
 
+  for (i = 0; i < options->immutable_preopenc; ++i) {
+    if (options->immutable_preopens[i].real_path == NULL ||
+        options->immutable_preopens[i].mapped_path == NULL) {
+      err = UVWASI_EINVAL;
+      goto exit;
+    }
+  }
+
+  for (i = 0; i < options->preopen_vfsc; ++i) {
+    if (options->preopen_vfs[i].vfs == NULL ||
+        options->preopen_vfs[i].mapped_path == NULL) {
+      err = UVWASI_EINVAL;
+      goto exit;
+    }
+  }
+
   for (i = 0; i < options->preopen_socketc; ++i) {
     if (options->preopen_sockets[i].address == NULL ||
         options->preopen_sockets[i].port > 65535) {
@@ -362,33 +803,29 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
+  err = uvwasi__stdio_init(uvwasi, options);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
   for (i = 0; i < options->preopenc; ++i) {
-    r = uv_fs_realpath(NULL,
-                       &realpath_req,
-                       options->preopens[i].real_path,
-                       NULL);
-    if (r != 0) {
-      err = uvwasi__translate_uv_error(r);
-      uv_fs_req_cleanup(&realpath_req);
+    err = uvwasi__preopen_host(uvwasi, &options->preopens[i], 0);
+    if (err != UVWASI_ESUCCESS)
       goto exit;
-    }
+  }
 
-    r = uv_fs_open(NULL, &open_req, realpath_req.ptr, 0, 0666, NULL);
-    if (r < 0) {
-      err = uvwasi__translate_uv_error(r);
-      uv_fs_req_cleanup(&realpath_req);
-      uv_fs_req_cleanup(&open_req);
+  for (i = 0; i < options->immutable_preopenc; ++i) {
+    err = uvwasi__preopen_host(uvwasi, &options->immutable_preopens[i], 1);
+    if (err != UVWASI_ESUCCESS)
       goto exit;
-    }
-
-    err = uvwasi_fd_table_insert_preopen(uvwasi,
-                                         uvwasi->fds,
-                                         open_req.result,
-                                         options->preopens[i].mapped_path,
-                                         realpath_req.ptr);
-    uv_fs_req_cleanup(&realpath_req);
-    uv_fs_req_cleanup(&open_req);
+  }
 
+  for (i = 0; i < options->preopen_vfsc; ++i) {
+    err = uvwasi_fd_table_insert_preopen_vfs(
+                                          uvwasi,
+                                          uvwasi->fds,
+                                          options->preopen_vfs[i].mapped_path,
+                                          options->preopen_vfs[i].vfs,
+                                          options->preopen_vfs[i].immutable);
     if (err != UVWASI_ESUCCESS)
       goto exit;
   }
@@ -407,7 +844,12 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, const uvwasi_options_t* options) {
   }
 
   for (i = 0; i < options->preopen_socketc; ++i) {
-    uv_tcp_t* socket = (uv_tcp_t*) malloc(sizeof(uv_tcp_t));
+    uv_tcp_t* socket = (uv_tcp_t*) uvwasi__malloc(uvwasi, sizeof(uv_tcp_t));
+    if (socket == NULL) {
+      err = UVWASI_ENOMEM;
+      goto exit;
+    }
+
     uv_tcp_init(uvwasi->loop, socket);
 
     uv_ip4_addr(options->preopen_sockets[i].address, options->preopen_sockets[i].port, &addr);
@@ -439,11 +881,13 @@ void uvwasi_destroy(uvwasi_t* uvwasi) {
   if (uvwasi == NULL)
     return;
 
+  uvwasi__record_free(uvwasi);
+  uvwasi__stdio_free(uvwasi);
   uvwasi_fd_table_free(uvwasi, uvwasi->fds);
-  uvwasi__free(uvwasi, uvwasi->argv_buf);
-  uvwasi__free(uvwasi, uvwasi->argv);
-  uvwasi__free(uvwasi, uvwasi->env_buf);
-  uvwasi__free(uvwasi, uvwasi->env);
+  uvwasi__args_release(uvwasi);
+  uvwasi__rng_free(uvwasi, uvwasi->rng);
+  uvwasi__stats_free(uvwasi);
+  uvwasi__trace_free(uvwasi);
   if (uvwasi->loop != NULL) {
     uv_stop(uvwasi->loop);
     uv_loop_close(uvwasi->loop);
@@ -455,15 +899,102 @@ void uvwasi_destroy(uvwasi_t* uvwasi) {
   uvwasi->argv = NULL;
   uvwasi->env_buf = NULL;
   uvwasi->env = NULL;
+  uvwasi->rng = NULL;
+
+  /* Everything else has been freed, so the account can go too. */
+  if (uvwasi->mem_account != NULL) {
+    uvwasi->allocator->free(uvwasi->mem_account,
+                            uvwasi->allocator->mem_user_data);
+    uvwasi->mem_account = NULL;
+  }
 }
 
 
-void uvwasi_options_init(uvwasi_options_t* options) {
-  if (options == NULL)
-    return;
+/* Recovers the options that src was initialized with, other than its args,
+   env and preopens, which clones take from src itself. */
+static void uvwasi__clone_options(const uvwasi_t* src,
+                                  uvwasi_options_t* options) {
+  uvwasi_options_init(options);
+  options->fd_table_size = src->fds->size;
+  options->allocator = src->allocator;
+  options->clock = src->clock;
+  if (src->rng != NULL)
+    options->random_buffer_size = uvwasi__rng_buffer_size(src->rng);
+  options->enable_stats = src->stats != NULL;
+  if (src->trace != NULL)
+    options->trace_buffer_size = src->trace->ring_size;
+  options->enable_record = src->record != NULL;
+  options->enable_lock_stats = src->fds->lock_stats != NULL;
+  if (src->mem_account != NULL) {
+    options->enable_mem_stats = 1;
+    options->mem_limit = src->mem_account->limit;
+  }
 
-  options->in = 0;
-  options->out = 1;
+  options->filestat_dont_sync = src->filestat_dont_sync;
+  options->filestat_cache_ttl = src->filestat_cache_ttl;
+  options->mmap_window_size = src->mmap_window_size;
+  options->file_cache = src->file_cache;
+  if (src->stdio != NULL) {
+    options->stdio_buffer_size = src->stdio->size;
+    options->stdio_line_buffered = src->stdio->line_buffered;
+    options->stdio_ordered = src->stdio->ordered;
+    options->stdio_flush_interval = src->stdio->flush_interval;
+  }
+}
+
+
+uvwasi_errno_t uvwasi_clone(uvwasi_t* dst, const uvwasi_t* src) {
+  uvwasi_options_t options;
+  uvwasi_errno_t err;
+
+  if (dst == NULL || src == NULL || src->fds == NULL)
+    return UVWASI_EINVAL;
+
+  /* Listening sockets cannot be shared between sandboxes. */
+  if (src->loop != NULL)
+    return UVWASI_ENOTSUP;
+
+  uvwasi__clone_options(src, &options);
+  err = uvwasi__init_common(dst, &options);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  if (src->args != NULL) {
+    uvwasi__atomic_add_u64(&src->args->refs, 1);
+    dst->args = src->args;
+  }
+
+  dst->argc = src->argc;
+  dst->argv = src->argv;
+  dst->argv_buf = src->argv_buf;
+  dst->argv_buf_size = src->argv_buf_size;
+  dst->envc = src->envc;
+  dst->env = src->env;
+  dst->env_buf = src->env_buf;
+  dst->env_buf_size = src->env_buf_size;
+
+  err = uvwasi_fd_table_clone(dst, src->fds);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  err = uvwasi__stdio_init(dst, &options);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  return UVWASI_ESUCCESS;
+
+exit:
+  uvwasi_destroy(dst);
+  return err;
+}
+
+
+void uvwasi_options_init(uvwasi_options_t* options) {
+  if (options == NULL)
+    return;
+
+  options->in = 0;
+  options->out = 1;
   options->err = 2;
   options->fd_table_size = 3;
   options->argc = 0;
@@ -473,7 +1004,48 @@ void uvwasi_options_init(uvwasi_options_t* options) {
   options->preopens = NULL;
   options->preopen_socketc = 0;
   options->preopen_sockets = NULL;
+  options->immutable_preopenc = 0;
+  options->immutable_preopens = NULL;
+  options->preopen_vfsc = 0;
+  options->preopen_vfs = NULL;
   options->allocator = NULL;
+  options->clock = NULL;
+  options->random_buffer_size = 0;
+  options->enable_stats = 0;
+  options->trace_buffer_size = 0;
+  options->enable_record = 0;
+  options->enable_lock_stats = 0;
+  options->enable_mem_stats = 0;
+  options->mem_limit = 0;
+  options->filestat_dont_sync = 0;
+  options->filestat_cache_ttl = 0;
+  options->mmap_window_size = 0;
+  options->file_cache = NULL;
+  options->stdio_buffer_size = 0;
+  options->stdio_line_buffered = 0;
+  options->stdio_ordered = 0;
+  options->stdio_flush_interval = 0;
+}
+
+
+uvwasi_errno_t uvwasi_mem_stats_get(const uvwasi_t* uvwasi,
+                                    uvwasi_mem_stats_t* stats) {
+  uint64_t* src;
+  uint64_t* dst;
+  size_t i;
+
+  if (uvwasi == NULL || stats == NULL)
+    return UVWASI_EINVAL;
+
+  if (uvwasi->mem_account == NULL)
+    return UVWASI_ENOTSUP;
+
+  src = (uint64_t*) &uvwasi->mem_account->stats;
+  dst = (uint64_t*) stats;
+  for (i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++)
+    dst[i] = uvwasi__atomic_load_u64(&src[i]);
+
+  return UVWASI_ESUCCESS;
 }
 
 
@@ -490,13 +1062,303 @@ uvwasi_errno_t uvwasi_embedder_remap_fd(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  /* Output buffered for the old host fd is written to it first. */
+  if (wrap->cold->out_buf != NULL)
+    uvwasi__stdio_retarget(uvwasi, wrap->cold->out_buf, new_host_fd);
+
   wrap->fd = new_host_fd;
   uv_mutex_unlock(&wrap->mutex);
   return UVWASI_ESUCCESS;
 }
 
 
-uvwasi_errno_t uvwasi_args_get(uvwasi_t* uvwasi, char** argv, char* argv_buf) {
+/* Copies up to len bytes from in, starting at *offset, to out's file position
+   without passing them through user space. copy_file_range() is tried first,
+   and sendfile() when the two fds do not allow it, for example because out is
+   a socket or in another file system. *offset and *copied are advanced by the
+   bytes copied. Returns UV_ENOTSUP if neither call works for these fds and
+   nothing was copied. */
+static int uvwasi__fd_copy_kernel(uv_file in,
+                                  uv_file out,
+                                  int out_is_socket,
+                                  uvwasi_filesize_t* offset,
+                                  uvwasi_filesize_t len,
+                                  uvwasi_filesize_t* copied) {
+#if defined(__linux__)
+  uvwasi_filesize_t chunk;
+#ifdef __NR_copy_file_range
+  int64_t range_off;
+#endif /* __NR_copy_file_range */
+  ssize_t n;
+  off_t off;
+  int use_copy_file_range;
+
+  use_copy_file_range = !out_is_socket;
+  while (*copied < len) {
+    chunk = len - *copied;
+    if (chunk > UVWASI__FD_COPY_MAX_CHUNK)
+      chunk = UVWASI__FD_COPY_MAX_CHUNK;
+
+#ifdef __NR_copy_file_range
+    if (use_copy_file_range) {
+      range_off = (int64_t) *offset;
+      n = syscall(__NR_copy_file_range,
+                  in,
+                  &range_off,
+                  out,
+                  NULL,
+                  (size_t) chunk,
+                  0);
+    } else
+#endif /* __NR_copy_file_range */
+    {
+      off = (off_t) *offset;
+      n = sendfile(out, in, &off, (size_t) chunk);
+    }
+
+    if (n > 0) {
+      *offset += n;
+      *copied += n;
+      continue;
+    }
+
+    /* Some file systems, such as procfs, report an empty file to
+       copy_file_range(). */
+    if (n == 0) {
+      if (use_copy_file_range && *copied == 0) {
+        use_copy_file_range = 0;
+        continue;
+      }
+
+      break;
+    }
+
+    if (errno == EINTR)
+      continue;
+
+    if (use_copy_file_range &&
+        (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+         errno == EOPNOTSUPP || errno == EBADF || errno == EPERM)) {
+      use_copy_file_range = 0;
+      continue;
+    }
+
+    if (*copied > 0)
+      break;
+
+    if (errno == EINVAL || errno == ENOSYS)
+      return UV_ENOTSUP;
+
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif /* defined(__linux__) */
+}
+
+
+/* Copies through a buffer, for when the kernel cannot copy between the two
+   fds. A socket takes what it can without blocking, which ends the copy. */
+static int uvwasi__fd_copy_buffered(uvwasi_t* uvwasi,
+                                    uv_file in,
+                                    struct uvwasi_fd_wrap_t* out,
+                                    uvwasi_filesize_t* offset,
+                                    uvwasi_filesize_t len,
+                                    uvwasi_filesize_t* copied) {
+  uv_buf_t buf;
+  uv_fs_t req;
+  char* data;
+  size_t size;
+  int nread;
+  int r;
+
+  if (*copied >= len)
+    return 0;
+
+  size = UVWASI__FD_COPY_BUFFER_SIZE;
+  if (len - *copied < size)
+    size = (size_t) (len - *copied);
+
+  data = uvwasi__malloc(uvwasi, size);
+  if (data == NULL)
+    return UV_ENOMEM;
+
+  r = 0;
+  while (*copied < len) {
+    buf = uv_buf_init(data, (unsigned int) size);
+    if (len - *copied < size)
+      buf.len = (size_t) (len - *copied);
+
+    nread = uv_fs_read(NULL, &req, in, &buf, 1, *offset, NULL);
+    uv_fs_req_cleanup(&req);
+    if (nread <= 0) {
+      r = nread;
+      break;
+    }
+
+    buf.len = nread;
+    while (buf.len > 0) {
+      if (out->cold->sock != NULL) {
+        r = uv_try_write((uv_stream_t*) out->cold->sock, &buf, 1);
+      } else {
+        r = uv_fs_write(NULL, &req, out->fd, &buf, 1, -1, NULL);
+        uv_fs_req_cleanup(&req);
+      }
+
+      if (r < 0)
+        break;
+
+      *offset += r;
+      *copied += r;
+      buf.base += r;
+      buf.len -= r;
+      if (out->cold->sock != NULL && buf.len > 0)
+        break;
+    }
+
+    if (r < 0 || buf.len > 0)
+      break;
+  }
+
+  uvwasi__free(uvwasi, data);
+  if (*copied > 0 || r == UV_EOF)
+    return 0;
+
+  return r < 0 ? r : 0;
+}
+
+
+uvwasi_errno_t uvwasi_fd_copy(uvwasi_t* uvwasi,
+                              uvwasi_fd_t in_fd,
+                              uvwasi_fd_t out_fd,
+                              uvwasi_filesize_t offset,
+                              uvwasi_filesize_t len,
+                              uvwasi_filesize_t* copied) {
+  struct uvwasi_fd_wrap_t* in;
+  struct uvwasi_fd_wrap_t* out;
+  uvwasi_errno_t err;
+  uv_os_fd_t sock_fd;
+  uv_file out_file;
+  int r;
+
+  if (uvwasi == NULL || copied == NULL || in_fd == out_fd ||
+      offset > INT64_MAX) {
+    return UVWASI_EINVAL;
+  }
+
+  *copied = 0;
+  if (len > INT64_MAX - offset)
+    len = INT64_MAX - offset;
+
+  /* Both fds are locked in order of their ids, under the table lock, so that
+     this cannot deadlock with a copy in the other direction. */
+  uvwasi_fd_table_lock(uvwasi->fds);
+  if (in_fd < out_fd) {
+    err = uvwasi_fd_table_get_nolock(uvwasi->fds,
+                                     in_fd,
+                                     &in,
+                                     UVWASI_RIGHT_FD_READ |
+                                     UVWASI_RIGHT_FD_SEEK,
+                                     0);
+    if (err != UVWASI_ESUCCESS) {
+      uvwasi_fd_table_unlock(uvwasi->fds);
+      return err;
+    }
+
+    err = uvwasi_fd_table_get_nolock(uvwasi->fds,
+                                     out_fd,
+                                     &out,
+                                     UVWASI_RIGHT_FD_WRITE,
+                                     0);
+    if (err != UVWASI_ESUCCESS) {
+      uv_mutex_unlock(&in->mutex);
+      uvwasi_fd_table_unlock(uvwasi->fds);
+      return err;
+    }
+  } else {
+    err = uvwasi_fd_table_get_nolock(uvwasi->fds,
+                                     out_fd,
+                                     &out,
+                                     UVWASI_RIGHT_FD_WRITE,
+                                     0);
+    if (err != UVWASI_ESUCCESS) {
+      uvwasi_fd_table_unlock(uvwasi->fds);
+      return err;
+    }
+
+    err = uvwasi_fd_table_get_nolock(uvwasi->fds,
+                                     in_fd,
+                                     &in,
+                                     UVWASI_RIGHT_FD_READ |
+                                     UVWASI_RIGHT_FD_SEEK,
+                                     0);
+    if (err != UVWASI_ESUCCESS) {
+      uv_mutex_unlock(&out->mutex);
+      uvwasi_fd_table_unlock(uvwasi->fds);
+      return err;
+    }
+  }
+  uvwasi_fd_table_unlock(uvwasi->fds);
+
+  if (in->cold->sock != NULL) {
+    err = UVWASI_EINVAL;
+    goto exit;
+  }
+
+  if (in->cold->vfs != NULL || out->cold->vfs != NULL) {
+    err = UVWASI_ENOTSUP;
+    goto exit;
+  }
+
+  /* Bytes reach out at its file position, so anything that has not yet been
+     written there has to be first. */
+  err = uvwasi__fd_flush_output(uvwasi, out);
+  if (err == UVWASI_ESUCCESS)
+    err = uvwasi__fd_pos_sync(out);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  out_file = out->fd;
+  r = 0;
+  if (out->cold->sock != NULL) {
+    r = uv_fileno((uv_handle_t*) out->cold->sock, &sock_fd);
+#ifndef _WIN32
+    out_file = sock_fd;
+#else
+    r = UV_ENOTSUP;
+#endif /* _WIN32 */
+  }
+
+  if (r == 0) {
+    r = uvwasi__fd_copy_kernel(in->fd,
+                               out_file,
+                               out->cold->sock != NULL,
+                               &offset,
+                               len,
+                               copied);
+  }
+
+  if (r == UV_ENOTSUP)
+    r = uvwasi__fd_copy_buffered(uvwasi, in->fd, out, &offset, len, copied);
+
+  if (*copied > 0) {
+    uvwasi__filestat_cache_wrote(out, -1, *copied);
+    uvwasi__fd_mmap_invalidate(out);
+  }
+
+  err = r < 0 ? uvwasi__translate_uv_error(r) : UVWASI_ESUCCESS;
+exit:
+  uv_mutex_unlock(&out->mutex);
+  uv_mutex_unlock(&in->mutex);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__args_get(uvwasi_t* uvwasi,
+                                       char** argv,
+                                       char* argv_buf) {
   uvwasi_size_t i;
 
   UVWASI_DEBUG("uvwasi_args_get(uvwasi=%p, argv=%p, argv_buf=%p)\n",
@@ -516,9 +1378,9 @@ uvwasi_errno_t uvwasi_args_get(uvwasi_t* uvwasi, char** argv, char* argv_buf) {
 }
 
 
-uvwasi_errno_t uvwasi_args_sizes_get(uvwasi_t* uvwasi,
-                                     uvwasi_size_t* argc,
-                                     uvwasi_size_t* argv_buf_size) {
+static uvwasi_errno_t uvwasi__args_sizes_get(uvwasi_t* uvwasi,
+                                             uvwasi_size_t* argc,
+                                             uvwasi_size_t* argv_buf_size) {
   UVWASI_DEBUG("uvwasi_args_sizes_get(uvwasi=%p, argc=%p, argv_buf_size=%p)\n",
                uvwasi,
                argc,
@@ -533,9 +1395,9 @@ uvwasi_errno_t uvwasi_args_sizes_get(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_clock_res_get(uvwasi_t* uvwasi,
-                                    uvwasi_clockid_t clock_id,
-                                    uvwasi_timestamp_t* resolution) {
+static uvwasi_errno_t uvwasi__clock_res_get(uvwasi_t* uvwasi,
+                                            uvwasi_clockid_t clock_id,
+                                            uvwasi_timestamp_t* resolution) {
   UVWASI_DEBUG("uvwasi_clock_res_get(uvwasi=%p, clock_id=%d, resolution=%p)\n",
                uvwasi,
                clock_id,
@@ -544,25 +1406,14 @@ uvwasi_errno_t uvwasi_clock_res_get(uvwasi_t* uvwasi,
   if (uvwasi == NULL || resolution == NULL)
     return UVWASI_EINVAL;
 
-  switch (clock_id) {
-    case UVWASI_CLOCK_MONOTONIC:
-    case UVWASI_CLOCK_REALTIME:
-      *resolution = 1;  /* Nanosecond precision. */
-      return UVWASI_ESUCCESS;
-    case UVWASI_CLOCK_PROCESS_CPUTIME_ID:
-      return uvwasi__clock_getres_process_cputime(resolution);
-    case UVWASI_CLOCK_THREAD_CPUTIME_ID:
-      return uvwasi__clock_getres_thread_cputime(resolution);
-    default:
-      return UVWASI_EINVAL;
-  }
+  return uvwasi__clock_getres(uvwasi, clock_id, resolution);
 }
 
 
-uvwasi_errno_t uvwasi_clock_time_get(uvwasi_t* uvwasi,
-                                     uvwasi_clockid_t clock_id,
-                                     uvwasi_timestamp_t precision,
-                                     uvwasi_timestamp_t* time) {
+static uvwasi_errno_t uvwasi__clock_time_get(uvwasi_t* uvwasi,
+                                             uvwasi_clockid_t clock_id,
+                                             uvwasi_timestamp_t precision,
+                                             uvwasi_timestamp_t* time) {
   UVWASI_DEBUG("uvwasi_clock_time_get(uvwasi=%p, clock_id=%d, "
                "precision=%"PRIu64", time=%p)\n",
                uvwasi,
@@ -573,25 +1424,13 @@ uvwasi_errno_t uvwasi_clock_time_get(uvwasi_t* uvwasi,
   if (uvwasi == NULL || time == NULL)
     return UVWASI_EINVAL;
 
-  switch (clock_id) {
-    case UVWASI_CLOCK_MONOTONIC:
-      *time = uv_hrtime();
-      return UVWASI_ESUCCESS;
-    case UVWASI_CLOCK_REALTIME:
-      return uvwasi__clock_gettime_realtime(time);
-    case UVWASI_CLOCK_PROCESS_CPUTIME_ID:
-      return uvwasi__clock_gettime_process_cputime(time);
-    case UVWASI_CLOCK_THREAD_CPUTIME_ID:
-      return uvwasi__clock_gettime_thread_cputime(time);
-    default:
-      return UVWASI_EINVAL;
-  }
+  return uvwasi__clock_gettime(uvwasi, clock_id, precision, time);
 }
 
 
-uvwasi_errno_t uvwasi_environ_get(uvwasi_t* uvwasi,
-                                  char** environment,
-                                  char* environ_buf) {
+static uvwasi_errno_t uvwasi__environ_get(uvwasi_t* uvwasi,
+                                          char** environment,
+                                          char* environ_buf) {
   uvwasi_size_t i;
 
   UVWASI_DEBUG("uvwasi_environ_get(uvwasi=%p, environment=%p, "
@@ -612,9 +1451,10 @@ uvwasi_errno_t uvwasi_environ_get(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_environ_sizes_get(uvwasi_t* uvwasi,
-                                        uvwasi_size_t* environ_count,
-                                        uvwasi_size_t* environ_buf_size) {
+static uvwasi_errno_t uvwasi__environ_sizes_get(
+    uvwasi_t* uvwasi,
+    uvwasi_size_t* environ_count,
+    uvwasi_size_t* environ_buf_size) {
   UVWASI_DEBUG("uvwasi_environ_sizes_get(uvwasi=%p, environ_count=%p, "
                "environ_buf_size=%p)\n",
                uvwasi,
@@ -630,11 +1470,11 @@ uvwasi_errno_t uvwasi_environ_sizes_get(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_advise(uvwasi_t* uvwasi,
-                                uvwasi_fd_t fd,
-                                uvwasi_filesize_t offset,
-                                uvwasi_filesize_t len,
-                                uvwasi_advice_t advice) {
+static uvwasi_errno_t uvwasi__fd_advise(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t fd,
+                                        uvwasi_filesize_t offset,
+                                        uvwasi_filesize_t len,
+                                        uvwasi_advice_t advice) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
   uv_fs_t req;
@@ -693,6 +1533,12 @@ uvwasi_errno_t uvwasi_fd_advise(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  /* Advice is only a hint, so file systems that cannot take it ignore it. */
+  if (wrap->cold->vfs != NULL) {
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
   r = uv_fs_fstat(NULL, &req, wrap->fd, NULL);
   if (r == -1) {
     err = uvwasi__translate_uv_error(r);
@@ -718,15 +1564,50 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_allocate(uvwasi_t* uvwasi,
-                                  uvwasi_fd_t fd,
-                                  uvwasi_filesize_t offset,
-                                  uvwasi_filesize_t len) {
-#if !defined(__POSIX__)
-  uv_fs_t req;
-  uint64_t st_size;
-#endif /* !__POSIX__ */
+/* Reserves storage for a range of a file. Returns 0, a negated uv error, or
+   UV_ENOTSUP if the platform or the file system cannot reserve storage. */
+static int uvwasi__fallocate(uv_file fd,
+                             uvwasi_filesize_t offset,
+                             uvwasi_filesize_t len) {
+#if defined(__linux__)
+  int r;
+
+  do
+    r = fallocate(fd, 0, (off_t) offset, (off_t) len);
+  while (r == -1 && errno == EINTR);
+
+  if (r == 0)
+    return 0;
+
+  if (errno == EOPNOTSUPP || errno == ENOSYS)
+    return UV_ENOTSUP;
+
+  return uv_translate_sys_error(errno);
+#elif defined(__FreeBSD__)
+  int r;
+
+  r = posix_fallocate(fd, (off_t) offset, (off_t) len);
+  if (r == 0)
+    return 0;
+
+  /* ZFS reports EINVAL rather than EOPNOTSUPP. */
+  if (r == EOPNOTSUPP || r == ENOSYS || r == EINVAL)
+    return UV_ENOTSUP;
+
+  return uv_translate_sys_error(r);
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+static uvwasi_errno_t uvwasi__fd_allocate(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t fd,
+                                          uvwasi_filesize_t offset,
+                                          uvwasi_filesize_t len) {
   struct uvwasi_fd_wrap_t* wrap;
+  uint64_t st_size;
+  uv_fs_t req;
   uvwasi_errno_t err;
   int r;
 
@@ -748,15 +1629,23 @@ uvwasi_errno_t uvwasi_fd_allocate(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  /* Try to use posix_fallocate(). If that's not an option, fall back to the
-     race condition prone combination of fstat() + ftruncate(). */
-#if defined(__POSIX__)
-  r = posix_fallocate(wrap->fd, offset, len);
-  if (r != 0) {
-    err = uvwasi__translate_uv_error(uv_translate_sys_error(r));
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_allocate(wrap, offset, len);
     goto exit;
   }
-#else
+
+  /* Try to reserve the storage. If that's not an option, fall back to the
+     race condition prone combination of fstat() + ftruncate(), which leaves
+     the file sparse. A zero length range has nothing to reserve. */
+  r = len == 0 ? UV_ENOTSUP : uvwasi__fallocate(wrap->fd, offset, len);
+  if (r == 0)
+    goto done;
+
+  if (r != UV_ENOTSUP) {
+    err = uvwasi__translate_uv_error(r);
+    goto exit;
+  }
+
   r = uv_fs_fstat(NULL, &req, wrap->fd, NULL);
   st_size = req.statbuf.st_size;
   uv_fs_req_cleanup(&req);
@@ -772,15 +1661,18 @@ uvwasi_errno_t uvwasi_fd_allocate(uvwasi_t* uvwasi,
       goto exit;
     }
   }
-#endif /* __POSIX__ */
 
+done:
+  uvwasi__filestat_cache_resized(wrap, offset + len, 1);
+  uvwasi__fd_mmap_invalidate(wrap);
   err = UVWASI_ESUCCESS;
 exit:
   uv_mutex_unlock(&wrap->mutex);
   return err;
 }
 
-uvwasi_errno_t uvwasi_fd_close(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+static uvwasi_errno_t uvwasi__fd_close(uvwasi_t* uvwasi,
+                                       uvwasi_fd_t fd) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err = 0;
   uv_fs_t req;
@@ -797,13 +1689,24 @@ uvwasi_errno_t uvwasi_fd_close(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
-  if (wrap->sock == NULL) {
+  if (wrap->cold->out_buf != NULL)
+    uvwasi__stdio_flush(uvwasi, wrap->cold->out_buf);
+
+  if (wrap->cold->vfs != NULL) {
+    r = 0;
+    err = uvwasi__vfs_close(wrap->cold);
+    uv_mutex_unlock(&wrap->mutex);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+  } else if (wrap->cold->sock == NULL) {
     r = uv_fs_close(NULL, &req, wrap->fd, NULL);
+    if (r == 0 && wrap->cold->out_buf != NULL)
+      uvwasi__stdio_retarget(uvwasi, wrap->cold->out_buf, -1);
     uv_mutex_unlock(&wrap->mutex);
     uv_fs_req_cleanup(&req);
   } else {
     r = 0;
-    err = free_handle_sync(uvwasi, (uv_handle_t*) wrap->sock);
+    err = free_handle_sync(uvwasi, (uv_handle_t*) wrap->cold->sock);
     uv_mutex_unlock(&wrap->mutex);
     if (err != UVWASI_ESUCCESS) {
       goto exit;
@@ -823,7 +1726,8 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_datasync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+static uvwasi_errno_t uvwasi__fd_datasync(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t fd) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
   uv_fs_t req;
@@ -842,6 +1746,12 @@ uvwasi_errno_t uvwasi_fd_datasync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  err = uvwasi__fd_flush_output(uvwasi, wrap);
+  if (err != UVWASI_ESUCCESS || wrap->cold->vfs != NULL) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   r = uv_fs_fdatasync(NULL, &req, wrap->fd, NULL);
   uv_mutex_unlock(&wrap->mutex);
   uv_fs_req_cleanup(&req);
@@ -853,9 +1763,9 @@ uvwasi_errno_t uvwasi_fd_datasync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
 }
 
 
-uvwasi_errno_t uvwasi_fd_fdstat_get(uvwasi_t* uvwasi,
-                                    uvwasi_fd_t fd,
-                                    uvwasi_fdstat_t* buf) {
+static uvwasi_errno_t uvwasi__fd_fdstat_get(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t fd,
+                                            uvwasi_fdstat_t* buf) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
 #ifndef _WIN32
@@ -877,6 +1787,12 @@ uvwasi_errno_t uvwasi_fd_fdstat_get(uvwasi_t* uvwasi,
   buf->fs_filetype = wrap->type;
   buf->fs_rights_base = wrap->rights_base;
   buf->fs_rights_inheriting = wrap->rights_inheriting;
+  if (wrap->cold->vfs != NULL) {
+    buf->fs_flags = wrap->cold->vfs_append ? UVWASI_FDFLAG_APPEND : 0;
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
 #ifdef _WIN32
   buf->fs_flags = 0;  /* TODO(cjihrig): Missing Windows support. */
 #else
@@ -894,9 +1810,9 @@ uvwasi_errno_t uvwasi_fd_fdstat_get(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_fdstat_set_flags(uvwasi_t* uvwasi,
-                                          uvwasi_fd_t fd,
-                                          uvwasi_fdflags_t flags) {
+static uvwasi_errno_t uvwasi__fd_fdstat_set_flags(uvwasi_t* uvwasi,
+                                                  uvwasi_fd_t fd,
+                                                  uvwasi_fdflags_t flags) {
 #ifdef _WIN32
   UVWASI_DEBUG("uvwasi_fd_fdstat_set_flags(uvwasi=%p, fd=%d, flags=%d)\n",
                uvwasi,
@@ -927,6 +1843,13 @@ uvwasi_errno_t uvwasi_fd_fdstat_set_flags(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  /* Only appending has a meaning for files that are not on the host. */
+  if (wrap->cold->vfs != NULL) {
+    wrap->cold->vfs_append = (flags & UVWASI_FDFLAG_APPEND) != 0;
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
   mapped_flags = 0;
 
   if ((flags & UVWASI_FDFLAG_APPEND) == UVWASI_FDFLAG_APPEND)
@@ -958,17 +1881,20 @@ uvwasi_errno_t uvwasi_fd_fdstat_set_flags(uvwasi_t* uvwasi,
   else
     err = UVWASI_ESUCCESS;
 
+  /* A change to O_APPEND changes how cached writes are accounted for. */
+  uvwasi__filestat_cache_invalidate(wrap);
+
   uv_mutex_unlock(&wrap->mutex);
   return err;
 #endif /* _WIN32 */
 }
 
 
-uvwasi_errno_t uvwasi_fd_fdstat_set_rights(uvwasi_t* uvwasi,
-                                           uvwasi_fd_t fd,
-                                           uvwasi_rights_t fs_rights_base,
-                                           uvwasi_rights_t fs_rights_inheriting
-                                          ) {
+static uvwasi_errno_t uvwasi__fd_fdstat_set_rights(
+    uvwasi_t* uvwasi,
+    uvwasi_fd_t fd,
+    uvwasi_rights_t fs_rights_base,
+    uvwasi_rights_t fs_rights_inheriting) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
 
@@ -1007,13 +1933,11 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_filestat_get(uvwasi_t* uvwasi,
-                                      uvwasi_fd_t fd,
-                                      uvwasi_filestat_t* buf) {
+static uvwasi_errno_t uvwasi__fd_filestat_get(uvwasi_t* uvwasi,
+                                              uvwasi_fd_t fd,
+                                              uvwasi_filestat_t* buf) {
   struct uvwasi_fd_wrap_t* wrap;
-  uv_fs_t req;
   uvwasi_errno_t err;
-  int r;
 
   UVWASI_DEBUG("uvwasi_fd_filestat_get(uvwasi=%p, fd=%d, buf=%p)\n",
                uvwasi,
@@ -1031,24 +1955,18 @@ uvwasi_errno_t uvwasi_fd_filestat_get(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_fstat(NULL, &req, wrap->fd, NULL);
-  if (r != 0) {
-    err = uvwasi__translate_uv_error(r);
-    goto exit;
-  }
-
-  uvwasi__stat_to_filestat(&req.statbuf, buf);
-  err = UVWASI_ESUCCESS;
-exit:
+  if (wrap->cold->vfs != NULL)
+    err = uvwasi__vfs_fstat(wrap, buf);
+  else
+    err = uvwasi__filestat_fd_cached(uvwasi, wrap, buf);
   uv_mutex_unlock(&wrap->mutex);
-  uv_fs_req_cleanup(&req);
   return err;
 }
 
 
-uvwasi_errno_t uvwasi_fd_filestat_set_size(uvwasi_t* uvwasi,
-                                           uvwasi_fd_t fd,
-                                           uvwasi_filesize_t st_size) {
+static uvwasi_errno_t uvwasi__fd_filestat_set_size(uvwasi_t* uvwasi,
+                                                   uvwasi_fd_t fd,
+                                                   uvwasi_filesize_t st_size) {
   /* TODO(cjihrig): uv_fs_ftruncate() takes an int64_t. st_size is uint64_t. */
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
@@ -1072,7 +1990,17 @@ uvwasi_errno_t uvwasi_fd_filestat_set_size(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_set_size(wrap, st_size);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   r = uv_fs_ftruncate(NULL, &req, wrap->fd, st_size, NULL);
+  if (r == 0) {
+    uvwasi__filestat_cache_resized(wrap, st_size, 0);
+    uvwasi__fd_mmap_invalidate(wrap);
+  }
   uv_mutex_unlock(&wrap->mutex);
   uv_fs_req_cleanup(&req);
 
@@ -1083,11 +2011,12 @@ uvwasi_errno_t uvwasi_fd_filestat_set_size(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
-                                            uvwasi_fd_t fd,
-                                            uvwasi_timestamp_t st_atim,
-                                            uvwasi_timestamp_t st_mtim,
-                                            uvwasi_fstflags_t fst_flags) {
+static uvwasi_errno_t uvwasi__fd_filestat_set_times(
+    uvwasi_t* uvwasi,
+    uvwasi_fd_t fd,
+    uvwasi_timestamp_t st_atim,
+    uvwasi_timestamp_t st_mtim,
+    uvwasi_fstflags_t fst_flags) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_timestamp_t atim;
   uvwasi_timestamp_t mtim;
@@ -1116,6 +2045,12 @@ uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_fset_times(wrap, st_atim, st_mtim, fst_flags);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   atim = st_atim;
   mtim = st_mtim;
   err = uvwasi__get_filestat_set_times(&atim,
@@ -1130,6 +2065,11 @@ uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
 
   /* libuv does not currently support nanosecond precision. */
   r = uv_fs_futime(NULL, &req, wrap->fd, atim, mtim, NULL);
+  if (r == 0) {
+    uvwasi__filestat_cache_set_times(wrap,
+                                     atim * NANOS_PER_SEC,
+                                     mtim * NANOS_PER_SEC);
+  }
   uv_mutex_unlock(&wrap->mutex);
   uv_fs_req_cleanup(&req);
 
@@ -1140,12 +2080,12 @@ uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_pread(uvwasi_t* uvwasi,
-                               uvwasi_fd_t fd,
-                               const uvwasi_iovec_t* iovs,
-                               uvwasi_size_t iovs_len,
-                               uvwasi_filesize_t offset,
-                               uvwasi_size_t* nread) {
+static uvwasi_errno_t uvwasi__fd_pread(uvwasi_t* uvwasi,
+                                       uvwasi_fd_t fd,
+                                       const uvwasi_iovec_t* iovs,
+                                       uvwasi_size_t iovs_len,
+                                       uvwasi_filesize_t offset,
+                                       uvwasi_size_t* nread) {
   struct uvwasi_fd_wrap_t* wrap;
   uv_buf_t* bufs;
   uv_fs_t req;
@@ -1181,6 +2121,23 @@ uvwasi_errno_t uvwasi_fd_pread(uvwasi_t* uvwasi,
     return UVWASI_ESUCCESS;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_read(wrap, iovs, iovs_len, (int64_t) offset, nread);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  err = uvwasi__fd_read_fast(uvwasi,
+                             wrap,
+                             iovs,
+                             iovs_len,
+                             (int64_t) offset,
+                             nread);
+  if (err != UVWASI_ENOTSUP) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   err = uvwasi__setup_iovs(uvwasi, &bufs, iovs, iovs_len);
   if (err != UVWASI_ESUCCESS) {
     uv_mutex_unlock(&wrap->mutex);
@@ -1201,9 +2158,9 @@ uvwasi_errno_t uvwasi_fd_pread(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_prestat_get(uvwasi_t* uvwasi,
-                                     uvwasi_fd_t fd,
-                                     uvwasi_prestat_t* buf) {
+static uvwasi_errno_t uvwasi__fd_prestat_get(uvwasi_t* uvwasi,
+                                             uvwasi_fd_t fd,
+                                             uvwasi_prestat_t* buf) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
 
@@ -1224,7 +2181,7 @@ uvwasi_errno_t uvwasi_fd_prestat_get(uvwasi_t* uvwasi,
   }
 
   buf->pr_type = UVWASI_PREOPENTYPE_DIR;
-  buf->u.dir.pr_name_len = strlen(wrap->path);
+  buf->u.dir.pr_name_len = strlen(wrap->cold->path);
   err = UVWASI_ESUCCESS;
 exit:
   uv_mutex_unlock(&wrap->mutex);
@@ -1232,10 +2189,10 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_prestat_dir_name(uvwasi_t* uvwasi,
-                                          uvwasi_fd_t fd,
-                                          char* path,
-                                          uvwasi_size_t path_len) {
+static uvwasi_errno_t uvwasi__fd_prestat_dir_name(uvwasi_t* uvwasi,
+                                                  uvwasi_fd_t fd,
+                                                  char* path,
+                                                  uvwasi_size_t path_len) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
   size_t size;
@@ -1258,13 +2215,13 @@ uvwasi_errno_t uvwasi_fd_prestat_dir_name(uvwasi_t* uvwasi,
     goto exit;
   }
 
-  size = strlen(wrap->path);
+  size = strlen(wrap->cold->path);
   if (size > (size_t) path_len) {
     err = UVWASI_ENOBUFS;
     goto exit;
   }
 
-  memcpy(path, wrap->path, size);
+  memcpy(path, wrap->cold->path, size);
   err = UVWASI_ESUCCESS;
 exit:
   uv_mutex_unlock(&wrap->mutex);
@@ -1272,12 +2229,12 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
-                                uvwasi_fd_t fd,
-                                const uvwasi_ciovec_t* iovs,
-                                uvwasi_size_t iovs_len,
-                                uvwasi_filesize_t offset,
-                                uvwasi_size_t* nwritten) {
+static uvwasi_errno_t uvwasi__fd_pwrite(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t fd,
+                                        const uvwasi_ciovec_t* iovs,
+                                        uvwasi_size_t iovs_len,
+                                        uvwasi_filesize_t offset,
+                                        uvwasi_size_t* nwritten) {
   struct uvwasi_fd_wrap_t* wrap;
   uv_buf_t* bufs;
   uv_fs_t req;
@@ -1305,6 +2262,12 @@ uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  err = uvwasi__fd_flush_output(uvwasi, wrap);
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   // libuv returns EINVAL in this case.  To behave consistently with other
   // Wasm runtimes, return OK here with a no-op.
   if (iovs_len == 0) {
@@ -1313,6 +2276,12 @@ uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
     return UVWASI_ESUCCESS;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_write(wrap, iovs, iovs_len, (int64_t) offset, nwritten);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   err = uvwasi__setup_ciovs(uvwasi, &bufs, iovs, iovs_len);
   if (err != UVWASI_ESUCCESS) {
     uv_mutex_unlock(&wrap->mutex);
@@ -1320,6 +2289,10 @@ uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
   }
 
   r = uv_fs_write(NULL, &req, wrap->fd, bufs, iovs_len, offset, NULL);
+  if (r >= 0) {
+    uvwasi__filestat_cache_wrote(wrap, offset, (uvwasi_filesize_t) r);
+    uvwasi__fd_mmap_invalidate(wrap);
+  }
   uv_mutex_unlock(&wrap->mutex);
   uvwritten = req.result;
   uv_fs_req_cleanup(&req);
@@ -1333,11 +2306,11 @@ uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
-                              uvwasi_fd_t fd,
-                              const uvwasi_iovec_t* iovs,
-                              uvwasi_size_t iovs_len,
-                              uvwasi_size_t* nread) {
+static uvwasi_errno_t uvwasi__fd_read(uvwasi_t* uvwasi,
+                                      uvwasi_fd_t fd,
+                                      const uvwasi_iovec_t* iovs,
+                                      uvwasi_size_t iovs_len,
+                                      uvwasi_size_t* nread) {
   struct uvwasi_fd_wrap_t* wrap;
   uv_buf_t* bufs;
   uv_fs_t req;
@@ -1367,6 +2340,18 @@ uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
     return UVWASI_ESUCCESS;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_read(wrap, iovs, iovs_len, -1, nread);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  err = uvwasi__fd_read_fast(uvwasi, wrap, iovs, iovs_len, -1, nread);
+  if (err != UVWASI_ENOTSUP) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   err = uvwasi__setup_iovs(uvwasi, &bufs, iovs, iovs_len);
   if (err != UVWASI_ESUCCESS) {
     uv_mutex_unlock(&wrap->mutex);
@@ -1387,12 +2372,12 @@ uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
-                                 uvwasi_fd_t fd,
-                                 void* buf,
-                                 uvwasi_size_t buf_len,
-                                 uvwasi_dircookie_t cookie,
-                                 uvwasi_size_t* bufused) {
+static uvwasi_errno_t uvwasi__fd_readdir(uvwasi_t* uvwasi,
+                                         uvwasi_fd_t fd,
+                                         void* buf,
+                                         uvwasi_size_t buf_len,
+                                         uvwasi_dircookie_t cookie,
+                                         uvwasi_size_t* bufused) {
 #if defined(UVWASI_FD_READDIR_SUPPORTED)
   /* TODO(cjihrig): Avoid opening and closing the directory on each call. */
   struct uvwasi_fd_wrap_t* wrap;
@@ -1430,8 +2415,14 @@ uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_readdir(wrap, buf, buf_len, cookie, bufused);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   /* Open the directory. */
-  r = uv_fs_opendir(NULL, &req, wrap->real_path, NULL);
+  r = uv_fs_opendir(NULL, &req, wrap->cold->real_path, NULL);
   if (r != 0) {
     uv_mutex_unlock(&wrap->mutex);
     return uvwasi__translate_uv_error(r);
@@ -1551,9 +2542,9 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_fd_renumber(uvwasi_t* uvwasi,
-                                  uvwasi_fd_t from,
-                                  uvwasi_fd_t to) {
+static uvwasi_errno_t uvwasi__fd_renumber(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t from,
+                                          uvwasi_fd_t to) {
   UVWASI_DEBUG("uvwasi_fd_renumber(uvwasi=%p, from=%d, to=%d)\n",
                uvwasi,
                from,
@@ -1566,11 +2557,11 @@ uvwasi_errno_t uvwasi_fd_renumber(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_fd_seek(uvwasi_t* uvwasi,
-                              uvwasi_fd_t fd,
-                              uvwasi_filedelta_t offset,
-                              uvwasi_whence_t whence,
-                              uvwasi_filesize_t* newoffset) {
+static uvwasi_errno_t uvwasi__fd_seek(uvwasi_t* uvwasi,
+                                      uvwasi_fd_t fd,
+                                      uvwasi_filedelta_t offset,
+                                      uvwasi_whence_t whence,
+                                      uvwasi_filesize_t* newoffset) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
 
@@ -1589,13 +2580,24 @@ uvwasi_errno_t uvwasi_fd_seek(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__lseek(wrap->fd, offset, whence, newoffset);
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_seek(wrap, offset, whence, newoffset);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  err = uvwasi__fd_flush_output(uvwasi, wrap);
+  if (err == UVWASI_ESUCCESS)
+    err = uvwasi__fd_pos_sync(wrap);
+  if (err == UVWASI_ESUCCESS)
+    err = uvwasi__lseek(wrap->fd, offset, whence, newoffset);
   uv_mutex_unlock(&wrap->mutex);
   return err;
 }
 
 
-uvwasi_errno_t uvwasi_fd_sync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+static uvwasi_errno_t uvwasi__fd_sync(uvwasi_t* uvwasi,
+                                      uvwasi_fd_t fd) {
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
@@ -1614,6 +2616,12 @@ uvwasi_errno_t uvwasi_fd_sync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  err = uvwasi__fd_flush_output(uvwasi, wrap);
+  if (err != UVWASI_ESUCCESS || wrap->cold->vfs != NULL) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   r = uv_fs_fsync(NULL, &req, wrap->fd, NULL);
   uv_mutex_unlock(&wrap->mutex);
   uv_fs_req_cleanup(&req);
@@ -1625,9 +2633,9 @@ uvwasi_errno_t uvwasi_fd_sync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
 }
 
 
-uvwasi_errno_t uvwasi_fd_tell(uvwasi_t* uvwasi,
-                              uvwasi_fd_t fd,
-                              uvwasi_filesize_t* offset) {
+static uvwasi_errno_t uvwasi__fd_tell(uvwasi_t* uvwasi,
+                                      uvwasi_fd_t fd,
+                                      uvwasi_filesize_t* offset) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
 
@@ -1643,17 +2651,27 @@ uvwasi_errno_t uvwasi_fd_tell(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__lseek(wrap->fd, 0, UVWASI_WHENCE_CUR, offset);
+  if (wrap->cold->vfs != NULL) {
+    *offset = wrap->cold->pos;
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
+  err = uvwasi__fd_flush_output(uvwasi, wrap);
+  if (err == UVWASI_ESUCCESS)
+    err = uvwasi__fd_pos_sync(wrap);
+  if (err == UVWASI_ESUCCESS)
+    err = uvwasi__lseek(wrap->fd, 0, UVWASI_WHENCE_CUR, offset);
   uv_mutex_unlock(&wrap->mutex);
   return err;
 }
 
 
-uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
-                               uvwasi_fd_t fd,
-                               const uvwasi_ciovec_t* iovs,
-                               uvwasi_size_t iovs_len,
-                               uvwasi_size_t* nwritten) {
+static uvwasi_errno_t uvwasi__fd_write(uvwasi_t* uvwasi,
+                                       uvwasi_fd_t fd,
+                                       const uvwasi_ciovec_t* iovs,
+                                       uvwasi_size_t iovs_len,
+                                       uvwasi_size_t* nwritten) {
   struct uvwasi_fd_wrap_t* wrap;
   uv_buf_t* bufs;
   uv_fs_t req;
@@ -1684,6 +2702,24 @@ uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
     return UVWASI_ESUCCESS;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_write(wrap, iovs, iovs_len, -1, nwritten);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  if (wrap->cold->out_buf != NULL) {
+    err = uvwasi__stdio_write(uvwasi,
+                              wrap->cold->out_buf,
+                              iovs,
+                              iovs_len,
+                              nwritten);
+    uvwasi__filestat_cache_invalidate(wrap);
+    uvwasi__fd_mmap_invalidate(wrap);
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
   err = uvwasi__setup_ciovs(uvwasi, &bufs, iovs, iovs_len);
   if (err != UVWASI_ESUCCESS) {
     uv_mutex_unlock(&wrap->mutex);
@@ -1691,6 +2727,10 @@ uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
   }
 
   r = uv_fs_write(NULL, &req, wrap->fd, bufs, iovs_len, -1, NULL);
+  if (r >= 0) {
+    uvwasi__filestat_cache_wrote(wrap, -1, (uvwasi_filesize_t) r);
+    uvwasi__fd_mmap_invalidate(wrap);
+  }
   uv_mutex_unlock(&wrap->mutex);
   uvwritten = req.result;
   uv_fs_req_cleanup(&req);
@@ -1704,10 +2744,10 @@ uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_path_create_directory(uvwasi_t* uvwasi,
-                                            uvwasi_fd_t fd,
-                                            const char* path,
-                                            uvwasi_size_t path_len) {
+static uvwasi_errno_t uvwasi__path_create_directory(uvwasi_t* uvwasi,
+                                                    uvwasi_fd_t fd,
+                                                    const char* path,
+                                                    uvwasi_size_t path_len) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
@@ -1736,6 +2776,12 @@ uvwasi_errno_t uvwasi_path_create_directory(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_mkdir(wrap->cold->vfs, resolved_path);
+    uvwasi__free(uvwasi, resolved_path);
+    goto exit;
+  }
+
   r = uv_fs_mkdir(NULL, &req, resolved_path, 0777, NULL);
   uv_fs_req_cleanup(&req);
   uvwasi__free(uvwasi, resolved_path);
@@ -1752,17 +2798,15 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_path_filestat_get(uvwasi_t* uvwasi,
-                                        uvwasi_fd_t fd,
-                                        uvwasi_lookupflags_t flags,
-                                        const char* path,
-                                        uvwasi_size_t path_len,
-                                        uvwasi_filestat_t* buf) {
+static uvwasi_errno_t uvwasi__path_filestat_get(uvwasi_t* uvwasi,
+                                                uvwasi_fd_t fd,
+                                                uvwasi_lookupflags_t flags,
+                                                const char* path,
+                                                uvwasi_size_t path_len,
+                                                uvwasi_filestat_t* buf) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
-  uv_fs_t req;
   uvwasi_errno_t err;
-  int r;
 
   UVWASI_DEBUG("uvwasi_path_filestat_get(uvwasi=%p, fd=%d, flags=%d, "
                "path='%s', path_len=%d, buf=%p)\n",
@@ -1793,31 +2837,26 @@ uvwasi_errno_t uvwasi_path_filestat_get(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
-  r = uv_fs_lstat(NULL, &req, resolved_path, NULL);
+  if (wrap->cold->vfs != NULL)
+    err = uvwasi__vfs_stat(wrap->cold->vfs, resolved_path, buf);
+  else
+    err = uvwasi__filestat_path(uvwasi, resolved_path, buf);
   uvwasi__free(uvwasi, resolved_path);
-  if (r != 0) {
-    uv_fs_req_cleanup(&req);
-    err = uvwasi__translate_uv_error(r);
-    goto exit;
-  }
-
-  uvwasi__stat_to_filestat(&req.statbuf, buf);
-  uv_fs_req_cleanup(&req);
-  err = UVWASI_ESUCCESS;
 exit:
   uv_mutex_unlock(&wrap->mutex);
   return err;
 }
 
 
-uvwasi_errno_t uvwasi_path_filestat_set_times(uvwasi_t* uvwasi,
-                                              uvwasi_fd_t fd,
-                                              uvwasi_lookupflags_t flags,
-                                              const char* path,
-                                              uvwasi_size_t path_len,
-                                              uvwasi_timestamp_t st_atim,
-                                              uvwasi_timestamp_t st_mtim,
-                                              uvwasi_fstflags_t fst_flags) {
+static uvwasi_errno_t uvwasi__path_filestat_set_times(
+    uvwasi_t* uvwasi,
+    uvwasi_fd_t fd,
+    uvwasi_lookupflags_t flags,
+    const char* path,
+    uvwasi_size_t path_len,
+    uvwasi_timestamp_t st_atim,
+    uvwasi_timestamp_t st_mtim,
+    uvwasi_fstflags_t fst_flags) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_timestamp_t atim;
@@ -1860,6 +2899,16 @@ uvwasi_errno_t uvwasi_path_filestat_set_times(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_set_times(wrap->cold->vfs,
+                                resolved_path,
+                                st_atim,
+                                st_mtim,
+                                fst_flags);
+    uvwasi__free(uvwasi, resolved_path);
+    goto exit;
+  }
+
   atim = st_atim;
   mtim = st_mtim;
   err = uvwasi__get_filestat_set_times(&atim,
@@ -1889,14 +2938,14 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
-                                uvwasi_fd_t old_fd,
-                                uvwasi_lookupflags_t old_flags,
-                                const char* old_path,
-                                uvwasi_size_t old_path_len,
-                                uvwasi_fd_t new_fd,
-                                const char* new_path,
-                                uvwasi_size_t new_path_len) {
+static uvwasi_errno_t uvwasi__path_link(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t old_fd,
+                                        uvwasi_lookupflags_t old_flags,
+                                        const char* old_path,
+                                        uvwasi_size_t old_path_len,
+                                        uvwasi_fd_t new_fd,
+                                        const char* new_path,
+                                        uvwasi_size_t new_path_len) {
   char* resolved_old_path;
   char* resolved_new_path;
   struct uvwasi_fd_wrap_t* old_wrap;
@@ -1958,6 +3007,11 @@ uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
   resolved_old_path = NULL;
   resolved_new_path = NULL;
 
+  if (old_wrap->cold->vfs != new_wrap->cold->vfs) {
+    err = UVWASI_EXDEV;
+    goto exit;
+  }
+
   err = uvwasi__resolve_path(uvwasi,
                              old_wrap,
                              old_path,
@@ -1976,6 +3030,13 @@ uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
+  if (old_wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_link(old_wrap->cold->vfs,
+                           resolved_old_path,
+                           resolved_new_path);
+    goto exit;
+  }
+
   r = uv_fs_link(NULL, &req, resolved_old_path, resolved_new_path, NULL);
   uv_fs_req_cleanup(&req);
   if (r != 0) {
@@ -1995,16 +3056,81 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
-                                uvwasi_fd_t dirfd,
-                                uvwasi_lookupflags_t dirflags,
-                                const char* path,
-                                uvwasi_size_t path_len,
-                                uvwasi_oflags_t o_flags,
-                                uvwasi_rights_t fs_rights_base,
-                                uvwasi_rights_t fs_rights_inheriting,
-                                uvwasi_fdflags_t fs_flags,
-                                uvwasi_fd_t* fd) {
+/* path_open() for a directory backed by a uvwasi_vfs_t. dirfd_wrap is locked
+   on entry and is unlocked before the new fd is inserted. */
+static uvwasi_errno_t uvwasi__path_open_vfs(uvwasi_t* uvwasi,
+                                          struct uvwasi_fd_wrap_t* dirfd_wrap,
+                                          const char* resolved_path,
+                                          uvwasi_oflags_t o_flags,
+                                          uvwasi_fdflags_t fs_flags,
+                                          int flags,
+                                          uvwasi_rights_t fs_rights_base,
+                                          uvwasi_rights_t fs_rights_inheriting,
+                                          uvwasi_fd_t* fd) {
+  const uvwasi_vfs_t* vfs;
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_rights_t max_base;
+  uvwasi_rights_t max_inheriting;
+  uvwasi_filetype_t filetype;
+  uvwasi_errno_t err;
+  void* file;
+  int immutable;
+
+  vfs = dirfd_wrap->cold->vfs;
+  immutable = dirfd_wrap->cold->immutable;
+  err = uvwasi__vfs_open(vfs,
+                         resolved_path,
+                         o_flags,
+                         fs_flags,
+                         (flags & (UV_FS_O_WRONLY | UV_FS_O_RDWR)) != 0,
+                         &file,
+                         &filetype);
+  uv_mutex_unlock(&dirfd_wrap->mutex);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  err = uvwasi__get_rights(-1, flags, filetype, &max_base, &max_inheriting);
+  if (err != UVWASI_ESUCCESS)
+    goto close_file_and_error_exit;
+
+  err = uvwasi_fd_table_insert(uvwasi,
+                               uvwasi->fds,
+                               -1,
+                               NULL,
+                               resolved_path,
+                               resolved_path,
+                               filetype,
+                               fs_rights_base & max_base,
+                               fs_rights_inheriting & max_inheriting,
+                               0,
+                               &wrap);
+  if (err != UVWASI_ESUCCESS)
+    goto close_file_and_error_exit;
+
+  wrap->cold->immutable = immutable;
+  wrap->cold->vfs = vfs;
+  wrap->cold->vfs_file = file;
+  wrap->cold->vfs_append = (fs_flags & UVWASI_FDFLAG_APPEND) != 0;
+  *fd = wrap->id;
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
+
+close_file_and_error_exit:
+  vfs->close(file, vfs->vfs_user_data);
+  return err;
+}
+
+
+static uvwasi_errno_t uvwasi__path_open(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t dirfd,
+                                        uvwasi_lookupflags_t dirflags,
+                                        const char* path,
+                                        uvwasi_size_t path_len,
+                                        uvwasi_oflags_t o_flags,
+                                        uvwasi_rights_t fs_rights_base,
+                                        uvwasi_rights_t fs_rights_inheriting,
+                                        uvwasi_fdflags_t fs_flags,
+                                        uvwasi_fd_t* fd) {
   char* resolved_path;
   uvwasi_rights_t needed_inheriting;
   uvwasi_rights_t needed_base;
@@ -2015,6 +3141,7 @@ uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
   uvwasi_filetype_t filetype;
   uvwasi_errno_t err;
   uv_fs_t req;
+  int immutable;
   int flags;
   int read;
   int write;
@@ -2102,7 +3229,22 @@ uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
     return err;
   }
 
+  if (dirfd_wrap->cold->vfs != NULL) {
+    err = uvwasi__path_open_vfs(uvwasi,
+                                dirfd_wrap,
+                                resolved_path,
+                                o_flags,
+                                fs_flags,
+                                flags,
+                                fs_rights_base,
+                                fs_rights_inheriting,
+                                fd);
+    uvwasi__free(uvwasi, resolved_path);
+    return err;
+  }
+
   r = uv_fs_open(NULL, &req, resolved_path, flags, 0666, NULL);
+  immutable = dirfd_wrap->cold->immutable;
   uv_mutex_unlock(&dirfd_wrap->mutex);
   uv_fs_req_cleanup(&req);
 
@@ -2146,6 +3288,23 @@ uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto close_file_and_error_exit;
 
+  uvwasi__fd_mmap_enable(uvwasi, wrap, flags);
+  if ((flags & UV_FS_O_TRUNC) != 0)
+    uvwasi__fd_mmap_invalidate(wrap);
+
+  /* Files under immutable preopens are inherited as such. Read-only regular
+     files among them are served from the shared file cache when possible. */
+  wrap->cold->immutable = immutable;
+  if (immutable &&
+      uvwasi->file_cache != NULL &&
+      filetype == UVWASI_FILETYPE_REGULAR_FILE &&
+      (flags & (UV_FS_O_WRONLY | UV_FS_O_RDWR)) == 0) {
+    uvwasi__file_cache_acquire(uvwasi->file_cache,
+                               uvwasi,
+                               wrap->fd,
+                               &wrap->cold->cache_entry);
+  }
+
   *fd = wrap->id;
   uv_mutex_unlock(&wrap->mutex);
   uvwasi__free(uvwasi, resolved_path);
@@ -2159,13 +3318,13 @@ close_file_and_error_exit:
 }
 
 
-uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
-                                    uvwasi_fd_t fd,
-                                    const char* path,
-                                    uvwasi_size_t path_len,
-                                    char* buf,
-                                    uvwasi_size_t buf_len,
-                                    uvwasi_size_t* bufused) {
+static uvwasi_errno_t uvwasi__path_readlink(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t fd,
+                                            const char* path,
+                                            uvwasi_size_t path_len,
+                                            char* buf,
+                                            uvwasi_size_t buf_len,
+                                            uvwasi_size_t* bufused) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
@@ -2200,6 +3359,17 @@ uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
     return err;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_readlink(wrap->cold->vfs,
+                               resolved_path,
+                               buf,
+                               buf_len,
+                               bufused);
+    uv_mutex_unlock(&wrap->mutex);
+    uvwasi__free(uvwasi, resolved_path);
+    return err;
+  }
+
   r = uv_fs_readlink(NULL, &req, resolved_path, NULL);
   uv_mutex_unlock(&wrap->mutex);
   uvwasi__free(uvwasi, resolved_path);
@@ -2222,10 +3392,10 @@ uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
-                                            uvwasi_fd_t fd,
-                                            const char* path,
-                                            uvwasi_size_t path_len) {
+static uvwasi_errno_t uvwasi__path_remove_directory(uvwasi_t* uvwasi,
+                                                    uvwasi_fd_t fd,
+                                                    const char* path,
+                                                    uvwasi_size_t path_len) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
@@ -2256,6 +3426,13 @@ uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
     return err;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_rmdir(wrap->cold->vfs, resolved_path);
+    uv_mutex_unlock(&wrap->mutex);
+    uvwasi__free(uvwasi, resolved_path);
+    return err;
+  }
+
   r = uv_fs_rmdir(NULL, &req, resolved_path, NULL);
   uv_mutex_unlock(&wrap->mutex);
   uvwasi__free(uvwasi, resolved_path);
@@ -2268,13 +3445,13 @@ uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
-                                  uvwasi_fd_t old_fd,
-                                  const char* old_path,
-                                  uvwasi_size_t old_path_len,
-                                  uvwasi_fd_t new_fd,
-                                  const char* new_path,
-                                  uvwasi_size_t new_path_len) {
+static uvwasi_errno_t uvwasi__path_rename(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t old_fd,
+                                          const char* old_path,
+                                          uvwasi_size_t old_path_len,
+                                          uvwasi_fd_t new_fd,
+                                          const char* new_path,
+                                          uvwasi_size_t new_path_len) {
   char* resolved_old_path;
   char* resolved_new_path;
   struct uvwasi_fd_wrap_t* old_wrap;
@@ -2334,6 +3511,11 @@ uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
   resolved_old_path = NULL;
   resolved_new_path = NULL;
 
+  if (old_wrap->cold->vfs != new_wrap->cold->vfs) {
+    err = UVWASI_EXDEV;
+    goto exit;
+  }
+
   err = uvwasi__resolve_path(uvwasi,
                              old_wrap,
                              old_path,
@@ -2352,6 +3534,13 @@ uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     goto exit;
 
+  if (old_wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_rename(old_wrap->cold->vfs,
+                             resolved_old_path,
+                             resolved_new_path);
+    goto exit;
+  }
+
   r = uv_fs_rename(NULL, &req, resolved_old_path, resolved_new_path, NULL);
   uv_fs_req_cleanup(&req);
   if (r != 0) {
@@ -2371,12 +3560,12 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_path_symlink(uvwasi_t* uvwasi,
-                                   const char* old_path,
-                                   uvwasi_size_t old_path_len,
-                                   uvwasi_fd_t fd,
-                                   const char* new_path,
-                                   uvwasi_size_t new_path_len) {
+static uvwasi_errno_t uvwasi__path_symlink(uvwasi_t* uvwasi,
+                                           const char* old_path,
+                                           uvwasi_size_t old_path_len,
+                                           uvwasi_fd_t fd,
+                                           const char* new_path,
+                                           uvwasi_size_t new_path_len) {
   char* truncated_old_path;
   char* resolved_old_path;
   char* resolved_new_path;
@@ -2442,6 +3631,13 @@ uvwasi_errno_t uvwasi_path_symlink(uvwasi_t* uvwasi,
     goto exit;
 
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_symlink(wrap->cold->vfs,
+                              truncated_old_path,
+                              resolved_new_path);
+    goto exit;
+  }
+
   /* Windows support may require setting the flags option. */
   r = uv_fs_symlink(NULL, &req, truncated_old_path, resolved_new_path, 0, NULL);
   uv_fs_req_cleanup(&req);
@@ -2460,10 +3656,10 @@ exit:
   return err;
 }
 
-uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
-                                       uvwasi_fd_t fd,
-                                       const char* path,
-                                       uvwasi_size_t path_len) {
+static uvwasi_errno_t uvwasi__path_unlink_file(uvwasi_t* uvwasi,
+                                               uvwasi_fd_t fd,
+                                               const char* path,
+                                               uvwasi_size_t path_len) {
   char* resolved_path;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
@@ -2494,6 +3690,13 @@ uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
     return err;
   }
 
+  if (wrap->cold->vfs != NULL) {
+    err = uvwasi__vfs_unlink(wrap->cold->vfs, resolved_path);
+    uv_mutex_unlock(&wrap->mutex);
+    uvwasi__free(uvwasi, resolved_path);
+    return err;
+  }
+
   r = uv_fs_unlink(NULL, &req, resolved_path, NULL);
   uv_mutex_unlock(&wrap->mutex);
   uvwasi__free(uvwasi, resolved_path);
@@ -2506,11 +3709,11 @@ uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_poll_oneoff(uvwasi_t* uvwasi,
-                                  const uvwasi_subscription_t* in,
-                                  uvwasi_event_t* out,
-                                  uvwasi_size_t nsubscriptions,
-                                  uvwasi_size_t* nevents) {
+static uvwasi_errno_t uvwasi__poll_oneoff(uvwasi_t* uvwasi,
+                                          const uvwasi_subscription_t* in,
+                                          uvwasi_event_t* out,
+                                          uvwasi_size_t nsubscriptions,
+                                          uvwasi_size_t* nevents) {
   struct uvwasi_poll_oneoff_state_t state;
   struct uvwasi__poll_fdevent_t* fdevent;
   uvwasi_userdata_t timer_userdata;
@@ -2536,6 +3739,10 @@ uvwasi_errno_t uvwasi_poll_oneoff(uvwasi_t* uvwasi,
     return UVWASI_EINVAL;
   }
 
+  /* Output is written out before the sandbox waits on anything. */
+  if (uvwasi->stdio != NULL)
+    uvwasi__stdio_flush(uvwasi, NULL);
+
   *nevents = 0;
   err = uvwasi__poll_oneoff_state_init(uvwasi, &state, nsubscriptions);
   if (err != UVWASI_ESUCCESS)
@@ -2551,12 +3758,19 @@ uvwasi_errno_t uvwasi_poll_oneoff(uvwasi_t* uvwasi,
     switch (sub.type) {
       case UVWASI_EVENTTYPE_CLOCK:
         if (sub.u.clock.flags == UVWASI_SUBSCRIPTION_CLOCK_ABSTIME) {
-          /* Convert absolute time to relative delay. */
-          err = uvwasi__clock_gettime_realtime(&now);
+          /* Convert absolute time to relative delay. Deadlines that have
+             already passed expire immediately. */
+          err = uvwasi__clock_gettime(uvwasi,
+                                      sub.u.clock.clock_id,
+                                      sub.u.clock.precision,
+                                      &now);
           if (err != UVWASI_ESUCCESS)
             goto exit;
 
-          cur_timeout = sub.u.clock.timeout - now;
+          if (sub.u.clock.timeout > now)
+            cur_timeout = sub.u.clock.timeout - now;
+          else
+            cur_timeout = 0;
         } else {
           cur_timeout = sub.u.clock.timeout;
         }
@@ -2629,14 +3843,18 @@ exit:
 }
 
 
-uvwasi_errno_t uvwasi_proc_exit(uvwasi_t* uvwasi, uvwasi_exitcode_t rval) {
+static uvwasi_errno_t uvwasi__proc_exit(uvwasi_t* uvwasi,
+                                        uvwasi_exitcode_t rval) {
   UVWASI_DEBUG("uvwasi_proc_exit(uvwasi=%p, rval=%d)\n", uvwasi, rval);
+  if (uvwasi != NULL && uvwasi->stdio != NULL)
+    uvwasi__stdio_flush(uvwasi, NULL);
   exit(rval);
   return UVWASI_ESUCCESS; /* This doesn't happen. */
 }
 
 
-uvwasi_errno_t uvwasi_proc_raise(uvwasi_t* uvwasi, uvwasi_signal_t sig) {
+static uvwasi_errno_t uvwasi__proc_raise(uvwasi_t* uvwasi,
+                                         uvwasi_signal_t sig) {
   int r;
 
   UVWASI_DEBUG("uvwasi_proc_raise(uvwasi=%p, sig=%d)\n", uvwasi, sig);
@@ -2656,9 +3874,9 @@ uvwasi_errno_t uvwasi_proc_raise(uvwasi_t* uvwasi, uvwasi_signal_t sig) {
 }
 
 
-uvwasi_errno_t uvwasi_random_get(uvwasi_t* uvwasi,
-                                 void* buf,
-                                 uvwasi_size_t buf_len) {
+static uvwasi_errno_t uvwasi__random_get(uvwasi_t* uvwasi,
+                                         void* buf,
+                                         uvwasi_size_t buf_len) {
   int r;
 
   UVWASI_DEBUG("uvwasi_random_get(uvwasi=%p, buf=%p, buf_len=%d)\n",
@@ -2669,6 +3887,9 @@ uvwasi_errno_t uvwasi_random_get(uvwasi_t* uvwasi,
   if (uvwasi == NULL || buf == NULL)
     return UVWASI_EINVAL;
 
+  if (uvwasi->rng != NULL)
+    return uvwasi__rng_get(uvwasi->rng, buf, buf_len);
+
   r = uv_random(NULL, NULL, buf, buf_len, 0, NULL);
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -2677,7 +3898,7 @@ uvwasi_errno_t uvwasi_random_get(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_sched_yield(uvwasi_t* uvwasi) {
+static uvwasi_errno_t uvwasi__sched_yield(uvwasi_t* uvwasi) {
   UVWASI_DEBUG("uvwasi_sched_yield(uvwasi=%p)\n", uvwasi);
 
   if (uvwasi == NULL)
@@ -2693,13 +3914,13 @@ uvwasi_errno_t uvwasi_sched_yield(uvwasi_t* uvwasi) {
   return UVWASI_ESUCCESS;
 }
 
-uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
-                                uvwasi_fd_t sock,
-                                const uvwasi_iovec_t* ri_data,
-                                uvwasi_size_t ri_data_len,
-                                uvwasi_riflags_t ri_flags,
-                                uvwasi_size_t* ro_datalen,
-                                uvwasi_roflags_t* ro_flags) {
+static uvwasi_errno_t uvwasi__sock_recv(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t sock,
+                                        const uvwasi_iovec_t* ri_data,
+                                        uvwasi_size_t ri_data_len,
+                                        uvwasi_riflags_t ri_flags,
+                                        uvwasi_size_t* ro_datalen,
+                                        uvwasi_roflags_t* ro_flags) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err = 0;
   recv_data_t recv_data;
@@ -2730,7 +3951,7 @@ uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
 
   recv_data.base = ri_data->buf;
   recv_data.len = ri_data->buf_len;
-  err = read_stream_sync(uvwasi, (uv_stream_t*) wrap->sock, &recv_data);
+  err = read_stream_sync(uvwasi, (uv_stream_t*) wrap->cold->sock, &recv_data);
   uv_mutex_unlock(&wrap->mutex);
   if (err != 0) {
     return err;
@@ -2747,12 +3968,12 @@ uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
 }
 
 
-uvwasi_errno_t uvwasi_sock_send(uvwasi_t* uvwasi,
-                                uvwasi_fd_t sock,
-                                const uvwasi_ciovec_t* si_data,
-                                uvwasi_size_t si_data_len,
-                                uvwasi_siflags_t si_flags,
-                                uvwasi_size_t* so_datalen) {
+static uvwasi_errno_t uvwasi__sock_send(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t sock,
+                                        const uvwasi_ciovec_t* si_data,
+                                        uvwasi_size_t si_data_len,
+                                        uvwasi_siflags_t si_flags,
+                                        uvwasi_size_t* so_datalen) {
 
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err = 0;
@@ -2786,7 +4007,7 @@ uvwasi_errno_t uvwasi_sock_send(uvwasi_t* uvwasi,
     return err;
   }
 
-  r = uv_try_write((uv_stream_t*) wrap->sock, bufs, si_data_len);
+  r = uv_try_write((uv_stream_t*) wrap->cold->sock, bufs, si_data_len);
   uvwasi__free(uvwasi, bufs);
   uv_mutex_unlock(&wrap->mutex);
   if (r < 0)
@@ -2796,9 +4017,9 @@ uvwasi_errno_t uvwasi_sock_send(uvwasi_t* uvwasi,
   return UVWASI_ESUCCESS;
 }
 
-uvwasi_errno_t uvwasi_sock_shutdown(uvwasi_t* uvwasi,
-                                    uvwasi_fd_t sock,
-                                    uvwasi_sdflags_t how) {
+static uvwasi_errno_t uvwasi__sock_shutdown(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t sock,
+                                            uvwasi_sdflags_t how) {
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err = 0;
   shutdown_data_t shutdown_data = {0};
@@ -2823,7 +4044,9 @@ uvwasi_errno_t uvwasi_sock_shutdown(uvwasi_t* uvwasi,
     return err;
 
   if (how & UVWASI_SHUT_WR) {
-    err = shutdown_stream_sync(uvwasi, (uv_stream_t*) wrap->sock, &shutdown_data);
+    err = shutdown_stream_sync(uvwasi,
+                               (uv_stream_t*) wrap->cold->sock,
+                               &shutdown_data);
     if (err != UVWASI_ESUCCESS) {
       uv_mutex_unlock(&wrap->mutex);
       return err;
@@ -2838,10 +4061,10 @@ uvwasi_errno_t uvwasi_sock_shutdown(uvwasi_t* uvwasi,
   return UVWASI_ESUCCESS;
 }
 
-uvwasi_errno_t uvwasi_sock_accept(uvwasi_t* uvwasi,
-                                  uvwasi_fd_t sock,
-                                  uvwasi_fdflags_t flags,
-                                  uvwasi_fd_t* connect_sock) {
+static uvwasi_errno_t uvwasi__sock_accept(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t sock,
+                                          uvwasi_fdflags_t flags,
+                                          uvwasi_fd_t* connect_sock) {
   struct uvwasi_fd_wrap_t* wrap;
   struct uvwasi_fd_wrap_t* connected_wrap;
   uvwasi_errno_t err = 0;
@@ -2869,7 +4092,7 @@ uvwasi_errno_t uvwasi_sock_accept(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  sock_loop = uv_handle_get_loop((uv_handle_t*) wrap->sock);
+  sock_loop = uv_handle_get_loop((uv_handle_t*) wrap->cold->sock);
   uv_tcp_t* uv_connect_sock = (uv_tcp_t*) uvwasi__malloc(uvwasi, sizeof(uv_tcp_t));
 
   if (uv_connect_sock == NULL)
@@ -2877,7 +4100,8 @@ uvwasi_errno_t uvwasi_sock_accept(uvwasi_t* uvwasi,
 
   uv_tcp_init(sock_loop, uv_connect_sock);
 
-  r = uv_accept((uv_stream_t*) wrap->sock, (uv_stream_t*) uv_connect_sock);
+  r = uv_accept((uv_stream_t*) wrap->cold->sock,
+                (uv_stream_t*) uv_connect_sock);
   if (r != 0) {
     if (r == UV_EAGAIN) {
       // if not blocking then just return as we have to wait for a connection
@@ -2903,7 +4127,8 @@ uvwasi_errno_t uvwasi_sock_accept(uvwasi_t* uvwasi,
         goto close_sock_and_error_exit;
       }
 
-      r = uv_accept((uv_stream_t*) wrap->sock, (uv_stream_t*) uv_connect_sock);
+      r = uv_accept((uv_stream_t*) wrap->cold->sock,
+                (uv_stream_t*) uv_connect_sock);
       if (r == UV_EAGAIN) {
 	// still no connection or error so run the loop again
         continue;
@@ -2948,6 +4173,1113 @@ close_sock_and_error_exit:
 }
 
 
+/* Public system call entry points. Each one wraps the implementation above so
+   that per-call instrumentation lives in a single place. */
+uvwasi_errno_t uvwasi_args_get(uvwasi_t* uvwasi, char** argv, char* argv_buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_ARGS_GET);
+  err = uvwasi__args_get(uvwasi, argv, argv_buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_ARGS_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              0,
+                              0,
+                              "");
+}
+
+
+uvwasi_errno_t uvwasi_args_sizes_get(uvwasi_t* uvwasi,
+                                     uvwasi_size_t* argc,
+                                     uvwasi_size_t* argv_buf_size) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_ARGS_SIZES_GET);
+  err = uvwasi__args_sizes_get(uvwasi, argc, argv_buf_size);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_ARGS_SIZES_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              0,
+                              err == UVWASI_ESUCCESS ? *argc : 0,
+                              "");
+}
+
+
+uvwasi_errno_t uvwasi_clock_res_get(uvwasi_t* uvwasi,
+                                    uvwasi_clockid_t clock_id,
+                                    uvwasi_timestamp_t* resolution) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_CLOCK_RES_GET);
+  err = uvwasi__clock_res_get(uvwasi, clock_id, resolution);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_CLOCK_RES_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              clock_id,
+                              err == UVWASI_ESUCCESS ? *resolution : 0,
+                              "u",
+                              (uint64_t) clock_id);
+}
+
+
+uvwasi_errno_t uvwasi_clock_time_get(uvwasi_t* uvwasi,
+                                     uvwasi_clockid_t clock_id,
+                                     uvwasi_timestamp_t precision,
+                                     uvwasi_timestamp_t* time) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_CLOCK_TIME_GET);
+  err = uvwasi__clock_time_get(uvwasi, clock_id, precision, time);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_CLOCK_TIME_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              clock_id,
+                              err == UVWASI_ESUCCESS ? *time : 0,
+                              "uu",
+                              (uint64_t) clock_id,
+                              precision);
+}
+
+
+uvwasi_errno_t uvwasi_environ_get(uvwasi_t* uvwasi,
+                                  char** environment,
+                                  char* environ_buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_ENVIRON_GET);
+  err = uvwasi__environ_get(uvwasi, environment, environ_buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_ENVIRON_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              0,
+                              0,
+                              "");
+}
+
+
+uvwasi_errno_t uvwasi_environ_sizes_get(uvwasi_t* uvwasi,
+                                        uvwasi_size_t* environ_count,
+                                        uvwasi_size_t* environ_buf_size) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_ENVIRON_SIZES_GET);
+  err = uvwasi__environ_sizes_get(uvwasi, environ_count, environ_buf_size);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_ENVIRON_SIZES_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              0,
+                              err == UVWASI_ESUCCESS ? *environ_count : 0,
+                              "");
+}
+
+
+uvwasi_errno_t uvwasi_fd_advise(uvwasi_t* uvwasi,
+                                uvwasi_fd_t fd,
+                                uvwasi_filesize_t offset,
+                                uvwasi_filesize_t len,
+                                uvwasi_advice_t advice) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_ADVISE);
+  err = uvwasi__fd_advise(uvwasi, fd, offset, len, advice);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_ADVISE,
+                              start,
+                              err,
+                              fd,
+                              advice,
+                              0,
+                              "uuuu",
+                              (uint64_t) fd,
+                              offset,
+                              len,
+                              (uint64_t) advice);
+}
+
+
+uvwasi_errno_t uvwasi_fd_allocate(uvwasi_t* uvwasi,
+                                  uvwasi_fd_t fd,
+                                  uvwasi_filesize_t offset,
+                                  uvwasi_filesize_t len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_ALLOCATE);
+  err = uvwasi__fd_allocate(uvwasi, fd, offset, len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_ALLOCATE,
+                              start,
+                              err,
+                              fd,
+                              len,
+                              0,
+                              "uuu",
+                              (uint64_t) fd,
+                              offset,
+                              len);
+}
+
+
+uvwasi_errno_t uvwasi_fd_close(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_CLOSE);
+  err = uvwasi__fd_close(uvwasi, fd);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_CLOSE,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_datasync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_DATASYNC);
+  err = uvwasi__fd_datasync(uvwasi, fd);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_DATASYNC,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_fdstat_get(uvwasi_t* uvwasi,
+                                    uvwasi_fd_t fd,
+                                    uvwasi_fdstat_t* buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FDSTAT_GET);
+  err = uvwasi__fd_fdstat_get(uvwasi, fd, buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FDSTAT_GET,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_fdstat_set_flags(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t fd,
+                                          uvwasi_fdflags_t flags) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FDSTAT_SET_FLAGS);
+  err = uvwasi__fd_fdstat_set_flags(uvwasi, fd, flags);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FDSTAT_SET_FLAGS,
+                              start,
+                              err,
+                              fd,
+                              flags,
+                              0,
+                              "uu",
+                              (uint64_t) fd,
+                              (uint64_t) flags);
+}
+
+
+uvwasi_errno_t uvwasi_fd_fdstat_set_rights(uvwasi_t* uvwasi,
+                                           uvwasi_fd_t fd,
+                                           uvwasi_rights_t fs_rights_base,
+                                           uvwasi_rights_t fs_rights_inheriting
+                                          ) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FDSTAT_SET_RIGHTS);
+  err = uvwasi__fd_fdstat_set_rights(uvwasi,
+                                     fd,
+                                     fs_rights_base,
+                                     fs_rights_inheriting);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FDSTAT_SET_RIGHTS,
+                              start,
+                              err,
+                              fd,
+                              fs_rights_base,
+                              0,
+                              "uuu",
+                              (uint64_t) fd,
+                              fs_rights_base,
+                              fs_rights_inheriting);
+}
+
+
+uvwasi_errno_t uvwasi_fd_filestat_get(uvwasi_t* uvwasi,
+                                      uvwasi_fd_t fd,
+                                      uvwasi_filestat_t* buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FILESTAT_GET);
+  err = uvwasi__fd_filestat_get(uvwasi, fd, buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FILESTAT_GET,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              err == UVWASI_ESUCCESS ? buf->st_size : 0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_filestat_set_size(uvwasi_t* uvwasi,
+                                           uvwasi_fd_t fd,
+                                           uvwasi_filesize_t st_size) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FILESTAT_SET_SIZE);
+  err = uvwasi__fd_filestat_set_size(uvwasi, fd, st_size);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FILESTAT_SET_SIZE,
+                              start,
+                              err,
+                              fd,
+                              st_size,
+                              0,
+                              "uu",
+                              (uint64_t) fd,
+                              st_size);
+}
+
+
+uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t fd,
+                                            uvwasi_timestamp_t st_atim,
+                                            uvwasi_timestamp_t st_mtim,
+                                            uvwasi_fstflags_t fst_flags) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_FILESTAT_SET_TIMES);
+  err = uvwasi__fd_filestat_set_times(uvwasi, fd, st_atim, st_mtim, fst_flags);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_FILESTAT_SET_TIMES,
+                              start,
+                              err,
+                              fd,
+                              fst_flags,
+                              0,
+                              "uuuu",
+                              (uint64_t) fd,
+                              st_atim,
+                              st_mtim,
+                              (uint64_t) fst_flags);
+}
+
+
+uvwasi_errno_t uvwasi_fd_pread(uvwasi_t* uvwasi,
+                               uvwasi_fd_t fd,
+                               const uvwasi_iovec_t* iovs,
+                               uvwasi_size_t iovs_len,
+                               uvwasi_filesize_t offset,
+                               uvwasi_size_t* nread) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_PREAD);
+  err = uvwasi__fd_pread(uvwasi, fd, iovs, iovs_len, offset, nread);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_PREAD,
+                              start,
+                              err,
+                              fd,
+                              offset,
+                              err == UVWASI_ESUCCESS ? *nread : 0,
+                              "uiu",
+                              (uint64_t) fd,
+                              iovs,
+                              iovs_len,
+                              offset);
+}
+
+
+uvwasi_errno_t uvwasi_fd_prestat_get(uvwasi_t* uvwasi,
+                                     uvwasi_fd_t fd,
+                                     uvwasi_prestat_t* buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_PRESTAT_GET);
+  err = uvwasi__fd_prestat_get(uvwasi, fd, buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_PRESTAT_GET,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_prestat_dir_name(uvwasi_t* uvwasi,
+                                          uvwasi_fd_t fd,
+                                          char* path,
+                                          uvwasi_size_t path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_PRESTAT_DIR_NAME);
+  err = uvwasi__fd_prestat_dir_name(uvwasi, fd, path, path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_PRESTAT_DIR_NAME,
+                              start,
+                              err,
+                              fd,
+                              path_len,
+                              0,
+                              "uu",
+                              (uint64_t) fd,
+                              (uint64_t) path_len);
+}
+
+
+uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
+                                uvwasi_fd_t fd,
+                                const uvwasi_ciovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                uvwasi_filesize_t offset,
+                                uvwasi_size_t* nwritten) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_PWRITE);
+  err = uvwasi__fd_pwrite(uvwasi, fd, iovs, iovs_len, offset, nwritten);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_PWRITE,
+                              start,
+                              err,
+                              fd,
+                              offset,
+                              err == UVWASI_ESUCCESS ? *nwritten : 0,
+                              "ucu",
+                              (uint64_t) fd,
+                              iovs,
+                              iovs_len,
+                              offset);
+}
+
+
+uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
+                              uvwasi_fd_t fd,
+                              const uvwasi_iovec_t* iovs,
+                              uvwasi_size_t iovs_len,
+                              uvwasi_size_t* nread) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_READ);
+  err = uvwasi__fd_read(uvwasi, fd, iovs, iovs_len, nread);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_READ,
+                              start,
+                              err,
+                              fd,
+                              iovs_len,
+                              err == UVWASI_ESUCCESS ? *nread : 0,
+                              "ui",
+                              (uint64_t) fd,
+                              iovs,
+                              iovs_len);
+}
+
+
+uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
+                                 uvwasi_fd_t fd,
+                                 void* buf,
+                                 uvwasi_size_t buf_len,
+                                 uvwasi_dircookie_t cookie,
+                                 uvwasi_size_t* bufused) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_READDIR);
+  err = uvwasi__fd_readdir(uvwasi, fd, buf, buf_len, cookie, bufused);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_READDIR,
+                              start,
+                              err,
+                              fd,
+                              cookie,
+                              err == UVWASI_ESUCCESS ? *bufused : 0,
+                              "uuu",
+                              (uint64_t) fd,
+                              (uint64_t) buf_len,
+                              cookie);
+}
+
+
+uvwasi_errno_t uvwasi_fd_renumber(uvwasi_t* uvwasi,
+                                  uvwasi_fd_t from,
+                                  uvwasi_fd_t to) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_RENUMBER);
+  err = uvwasi__fd_renumber(uvwasi, from, to);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_RENUMBER,
+                              start,
+                              err,
+                              from,
+                              to,
+                              0,
+                              "uu",
+                              (uint64_t) from,
+                              (uint64_t) to);
+}
+
+
+uvwasi_errno_t uvwasi_fd_seek(uvwasi_t* uvwasi,
+                              uvwasi_fd_t fd,
+                              uvwasi_filedelta_t offset,
+                              uvwasi_whence_t whence,
+                              uvwasi_filesize_t* newoffset) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_SEEK);
+  err = uvwasi__fd_seek(uvwasi, fd, offset, whence, newoffset);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_SEEK,
+                              start,
+                              err,
+                              fd,
+                              offset,
+                              err == UVWASI_ESUCCESS ? *newoffset : 0,
+                              "uuu",
+                              (uint64_t) fd,
+                              (uint64_t) offset,
+                              (uint64_t) whence);
+}
+
+
+uvwasi_errno_t uvwasi_fd_sync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_SYNC);
+  err = uvwasi__fd_sync(uvwasi, fd);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_SYNC,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_tell(uvwasi_t* uvwasi,
+                              uvwasi_fd_t fd,
+                              uvwasi_filesize_t* offset) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_TELL);
+  err = uvwasi__fd_tell(uvwasi, fd, offset);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_TELL,
+                              start,
+                              err,
+                              fd,
+                              0,
+                              err == UVWASI_ESUCCESS ? *offset : 0,
+                              "u",
+                              (uint64_t) fd);
+}
+
+
+uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
+                               uvwasi_fd_t fd,
+                               const uvwasi_ciovec_t* iovs,
+                               uvwasi_size_t iovs_len,
+                               uvwasi_size_t* nwritten) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_FD_WRITE);
+  err = uvwasi__fd_write(uvwasi, fd, iovs, iovs_len, nwritten);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_FD_WRITE,
+                              start,
+                              err,
+                              fd,
+                              iovs_len,
+                              err == UVWASI_ESUCCESS ? *nwritten : 0,
+                              "uc",
+                              (uint64_t) fd,
+                              iovs,
+                              iovs_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_create_directory(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t fd,
+                                            const char* path,
+                                            uvwasi_size_t path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_CREATE_DIRECTORY);
+  err = uvwasi__path_create_directory(uvwasi, fd, path, path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_CREATE_DIRECTORY,
+                              start,
+                              err,
+                              fd,
+                              path_len,
+                              0,
+                              "ub",
+                              (uint64_t) fd,
+                              path,
+                              path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_filestat_get(uvwasi_t* uvwasi,
+                                        uvwasi_fd_t fd,
+                                        uvwasi_lookupflags_t flags,
+                                        const char* path,
+                                        uvwasi_size_t path_len,
+                                        uvwasi_filestat_t* buf) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_FILESTAT_GET);
+  err = uvwasi__path_filestat_get(uvwasi, fd, flags, path, path_len, buf);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_FILESTAT_GET,
+                              start,
+                              err,
+                              fd,
+                              path_len,
+                              err == UVWASI_ESUCCESS ? buf->st_size : 0,
+                              "uub",
+                              (uint64_t) fd,
+                              (uint64_t) flags,
+                              path,
+                              path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_filestat_set_times(uvwasi_t* uvwasi,
+                                              uvwasi_fd_t fd,
+                                              uvwasi_lookupflags_t flags,
+                                              const char* path,
+                                              uvwasi_size_t path_len,
+                                              uvwasi_timestamp_t st_atim,
+                                              uvwasi_timestamp_t st_mtim,
+                                              uvwasi_fstflags_t fst_flags) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_FILESTAT_SET_TIMES);
+  err = uvwasi__path_filestat_set_times(uvwasi,
+                                        fd,
+                                        flags,
+                                        path,
+                                        path_len,
+                                        st_atim,
+                                        st_mtim,
+                                        fst_flags);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_FILESTAT_SET_TIMES,
+                              start,
+                              err,
+                              fd,
+                              fst_flags,
+                              0,
+                              "uubuuu",
+                              (uint64_t) fd,
+                              (uint64_t) flags,
+                              path,
+                              path_len,
+                              st_atim,
+                              st_mtim,
+                              (uint64_t) fst_flags);
+}
+
+
+uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
+                                uvwasi_fd_t old_fd,
+                                uvwasi_lookupflags_t old_flags,
+                                const char* old_path,
+                                uvwasi_size_t old_path_len,
+                                uvwasi_fd_t new_fd,
+                                const char* new_path,
+                                uvwasi_size_t new_path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_LINK);
+  err = uvwasi__path_link(uvwasi,
+                          old_fd,
+                          old_flags,
+                          old_path,
+                          old_path_len,
+                          new_fd,
+                          new_path,
+                          new_path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_LINK,
+                              start,
+                              err,
+                              old_fd,
+                              new_fd,
+                              0,
+                              "uubub",
+                              (uint64_t) old_fd,
+                              (uint64_t) old_flags,
+                              old_path,
+                              old_path_len,
+                              (uint64_t) new_fd,
+                              new_path,
+                              new_path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
+                                uvwasi_fd_t dirfd,
+                                uvwasi_lookupflags_t dirflags,
+                                const char* path,
+                                uvwasi_size_t path_len,
+                                uvwasi_oflags_t o_flags,
+                                uvwasi_rights_t fs_rights_base,
+                                uvwasi_rights_t fs_rights_inheriting,
+                                uvwasi_fdflags_t fs_flags,
+                                uvwasi_fd_t* fd) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_OPEN);
+  err = uvwasi__path_open(uvwasi,
+                          dirfd,
+                          dirflags,
+                          path,
+                          path_len,
+                          o_flags,
+                          fs_rights_base,
+                          fs_rights_inheriting,
+                          fs_flags,
+                          fd);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_OPEN,
+                              start,
+                              err,
+                              dirfd,
+                              o_flags,
+                              err == UVWASI_ESUCCESS ? *fd : 0,
+                              "uubuuuu",
+                              (uint64_t) dirfd,
+                              (uint64_t) dirflags,
+                              path,
+                              path_len,
+                              (uint64_t) o_flags,
+                              fs_rights_base,
+                              fs_rights_inheriting,
+                              (uint64_t) fs_flags);
+}
+
+
+uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
+                                    uvwasi_fd_t fd,
+                                    const char* path,
+                                    uvwasi_size_t path_len,
+                                    char* buf,
+                                    uvwasi_size_t buf_len,
+                                    uvwasi_size_t* bufused) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_READLINK);
+  err = uvwasi__path_readlink(uvwasi,
+                              fd,
+                              path,
+                              path_len,
+                              buf,
+                              buf_len,
+                              bufused);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_READLINK,
+                              start,
+                              err,
+                              fd,
+                              buf_len,
+                              err == UVWASI_ESUCCESS ? *bufused : 0,
+                              "ubu",
+                              (uint64_t) fd,
+                              path,
+                              path_len,
+                              (uint64_t) buf_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
+                                            uvwasi_fd_t fd,
+                                            const char* path,
+                                            uvwasi_size_t path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_REMOVE_DIRECTORY);
+  err = uvwasi__path_remove_directory(uvwasi, fd, path, path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_REMOVE_DIRECTORY,
+                              start,
+                              err,
+                              fd,
+                              path_len,
+                              0,
+                              "ub",
+                              (uint64_t) fd,
+                              path,
+                              path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
+                                  uvwasi_fd_t old_fd,
+                                  const char* old_path,
+                                  uvwasi_size_t old_path_len,
+                                  uvwasi_fd_t new_fd,
+                                  const char* new_path,
+                                  uvwasi_size_t new_path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_RENAME);
+  err = uvwasi__path_rename(uvwasi,
+                            old_fd,
+                            old_path,
+                            old_path_len,
+                            new_fd,
+                            new_path,
+                            new_path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_RENAME,
+                              start,
+                              err,
+                              old_fd,
+                              new_fd,
+                              0,
+                              "ubub",
+                              (uint64_t) old_fd,
+                              old_path,
+                              old_path_len,
+                              (uint64_t) new_fd,
+                              new_path,
+                              new_path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_symlink(uvwasi_t* uvwasi,
+                                   const char* old_path,
+                                   uvwasi_size_t old_path_len,
+                                   uvwasi_fd_t fd,
+                                   const char* new_path,
+                                   uvwasi_size_t new_path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_SYMLINK);
+  err = uvwasi__path_symlink(uvwasi,
+                             old_path,
+                             old_path_len,
+                             fd,
+                             new_path,
+                             new_path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_SYMLINK,
+                              start,
+                              err,
+                              fd,
+                              new_path_len,
+                              0,
+                              "bub",
+                              old_path,
+                              old_path_len,
+                              (uint64_t) fd,
+                              new_path,
+                              new_path_len);
+}
+
+
+uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
+                                       uvwasi_fd_t fd,
+                                       const char* path,
+                                       uvwasi_size_t path_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PATH_UNLINK_FILE);
+  err = uvwasi__path_unlink_file(uvwasi, fd, path, path_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PATH_UNLINK_FILE,
+                              start,
+                              err,
+                              fd,
+                              path_len,
+                              0,
+                              "ub",
+                              (uint64_t) fd,
+                              path,
+                              path_len);
+}
+
+
+uvwasi_errno_t uvwasi_poll_oneoff(uvwasi_t* uvwasi,
+                                  const uvwasi_subscription_t* in,
+                                  uvwasi_event_t* out,
+                                  uvwasi_size_t nsubscriptions,
+                                  uvwasi_size_t* nevents) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_POLL_ONEOFF);
+  err = uvwasi__poll_oneoff(uvwasi, in, out, nsubscriptions, nevents);
+  /* out has room for one event per subscription, so nsubscriptions is
+     recorded as its size too. */
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_POLL_ONEOFF,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              nsubscriptions,
+                              err == UVWASI_ESUCCESS ? *nevents : 0,
+                              "buu",
+                              in,
+                              nsubscriptions * (uvwasi_size_t) sizeof(*in),
+                              (uint64_t) nsubscriptions,
+                              (uint64_t) nsubscriptions);
+}
+
+
+uvwasi_errno_t uvwasi_proc_exit(uvwasi_t* uvwasi, uvwasi_exitcode_t rval) {
+  uint64_t start;
+
+  /* The call does not return, so it is recorded up front. */
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PROC_EXIT);
+  uvwasi__syscall_exit(uvwasi,
+                       UVWASI_SYSCALL_PROC_EXIT,
+                       start,
+                       UVWASI_ESUCCESS,
+                       UVWASI_TRACE_NO_FD,
+                       rval,
+                       0,
+                       "u",
+                       (uint64_t) rval);
+  return uvwasi__proc_exit(uvwasi, rval);
+}
+
+
+uvwasi_errno_t uvwasi_proc_raise(uvwasi_t* uvwasi, uvwasi_signal_t sig) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_PROC_RAISE);
+  err = uvwasi__proc_raise(uvwasi, sig);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_PROC_RAISE,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              sig,
+                              0,
+                              "u",
+                              (uint64_t) sig);
+}
+
+
+uvwasi_errno_t uvwasi_random_get(uvwasi_t* uvwasi,
+                                 void* buf,
+                                 uvwasi_size_t buf_len) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_RANDOM_GET);
+  err = uvwasi__random_get(uvwasi, buf, buf_len);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_RANDOM_GET,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              buf_len,
+                              err == UVWASI_ESUCCESS ? buf_len : 0,
+                              "u",
+                              (uint64_t) buf_len);
+}
+
+
+uvwasi_errno_t uvwasi_sched_yield(uvwasi_t* uvwasi) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_SCHED_YIELD);
+  err = uvwasi__sched_yield(uvwasi);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_SCHED_YIELD,
+                              start,
+                              err,
+                              UVWASI_TRACE_NO_FD,
+                              0,
+                              0,
+                              "");
+}
+
+
+uvwasi_errno_t uvwasi_sock_accept(uvwasi_t* uvwasi,
+                                  uvwasi_fd_t sock,
+                                  uvwasi_fdflags_t flags,
+                                  uvwasi_fd_t* connect_sock) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_SOCK_ACCEPT);
+  err = uvwasi__sock_accept(uvwasi, sock, flags, connect_sock);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_SOCK_ACCEPT,
+                              start,
+                              err,
+                              sock,
+                              flags,
+                              err == UVWASI_ESUCCESS ? *connect_sock : 0,
+                              "uu",
+                              (uint64_t) sock,
+                              (uint64_t) flags);
+}
+
+
+uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
+                                uvwasi_fd_t sock,
+                                const uvwasi_iovec_t* ri_data,
+                                uvwasi_size_t ri_data_len,
+                                uvwasi_riflags_t ri_flags,
+                                uvwasi_size_t* ro_datalen,
+                                uvwasi_roflags_t* ro_flags) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_SOCK_RECV);
+  err = uvwasi__sock_recv(uvwasi,
+                          sock,
+                          ri_data,
+                          ri_data_len,
+                          ri_flags,
+                          ro_datalen,
+                          ro_flags);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_SOCK_RECV,
+                              start,
+                              err,
+                              sock,
+                              ri_flags,
+                              err == UVWASI_ESUCCESS ? *ro_datalen : 0,
+                              "uiu",
+                              (uint64_t) sock,
+                              ri_data,
+                              ri_data_len,
+                              (uint64_t) ri_flags);
+}
+
+
+uvwasi_errno_t uvwasi_sock_send(uvwasi_t* uvwasi,
+                                uvwasi_fd_t sock,
+                                const uvwasi_ciovec_t* si_data,
+                                uvwasi_size_t si_data_len,
+                                uvwasi_siflags_t si_flags,
+                                uvwasi_size_t* so_datalen) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_SOCK_SEND);
+  err = uvwasi__sock_send(uvwasi,
+                          sock,
+                          si_data,
+                          si_data_len,
+                          si_flags,
+                          so_datalen);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_SOCK_SEND,
+                              start,
+                              err,
+                              sock,
+                              si_flags,
+                              err == UVWASI_ESUCCESS ? *so_datalen : 0,
+                              "ucu",
+                              (uint64_t) sock,
+                              si_data,
+                              si_data_len,
+                              (uint64_t) si_flags);
+}
+
+
+uvwasi_errno_t uvwasi_sock_shutdown(uvwasi_t* uvwasi,
+                                    uvwasi_fd_t sock,
+                                    uvwasi_sdflags_t how) {
+  uint64_t start;
+  uvwasi_errno_t err;
+
+  start = uvwasi__syscall_enter(uvwasi, UVWASI_SYSCALL_SOCK_SHUTDOWN);
+  err = uvwasi__sock_shutdown(uvwasi, sock, how);
+  return uvwasi__syscall_exit(uvwasi,
+                              UVWASI_SYSCALL_SOCK_SHUTDOWN,
+                              start,
+                              err,
+                              sock,
+                              how,
+                              0,
+                              "uu",
+                              (uint64_t) sock,
+                              (uint64_t) how);
+}
+
+
 const char* uvwasi_embedder_err_code_to_string(uvwasi_errno_t code) {
   switch (code) {
 #define V(errcode) case errcode: return #errcode;
@@ -3033,3 +5365,14 @@ const char* uvwasi_embedder_err_code_to_string(uvwasi_errno_t code) {
       return "UVWASI_UNKNOWN_ERROR";
   }
 }
+
+
+const char* uvwasi_embedder_syscall_name(uvwasi_syscall_t syscall) {
+  switch (syscall) {
+#define XX(uc, lc) case UVWASI_SYSCALL_##uc: return #lc;
+    UVWASI_SYSCALL_MAP(XX)
+#undef XX
+    default:
+      return "unknown";
+  }
+}
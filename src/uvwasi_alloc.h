@@ -3,6 +3,9 @@
 
 #include "uvwasi.h"
 
+/* The allocator used when none is given: the C library's. */
+extern const uvwasi_mem_t uvwasi__default_allocator;
+
 void* uvwasi__malloc(const uvwasi_t* uvwasi, size_t size);
 void uvwasi__free(const uvwasi_t* uvwasi, void* ptr);
 void* uvwasi__calloc(const uvwasi_t* uvwasi, size_t nmemb, size_t size);
@@ -0,0 +1,403 @@
+#include <string.h>
+
+#include "uvwasi.h"
+#include "vfs.h"
+#include "fd_table.h"
+#include "wasi_serdes.h"
+#include "clocks.h"
+
+
+uvwasi_errno_t uvwasi__vfs_open(const uvwasi_vfs_t* vfs,
+                                const char* path,
+                                uvwasi_oflags_t oflags,
+                                uvwasi_fdflags_t fdflags,
+                                int writable,
+                                void** file,
+                                uvwasi_filetype_t* type) {
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+
+  err = vfs->open(path, oflags, fdflags, writable, file, vfs->vfs_user_data);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  err = vfs->fstat(*file, &stat, vfs->vfs_user_data);
+  if (err == UVWASI_ESUCCESS &&
+      stat.st_filetype != UVWASI_FILETYPE_DIRECTORY &&
+      ((oflags & UVWASI_O_DIRECTORY) != 0 || path[strlen(path) - 1] == '/')) {
+    err = UVWASI_ENOTDIR;
+  }
+
+  if (err != UVWASI_ESUCCESS) {
+    vfs->close(*file, vfs->vfs_user_data);
+    return err;
+  }
+
+  *type = stat.st_filetype;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_close(struct uvwasi_fd_cold_t* cold) {
+  void* file;
+
+  if (cold->vfs_file == NULL)
+    return UVWASI_ESUCCESS;
+
+  file = cold->vfs_file;
+  cold->vfs_file = NULL;
+  return cold->vfs->close(file, cold->vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_read(struct uvwasi_fd_wrap_t* wrap,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                int64_t offset,
+                                uvwasi_size_t* nread) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_errno_t err;
+
+  cold = wrap->cold;
+  if (cold->vfs->pread == NULL)
+    return UVWASI_ENOTSUP;
+
+  err = cold->vfs->pread(cold->vfs_file,
+                         iovs,
+                         iovs_len,
+                         offset < 0 ? cold->pos : (uvwasi_filesize_t) offset,
+                         nread,
+                         cold->vfs->vfs_user_data);
+  if (err == UVWASI_ESUCCESS && offset < 0)
+    cold->pos += *nread;
+
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_write(struct uvwasi_fd_wrap_t* wrap,
+                                 const uvwasi_ciovec_t* iovs,
+                                 uvwasi_size_t iovs_len,
+                                 int64_t offset,
+                                 uvwasi_size_t* nwritten) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_filestat_t stat;
+  uvwasi_filesize_t pos;
+  uvwasi_errno_t err;
+
+  cold = wrap->cold;
+  if (cold->vfs->pwrite == NULL)
+    return UVWASI_ENOTSUP;
+
+  /* Like the host, appending fds write at the end of the file whatever the
+     offset. */
+  if (cold->vfs_append) {
+    err = cold->vfs->fstat(cold->vfs_file, &stat, cold->vfs->vfs_user_data);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+
+    pos = stat.st_size;
+  } else {
+    pos = offset < 0 ? cold->pos : (uvwasi_filesize_t) offset;
+  }
+
+  err = cold->vfs->pwrite(cold->vfs_file,
+                          iovs,
+                          iovs_len,
+                          pos,
+                          nwritten,
+                          cold->vfs->vfs_user_data);
+  if (err == UVWASI_ESUCCESS && offset < 0)
+    cold->pos = pos + *nwritten;
+
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_seek(struct uvwasi_fd_wrap_t* wrap,
+                                uvwasi_filedelta_t offset,
+                                uvwasi_whence_t whence,
+                                uvwasi_filesize_t* newoffset) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  int64_t base;
+
+  cold = wrap->cold;
+  switch (whence) {
+    case UVWASI_WHENCE_SET:
+      base = 0;
+      break;
+    case UVWASI_WHENCE_CUR:
+      base = (int64_t) cold->pos;
+      break;
+    case UVWASI_WHENCE_END:
+      err = cold->vfs->fstat(cold->vfs_file, &stat, cold->vfs->vfs_user_data);
+      if (err != UVWASI_ESUCCESS)
+        return err;
+
+      base = (int64_t) stat.st_size;
+      break;
+    default:
+      return UVWASI_EINVAL;
+  }
+
+  if ((offset > 0 && base > INT64_MAX - offset) || base + offset < 0)
+    return UVWASI_EINVAL;
+
+  cold->pos = (uvwasi_filesize_t) (base + offset);
+  *newoffset = cold->pos;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_fstat(struct uvwasi_fd_wrap_t* wrap,
+                                 uvwasi_filestat_t* buf) {
+  struct uvwasi_fd_cold_t* cold;
+
+  cold = wrap->cold;
+  return cold->vfs->fstat(cold->vfs_file, buf, cold->vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_set_size(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t size) {
+  struct uvwasi_fd_cold_t* cold;
+
+  cold = wrap->cold;
+  if (cold->vfs->set_size == NULL)
+    return UVWASI_ENOTSUP;
+
+  return cold->vfs->set_size(cold->vfs_file, size, cold->vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_allocate(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t offset,
+                                    uvwasi_filesize_t len) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+
+  cold = wrap->cold;
+  if (cold->vfs->set_size == NULL)
+    return UVWASI_ENOTSUP;
+
+  if (offset > UINT64_MAX - len)
+    return UVWASI_EFBIG;
+
+  err = cold->vfs->fstat(cold->vfs_file, &stat, cold->vfs->vfs_user_data);
+  if (err != UVWASI_ESUCCESS || stat.st_size >= offset + len)
+    return err;
+
+  return cold->vfs->set_size(cold->vfs_file,
+                             offset + len,
+                             cold->vfs->vfs_user_data);
+}
+
+
+/* Replaces the _NOW flags with the current time. */
+static uvwasi_errno_t uvwasi__vfs_resolve_times(uvwasi_timestamp_t* atim,
+                                                uvwasi_timestamp_t* mtim,
+                                                uvwasi_fstflags_t* fst_flags) {
+  uvwasi_timestamp_t now;
+  uvwasi_errno_t err;
+
+  if ((*fst_flags &
+       (UVWASI_FILESTAT_SET_ATIM_NOW | UVWASI_FILESTAT_SET_MTIM_NOW)) == 0) {
+    return UVWASI_ESUCCESS;
+  }
+
+  err = uvwasi__clock_gettime_realtime(&now);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if ((*fst_flags & UVWASI_FILESTAT_SET_ATIM_NOW) != 0) {
+    *atim = now;
+    *fst_flags |= UVWASI_FILESTAT_SET_ATIM;
+  }
+
+  if ((*fst_flags & UVWASI_FILESTAT_SET_MTIM_NOW) != 0) {
+    *mtim = now;
+    *fst_flags |= UVWASI_FILESTAT_SET_MTIM;
+  }
+
+  *fst_flags &= UVWASI_FILESTAT_SET_ATIM | UVWASI_FILESTAT_SET_MTIM;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_fset_times(struct uvwasi_fd_wrap_t* wrap,
+                                      uvwasi_timestamp_t atim,
+                                      uvwasi_timestamp_t mtim,
+                                      uvwasi_fstflags_t fst_flags) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_errno_t err;
+
+  cold = wrap->cold;
+  if (cold->vfs->fset_times == NULL)
+    return UVWASI_ENOTSUP;
+
+  err = uvwasi__vfs_resolve_times(&atim, &mtim, &fst_flags);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  return cold->vfs->fset_times(cold->vfs_file,
+                               atim,
+                               mtim,
+                               fst_flags,
+                               cold->vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_readdir(struct uvwasi_fd_wrap_t* wrap,
+                                   void* buf,
+                                   uvwasi_size_t buf_len,
+                                   uvwasi_dircookie_t cookie,
+                                   uvwasi_size_t* bufused) {
+  struct uvwasi_fd_cold_t* cold;
+  uvwasi_dirent_t dirent;
+  uvwasi_errno_t err;
+  uvwasi_size_t name_size;
+
+  cold = wrap->cold;
+  if (cold->vfs->readdir == NULL)
+    return UVWASI_ENOTSUP;
+
+  /* Names are copied straight into buf, after the room for their entry. A
+     full buffer tells the caller that there are more entries. */
+  *bufused = 0;
+  while (buf_len - *bufused >= UVWASI_SERDES_SIZE_dirent_t) {
+    name_size = buf_len - *bufused - UVWASI_SERDES_SIZE_dirent_t;
+    err = cold->vfs->readdir(cold->vfs_file,
+                             cookie,
+                             &dirent,
+                             (char*) buf + *bufused +
+                                 UVWASI_SERDES_SIZE_dirent_t,
+                             name_size,
+                             cold->vfs->vfs_user_data);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+
+    if (dirent.d_namlen == 0)
+      return UVWASI_ESUCCESS;
+
+    cookie++;
+    dirent.d_next = cookie;
+    uvwasi_serdes_write_dirent_t(buf, *bufused, &dirent);
+    if (dirent.d_namlen >= name_size) {
+      *bufused = buf_len;
+      return UVWASI_ESUCCESS;
+    }
+
+    *bufused += UVWASI_SERDES_SIZE_dirent_t + dirent.d_namlen;
+  }
+
+  *bufused = buf_len;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_stat(const uvwasi_vfs_t* vfs,
+                                const char* path,
+                                uvwasi_filestat_t* buf) {
+  if (vfs->stat == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->stat(path, buf, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_mkdir(const uvwasi_vfs_t* vfs, const char* path) {
+  if (vfs->mkdir == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->mkdir(path, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_rmdir(const uvwasi_vfs_t* vfs, const char* path) {
+  if (vfs->rmdir == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->rmdir(path, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_unlink(const uvwasi_vfs_t* vfs, const char* path) {
+  if (vfs->unlink == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->unlink(path, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_rename(const uvwasi_vfs_t* vfs,
+                                  const char* old_path,
+                                  const char* new_path) {
+  if (vfs->rename == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->rename(old_path, new_path, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_readlink(const uvwasi_vfs_t* vfs,
+                                    const char* path,
+                                    char* buf,
+                                    uvwasi_size_t buf_len,
+                                    uvwasi_size_t* bufused) {
+  uvwasi_errno_t err;
+
+  if (vfs->readlink == NULL)
+    return UVWASI_ENOTSUP;
+
+  err = vfs->readlink(path, buf, buf_len, bufused, vfs->vfs_user_data);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  /* Like the host, leave room to terminate the target. */
+  if (*bufused >= buf_len)
+    return UVWASI_ENOBUFS;
+
+  buf[*bufused] = '\0';
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__vfs_symlink(const uvwasi_vfs_t* vfs,
+                                   const char* target,
+                                   const char* path) {
+  if (vfs->symlink == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->symlink(target, path, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_set_times(const uvwasi_vfs_t* vfs,
+                                     const char* path,
+                                     uvwasi_timestamp_t atim,
+                                     uvwasi_timestamp_t mtim,
+                                     uvwasi_fstflags_t fst_flags) {
+  uvwasi_errno_t err;
+
+  if (vfs->set_times == NULL)
+    return UVWASI_ENOTSUP;
+
+  err = uvwasi__vfs_resolve_times(&atim, &mtim, &fst_flags);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  return vfs->set_times(path, atim, mtim, fst_flags, vfs->vfs_user_data);
+}
+
+
+uvwasi_errno_t uvwasi__vfs_link(const uvwasi_vfs_t* vfs,
+                                const char* old_path,
+                                const char* new_path) {
+  if (vfs->link == NULL)
+    return UVWASI_ENOTSUP;
+
+  return vfs->link(old_path, new_path, vfs->vfs_user_data);
+}
@@ -0,0 +1,88 @@
+#ifndef __UVWASI_VFS_H__
+#define __UVWASI_VFS_H__
+
+#include "uvwasi.h"
+
+struct uvwasi_fd_cold_t;
+struct uvwasi_fd_wrap_t;
+
+/* fds opened through a uvwasi_vfs_t have no host fd. Their cold state holds
+   the file system and the file's handle, and pos is always their file
+   position. Unless noted otherwise, these require the fd's mutex to be
+   held. */
+
+/* Opens path and gets its file type. Fails with UVWASI_ENOTDIR if a directory
+   was asked for and path is something else. */
+uvwasi_errno_t uvwasi__vfs_open(const uvwasi_vfs_t* vfs,
+                                const char* path,
+                                uvwasi_oflags_t oflags,
+                                uvwasi_fdflags_t fdflags,
+                                int writable,
+                                void** file,
+                                uvwasi_filetype_t* type);
+/* Closes the fd's file, if it is still open. */
+uvwasi_errno_t uvwasi__vfs_close(struct uvwasi_fd_cold_t* cold);
+/* offset is -1 to read or write at, and advance, the file position. */
+uvwasi_errno_t uvwasi__vfs_read(struct uvwasi_fd_wrap_t* wrap,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                int64_t offset,
+                                uvwasi_size_t* nread);
+uvwasi_errno_t uvwasi__vfs_write(struct uvwasi_fd_wrap_t* wrap,
+                                 const uvwasi_ciovec_t* iovs,
+                                 uvwasi_size_t iovs_len,
+                                 int64_t offset,
+                                 uvwasi_size_t* nwritten);
+uvwasi_errno_t uvwasi__vfs_seek(struct uvwasi_fd_wrap_t* wrap,
+                                uvwasi_filedelta_t offset,
+                                uvwasi_whence_t whence,
+                                uvwasi_filesize_t* newoffset);
+uvwasi_errno_t uvwasi__vfs_fstat(struct uvwasi_fd_wrap_t* wrap,
+                                 uvwasi_filestat_t* buf);
+uvwasi_errno_t uvwasi__vfs_set_size(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t size);
+/* Grows the file to at least offset + len bytes. */
+uvwasi_errno_t uvwasi__vfs_allocate(struct uvwasi_fd_wrap_t* wrap,
+                                    uvwasi_filesize_t offset,
+                                    uvwasi_filesize_t len);
+/* fst_flags are those of fd_filestat_set_times(). */
+uvwasi_errno_t uvwasi__vfs_fset_times(struct uvwasi_fd_wrap_t* wrap,
+                                      uvwasi_timestamp_t atim,
+                                      uvwasi_timestamp_t mtim,
+                                      uvwasi_fstflags_t fst_flags);
+/* Fills buf the way fd_readdir() does. */
+uvwasi_errno_t uvwasi__vfs_readdir(struct uvwasi_fd_wrap_t* wrap,
+                                   void* buf,
+                                   uvwasi_size_t buf_len,
+                                   uvwasi_dircookie_t cookie,
+                                   uvwasi_size_t* bufused);
+
+/* Path operations, which need the mutex of the fd the path was resolved
+   against. */
+uvwasi_errno_t uvwasi__vfs_stat(const uvwasi_vfs_t* vfs,
+                                const char* path,
+                                uvwasi_filestat_t* buf);
+uvwasi_errno_t uvwasi__vfs_mkdir(const uvwasi_vfs_t* vfs, const char* path);
+uvwasi_errno_t uvwasi__vfs_rmdir(const uvwasi_vfs_t* vfs, const char* path);
+uvwasi_errno_t uvwasi__vfs_unlink(const uvwasi_vfs_t* vfs, const char* path);
+uvwasi_errno_t uvwasi__vfs_rename(const uvwasi_vfs_t* vfs,
+                                  const char* old_path,
+                                  const char* new_path);
+uvwasi_errno_t uvwasi__vfs_readlink(const uvwasi_vfs_t* vfs,
+                                    const char* path,
+                                    char* buf,
+                                    uvwasi_size_t buf_len,
+                                    uvwasi_size_t* bufused);
+uvwasi_errno_t uvwasi__vfs_symlink(const uvwasi_vfs_t* vfs,
+                                   const char* target,
+                                   const char* path);
+uvwasi_errno_t uvwasi__vfs_set_times(const uvwasi_vfs_t* vfs,
+                                     const char* path,
+                                     uvwasi_timestamp_t atim,
+                                     uvwasi_timestamp_t mtim,
+                                     uvwasi_fstflags_t fst_flags);
+uvwasi_errno_t uvwasi__vfs_link(const uvwasi_vfs_t* vfs,
+                                const char* old_path,
+                                const char* new_path);
+
+#endif /* __UVWASI_VFS_H__ */
@@ -13,6 +13,7 @@ int main(void) {
   uvwasi_fd_t fd;
   uvwasi_t uvwasi;
   uvwasi_options_t init_options;
+  uvwasi_memfs_t* memfs;
   uvwasi_rights_t fs_rights_base;
   uvwasi_ciovec_t* ciovecs;
   uvwasi_iovec_t* iovecs;
@@ -35,10 +36,7 @@ int main(void) {
   assert(r == 0 || r == UV_EEXIST);
 
   uvwasi_options_init(&init_options);
-  init_options.preopenc = 1;
-  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
-  init_options.preopens[0].mapped_path = "/var";
-  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  memfs = test_preopen_init(&init_options, "/var", TEST_TMP_DIR);
 
   err = uvwasi_init(&uvwasi, &init_options);
   assert(err == 0);
@@ -217,6 +215,7 @@ int main(void) {
 
   /* Clean things up. */
   uvwasi_destroy(&uvwasi);
+  test_preopen_free(&init_options, memfs);
 
   for (i = 0; i < ciovec_size; ++i) {
     buf = (void*) ciovecs[i].buf;
@@ -229,7 +228,6 @@ int main(void) {
     free(iovecs[i].buf);
 
   free(iovecs);
-  free(init_options.preopens);
 
   return 0;
 }
@@ -0,0 +1,61 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "test-common.h"
+
+#define MAX_RESOLUTION 1000000
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  uvwasi_timestamp_t res;
+  uvwasi_timestamp_t res2;
+  volatile int count;
+  int i;
+
+  setup_test_environment();
+
+  uvwasi_options_init(&init_options);
+
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  // use some cpu time, so that a resolution derived from the clock's current
+  // value would be caught below
+  count = 0;
+  for (i = 0; i < 100000000; i++)
+    count++;
+  assert(count == 100000000);
+
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_REALTIME, &res);
+  assert(err == 0);
+  assert(res > 0 && res <= MAX_RESOLUTION);
+
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_MONOTONIC, &res);
+  assert(err == 0);
+  assert(res > 0 && res <= MAX_RESOLUTION);
+
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_PROCESS_CPUTIME_ID, &res);
+  assert(err == 0);
+  assert(res > 0 && res <= MAX_RESOLUTION);
+
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_THREAD_CPUTIME_ID, &res);
+  assert(err == 0);
+  assert(res > 0 && res <= MAX_RESOLUTION);
+
+  // resolutions are constant
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_THREAD_CPUTIME_ID, &res2);
+  assert(err == 0);
+  assert(res == res2);
+
+  err = uvwasi_clock_res_get(&uvwasi, 4, &res);
+  assert(err == UVWASI_EINVAL);
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_REALTIME, NULL);
+  assert(err == UVWASI_EINVAL);
+
+  uvwasi_destroy(&uvwasi);
+
+  return 0;
+}
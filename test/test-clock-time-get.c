@@ -9,7 +9,9 @@ int main(void) {
   uvwasi_options_t init_options;
   uvwasi_errno_t err;
   uvwasi_timestamp_t time;
+  uvwasi_timestamp_t precise;
   uvwasi_timestamp_t precision = 1000;
+  uvwasi_timestamp_t coarse_precision = 1000000000;
 
   setup_test_environment();
 
@@ -26,6 +28,32 @@ int main(void) {
   assert(err == 0);
   assert(time > 0);
 
+  // a loose precision may be served by a coarse clock, which can lag behind
+  // the precise clock by at most the requested precision
+  err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_REALTIME, 0, &precise);
+  assert(err == 0);
+  err = uvwasi_clock_time_get(&uvwasi,
+                              UVWASI_CLOCK_REALTIME,
+                              coarse_precision,
+                              &time);
+  assert(err == 0);
+  assert(time > 0);
+  assert(time + coarse_precision > precise);
+
+  err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_MONOTONIC, 0, &precise);
+  assert(err == 0);
+  err = uvwasi_clock_time_get(&uvwasi,
+                              UVWASI_CLOCK_MONOTONIC,
+                              coarse_precision,
+                              &time);
+  assert(err == 0);
+  assert(time > 0);
+  assert(time + coarse_precision > precise);
+
+  // the monotonic clock never goes backwards, even when a coarse read
+  // follows a precise one
+  assert(time >= precise);
+
   // use some cpu time
   int count = 0;
   for (int i = 0; i < 100000000; i++) {
@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+
+static void check_args(uvwasi_t* uvwasi) {
+  uvwasi_size_t count;
+  uvwasi_size_t buf_size;
+  char* ptrs[2];
+  char buf[64];
+
+  assert(uvwasi_args_sizes_get(uvwasi, &count, &buf_size) == 0);
+  assert(count == 2);
+  assert(buf_size == 13);
+  assert(uvwasi_args_get(uvwasi, ptrs, buf) == 0);
+  assert(strcmp(ptrs[0], "main.wasm") == 0);
+  assert(strcmp(ptrs[1], "-v") == 0);
+
+  assert(uvwasi_environ_sizes_get(uvwasi, &count, &buf_size) == 0);
+  assert(count == 1);
+  assert(buf_size == 8);
+  assert(uvwasi_environ_get(uvwasi, ptrs, buf) == 0);
+  assert(strcmp(ptrs[0], "HOME=/h") == 0);
+}
+
+static void check_preopens(uvwasi_t* uvwasi) {
+  const char* path = "clone.txt";
+  uvwasi_prestat_t prestat;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  char name[16];
+
+  assert(uvwasi_fd_prestat_get(uvwasi, 3, &prestat) == 0);
+  assert(prestat.u.dir.pr_name_len == 4);
+  assert(uvwasi_fd_prestat_dir_name(uvwasi, 3, name, sizeof(name)) == 0);
+  assert(memcmp(name, "/var", 4) == 0);
+  assert(uvwasi_fd_prestat_get(uvwasi, 4, &prestat) == 0);
+  assert(uvwasi_fd_prestat_dir_name(uvwasi, 4, name, sizeof(name)) == 0);
+  assert(memcmp(name, "/mem", 4) == 0);
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_READ,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  assert(fd == 5);
+  assert(uvwasi_fd_close(uvwasi, fd) == 0);
+  err = uvwasi_path_filestat_get(uvwasi, 3, 0, path, strlen(path) + 1, &stat);
+  assert(err == 0);
+  assert(uvwasi_path_unlink_file(uvwasi, 3, path, strlen(path) + 1) == 0);
+
+  err = uvwasi_path_create_directory(uvwasi, 4, "d", 2);
+  assert(err == 0 || err == UVWASI_EEXIST);
+  err = uvwasi_path_filestat_get(uvwasi, 4, 0, "d", 2, &stat);
+  assert(err == 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_DIRECTORY);
+}
+
+int main(void) {
+  const char* path = "template.txt";
+  uvwasi_t template;
+  uvwasi_t clone;
+  uvwasi_t clone2;
+  uvwasi_options_t init_options;
+  uvwasi_mem_stats_t stats;
+  uvwasi_mem_t allocator;
+  counting_counts_t counts;
+  uvwasi_memfs_t* memfs;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  const char* argv[2];
+  const char* envp[2];
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  counting_allocator_init(&allocator, &counts);
+  assert(uvwasi_memfs_new(&allocator, 0, &memfs) == 0);
+
+  argv[0] = "main.wasm";
+  argv[1] = "-v";
+  envp[0] = "HOME=/h";
+  envp[1] = NULL;
+  uvwasi_options_init(&init_options);
+  init_options.allocator = &allocator;
+  init_options.enable_mem_stats = 1;
+  init_options.argc = 2;
+  init_options.argv = argv;
+  init_options.envp = envp;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  init_options.preopen_vfsc = 1;
+  init_options.preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  init_options.preopen_vfs[0].mapped_path = "/mem";
+  init_options.preopen_vfs[0].vfs = uvwasi_memfs_vfs(memfs);
+  err = uvwasi_init(&template, &init_options);
+  assert(err == 0);
+  free(init_options.preopens);
+  free(init_options.preopen_vfs);
+
+  assert(uvwasi_clone(NULL, &template) == UVWASI_EINVAL);
+  assert(uvwasi_clone(&clone, NULL) == UVWASI_EINVAL);
+
+  /* A file the template has open is not carried over. */
+  err = uvwasi_path_open(&template,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_READ,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  assert(fd == 5);
+
+  err = uvwasi_clone(&clone, &template);
+  assert(err == 0);
+  assert(clone.argv == template.argv);
+  assert(clone.env == template.env);
+  assert(uvwasi_fd_filestat_get(&clone, 5, &stat) == UVWASI_EBADF);
+  assert(uvwasi_fd_close(&template, fd) == 0);
+  err = uvwasi_path_unlink_file(&template, 3, path, strlen(path) + 1);
+  assert(err == 0);
+
+  /* The clone has an account of its own. */
+  assert(uvwasi_mem_stats_get(&clone, &stats) == 0);
+  assert(stats.current_bytes > 0);
+
+  /* A clone keeps working, and can be cloned, once the template is gone. */
+  check_args(&clone);
+  check_preopens(&clone);
+  uvwasi_destroy(&template);
+  check_args(&clone);
+  check_preopens(&clone);
+
+  err = uvwasi_clone(&clone2, &clone);
+  assert(err == 0);
+  uvwasi_destroy(&clone);
+  check_args(&clone2);
+  check_preopens(&clone2);
+
+  /* Closing a clone's preopen leaves the other sandboxes' alone. */
+  err = uvwasi_clone(&clone, &clone2);
+  assert(err == 0);
+  assert(uvwasi_fd_close(&clone, 3) == 0);
+  check_preopens(&clone2);
+  uvwasi_destroy(&clone);
+  uvwasi_destroy(&clone2);
+
+  assert(uvwasi_memfs_free(memfs) == 0);
+  assert(counts.live == 0);
+  return 0;
+}
@@ -1,3 +1,7 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "uvwasi.h"
+
 #ifdef _WIN32
 #include "crtdbg.h"
 #endif
@@ -8,3 +12,97 @@ void static inline setup_test_environment(void) {
   _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_DEBUG);
 #endif 
 }
+
+/* Counts kept by the allocator from counting_allocator_init(): the calls made
+   to it, and the allocations that have not been freed yet. */
+typedef struct counting_counts_s {
+  uint64_t calls;
+  int64_t live;
+} counting_counts_t;
+
+static inline void* counting_malloc(size_t size, void* mem_user_data) {
+  counting_counts_t* counts = mem_user_data;
+
+  counts->calls++;
+  counts->live++;
+  return malloc(size);
+}
+
+static inline void counting_free(void* ptr, void* mem_user_data) {
+  counting_counts_t* counts = mem_user_data;
+
+  if (ptr != NULL) {
+    counts->calls++;
+    counts->live--;
+  }
+  free(ptr);
+}
+
+static inline void* counting_calloc(size_t nmemb,
+                                    size_t size,
+                                    void* mem_user_data) {
+  counting_counts_t* counts = mem_user_data;
+
+  counts->calls++;
+  counts->live++;
+  return calloc(nmemb, size);
+}
+
+static inline void* counting_realloc(void* ptr,
+                                     size_t size,
+                                     void* mem_user_data) {
+  counting_counts_t* counts = mem_user_data;
+
+  counts->calls++;
+  if (ptr == NULL)
+    counts->live++;
+  return realloc(ptr, size);
+}
+
+static inline void counting_allocator_init(uvwasi_mem_t* allocator,
+                                           counting_counts_t* counts) {
+  counts->calls = 0;
+  counts->live = 0;
+  allocator->mem_user_data = counts;
+  allocator->malloc = counting_malloc;
+  allocator->free = counting_free;
+  allocator->calloc = counting_calloc;
+  allocator->realloc = counting_realloc;
+}
+
+/* Preopens real_path at mapped_path or, when the UVWASI_TEST_MEMFS
+   environment variable is set, an empty memfs in its place, so that a test
+   runs against either. Returns the memfs, if any, for test_preopen_free()
+   once the sandbox is destroyed. */
+static inline uvwasi_memfs_t* test_preopen_init(uvwasi_options_t* options,
+                                                const char* mapped_path,
+                                                const char* real_path) {
+  uvwasi_memfs_t* memfs;
+  const char* env;
+
+  env = getenv("UVWASI_TEST_MEMFS");
+  if (env == NULL || env[0] == '\0') {
+    options->preopenc = 1;
+    options->preopens = calloc(1, sizeof(uvwasi_preopen_t));
+    options->preopens[0].mapped_path = mapped_path;
+    options->preopens[0].real_path = real_path;
+    return NULL;
+  }
+
+  assert(0 == uvwasi_memfs_new(NULL, 0, &memfs));
+  options->preopen_vfsc = 1;
+  options->preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  options->preopen_vfs[0].mapped_path = mapped_path;
+  options->preopen_vfs[0].vfs = uvwasi_memfs_vfs(memfs);
+  return memfs;
+}
+
+static inline void test_preopen_free(uvwasi_options_t* options,
+                                     uvwasi_memfs_t* memfs) {
+  free(options->preopens);
+  free(options->preopen_vfs);
+  options->preopens = NULL;
+  options->preopen_vfs = NULL;
+  if (memfs != NULL)
+    assert(0 == uvwasi_memfs_free(memfs));
+}
@@ -27,6 +27,9 @@ int main(void) {
 
   setup_test_environment();
 
+  /* Every call reads the sandbox's stats, trace and record state before it
+     validates its arguments, so the sandbox must not be garbage. */
+  memset(&uvw, 0, sizeof(uvw));
   test_void = (void*) &test_fdstat;
 
   CHECK(uvwasi_args_get(NULL, &test_str, test_str));
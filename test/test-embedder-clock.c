@@ -0,0 +1,129 @@
+#include <assert.h>
+#include "uvwasi.h"
+#include "test-common.h"
+
+typedef struct virtual_clock_s {
+  uvwasi_timestamp_t now;
+  uvwasi_timestamp_t last_precision;
+  int gettime_calls;
+} virtual_clock_t;
+
+static uvwasi_errno_t virtual_gettime(uvwasi_clockid_t clock_id,
+                                      uvwasi_timestamp_t precision,
+                                      uvwasi_timestamp_t* time,
+                                      void* clock_user_data) {
+  virtual_clock_t* vc = clock_user_data;
+
+  vc->gettime_calls++;
+  vc->last_precision = precision;
+
+  if (clock_id == UVWASI_CLOCK_REALTIME)
+    *time = vc->now + 1000;
+  else
+    *time = vc->now;
+
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t virtual_getres(uvwasi_clockid_t clock_id,
+                                     uvwasi_timestamp_t* resolution,
+                                     void* clock_user_data) {
+  (void) clock_id;
+  (void) clock_user_data;
+  *resolution = 1000;
+  return UVWASI_ESUCCESS;
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_clock_t clock;
+  virtual_clock_t vc;
+  uvwasi_subscription_t sub;
+  uvwasi_event_t event;
+  uvwasi_size_t nevents;
+  uvwasi_timestamp_t time;
+  uvwasi_errno_t err;
+
+  setup_test_environment();
+
+  vc.now = 5000;
+  vc.last_precision = 0;
+  vc.gettime_calls = 0;
+  clock.clock_user_data = &vc;
+  clock.gettime = virtual_gettime;
+  clock.getres = virtual_getres;
+
+  /* A clock without a gettime callback is rejected. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.clock == NULL);
+  clock.gettime = NULL;
+  init_options.clock = &clock;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == UVWASI_EINVAL);
+  clock.gettime = virtual_gettime;
+
+  uvwasi_options_init(&init_options);
+  init_options.clock = &clock;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_MONOTONIC, 7, &time);
+  assert(err == 0);
+  assert(time == 5000);
+  assert(vc.last_precision == 7);
+
+  err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_REALTIME, 0, &time);
+  assert(err == 0);
+  assert(time == 6000);
+  assert(vc.gettime_calls == 2);
+
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_MONOTONIC, &time);
+  assert(err == 0);
+  assert(time == 1000);
+
+  /* CPU time clocks are not virtualized. */
+  err = uvwasi_clock_time_get(&uvwasi,
+                              UVWASI_CLOCK_PROCESS_CPUTIME_ID,
+                              0,
+                              &time);
+  assert(err == 0);
+  assert(vc.gettime_calls == 2);
+
+  /* Absolute timeouts are measured against the virtual clock. A deadline
+     that has already passed fires without blocking. */
+  sub.userdata = 42;
+  sub.type = UVWASI_EVENTTYPE_CLOCK;
+  sub.u.clock.clock_id = UVWASI_CLOCK_MONOTONIC;
+  sub.u.clock.timeout = 4000;
+  sub.u.clock.precision = 1;
+  sub.u.clock.flags = UVWASI_SUBSCRIPTION_CLOCK_ABSTIME;
+  err = uvwasi_poll_oneoff(&uvwasi, &sub, &event, 1, &nevents);
+  assert(err == 0);
+  assert(nevents == 1);
+  assert(event.userdata == 42);
+  assert(event.error == UVWASI_ESUCCESS);
+  assert(event.type == UVWASI_EVENTTYPE_CLOCK);
+  assert(vc.gettime_calls == 3);
+
+  sub.u.clock.timeout = vc.now + 1000000;
+  err = uvwasi_poll_oneoff(&uvwasi, &sub, &event, 1, &nevents);
+  assert(err == 0);
+  assert(nevents == 1);
+  assert(event.type == UVWASI_EVENTTYPE_CLOCK);
+
+  uvwasi_destroy(&uvwasi);
+
+  /* Without a getres callback the reported resolution is 1ns. */
+  clock.getres = NULL;
+  uvwasi_options_init(&init_options);
+  init_options.clock = &clock;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  err = uvwasi_clock_res_get(&uvwasi, UVWASI_CLOCK_REALTIME, &time);
+  assert(err == 0);
+  assert(time == 1);
+  uvwasi_destroy(&uvwasi);
+
+  return 0;
+}
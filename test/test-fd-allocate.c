@@ -0,0 +1,121 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif /* defined(__linux__) */
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_FILE TEST_TMP_DIR "/fd-allocate.bin"
+#define TEST_PATH "fd-allocate.bin"
+#define ALLOC_SIZE (1024 * 1024)
+
+static void host_stat(uv_stat_t* stat) {
+  uv_fs_t req;
+
+  assert(0 == uv_fs_stat(NULL, &req, TEST_FILE, NULL));
+  *stat = req.statbuf;
+  uv_fs_req_cleanup(&req);
+}
+
+#if defined(__linux__)
+/* Returns 0 if the file system holding the test file cannot reserve storage,
+   in which case uvwasi_fd_allocate() only sets the size. */
+static int host_reserves_storage(void) {
+  int fd;
+  int r;
+
+  fd = open(TEST_FILE, O_WRONLY);
+  assert(fd >= 0);
+  r = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, 1);
+  assert(r == 0 || errno == EOPNOTSUPP);
+  close(fd);
+  return r == 0;
+}
+#endif /* defined(__linux__) */
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_t uvwasi;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uv_stat_t stat;
+  uv_fs_t req;
+#if defined(__linux__)
+  int reserves;
+#endif /* defined(__linux__) */
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  uvwasi_options_init(&init_options);
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  assert(0 == uvwasi_init(&uvwasi, &init_options));
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         TEST_PATH,
+                         strlen(TEST_PATH) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_ALLOCATE | UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+#if defined(__linux__)
+  reserves = host_reserves_storage();
+#endif /* defined(__linux__) */
+
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 0, ALLOC_SIZE));
+  host_stat(&stat);
+  assert(stat.st_size == ALLOC_SIZE);
+#if defined(__linux__)
+  /* Storage is reserved rather than left sparse, where the file system can
+     reserve it. st_blocks counts 512 byte units. */
+  assert(!reserves || stat.st_blocks * 512 >= ALLOC_SIZE);
+#endif /* defined(__linux__) */
+
+  /* Allocating within the file never shrinks it. */
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 100, 10));
+  host_stat(&stat);
+  assert(stat.st_size == ALLOC_SIZE);
+
+  /* A range past the end grows the file to its end. */
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 2 * ALLOC_SIZE, ALLOC_SIZE));
+  host_stat(&stat);
+  assert(stat.st_size == 3 * ALLOC_SIZE);
+#if defined(__linux__)
+  assert(!reserves || stat.st_blocks * 512 >= 2 * ALLOC_SIZE);
+#endif /* defined(__linux__) */
+
+  /* An empty range only grows the file to its offset. */
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 4 * ALLOC_SIZE, 0));
+  host_stat(&stat);
+  assert(stat.st_size == 4 * ALLOC_SIZE);
+
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  r = uv_fs_unlink(NULL, &req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_SRC "fd-copy-src.bin"
+#define TEST_DST "fd-copy-dst.bin"
+#define FILE_SIZE (300 * 1024)
+
+static char data[FILE_SIZE];
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_oflags_t oflags,
+                             uvwasi_rights_t rights) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         oflags,
+                         rights,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  return fd;
+}
+
+static void check_contents(uvwasi_t* uvwasi,
+                           uvwasi_fd_t fd,
+                           uvwasi_filesize_t offset,
+                           const char* expected,
+                           uvwasi_size_t len) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char* buf;
+
+  buf = malloc(len);
+  assert(buf != NULL);
+  iov.buf = buf;
+  iov.buf_len = len;
+  assert(0 == uvwasi_fd_pread(uvwasi, fd, &iov, 1, offset, &nread));
+  assert(nread == len);
+  assert(memcmp(buf, expected, len) == 0);
+  free(buf);
+}
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_filesize_t copied;
+  uvwasi_filesize_t pos;
+  uvwasi_ciovec_t ciov;
+  uvwasi_size_t nwritten;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t src;
+  uvwasi_fd_t dst;
+  uvwasi_fd_t check;
+  uvwasi_fd_t ro;
+  uv_fs_t req;
+  char expected[8];
+  size_t i;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  for (i = 0; i < FILE_SIZE; i++)
+    data[i] = (char) (i * 7 + i / 251);
+
+  uvwasi_options_init(&init_options);
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  assert(0 == uvwasi_init(&uvwasi, &init_options));
+
+  src = open_file(&uvwasi,
+                  TEST_SRC,
+                  UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                  UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_WRITE |
+                  UVWASI_RIGHT_FD_SEEK | UVWASI_RIGHT_FD_TELL);
+  ciov.buf = data;
+  ciov.buf_len = FILE_SIZE;
+  assert(0 == uvwasi_fd_write(&uvwasi, src, &ciov, 1, &nwritten));
+  assert(nwritten == FILE_SIZE);
+  dst = open_file(&uvwasi,
+                  TEST_DST,
+                  UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                  UVWASI_RIGHT_FD_WRITE | UVWASI_RIGHT_FD_SEEK |
+                  UVWASI_RIGHT_FD_TELL);
+  check = open_file(&uvwasi,
+                    TEST_DST,
+                    0,
+                    UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_SEEK);
+
+  /* A copy starts at the given offset and leaves the source's position
+     alone. The destination's position advances. */
+  assert(0 == uvwasi_fd_copy(&uvwasi, src, dst, 10, 200000, &copied));
+  assert(copied == 200000);
+  assert(0 == uvwasi_fd_tell(&uvwasi, src, &pos));
+  assert(pos == FILE_SIZE);
+  assert(0 == uvwasi_fd_tell(&uvwasi, dst, &pos));
+  assert(pos == 200000);
+  check_contents(&uvwasi, check, 0, data + 10, 200000);
+
+  /* Copies stop at the end of the source. */
+  assert(0 == uvwasi_fd_copy(&uvwasi, src, dst, 250000, 100000, &copied));
+  assert(copied == FILE_SIZE - 250000);
+  check_contents(&uvwasi, check, 200000, data + 250000, FILE_SIZE - 250000);
+  assert(0 == uvwasi_fd_copy(&uvwasi, src, dst, FILE_SIZE, 10, &copied));
+  assert(copied == 0);
+  assert(0 == uvwasi_fd_copy(&uvwasi, src, dst, 0, 0, &copied));
+  assert(copied == 0);
+
+  /* Copies go to the destination's current position. */
+  assert(0 == uvwasi_fd_seek(&uvwasi, dst, 5, UVWASI_WHENCE_SET, &pos));
+  assert(0 == uvwasi_fd_copy(&uvwasi, src, dst, 0, 3, &copied));
+  assert(copied == 3);
+  check_contents(&uvwasi, check, 0, data + 10, 5);
+  check_contents(&uvwasi, check, 5, data, 3);
+
+  /* The fds need the same rights as fd_pread() and fd_write(). */
+  ro = open_file(&uvwasi, TEST_SRC, 0, UVWASI_RIGHT_FD_READ);
+  assert(UVWASI_ENOTCAPABLE ==
+         uvwasi_fd_copy(&uvwasi, ro, dst, 0, 1, &copied));
+  assert(UVWASI_ENOTCAPABLE ==
+         uvwasi_fd_copy(&uvwasi, src, check, 0, 1, &copied));
+  assert(UVWASI_EBADF == uvwasi_fd_copy(&uvwasi, 100, dst, 0, 1, &copied));
+  assert(UVWASI_EINVAL == uvwasi_fd_copy(&uvwasi, src, src, 0, 1, &copied));
+  assert(UVWASI_EINVAL == uvwasi_fd_copy(&uvwasi, src, dst, 0, 1, NULL));
+  assert(UVWASI_EINVAL == uvwasi_fd_copy(NULL, src, dst, 0, 1, &copied));
+
+  /* The source can have the higher fd number. */
+  assert(check > src);
+  assert(0 == uvwasi_fd_copy(&uvwasi, check, src, 0, 8, &copied));
+  assert(copied == 8);
+  memcpy(expected, data + 10, 5);
+  memcpy(expected + 5, data, 3);
+  check_contents(&uvwasi, src, FILE_SIZE, expected, 8);
+
+  assert(0 == uvwasi_fd_close(&uvwasi, ro));
+  assert(0 == uvwasi_fd_close(&uvwasi, check));
+  assert(0 == uvwasi_fd_close(&uvwasi, dst));
+  assert(0 == uvwasi_fd_close(&uvwasi, src));
+  assert(0 == uvwasi_path_unlink_file(&uvwasi,
+                                      3,
+                                      TEST_SRC,
+                                      strlen(TEST_SRC) + 1));
+  assert(0 == uvwasi_path_unlink_file(&uvwasi,
+                                      3,
+                                      TEST_DST,
+                                      strlen(TEST_DST) + 1));
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+  return 0;
+}
@@ -0,0 +1,221 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_FILE TEST_TMP_DIR "/fd-mmap.bin"
+#define TEST_PATH "fd-mmap.bin"
+#define WINDOW_SIZE 4096
+/* Larger than all of the windows an fd keeps mapped. */
+#define FILE_SIZE (WINDOW_SIZE * 9 + 123)
+
+static char expected[FILE_SIZE + 64];
+
+static void write_host(int64_t offset, const char* data, size_t len) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int fd;
+  int r;
+
+  fd = uv_fs_open(NULL,
+                  &req,
+                  TEST_FILE,
+                  UV_FS_O_WRONLY | UV_FS_O_CREAT,
+                  0644,
+                  NULL);
+  uv_fs_req_cleanup(&req);
+  assert(fd >= 0);
+  buf = uv_buf_init((char*) data, len);
+  r = uv_fs_write(NULL, &req, fd, &buf, 1, offset, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == (int) len);
+  assert(0 == uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi, uvwasi_rights_t rights) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         TEST_PATH,
+                         strlen(TEST_PATH) + 1,
+                         0,
+                         rights,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  return fd;
+}
+
+static void check_pread(uvwasi_t* uvwasi,
+                        uvwasi_fd_t fd,
+                        uvwasi_filesize_t offset,
+                        uvwasi_size_t len,
+                        uvwasi_size_t file_size) {
+  uvwasi_iovec_t iovs[2];
+  uvwasi_size_t nread;
+  uvwasi_size_t want;
+  char buf[2 * WINDOW_SIZE + 16];
+
+  assert(len <= sizeof(buf));
+  iovs[0].buf = buf;
+  iovs[0].buf_len = len / 2;
+  iovs[1].buf = buf + len / 2;
+  iovs[1].buf_len = len - len / 2;
+  assert(0 == uvwasi_fd_pread(uvwasi, fd, iovs, 2, offset, &nread));
+
+  want = offset >= file_size ? 0 : file_size - (uvwasi_size_t) offset;
+  if (want > len)
+    want = len;
+  assert(nread == want);
+  assert(0 == memcmp(buf, expected + offset, nread));
+}
+
+static void check_read(uvwasi_t* uvwasi,
+                       uvwasi_fd_t fd,
+                       uvwasi_size_t len,
+                       uvwasi_filesize_t pos,
+                       uvwasi_size_t want) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char buf[WINDOW_SIZE * 2];
+
+  assert(len <= sizeof(buf));
+  iov.buf = buf;
+  iov.buf_len = len;
+  assert(0 == uvwasi_fd_read(uvwasi, fd, &iov, 1, &nread));
+  assert(nread == want);
+  assert(0 == memcmp(buf, expected + pos, nread));
+}
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_filesize_t offset;
+  uvwasi_ciovec_t ciov;
+  uvwasi_size_t n;
+  uvwasi_t uvwasi;
+  uvwasi_t uvwasi2;
+  uvwasi_fd_t writer;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  uint32_t seed;
+  int r;
+  int i;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  for (i = 0; i < (int) sizeof(expected); i++)
+    expected[i] = (char) (i * 7 + i / 251);
+  uv_fs_unlink(NULL, &req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&req);
+  write_host(0, expected, FILE_SIZE);
+
+  uvwasi_options_init(&init_options);
+  assert(init_options.mmap_window_size == 0);
+  init_options.mmap_window_size = WINDOW_SIZE;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  assert(0 == uvwasi_init(&uvwasi, &init_options));
+
+  fd = open_file(&uvwasi,
+                 UVWASI_RIGHT_FD_READ |
+                   UVWASI_RIGHT_FD_SEEK |
+                   UVWASI_RIGHT_FD_TELL);
+
+  /* Reads within, across, and past the end of windows. */
+  check_pread(&uvwasi, fd, 0, 100, FILE_SIZE);
+  check_pread(&uvwasi, fd, WINDOW_SIZE - 10, 20, FILE_SIZE);
+  check_pread(&uvwasi, fd, 100, 2 * WINDOW_SIZE + 16, FILE_SIZE);
+  check_pread(&uvwasi, fd, FILE_SIZE - 50, 100, FILE_SIZE);
+  check_pread(&uvwasi, fd, FILE_SIZE, 100, FILE_SIZE);
+  check_pread(&uvwasi, fd, FILE_SIZE + 1000, 100, FILE_SIZE);
+  seed = 12345;
+  for (i = 0; i < 1000; i++) {
+    seed = seed * 1103515245 + 12345;
+    offset = (seed >> 8) % FILE_SIZE;
+    check_pread(&uvwasi, fd, offset, (seed >> 4) % 300 + 1, FILE_SIZE);
+  }
+
+  /* fd_read() advances a file position that fd_tell() and fd_seek() see. */
+  check_read(&uvwasi, fd, 1000, 0, 1000);
+  check_read(&uvwasi, fd, WINDOW_SIZE, 1000, WINDOW_SIZE);
+  assert(0 == uvwasi_fd_tell(&uvwasi, fd, &offset));
+  assert(offset == 1000 + WINDOW_SIZE);
+  assert(0 == uvwasi_fd_seek(&uvwasi, fd, 10, UVWASI_WHENCE_CUR, &offset));
+  assert(offset == 1010 + WINDOW_SIZE);
+  check_read(&uvwasi, fd, 10, 1010 + WINDOW_SIZE, 10);
+  assert(0 == uvwasi_fd_seek(&uvwasi, fd, -5, UVWASI_WHENCE_END, &offset));
+  assert(offset == FILE_SIZE - 5);
+  check_read(&uvwasi, fd, 100, FILE_SIZE - 5, 5);
+  check_read(&uvwasi, fd, 100, FILE_SIZE, 0);
+
+  /* Growth by another process is seen at the end of the file. */
+  write_host(FILE_SIZE, expected + FILE_SIZE, 64);
+  check_read(&uvwasi, fd, 100, FILE_SIZE, 64);
+  check_pread(&uvwasi, fd, FILE_SIZE - 10, 100, FILE_SIZE + 64);
+
+  /* Writes and truncation through the sandbox are seen immediately. */
+  writer = open_file(&uvwasi,
+                     UVWASI_RIGHT_FD_WRITE |
+                       UVWASI_RIGHT_FD_SEEK |
+                       UVWASI_RIGHT_FD_FILESTAT_SET_SIZE);
+  memset(expected + 200, 'z', 50);
+  ciov.buf = expected + 200;
+  ciov.buf_len = 50;
+  assert(0 == uvwasi_fd_pwrite(&uvwasi, writer, &ciov, 1, 200, &n));
+  assert(n == 50);
+  check_pread(&uvwasi, fd, 150, 200, FILE_SIZE + 64);
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi, writer, WINDOW_SIZE + 7));
+  check_pread(&uvwasi, fd, WINDOW_SIZE, 100, WINDOW_SIZE + 7);
+  check_pread(&uvwasi, fd, 3 * WINDOW_SIZE, 100, WINDOW_SIZE + 7);
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi, writer, 0));
+  check_pread(&uvwasi, fd, 0, 100, 0);
+  assert(0 == uvwasi_fd_close(&uvwasi, writer));
+
+  /* So are those through a sandbox that does not map files itself. */
+  init_options.mmap_window_size = 0;
+  assert(0 == uvwasi_init(&uvwasi2, &init_options));
+  writer = open_file(&uvwasi2,
+                     UVWASI_RIGHT_FD_WRITE |
+                       UVWASI_RIGHT_FD_SEEK |
+                       UVWASI_RIGHT_FD_FILESTAT_SET_SIZE);
+  ciov.buf = expected;
+  ciov.buf_len = 100;
+  assert(0 == uvwasi_fd_pwrite(&uvwasi2, writer, &ciov, 1, 0, &n));
+  check_pread(&uvwasi, fd, 0, 200, 100);
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi2, writer, 40));
+  check_pread(&uvwasi, fd, 0, 200, 40);
+  assert(0 == uvwasi_fd_close(&uvwasi2, writer));
+  uvwasi_destroy(&uvwasi2);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  /* Files opened for writing are read as usual. */
+  write_host(0, expected, FILE_SIZE);
+  fd = open_file(&uvwasi,
+                 UVWASI_RIGHT_FD_READ |
+                   UVWASI_RIGHT_FD_WRITE |
+                   UVWASI_RIGHT_FD_SEEK);
+  check_pread(&uvwasi, fd, WINDOW_SIZE - 10, 20, FILE_SIZE);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  r = uv_fs_unlink(NULL, &req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
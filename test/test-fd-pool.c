@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define FD_COUNT 100
+
+static void open_files(uvwasi_t* uvwasi, const char* path, uvwasi_fd_t* fds) {
+  uvwasi_errno_t err;
+  int i;
+  int j;
+
+  for (i = 0; i < FD_COUNT; i++) {
+    err = uvwasi_path_open(uvwasi,
+                           3,
+                           0,
+                           path,
+                           strlen(path) + 1,
+                           UVWASI_O_CREAT,
+                           UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_FILESTAT_GET,
+                           0,
+                           0,
+                           &fds[i]);
+    assert(err == 0);
+    for (j = 0; j < i; j++)
+      assert(fds[i] != fds[j]);
+  }
+}
+
+static void check_files(uvwasi_t* uvwasi, const uvwasi_fd_t* fds) {
+  uvwasi_fdstat_t fdstat;
+  int i;
+
+  for (i = 0; i < FD_COUNT; i++) {
+    assert(0 == uvwasi_fd_fdstat_get(uvwasi, fds[i], &fdstat));
+    assert(fdstat.fs_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+    assert(fdstat.fs_rights_base ==
+           (UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_FILESTAT_GET));
+  }
+}
+
+static void close_files(uvwasi_t* uvwasi, const uvwasi_fd_t* fds, int count) {
+  int i;
+
+  for (i = 0; i < count; i++)
+    assert(0 == uvwasi_fd_close(uvwasi, fds[i]));
+}
+
+int main(void) {
+  const char* path = "fd-pool.txt";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_mem_stats_t stats;
+  uvwasi_mem_stats_t stats2;
+  uvwasi_fd_t fds[FD_COUNT];
+  uvwasi_prestat_t prestat;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  uvwasi_options_init(&init_options);
+  init_options.enable_mem_stats = 1;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  /* Enough descriptors to need more than one block of table slots. */
+  open_files(&uvwasi, path, fds);
+  check_files(&uvwasi, fds);
+
+  /* Renumbering returns the destination's entry to the pool. */
+  assert(0 == uvwasi_fd_renumber(&uvwasi, fds[0], fds[1]));
+  assert(uvwasi_fd_close(&uvwasi, fds[0]) == UVWASI_EBADF);
+  fds[0] = fds[1];
+  check_files(&uvwasi, fds);
+  close_files(&uvwasi, fds + 1, FD_COUNT - 1);
+
+  /* Reopening the same number of files reuses pooled memory. */
+  assert(0 == uvwasi_mem_stats_get(&uvwasi, &stats));
+  open_files(&uvwasi, path, fds);
+  check_files(&uvwasi, fds);
+  assert(0 == uvwasi_mem_stats_get(&uvwasi, &stats2));
+  assert(stats2.current_bytes == stats.current_bytes);
+  assert(stats2.live_allocations == stats.live_allocations);
+
+  /* Entries for preopens are unaffected by the churn. */
+  assert(0 == uvwasi_fd_prestat_get(&uvwasi, 3, &prestat));
+  assert(prestat.u.dir.pr_name_len == strlen("/var"));
+
+  /* The remaining descriptors are released with the sandbox. */
+  close_files(&uvwasi, fds, FD_COUNT / 2);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  assert(err == 0);
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+  return 0;
+}
@@ -15,6 +15,7 @@ int main(void) {
   uvwasi_fd_t fd;
   uvwasi_filesize_t large_offset = (uint64_t) INT64_MAX + 1;
   uvwasi_options_t init_options;
+  uvwasi_memfs_t* memfs;
   uvwasi_rights_t fs_rights_base;
   uvwasi_size_t nread;
   uvwasi_size_t iovs_len = 1;
@@ -29,10 +30,7 @@ int main(void) {
   assert(r == 0 || r == UV_EEXIST);
 
   uvwasi_options_init(&init_options);
-  init_options.preopenc = 1;
-  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
-  init_options.preopens[0].mapped_path = "/var";
-  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  memfs = test_preopen_init(&init_options, "/var", TEST_TMP_DIR);
 
   err = uvwasi_init(&uvwasi, &init_options);
   assert(err == 0);
@@ -71,13 +69,13 @@ int main(void) {
   assert(err == UVWASI_EINVAL);
 
   uvwasi_destroy(&uvwasi);
+  test_preopen_free(&init_options, memfs);
 
   for (int i = 0; i < iovs_len; i++) {
     free((void *) iovs[i].buf);
   }
 
   free(iovs);
-  free(init_options.preopens);
 
   return 0;
 }
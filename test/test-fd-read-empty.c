@@ -14,6 +14,7 @@ int main(void) {
   uvwasi_iovec_t* iovs;
   uvwasi_fd_t fd;
   uvwasi_options_t init_options;
+  uvwasi_memfs_t* memfs;
   uvwasi_rights_t fs_rights_base;
   uvwasi_size_t nwritten;
   uvwasi_size_t iovs_len = 0;
@@ -28,10 +29,7 @@ int main(void) {
   assert(r == 0 || r == UV_EEXIST);
 
   uvwasi_options_init(&init_options);
-  init_options.preopenc = 1;
-  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
-  init_options.preopens[0].mapped_path = "/var";
-  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  memfs = test_preopen_init(&init_options, "/var", TEST_TMP_DIR);
 
   err = uvwasi_init(&uvwasi, &init_options);
   assert(err == 0);
@@ -70,13 +68,13 @@ int main(void) {
   assert(err == UVWASI_ESUCCESS);
 
   uvwasi_destroy(&uvwasi);
+  test_preopen_free(&init_options, memfs);
 
   for (int i = 0; i < iovs_len; i++) {
     free((void *) iovs[i].buf);
   }
 
   free(iovs);
-  free(init_options.preopens);
 
   return 0;
 }
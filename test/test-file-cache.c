@@ -0,0 +1,258 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_FILE_A TEST_TMP_DIR "/file-cache-a.txt"
+#define TEST_FILE_B TEST_TMP_DIR "/file-cache-b.txt"
+#define TEST_FILE_BIG TEST_TMP_DIR "/file-cache-big.txt"
+#define TEST_FILE_C TEST_TMP_DIR "/file-cache-c.txt"
+#define CACHE_LIMIT 64
+#define CONTENTS_B "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+
+static void write_host(const char* path, const char* data) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int fd;
+  int r;
+
+  fd = uv_fs_open(NULL,
+                  &req,
+                  path,
+                  UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                  0644,
+                  NULL);
+  uv_fs_req_cleanup(&req);
+  assert(fd >= 0);
+  buf = uv_buf_init((char*) data, strlen(data));
+  r = uv_fs_write(NULL, &req, fd, &buf, 1, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == (int) strlen(data));
+  assert(0 == uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+static void init(uvwasi_t* uvwasi,
+                 uvwasi_options_t* init_options,
+                 uvwasi_file_cache_t* cache,
+                 int immutable) {
+  uvwasi_preopen_t* preopens;
+
+  uvwasi_options_init(init_options);
+  assert(init_options->file_cache == NULL);
+  init_options->file_cache = cache;
+  preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  preopens[0].mapped_path = "/var";
+  preopens[0].real_path = TEST_TMP_DIR;
+  if (immutable) {
+    init_options->immutable_preopenc = 1;
+    init_options->immutable_preopens = preopens;
+  } else {
+    init_options->preopenc = 1;
+    init_options->preopens = preopens;
+  }
+  assert(0 == uvwasi_init(uvwasi, init_options));
+}
+
+static void destroy(uvwasi_t* uvwasi, uvwasi_options_t* init_options) {
+  uvwasi_destroy(uvwasi);
+  free(init_options->preopens);
+  free(init_options->immutable_preopens);
+}
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_rights_t rights) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         0,
+                         rights,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  return fd;
+}
+
+static void check_pread(uvwasi_t* uvwasi,
+                        uvwasi_fd_t fd,
+                        uvwasi_filesize_t offset,
+                        const char* expected) {
+  uvwasi_iovec_t iovs[2];
+  uvwasi_size_t nread;
+  char buf[64];
+
+  memset(buf, 0, sizeof(buf));
+  iovs[0].buf = buf;
+  iovs[0].buf_len = 3;
+  iovs[1].buf = buf + 3;
+  iovs[1].buf_len = sizeof(buf) - 4;
+  assert(0 == uvwasi_fd_pread(uvwasi, fd, iovs, 2, offset, &nread));
+  assert(nread == strlen(expected));
+  assert(0 == strcmp(buf, expected));
+}
+
+static void check_read(uvwasi_t* uvwasi,
+                       uvwasi_fd_t fd,
+                       uvwasi_size_t len,
+                       const char* expected) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char buf[64];
+
+  memset(buf, 0, sizeof(buf));
+  iov.buf = buf;
+  iov.buf_len = len;
+  assert(0 == uvwasi_fd_read(uvwasi, fd, &iov, 1, &nread));
+  assert(nread == strlen(expected));
+  assert(0 == strcmp(buf, expected));
+}
+
+static uvwasi_file_cache_stats_t get_stats(uvwasi_file_cache_t* cache) {
+  uvwasi_file_cache_stats_t stats;
+
+  assert(0 == uvwasi_file_cache_stats_get(cache, &stats));
+  return stats;
+}
+
+int main(void) {
+  const uvwasi_rights_t read_rights =
+    UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_SEEK | UVWASI_RIGHT_FD_TELL;
+  uvwasi_options_t options1;
+  uvwasi_options_t options2;
+  uvwasi_file_cache_stats_t stats;
+  uvwasi_file_cache_t* cache;
+  uvwasi_filesize_t pos;
+  uvwasi_t uvwasi1;
+  uvwasi_t uvwasi2;
+  uvwasi_fd_t fd1;
+  uvwasi_fd_t fd2;
+  uvwasi_fd_t fd3;
+  uv_fs_t req;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+  write_host(TEST_FILE_A, "0123456789");
+  write_host(TEST_FILE_B, CONTENTS_B);
+  write_host(TEST_FILE_BIG,
+             "0123456789012345678901234567890123456789"
+             "0123456789012345678901234567890123456789");
+  write_host(TEST_FILE_C,
+             "012345678901234567890123456789012345678901234567890123456789");
+
+  assert(UVWASI_EINVAL == uvwasi_file_cache_new(CACHE_LIMIT, NULL, NULL));
+  assert(UVWASI_EINVAL == uvwasi_file_cache_free(NULL));
+  assert(0 == uvwasi_file_cache_new(CACHE_LIMIT, NULL, &cache));
+  assert(UVWASI_EINVAL == uvwasi_file_cache_stats_get(cache, NULL));
+  stats = get_stats(cache);
+  assert(stats.entries == 0 && stats.hits == 0 && stats.misses == 0);
+
+  /* Two sandboxes share one copy of a file under an immutable preopen. */
+  init(&uvwasi1, &options1, cache, 1);
+  init(&uvwasi2, &options2, cache, 1);
+  fd1 = open_file(&uvwasi1, "file-cache-a.txt", read_rights);
+  fd2 = open_file(&uvwasi2, "file-cache-a.txt", read_rights);
+  stats = get_stats(cache);
+  assert(stats.entries == 1);
+  assert(stats.bytes == 10);
+  assert(stats.misses == 1);
+  assert(stats.hits == 1);
+
+  check_pread(&uvwasi1, fd1, 0, "0123456789");
+  check_pread(&uvwasi2, fd2, 7, "789");
+  check_pread(&uvwasi2, fd2, 10, "");
+  check_pread(&uvwasi2, fd2, 100, "");
+  check_read(&uvwasi1, fd1, 4, "0123");
+  check_read(&uvwasi1, fd1, 4, "4567");
+  assert(0 == uvwasi_fd_tell(&uvwasi1, fd1, &pos));
+  assert(pos == 8);
+  assert(0 == uvwasi_fd_seek(&uvwasi1, fd1, -5, UVWASI_WHENCE_CUR, &pos));
+  assert(pos == 3);
+  check_read(&uvwasi1, fd1, 20, "3456789");
+  check_read(&uvwasi1, fd1, 20, "");
+
+  /* Changing the file makes later opens load it again. Files that are
+     already open keep the contents they were opened with. */
+  write_host(TEST_FILE_A, "changed");
+  fd3 = open_file(&uvwasi1, "file-cache-a.txt", read_rights);
+  check_pread(&uvwasi1, fd3, 0, "changed");
+  check_pread(&uvwasi2, fd2, 0, "0123456789");
+  stats = get_stats(cache);
+  assert(stats.entries == 2);
+  assert(stats.bytes == 17);
+  assert(stats.misses == 2);
+  assert(UVWASI_EBUSY == uvwasi_file_cache_free(cache));
+  assert(0 == uvwasi_fd_close(&uvwasi1, fd1));
+  assert(0 == uvwasi_fd_close(&uvwasi2, fd2));
+
+  /* Files opened for writing are not cached. */
+  fd1 = open_file(&uvwasi1,
+                  "file-cache-b.txt",
+                  read_rights | UVWASI_RIGHT_FD_WRITE);
+  check_pread(&uvwasi1, fd1, 50, "YZ");
+  assert(0 == uvwasi_fd_close(&uvwasi1, fd1));
+  assert(get_stats(cache).misses == 2);
+
+  /* Unreferenced files are evicted, least recently used first, to make room.
+     Files that are open are not. */
+  fd1 = open_file(&uvwasi1, "file-cache-b.txt", read_rights);
+  check_pread(&uvwasi1, fd1, 50, "YZ");
+  stats = get_stats(cache);
+  assert(stats.entries == 2);
+  assert(stats.bytes == 59);
+  assert(stats.evictions == 1);
+  assert(0 == uvwasi_fd_close(&uvwasi1, fd1));
+
+  /* Files larger than the cache are read as usual. */
+  fd1 = open_file(&uvwasi2, "file-cache-big.txt", read_rights);
+  check_pread(&uvwasi2, fd1, 75, "56789");
+  stats = get_stats(cache);
+  assert(stats.entries == 2);
+  assert(stats.misses == 4);
+  assert(0 == uvwasi_fd_close(&uvwasi2, fd1));
+
+  /* A file that only fits once open files are evicted evicts nothing. */
+  fd1 = open_file(&uvwasi2, "file-cache-c.txt", read_rights);
+  check_pread(&uvwasi2, fd1, 55, "56789");
+  stats = get_stats(cache);
+  assert(stats.entries == 2);
+  assert(stats.bytes == 59);
+  assert(stats.evictions == 1);
+  assert(0 == uvwasi_fd_close(&uvwasi2, fd1));
+  destroy(&uvwasi2, &options2);
+
+  /* Preopens that are not immutable do not use the cache. */
+  init(&uvwasi2, &options2, cache, 0);
+  fd1 = open_file(&uvwasi2, "file-cache-b.txt", read_rights);
+  check_pread(&uvwasi2, fd1, 0, CONTENTS_B);
+  assert(get_stats(cache).hits == 1);
+  destroy(&uvwasi2, &options2);
+
+  /* Destroying a sandbox releases its references. */
+  destroy(&uvwasi1, &options1);
+  assert(0 == uvwasi_file_cache_free(cache));
+
+  uv_fs_unlink(NULL, &req, TEST_FILE_A, NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_unlink(NULL, &req, TEST_FILE_B, NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_unlink(NULL, &req, TEST_FILE_C, NULL);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_unlink(NULL, &req, TEST_FILE_BIG, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
@@ -0,0 +1,203 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_FILE TEST_TMP_DIR "/filestat-cache.txt"
+#define TEST_PATH "filestat-cache.txt"
+#define NANOS_PER_SEC 1000000000
+
+static void write_external(int64_t offset, const char* data) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int fd;
+  int r;
+
+  fd = uv_fs_open(NULL, &req, TEST_FILE, UV_FS_O_WRONLY, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(fd >= 0);
+  buf = uv_buf_init((char*) data, strlen(data));
+  r = uv_fs_write(NULL, &req, fd, &buf, 1, offset, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == (int) strlen(data));
+  assert(0 == uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+static uvwasi_filesize_t host_size(void) {
+  uvwasi_filesize_t size;
+  uv_fs_t req;
+
+  assert(0 == uv_fs_stat(NULL, &req, TEST_FILE, NULL));
+  size = req.statbuf.st_size;
+  uv_fs_req_cleanup(&req);
+  return size;
+}
+
+static void init(uvwasi_t* uvwasi,
+                 uvwasi_options_t* init_options,
+                 uvwasi_timestamp_t ttl) {
+  uvwasi_options_init(init_options);
+  assert(init_options->filestat_cache_ttl == 0);
+  init_options->filestat_cache_ttl = ttl;
+  init_options->preopenc = 1;
+  init_options->preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options->preopens[0].mapped_path = "/var";
+  init_options->preopens[0].real_path = TEST_TMP_DIR;
+  assert(0 == uvwasi_init(uvwasi, init_options));
+}
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             uvwasi_oflags_t o_flags,
+                             uvwasi_fdflags_t fs_flags) {
+  uvwasi_fd_t fd;
+  uvwasi_errno_t err;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         0,
+                         TEST_PATH,
+                         strlen(TEST_PATH) + 1,
+                         o_flags,
+                         UVWASI_RIGHT_FD_FILESTAT_GET |
+                           UVWASI_RIGHT_FD_FILESTAT_SET_SIZE |
+                           UVWASI_RIGHT_FD_FILESTAT_SET_TIMES |
+                           UVWASI_RIGHT_FD_ALLOCATE |
+                           UVWASI_RIGHT_FD_WRITE |
+                           UVWASI_RIGHT_FD_SEEK |
+                           UVWASI_RIGHT_FD_FDSTAT_SET_FLAGS,
+                         0,
+                         fs_flags,
+                         &fd);
+  assert(err == 0);
+  return fd;
+}
+
+static void write_fd(uvwasi_t* uvwasi,
+                     uvwasi_fd_t fd,
+                     int64_t offset,
+                     const char* data) {
+  uvwasi_ciovec_t iov;
+  uvwasi_size_t nwritten;
+  uvwasi_errno_t err;
+
+  iov.buf = data;
+  iov.buf_len = strlen(data);
+  if (offset < 0)
+    err = uvwasi_fd_write(uvwasi, fd, &iov, 1, &nwritten);
+  else
+    err = uvwasi_fd_pwrite(uvwasi, fd, &iov, 1, offset, &nwritten);
+  assert(err == 0);
+  assert(nwritten == iov.buf_len);
+}
+
+static uvwasi_filestat_t get(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
+  uvwasi_filestat_t stat;
+
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  return stat;
+}
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_filestat_t stat;
+  uvwasi_filestat_t cached;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  /* Without a TTL, changes made elsewhere are seen immediately. */
+  init(&uvwasi, &init_options, 0);
+  fd = open_file(&uvwasi, UVWASI_O_CREAT | UVWASI_O_TRUNC, 0);
+  assert(get(&uvwasi, fd).st_size == 0);
+  write_external(0, "hello");
+  assert(get(&uvwasi, fd).st_size == 5);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  /* With a long TTL, changes made elsewhere are hidden while changes made
+     through the fd are applied to the cached attributes. */
+  init(&uvwasi, &init_options, (uvwasi_timestamp_t) 60 * NANOS_PER_SEC);
+  fd = open_file(&uvwasi, UVWASI_O_TRUNC, 0);
+  stat = get(&uvwasi, fd);
+  assert(stat.st_size == 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  write_external(0, "external");
+  cached = get(&uvwasi, fd);
+  assert(cached.st_size == 0);
+  assert(cached.st_ino == stat.st_ino);
+
+  write_fd(&uvwasi, fd, 10, "abc");
+  assert(get(&uvwasi, fd).st_size == 13);
+  assert(host_size() == 13);
+  write_fd(&uvwasi, fd, 0, "abc");
+  assert(get(&uvwasi, fd).st_size == 13);
+
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi, fd, 4));
+  assert(get(&uvwasi, fd).st_size == 4);
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 0, 2));
+  assert(get(&uvwasi, fd).st_size == 4);
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 4, 4));
+  assert(get(&uvwasi, fd).st_size == 8);
+  assert(host_size() == 8);
+
+  assert(0 == uvwasi_fd_filestat_set_times(&uvwasi,
+                                           fd,
+                                           (uvwasi_timestamp_t) 1000 *
+                                             NANOS_PER_SEC,
+                                           (uvwasi_timestamp_t) 2000 *
+                                             NANOS_PER_SEC,
+                                           UVWASI_FILESTAT_SET_ATIM |
+                                             UVWASI_FILESTAT_SET_MTIM));
+  stat = get(&uvwasi, fd);
+  assert(stat.st_atim == (uvwasi_timestamp_t) 1000 * NANOS_PER_SEC);
+  assert(stat.st_mtim == (uvwasi_timestamp_t) 2000 * NANOS_PER_SEC);
+
+  /* The file position is not tracked, so writing at it refreshes. */
+  write_external(20, "x");
+  write_fd(&uvwasi, fd, -1, "ab");
+  assert(get(&uvwasi, fd).st_size == 21);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  /* Appending writes only grow the file. */
+  fd = open_file(&uvwasi, 0, UVWASI_FDFLAG_APPEND);
+  assert(get(&uvwasi, fd).st_size == 21);
+  write_fd(&uvwasi, fd, -1, "abcd");
+  assert(get(&uvwasi, fd).st_size == 25);
+  assert(host_size() == 25);
+
+  /* Clearing O_APPEND drops the cached attributes. */
+  write_external(30, "x");
+  assert(0 == uvwasi_fd_fdstat_set_flags(&uvwasi, fd, 0));
+  assert(get(&uvwasi, fd).st_size == 31);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  /* Cached attributes expire. */
+  init(&uvwasi, &init_options, 1000000);
+  fd = open_file(&uvwasi, UVWASI_O_TRUNC, 0);
+  assert(get(&uvwasi, fd).st_size == 0);
+  write_external(0, "hello");
+  uv_sleep(10);
+  assert(get(&uvwasi, fd).st_size == 5);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  r = uv_fs_unlink(NULL, &req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_FILE TEST_TMP_DIR "/filestat-get.txt"
+#define TEST_LINK TEST_TMP_DIR "/filestat-get.lnk"
+
+static void check_stat(const uvwasi_filestat_t* stat,
+                       const uv_stat_t* expected,
+                       uvwasi_filetype_t type) {
+  assert(stat->st_dev == expected->st_dev);
+  assert(stat->st_ino == expected->st_ino);
+  assert(stat->st_nlink == expected->st_nlink);
+  assert(stat->st_size == expected->st_size);
+  assert(stat->st_filetype == type);
+  assert(stat->st_mtim ==
+         (uvwasi_timestamp_t) expected->st_mtim.tv_sec * 1000000000 +
+         expected->st_mtim.tv_nsec);
+  assert(stat->st_ctim ==
+         (uvwasi_timestamp_t) expected->st_ctim.tv_sec * 1000000000 +
+         expected->st_ctim.tv_nsec);
+}
+
+static void run(int dont_sync) {
+  const char* path = "filestat-get.txt";
+  const char* link = "filestat-get.lnk";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_filestat_t stat;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  int r;
+
+  uvwasi_options_init(&init_options);
+  assert(init_options.filestat_dont_sync == 0);
+  init_options.filestat_dont_sync = dont_sync;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         0,
+                         UVWASI_RIGHT_FD_FILESTAT_GET,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+
+  r = uv_fs_stat(NULL, &req, TEST_FILE, NULL);
+  assert(r == 0);
+
+  err = uvwasi_fd_filestat_get(&uvwasi, fd, &stat);
+  assert(err == 0);
+  check_stat(&stat, &req.statbuf, UVWASI_FILETYPE_REGULAR_FILE);
+
+  err = uvwasi_path_filestat_get(&uvwasi,
+                                 3,
+                                 0,
+                                 path,
+                                 strlen(path) + 1,
+                                 &stat);
+  assert(err == 0);
+  check_stat(&stat, &req.statbuf, UVWASI_FILETYPE_REGULAR_FILE);
+  uv_fs_req_cleanup(&req);
+
+  /* The preopened directory itself. */
+  r = uv_fs_stat(NULL, &req, TEST_TMP_DIR, NULL);
+  assert(r == 0);
+  err = uvwasi_path_filestat_get(&uvwasi, 3, 0, ".", 2, &stat);
+  assert(err == 0);
+  check_stat(&stat, &req.statbuf, UVWASI_FILETYPE_DIRECTORY);
+  uv_fs_req_cleanup(&req);
+
+#ifndef _WIN32
+  /* Symbolic links are only followed when asked to. */
+  r = uv_fs_lstat(NULL, &req, TEST_LINK, NULL);
+  assert(r == 0);
+  err = uvwasi_path_filestat_get(&uvwasi,
+                                 3,
+                                 0,
+                                 link,
+                                 strlen(link) + 1,
+                                 &stat);
+  assert(err == 0);
+  check_stat(&stat, &req.statbuf, UVWASI_FILETYPE_SYMBOLIC_LINK);
+  uv_fs_req_cleanup(&req);
+
+  err = uvwasi_path_filestat_get(&uvwasi,
+                                 3,
+                                 UVWASI_LOOKUP_SYMLINK_FOLLOW,
+                                 link,
+                                 strlen(link) + 1,
+                                 &stat);
+  assert(err == 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(stat.st_size == 5);
+#endif /* _WIN32 */
+
+  err = uvwasi_path_filestat_get(&uvwasi,
+                                 3,
+                                 0,
+                                 "missing",
+                                 8,
+                                 &stat);
+  assert(err == UVWASI_ENOENT);
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  assert(err == 0);
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+}
+
+int main(void) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  r = uv_fs_open(NULL,
+                 &req,
+                 TEST_FILE,
+                 UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                 0644,
+                 NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r >= 0);
+  buf = uv_buf_init("hello", 5);
+  assert(5 == uv_fs_write(NULL, &req, r, &buf, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+  assert(0 == uv_fs_close(NULL, &req, r, NULL));
+  uv_fs_req_cleanup(&req);
+
+#ifndef _WIN32
+  uv_fs_unlink(NULL, &req, TEST_LINK, NULL);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_symlink(NULL, &req, "filestat-get.txt", TEST_LINK, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+#endif /* _WIN32 */
+
+  run(0);
+  run(1);
+
+  uv_fs_unlink(NULL, &req, TEST_LINK, NULL);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_unlink(NULL, &req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
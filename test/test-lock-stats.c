@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define RECORDING TEST_TMP_DIR "/test-lock-stats.bin"
+
+static uvwasi_t uvwasi;
+
+#ifndef _WIN32
+static uv_file pipe_fds[2];
+
+/* Blocks in fd_read() on stdin while holding its mutex. */
+static void reader_main(void* arg) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  uvwasi_errno_t err;
+  char buf[8];
+
+  (void) arg;
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  err = uvwasi_fd_read(&uvwasi, 0, &iov, 1, &nread);
+  assert(err == 0);
+  assert(nread == 1);
+}
+
+/* Unblocks the reader once the main thread is waiting for stdin's mutex. */
+static void writer_main(void* arg) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  int r;
+
+  (void) arg;
+  uv_sleep(300);
+  buf = uv_buf_init("x", 1);
+  r = uv_fs_write(NULL, &req, pipe_fds[1], &buf, 1, -1, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 1);
+}
+#endif /* _WIN32 */
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_lock_stats_t stats;
+  uvwasi_fdstat_t fdstat;
+  uvwasi_errno_t err;
+  uv_fs_t fs_req;
+  int r;
+#ifndef _WIN32
+  uv_thread_t reader;
+  uv_thread_t writer;
+  uv_fs_t req;
+#endif /* _WIN32 */
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &fs_req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  /* Lock statistics are unavailable unless enabled. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.enable_lock_stats == 0);
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_lock_stats_get(&uvwasi, &stats) == UVWASI_ENOTSUP);
+  assert(uvwasi_lock_stats_reset(&uvwasi) == UVWASI_ENOTSUP);
+  uvwasi_destroy(&uvwasi);
+
+  init_options.enable_lock_stats = 1;
+  init_options.enable_record = 1;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_lock_stats_get(NULL, &stats) == UVWASI_EINVAL);
+  assert(uvwasi_lock_stats_get(&uvwasi, NULL) == UVWASI_EINVAL);
+
+  /* Uncontended acquisitions are counted. */
+  assert(uvwasi_lock_stats_reset(&uvwasi) == 0);
+  err = uvwasi_fd_fdstat_get(&uvwasi, 1, &fdstat);
+  assert(err == 0);
+  assert(uvwasi_lock_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.fd_table.acquisitions == 1);
+  assert(stats.fd_table.contended == 0);
+  assert(stats.fd.acquisitions == 1);
+  assert(stats.fd.contended == 0);
+  assert(stats.fd.wait_ns == 0);
+  assert(stats.hot_fd_count == 0);
+
+  /* Starting a recording reads the fd table under its lock. */
+  assert(uvwasi_lock_stats_reset(&uvwasi) == 0);
+  assert(uvwasi_record_start(&uvwasi, RECORDING) == 0);
+  assert(uvwasi_record_stop(&uvwasi) == 0);
+  assert(uvwasi_lock_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.fd_table.acquisitions == 1);
+  r = uv_fs_unlink(NULL, &fs_req, RECORDING, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  assert(r == 0);
+
+#ifndef _WIN32
+  assert(0 == uv_pipe(pipe_fds, 0, 0));
+  err = uvwasi_embedder_remap_fd(&uvwasi, 0, pipe_fds[0]);
+  assert(err == 0);
+  assert(uvwasi_lock_stats_reset(&uvwasi) == 0);
+
+  assert(0 == uv_thread_create(&reader, reader_main, NULL));
+  assert(0 == uv_thread_create(&writer, writer_main, NULL));
+  uv_sleep(100);
+  err = uvwasi_fd_fdstat_get(&uvwasi, 0, &fdstat);
+  assert(err == 0);
+  assert(0 == uv_thread_join(&reader));
+  assert(0 == uv_thread_join(&writer));
+
+  assert(uvwasi_lock_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.fd.acquisitions == 2);
+  assert(stats.fd.contended == 1);
+  assert(stats.fd.wait_ns > 0);
+  assert(stats.fd.max_wait_ns == stats.fd.wait_ns);
+  assert(stats.hot_fd_count == 1);
+  assert(stats.hot_fds[0].fd == 0);
+  assert(stats.hot_fds[0].contended == 1);
+  assert(stats.hot_fds[0].wait_ns == stats.fd.wait_ns);
+
+  assert(uvwasi_lock_stats_reset(&uvwasi) == 0);
+  assert(uvwasi_lock_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.fd.contended == 0);
+  assert(stats.hot_fd_count == 0);
+
+  uv_fs_close(NULL, &req, pipe_fds[1], NULL);
+  uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+
+  uvwasi_destroy(&uvwasi);
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define LIMIT_HEADROOM 256
+
+int main(void) {
+  const char* path = "mem-stats.txt";
+  char long_path[LIMIT_HEADROOM * 2];
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_mem_stats_t stats;
+  uvwasi_mem_stats_t stats2;
+  uvwasi_mem_t allocator;
+  counting_counts_t counts;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  uint64_t baseline;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  /* Accounting is unavailable unless enabled. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.enable_mem_stats == 0);
+  assert(init_options.mem_limit == 0);
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats) == UVWASI_ENOTSUP);
+  uvwasi_destroy(&uvwasi);
+
+  init_options.enable_mem_stats = 1;
+  counting_allocator_init(&allocator, &counts);
+  init_options.allocator = &allocator;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_mem_stats_get(NULL, &stats) == UVWASI_EINVAL);
+  assert(uvwasi_mem_stats_get(&uvwasi, NULL) == UVWASI_EINVAL);
+
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.current_bytes > 0);
+  assert(stats.peak_bytes >= stats.current_bytes);
+  assert(stats.live_allocations > 0);
+  assert(stats.allocations >= stats.live_allocations);
+  assert(stats.failures == 0);
+  baseline = stats.current_bytes;
+
+  /* Opening a file may grow the fd table's pool. Closing it keeps the memory
+     in the pool for the next open. */
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT,
+                         UVWASI_RIGHT_FD_READ,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats2) == 0);
+  assert(stats2.current_bytes >= stats.current_bytes);
+  assert(stats2.live_allocations >= stats.live_allocations);
+  assert(stats2.allocations > stats.allocations);
+  stats = stats2;
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  assert(err == 0);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  assert(err == 0);
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats2) == 0);
+  assert(stats2.current_bytes == stats.current_bytes);
+  assert(stats2.live_allocations == stats.live_allocations);
+  assert(stats2.peak_bytes > stats.current_bytes);
+
+  /* The account and every allocation are returned to the allocator. */
+  uvwasi_destroy(&uvwasi);
+  assert(counts.live == 0);
+
+  /* A limit below what initialization needs makes it fail cleanly. */
+  init_options.enable_mem_stats = 0;
+  init_options.mem_limit = 16;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == UVWASI_ENOMEM);
+  assert(counts.live == 0);
+
+  /* With a little headroom, calls that need more memory fail with ENOMEM. */
+  init_options.mem_limit = baseline + LIMIT_HEADROOM;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats) == 0);
+  assert(stats.current_bytes == baseline);
+
+  memset(long_path, 'a', sizeof(long_path) - 1);
+  long_path[sizeof(long_path) - 1] = '\0';
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         long_path,
+                         sizeof(long_path),
+                         0,
+                         UVWASI_RIGHT_FD_READ,
+                         0,
+                         0,
+                         &fd);
+  assert(err == UVWASI_ENOMEM);
+  assert(uvwasi_mem_stats_get(&uvwasi, &stats2) == 0);
+  assert(stats2.failures > 0);
+  assert(stats2.current_bytes == baseline);
+  assert(stats2.peak_bytes <= baseline + LIMIT_HEADROOM);
+
+  uvwasi_destroy(&uvwasi);
+  assert(counts.live == 0);
+  free(init_options.preopens);
+  return 0;
+}
@@ -0,0 +1,586 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define BUF_SIZE 256
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_lookupflags_t dirflags,
+                             uvwasi_oflags_t oflags,
+                             uvwasi_fdflags_t fdflags,
+                             uvwasi_errno_t expected) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         dirflags,
+                         path,
+                         strlen(path) + 1,
+                         oflags,
+                         UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_WRITE |
+                         UVWASI_RIGHT_FD_SEEK | UVWASI_RIGHT_FD_TELL |
+                         UVWASI_RIGHT_FD_FILESTAT_GET |
+                         UVWASI_RIGHT_FD_FILESTAT_SET_SIZE |
+                         UVWASI_RIGHT_FD_FILESTAT_SET_TIMES |
+                         UVWASI_RIGHT_FD_FDSTAT_SET_FLAGS |
+                         UVWASI_RIGHT_FD_READDIR | UVWASI_RIGHT_FD_ALLOCATE,
+                         0,
+                         fdflags,
+                         &fd);
+  assert(err == expected);
+  return fd;
+}
+
+static uvwasi_fd_t open_dir(uvwasi_t* uvwasi, const char* path) {
+  uvwasi_fd_t fd;
+
+  assert(0 == uvwasi_path_open(uvwasi,
+                               3,
+                               0,
+                               path,
+                               strlen(path) + 1,
+                               UVWASI_O_DIRECTORY,
+                               UVWASI_RIGHT_FD_READDIR,
+                               0,
+                               0,
+                               &fd));
+  return fd;
+}
+
+static void check_read(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* expected) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char buf[BUF_SIZE];
+
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_read(uvwasi, fd, &iov, 1, &nread));
+  assert(nread == strlen(expected));
+  assert(memcmp(buf, expected, nread) == 0);
+}
+
+static void write_str(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* str) {
+  uvwasi_ciovec_t ciov;
+  uvwasi_size_t nwritten;
+
+  ciov.buf = str;
+  ciov.buf_len = strlen(str);
+  assert(0 == uvwasi_fd_write(uvwasi, fd, &ciov, 1, &nwritten));
+  assert(nwritten == strlen(str));
+}
+
+static void create_file(uvwasi_t* uvwasi,
+                        const char* path,
+                        const char* contents) {
+  uvwasi_fd_t fd;
+
+  fd = open_file(uvwasi, path, 0, UVWASI_O_CREAT | UVWASI_O_TRUNC, 0, 0);
+  write_str(uvwasi, fd, contents);
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+}
+
+static void check_file(uvwasi_t* uvwasi,
+                       const char* path,
+                       const char* contents) {
+  uvwasi_fd_t fd;
+
+  fd = open_file(uvwasi, path, UVWASI_LOOKUP_SYMLINK_FOLLOW, 0, 0, 0);
+  check_read(uvwasi, fd, contents);
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+}
+
+static void path_stat(uvwasi_t* uvwasi,
+                      const char* path,
+                      uvwasi_lookupflags_t flags,
+                      uvwasi_filestat_t* stat,
+                      uvwasi_errno_t expected) {
+  assert(expected == uvwasi_path_filestat_get(uvwasi,
+                                              3,
+                                              flags,
+                                              path,
+                                              strlen(path) + 1,
+                                              stat));
+}
+
+/* Returns the names in a directory listing, separated by spaces. */
+static void list_dir(uvwasi_t* uvwasi, const char* path, char* names) {
+  uvwasi_dirent_t dirent;
+  uvwasi_size_t bufused;
+  uvwasi_size_t pos;
+  uvwasi_fd_t fd;
+  char buf[BUF_SIZE];
+
+  fd = open_dir(uvwasi, path);
+  assert(0 == uvwasi_fd_readdir(uvwasi, fd, buf, sizeof(buf), 0, &bufused));
+  assert(bufused < sizeof(buf));
+  names[0] = '\0';
+  for (pos = 0; pos < bufused; pos += dirent.d_namlen) {
+    uvwasi_serdes_read_dirent_t(buf, pos, &dirent);
+    pos += UVWASI_SERDES_SIZE_dirent_t;
+    if (names[0] != '\0')
+      strcat(names, " ");
+    strncat(names, buf + pos, dirent.d_namlen);
+  }
+
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+}
+
+static void init_sandbox(uvwasi_t* uvwasi,
+                         uvwasi_options_t* options,
+                         uvwasi_memfs_t* memfs) {
+  uvwasi_options_init(options);
+  options->preopen_vfsc = 1;
+  options->preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  options->preopen_vfs[0].mapped_path = "/tmp";
+  options->preopen_vfs[0].vfs = uvwasi_memfs_vfs(memfs);
+  assert(0 == uvwasi_init(uvwasi, options));
+}
+
+static void destroy_sandbox(uvwasi_t* uvwasi, uvwasi_options_t* options) {
+  uvwasi_destroy(uvwasi);
+  free(options->preopen_vfs);
+}
+
+static void test_file_io(uvwasi_t* uvwasi) {
+  uvwasi_filestat_t stat;
+  uvwasi_filesize_t pos;
+  uvwasi_fdstat_t fdstat;
+  uvwasi_ciovec_t ciovs[2];
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  uvwasi_size_t nwritten;
+  uvwasi_fd_t fd;
+  uvwasi_fd_t fd2;
+  char buf[BUF_SIZE];
+
+  open_file(uvwasi, "io.txt", 0, 0, 0, UVWASI_ENOENT);
+  fd = open_file(uvwasi, "io.txt", 0, UVWASI_O_CREAT, 0, 0);
+  ciovs[0].buf = "hello ";
+  ciovs[0].buf_len = 6;
+  ciovs[1].buf = "world";
+  ciovs[1].buf_len = 5;
+  assert(0 == uvwasi_fd_write(uvwasi, fd, ciovs, 2, &nwritten));
+  assert(nwritten == 11);
+  assert(0 == uvwasi_fd_seek(uvwasi, fd, 0, UVWASI_WHENCE_SET, &pos));
+  check_read(uvwasi, fd, "hello world");
+  assert(0 == uvwasi_fd_seek(uvwasi, fd, -5, UVWASI_WHENCE_CUR, &pos));
+  assert(pos == 6);
+  check_read(uvwasi, fd, "world");
+
+  /* Positioned I/O leaves the file position alone, and writes past the end
+     leave a zero filled gap. */
+  assert(0 == uvwasi_fd_pwrite(uvwasi, fd, ciovs, 1, 13, &nwritten));
+  assert(nwritten == 6);
+  assert(0 == uvwasi_fd_tell(uvwasi, fd, &pos));
+  assert(pos == 11);
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_pread(uvwasi, fd, &iov, 1, 9, &nread));
+  assert(nread == 10 && memcmp(buf, "ld\0\0hello ", 10) == 0);
+  assert(0 == uvwasi_fd_pread(uvwasi, fd, &iov, 1, 100, &nread));
+  assert(nread == 0);
+
+  /* Sizes. */
+  assert(0 == uvwasi_fd_filestat_set_size(uvwasi, fd, 5));
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_size == 5);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(stat.st_nlink == 1);
+  assert(0 == uvwasi_fd_allocate(uvwasi, fd, 0, 3));
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_size == 5);
+  assert(0 == uvwasi_fd_allocate(uvwasi, fd, 4, 4));
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_size == 8);
+  assert(0 == uvwasi_fd_filestat_set_size(uvwasi, fd, 5));
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+
+  /* Appending, also when turned on after the open. */
+  fd = open_file(uvwasi, "io.txt", 0, 0, UVWASI_FDFLAG_APPEND, 0);
+  write_str(uvwasi, fd, "!");
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+  fd = open_file(uvwasi, "io.txt", 0, 0, 0, 0);
+  assert(0 == uvwasi_fd_fdstat_set_flags(uvwasi, fd, UVWASI_FDFLAG_APPEND));
+  assert(0 == uvwasi_fd_fdstat_get(uvwasi, fd, &fdstat));
+  assert(fdstat.fs_flags == UVWASI_FDFLAG_APPEND);
+  write_str(uvwasi, fd, "?");
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+  check_file(uvwasi, "io.txt", "hello!?");
+
+  /* Two fds share the contents of the file. */
+  fd = open_file(uvwasi, "io.txt", 0, 0, 0, 0);
+  fd2 = open_file(uvwasi, "io.txt", 0, UVWASI_O_TRUNC, 0, 0);
+  check_read(uvwasi, fd, "");
+  write_str(uvwasi, fd2, "bye");
+  check_read(uvwasi, fd, "bye");
+  assert(0 == uvwasi_fd_close(uvwasi, fd2));
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+  open_file(uvwasi, "io.txt", 0, UVWASI_O_CREAT | UVWASI_O_EXCL, 0,
+            UVWASI_EEXIST);
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "io.txt", 7));
+}
+
+static void test_directories(uvwasi_t* uvwasi) {
+  uvwasi_filestat_t stat;
+  uvwasi_dirent_t dirent;
+  uvwasi_size_t bufused;
+  uvwasi_fd_t fd;
+  char buf[BUF_SIZE];
+  char names[BUF_SIZE];
+
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "d", 2));
+  assert(UVWASI_EEXIST == uvwasi_path_create_directory(uvwasi, 3, "d", 2));
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "d/sub/", 7));
+  assert(UVWASI_ENOENT ==
+         uvwasi_path_create_directory(uvwasi, 3, "d/missing/x", 12));
+  create_file(uvwasi, "d/a", "a");
+  create_file(uvwasi, "d/b", "b");
+  list_dir(uvwasi, "d", names);
+  assert(strcmp(names, "sub a b") == 0);
+  path_stat(uvwasi, "d", 0, &stat, 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_DIRECTORY);
+
+  /* Cookies name positions in the listing. */
+  fd = open_dir(uvwasi, "d");
+  assert(0 == uvwasi_fd_readdir(uvwasi, fd, buf, sizeof(buf), 2, &bufused));
+  assert(bufused == UVWASI_SERDES_SIZE_dirent_t + 1);
+  uvwasi_serdes_read_dirent_t(buf, 0, &dirent);
+  assert(dirent.d_next == 3);
+  assert(dirent.d_type == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(buf[UVWASI_SERDES_SIZE_dirent_t] == 'b');
+  assert(0 == uvwasi_fd_readdir(uvwasi, fd, buf, 30, 0, &bufused));
+  assert(bufused == 30);
+  uvwasi_serdes_read_dirent_t(buf, 0, &dirent);
+  assert(dirent.d_namlen == 3);
+  assert(memcmp(buf + UVWASI_SERDES_SIZE_dirent_t, "sub", 3) == 0);
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+
+  /* Directories cannot be written, and files are not directories. */
+  open_file(uvwasi, "d", 0, 0, 0, UVWASI_EISDIR);
+  open_file(uvwasi, "d/a", 0, UVWASI_O_DIRECTORY, 0, UVWASI_ENOTDIR);
+  open_file(uvwasi, "d/a/", 0, 0, 0, UVWASI_ENOTDIR);
+  open_file(uvwasi, "d/a/x", 0, UVWASI_O_CREAT, 0, UVWASI_ENOTDIR);
+  open_file(uvwasi, "../escape", 0, 0, 0, UVWASI_ENOTCAPABLE);
+
+  /* Removal. */
+  assert(UVWASI_ENOTEMPTY == uvwasi_path_remove_directory(uvwasi, 3, "d", 2));
+  assert(UVWASI_ENOTDIR == uvwasi_path_remove_directory(uvwasi, 3, "d/a", 4));
+  assert(UVWASI_EISDIR == uvwasi_path_unlink_file(uvwasi, 3, "d/sub", 6));
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "d/sub", 6));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "d/a", 4));
+  list_dir(uvwasi, "d", names);
+  assert(strcmp(names, "b") == 0);
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "d/b", 4));
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "d", 2));
+  path_stat(uvwasi, "d", 0, &stat, UVWASI_ENOENT);
+}
+
+static void test_symlinks(uvwasi_t* uvwasi) {
+  uvwasi_filestat_t stat;
+  uvwasi_size_t bufused;
+  char buf[BUF_SIZE];
+
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "s", 2));
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "s/inner", 8));
+  create_file(uvwasi, "s/inner/file", "data");
+  assert(0 == uvwasi_path_symlink(uvwasi, "inner/file", 11, 3, "s/f", 4));
+  assert(0 == uvwasi_path_symlink(uvwasi, "s/inner", 8, 3, "dirlink", 8));
+  assert(0 == uvwasi_path_symlink(uvwasi, "loop", 5, 3, "loop", 5));
+  assert(UVWASI_EEXIST ==
+         uvwasi_path_symlink(uvwasi, "x", 2, 3, "s/f", 4));
+
+  assert(0 == uvwasi_path_readlink(uvwasi, 3, "s/f", 4, buf, 11, &bufused));
+  assert(bufused == 10 && strcmp(buf, "inner/file") == 0);
+  assert(UVWASI_EINVAL ==
+         uvwasi_path_readlink(uvwasi, 3, "s", 2, buf, sizeof(buf), &bufused));
+  path_stat(uvwasi, "s/f", 0, &stat, 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_SYMBOLIC_LINK);
+  assert(stat.st_size == 10);
+  path_stat(uvwasi, "s/f", UVWASI_LOOKUP_SYMLINK_FOLLOW, &stat, 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(stat.st_size == 4);
+
+  /* Links are followed in the middle of paths, and at their end when asked
+     to. */
+  check_file(uvwasi, "s/f", "data");
+  check_file(uvwasi, "dirlink/file", "data");
+  open_file(uvwasi, "s/f", 0, 0, 0, UVWASI_ELOOP);
+  open_file(uvwasi, "loop", UVWASI_LOOKUP_SYMLINK_FOLLOW, 0, 0, UVWASI_ELOOP);
+  open_file(uvwasi, "loop/x", 0, 0, 0, UVWASI_ELOOP);
+
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "loop", 5));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "dirlink", 8));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "s/f", 4));
+  check_file(uvwasi, "s/inner/file", "data");
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "s/inner/file", 13));
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "s/inner", 8));
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "s", 2));
+}
+
+static void test_links_and_renames(uvwasi_t* uvwasi) {
+  uvwasi_filestat_t stat;
+  uvwasi_filestat_t stat2;
+  uvwasi_fd_t fd;
+  char names[BUF_SIZE];
+
+  create_file(uvwasi, "orig", "linked");
+  assert(0 == uvwasi_path_link(uvwasi, 3, 0, "orig", 5, 3, "hard", 5));
+  assert(UVWASI_EEXIST ==
+         uvwasi_path_link(uvwasi, 3, 0, "orig", 5, 3, "hard", 5));
+  path_stat(uvwasi, "orig", 0, &stat, 0);
+  path_stat(uvwasi, "hard", 0, &stat2, 0);
+  assert(stat.st_nlink == 2);
+  assert(stat.st_ino == stat2.st_ino && stat.st_dev == stat2.st_dev);
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "r", 2));
+  assert(UVWASI_EPERM == uvwasi_path_link(uvwasi, 3, 0, "r", 2, 3, "r2", 3));
+
+  /* A file that is unlinked while open stays readable. */
+  fd = open_file(uvwasi, "hard", 0, 0, 0, 0);
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "hard", 5));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "orig", 5));
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_nlink == 0);
+  check_read(uvwasi, fd, "linked");
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+
+  /* Renames replace files and empty directories. */
+  create_file(uvwasi, "r/one", "1");
+  create_file(uvwasi, "r/two", "2");
+  assert(0 == uvwasi_path_rename(uvwasi, 3, "r/one", 6, 3, "r/two", 6));
+  check_file(uvwasi, "r/two", "1");
+  list_dir(uvwasi, "r", names);
+  assert(strcmp(names, "two") == 0);
+  assert(0 == uvwasi_path_rename(uvwasi, 3, "r/two", 6, 3, "moved", 6));
+  check_file(uvwasi, "moved", "1");
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "r/sub", 6));
+  assert(0 == uvwasi_path_create_directory(uvwasi, 3, "empty", 6));
+  assert(UVWASI_EINVAL ==
+         uvwasi_path_rename(uvwasi, 3, "r", 2, 3, "r/sub/r", 8));
+  assert(UVWASI_EISDIR ==
+         uvwasi_path_rename(uvwasi, 3, "moved", 6, 3, "empty", 6));
+  assert(UVWASI_ENOTDIR ==
+         uvwasi_path_rename(uvwasi, 3, "empty", 6, 3, "moved", 6));
+  assert(UVWASI_ENOTEMPTY ==
+         uvwasi_path_rename(uvwasi, 3, "empty", 6, 3, "r", 2));
+  assert(0 == uvwasi_path_rename(uvwasi, 3, "r", 2, 3, "empty", 6));
+  path_stat(uvwasi, "empty/sub", 0, &stat, 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_DIRECTORY);
+  path_stat(uvwasi, "r", 0, &stat, UVWASI_ENOENT);
+
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "empty/sub", 10));
+  assert(0 == uvwasi_path_remove_directory(uvwasi, 3, "empty", 6));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "moved", 6));
+}
+
+static void test_timestamps(uvwasi_t* uvwasi) {
+  uvwasi_filestat_t stat;
+  uvwasi_filestat_t dir_stat;
+  uvwasi_timestamp_t before;
+  uvwasi_fd_t fd;
+
+  assert(0 == uvwasi_clock_time_get(uvwasi,
+                                    UVWASI_CLOCK_REALTIME,
+                                    1,
+                                    &before));
+  create_file(uvwasi, "t", "x");
+  path_stat(uvwasi, "t", 0, &stat, 0);
+  assert(stat.st_mtim >= before && stat.st_ctim >= before);
+  path_stat(uvwasi, ".", 0, &dir_stat, 0);
+  assert(dir_stat.st_mtim >= before);
+
+  assert(0 == uvwasi_path_filestat_set_times(uvwasi,
+                                             3,
+                                             0,
+                                             "t",
+                                             2,
+                                             1000,
+                                             2000,
+                                             UVWASI_FILESTAT_SET_ATIM |
+                                             UVWASI_FILESTAT_SET_MTIM));
+  path_stat(uvwasi, "t", 0, &stat, 0);
+  assert(stat.st_atim == 1000 && stat.st_mtim == 2000);
+  assert(stat.st_ctim >= before);
+
+  fd = open_file(uvwasi, "t", 0, 0, 0, 0);
+  assert(0 == uvwasi_fd_filestat_set_times(uvwasi,
+                                           fd,
+                                           0,
+                                           0,
+                                           UVWASI_FILESTAT_SET_MTIM_NOW));
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_atim == 1000 && stat.st_mtim >= before);
+  assert(0 == uvwasi_fd_filestat_set_times(uvwasi,
+                                           fd,
+                                           0,
+                                           3000,
+                                           UVWASI_FILESTAT_SET_MTIM));
+  write_str(uvwasi, fd, "y");
+  assert(0 == uvwasi_fd_filestat_get(uvwasi, fd, &stat));
+  assert(stat.st_mtim >= before);
+  assert(0 == uvwasi_fd_close(uvwasi, fd));
+  assert(0 == uvwasi_path_unlink_file(uvwasi, 3, "t", 2));
+}
+
+static void test_shared(uvwasi_memfs_t* memfs) {
+  uvwasi_options_t options;
+  uvwasi_options_t options2;
+  uvwasi_t uvwasi;
+  uvwasi_t uvwasi2;
+  uvwasi_fd_t fd;
+
+  /* Sandboxes see each other's changes, and open files keep the file system
+     from being freed. */
+  init_sandbox(&uvwasi, &options, memfs);
+  init_sandbox(&uvwasi2, &options2, memfs);
+  create_file(&uvwasi, "shared", "both");
+  check_file(&uvwasi2, "shared", "both");
+  fd = open_file(&uvwasi2, "shared", 0, 0, 0, 0);
+  assert(UVWASI_EBUSY == uvwasi_memfs_free(memfs));
+  assert(0 == uvwasi_fd_close(&uvwasi2, fd));
+  destroy_sandbox(&uvwasi2, &options2);
+  assert(UVWASI_EBUSY == uvwasi_memfs_free(memfs));
+  destroy_sandbox(&uvwasi, &options);
+}
+
+static void test_size_limit(void) {
+  uvwasi_options_t options;
+  uvwasi_memfs_t* memfs;
+  uvwasi_ciovec_t ciov;
+  uvwasi_filestat_t stat;
+  uvwasi_size_t nwritten;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t fd;
+  uvwasi_mem_t allocator;
+  counting_counts_t counts;
+  char buf[3000];
+
+  /* Growth past the limit fails without taking any memory. */
+  counting_allocator_init(&allocator, &counts);
+  assert(0 == uvwasi_memfs_new(&allocator, 4096, &memfs));
+  init_sandbox(&uvwasi, &options, memfs);
+  fd = open_file(&uvwasi, "big", 0, UVWASI_O_CREAT, 0, 0);
+  ciov.buf = "x";
+  ciov.buf_len = 1;
+  assert(UVWASI_ENOSPC ==
+         uvwasi_fd_pwrite(&uvwasi, fd, &ciov, 1, 1ULL << 40, &nwritten));
+  assert(UVWASI_ENOSPC ==
+         uvwasi_fd_filestat_set_size(&uvwasi, fd, 1ULL << 40));
+  assert(UVWASI_ENOSPC == uvwasi_fd_allocate(&uvwasi, fd, 0, 1ULL << 40));
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 0);
+
+  /* Up to the limit is fine, and removing a file gives its space back. */
+  memset(buf, 'x', sizeof(buf));
+  ciov.buf = buf;
+  ciov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_pwrite(&uvwasi, fd, &ciov, 1, 0, &nwritten));
+  assert(nwritten == sizeof(buf));
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  fd = open_file(&uvwasi, "small", 0, UVWASI_O_CREAT, 0, 0);
+  ciov.buf_len = 1500;
+  assert(UVWASI_ENOSPC ==
+         uvwasi_fd_pwrite(&uvwasi, fd, &ciov, 1, 0, &nwritten));
+  assert(0 == uvwasi_path_unlink_file(&uvwasi, 3, "big", 4));
+  assert(0 == uvwasi_fd_pwrite(&uvwasi, fd, &ciov, 1, 0, &nwritten));
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  destroy_sandbox(&uvwasi, &options);
+  assert(0 == uvwasi_memfs_free(memfs));
+  assert(counts.live == 0);
+}
+
+/* Empty files and directories, and their names, count towards the limit
+   too. */
+static void test_size_limit_entries(void) {
+  uvwasi_options_t options;
+  uvwasi_memfs_t* memfs;
+  uvwasi_errno_t err;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t fd;
+  uvwasi_mem_t allocator;
+  counting_counts_t counts;
+  char name[16];
+  int files;
+  int dirs;
+  int i;
+
+  counting_allocator_init(&allocator, &counts);
+  assert(0 == uvwasi_memfs_new(&allocator, 4096, &memfs));
+  init_sandbox(&uvwasi, &options, memfs);
+
+  for (files = 0; files < 4096; files++) {
+    snprintf(name, sizeof(name), "f%d", files);
+    err = uvwasi_path_open(&uvwasi,
+                           3,
+                           0,
+                           name,
+                           strlen(name) + 1,
+                           UVWASI_O_CREAT,
+                           UVWASI_RIGHT_FD_READ,
+                           0,
+                           0,
+                           &fd);
+    if (err != 0)
+      break;
+    assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  }
+  assert(err == UVWASI_ENOSPC);
+  assert(files > 0);
+
+  /* Removing files makes room for directories. */
+  for (i = 0; i < files; i++) {
+    snprintf(name, sizeof(name), "f%d", i);
+    assert(0 == uvwasi_path_unlink_file(&uvwasi, 3, name, strlen(name) + 1));
+  }
+
+  for (dirs = 0; dirs < 4096; dirs++) {
+    snprintf(name, sizeof(name), "d%d", dirs);
+    err = uvwasi_path_create_directory(&uvwasi, 3, name, strlen(name) + 1);
+    if (err != 0)
+      break;
+  }
+  assert(err == UVWASI_ENOSPC);
+  assert(dirs > 0);
+
+  destroy_sandbox(&uvwasi, &options);
+  assert(0 == uvwasi_memfs_free(memfs));
+  assert(counts.live == 0);
+}
+
+int main(void) {
+  uvwasi_options_t options;
+  uvwasi_memfs_t* memfs;
+  uvwasi_t uvwasi;
+  uvwasi_mem_t allocator;
+  counting_counts_t counts;
+
+  setup_test_environment();
+
+  assert(UVWASI_EINVAL == uvwasi_memfs_new(NULL, 0, NULL));
+  assert(UVWASI_EINVAL == uvwasi_memfs_free(NULL));
+  counting_allocator_init(&allocator, &counts);
+  assert(0 == uvwasi_memfs_new(&allocator, 0, &memfs));
+  assert(counts.live > 0);
+
+  init_sandbox(&uvwasi, &options, memfs);
+  test_file_io(&uvwasi);
+  test_directories(&uvwasi);
+  test_symlinks(&uvwasi);
+  test_links_and_renames(&uvwasi);
+  test_timestamps(&uvwasi);
+  destroy_sandbox(&uvwasi, &options);
+
+  /* Whatever is left in the file system is freed with it. */
+  test_shared(memfs);
+  assert(0 == uvwasi_memfs_free(memfs));
+  assert(counts.live == 0);
+
+  test_size_limit();
+  test_size_limit_entries();
+  return 0;
+}
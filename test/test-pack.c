@@ -0,0 +1,299 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_IMAGE TEST_TMP_DIR "/test-pack.img"
+#define BUF_SIZE 256
+#define NODE_COUNT 6
+
+/* Nodes in image order. Directories list their first child and count. */
+static const struct {
+  const char* name;
+  uint32_t parent;
+  uvwasi_filetype_t type;
+  const char* data;
+  uint64_t first;
+  uint64_t count;
+} tree[NODE_COUNT] = {
+  { "", 0, UVWASI_FILETYPE_DIRECTORY, NULL, 1, 4 },
+  { "a", 0, UVWASI_FILETYPE_DIRECTORY, NULL, 5, 1 },
+  { "empty", 0, UVWASI_FILETYPE_DIRECTORY, NULL, 0, 0 },
+  { "hello.txt", 0, UVWASI_FILETYPE_REGULAR_FILE, "hello world", 0, 0 },
+  { "link", 0, UVWASI_FILETYPE_SYMBOLIC_LINK, "a/b.txt", 0, 0 },
+  { "b.txt", 1, UVWASI_FILETYPE_REGULAR_FILE, "bee", 0, 0 },
+};
+
+static char image[1024];
+static size_t image_size;
+
+static uvwasi_pack_node_t* image_node(uint32_t i) {
+  return (uvwasi_pack_node_t*) (image + sizeof(uvwasi_pack_header_t)) + i;
+}
+
+static void build_image(void) {
+  uvwasi_pack_header_t* header;
+  uvwasi_pack_node_t* node;
+  size_t len;
+  uint32_t i;
+
+  memset(image, 0, sizeof(image));
+  header = (uvwasi_pack_header_t*) image;
+  memcpy(header->magic, UVWASI_PACK_MAGIC, sizeof(header->magic));
+  header->version = UVWASI_PACK_VERSION;
+  header->node_count = NODE_COUNT;
+  image_size = sizeof(*header) + NODE_COUNT * sizeof(*node);
+  for (i = 0; i < NODE_COUNT; i++) {
+    node = image_node(i);
+    node->parent = tree[i].parent;
+    node->type = tree[i].type;
+    node->mtim = 1000000000 * (uint64_t) (i + 1);
+    node->name_offset = (uint32_t) image_size;
+    node->name_len = (uint32_t) strlen(tree[i].name);
+    memcpy(image + image_size, tree[i].name, node->name_len);
+    image_size += node->name_len;
+  }
+
+  for (i = 0; i < NODE_COUNT; i++) {
+    node = image_node(i);
+    if (tree[i].data == NULL) {
+      node->offset = tree[i].first;
+      node->size = tree[i].count;
+      continue;
+    }
+
+    len = strlen(tree[i].data);
+    node->offset = image_size;
+    node->size = len;
+    memcpy(image + image_size, tree[i].data, len);
+    image_size += len;
+  }
+
+  assert(image_size <= sizeof(image));
+}
+
+static void write_image(size_t size) {
+  FILE* f;
+
+  f = fopen(TEST_IMAGE, "wb");
+  assert(f != NULL);
+  assert(fwrite(image, 1, size, f) == size);
+  assert(fclose(f) == 0);
+}
+
+/* Damaged images are refused when they are opened. */
+static void check_refused(void) {
+  uvwasi_pack_t* pack;
+
+  write_image(image_size);
+  assert(UVWASI_EINVAL == uvwasi_pack_open(TEST_IMAGE, NULL, &pack));
+  build_image();
+}
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_lookupflags_t dirflags,
+                             uvwasi_oflags_t oflags,
+                             uvwasi_rights_t rights,
+                             uvwasi_errno_t expected) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         3,
+                         dirflags,
+                         path,
+                         strlen(path) + 1,
+                         oflags,
+                         rights,
+                         0,
+                         0,
+                         &fd);
+  assert(err == expected);
+  return fd;
+}
+
+static void check_read(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* expected) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char buf[BUF_SIZE];
+
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_read(uvwasi, fd, &iov, 1, &nread));
+  assert(nread == strlen(expected));
+  assert(memcmp(buf, expected, nread) == 0);
+}
+
+static void run(uvwasi_pack_t* pack) {
+  uvwasi_options_t init_options;
+  uvwasi_filestat_t stat;
+  uvwasi_dirent_t dirent;
+  uvwasi_iovec_t iovs[2];
+  uvwasi_size_t bufused;
+  uvwasi_size_t nread;
+  uvwasi_size_t pos;
+  uvwasi_t uvwasi;
+  uvwasi_fd_t fd;
+  char buf[BUF_SIZE];
+  char buf2[4];
+  const char* names[] = { "a", "empty", "hello.txt", "link" };
+  int i;
+
+  uvwasi_options_init(&init_options);
+  init_options.preopen_vfsc = 1;
+  init_options.preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  init_options.preopen_vfs[0].mapped_path = "/lib";
+  init_options.preopen_vfs[0].vfs = uvwasi_pack_vfs(pack);
+  init_options.preopen_vfs[0].immutable = 1;
+  assert(0 == uvwasi_init(&uvwasi, &init_options));
+
+  /* Reads. */
+  fd = open_file(&uvwasi, "hello.txt", 0, 0,
+                 UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_SEEK |
+                 UVWASI_RIGHT_FD_FILESTAT_GET, 0);
+  iovs[0].buf = buf2;
+  iovs[0].buf_len = sizeof(buf2);
+  iovs[1].buf = buf;
+  iovs[1].buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_read(&uvwasi, fd, iovs, 2, &nread));
+  assert(nread == 11);
+  assert(memcmp(buf2, "hell", 4) == 0 && memcmp(buf, "o world", 7) == 0);
+  check_read(&uvwasi, fd, "");
+  assert(0 == uvwasi_fd_pread(&uvwasi, fd, iovs + 1, 1, 6, &nread));
+  assert(nread == 5 && memcmp(buf, "world", 5) == 0);
+  assert(0 == uvwasi_fd_pread(&uvwasi, fd, iovs + 1, 1, 100, &nread));
+  assert(nread == 0);
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 11);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(stat.st_ino == 4);
+  assert(stat.st_mtim == 4000000000ULL);
+  assert(UVWASI_EBUSY == uvwasi_pack_free(pack));
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  fd = open_file(&uvwasi, "a/b.txt", 0, 0, UVWASI_RIGHT_FD_READ, 0);
+  check_read(&uvwasi, fd, "bee");
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  fd = open_file(&uvwasi, "a/../a/./b.txt", 0, 0, UVWASI_RIGHT_FD_READ, 0);
+  check_read(&uvwasi, fd, "bee");
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  /* Lookups. */
+  assert(0 == uvwasi_path_filestat_get(&uvwasi, 3, 0, "a", 2, &stat));
+  assert(stat.st_filetype == UVWASI_FILETYPE_DIRECTORY);
+  assert(0 == uvwasi_path_filestat_get(&uvwasi, 3, 0, "link", 5, &stat));
+  assert(stat.st_filetype == UVWASI_FILETYPE_SYMBOLIC_LINK);
+  assert(stat.st_size == 7);
+  assert(0 == uvwasi_path_filestat_get(&uvwasi,
+                                       3,
+                                       UVWASI_LOOKUP_SYMLINK_FOLLOW,
+                                       "link",
+                                       5,
+                                       &stat));
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(stat.st_size == 3);
+  assert(0 == uvwasi_path_readlink(&uvwasi, 3, "link", 5, buf, 8, &bufused));
+  assert(bufused == 7 && strcmp(buf, "a/b.txt") == 0);
+  assert(UVWASI_ENOENT ==
+         uvwasi_path_filestat_get(&uvwasi, 3, 0, "b.txt", 6, &stat));
+  assert(UVWASI_ENOENT ==
+         uvwasi_path_filestat_get(&uvwasi, 3, 0, "hello", 6, &stat));
+  assert(UVWASI_ENOENT ==
+         uvwasi_path_filestat_get(&uvwasi, 3, 0, "zzz", 4, &stat));
+  assert(UVWASI_ENOTDIR ==
+         uvwasi_path_filestat_get(&uvwasi, 3, 0, "hello.txt/x", 12, &stat));
+  open_file(&uvwasi, "hello.txt", 0, UVWASI_O_DIRECTORY, 0, UVWASI_ENOTDIR);
+  open_file(&uvwasi, "link", 0, 0, UVWASI_RIGHT_FD_READ, UVWASI_ELOOP);
+
+  /* Listings are sorted by name. */
+  fd = open_file(&uvwasi, ".", 0, UVWASI_O_DIRECTORY,
+                 UVWASI_RIGHT_FD_READDIR, 0);
+  assert(0 == uvwasi_fd_readdir(&uvwasi, fd, buf, sizeof(buf), 0, &bufused));
+  pos = 0;
+  for (i = 0; i < 4; i++) {
+    uvwasi_serdes_read_dirent_t(buf, pos, &dirent);
+    pos += UVWASI_SERDES_SIZE_dirent_t;
+    assert(dirent.d_next == (uvwasi_dircookie_t) i + 1);
+    assert(dirent.d_namlen == strlen(names[i]));
+    assert(memcmp(buf + pos, names[i], dirent.d_namlen) == 0);
+    pos += dirent.d_namlen;
+  }
+  assert(pos == bufused);
+  assert(0 == uvwasi_fd_readdir(&uvwasi, fd, buf, sizeof(buf), 3, &bufused));
+  uvwasi_serdes_read_dirent_t(buf, 0, &dirent);
+  assert(dirent.d_type == UVWASI_FILETYPE_SYMBOLIC_LINK);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  fd = open_file(&uvwasi, "empty", 0, UVWASI_O_DIRECTORY,
+                 UVWASI_RIGHT_FD_READDIR, 0);
+  assert(0 == uvwasi_fd_readdir(&uvwasi, fd, buf, sizeof(buf), 0, &bufused));
+  assert(bufused == 0);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  /* The image cannot be changed. */
+  open_file(&uvwasi, "new", 0, UVWASI_O_CREAT, UVWASI_RIGHT_FD_READ,
+            UVWASI_EROFS);
+  open_file(&uvwasi, "hello.txt", 0, 0, UVWASI_RIGHT_FD_WRITE, UVWASI_EROFS);
+  open_file(&uvwasi, "hello.txt", 0, UVWASI_O_CREAT | UVWASI_O_EXCL,
+            UVWASI_RIGHT_FD_READ, UVWASI_EEXIST);
+  assert(UVWASI_EROFS == uvwasi_path_unlink_file(&uvwasi, 3, "link", 5));
+  assert(UVWASI_EROFS ==
+         uvwasi_path_create_directory(&uvwasi, 3, "dir", 4));
+  assert(UVWASI_EROFS ==
+         uvwasi_path_rename(&uvwasi, 3, "a", 2, 3, "c", 2));
+
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopen_vfs);
+}
+
+int main(void) {
+  uvwasi_pack_t* pack;
+  uv_fs_t req;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  assert(UVWASI_EINVAL == uvwasi_pack_open(NULL, NULL, &pack));
+  assert(UVWASI_EINVAL == uvwasi_pack_free(NULL));
+  assert(UVWASI_ENOENT ==
+         uvwasi_pack_open(TEST_TMP_DIR "/missing.img", NULL, &pack));
+
+  build_image();
+  memcpy(image, "UVWASPAX", 8);
+  check_refused();
+  write_image(sizeof(uvwasi_pack_header_t) + 8);
+  assert(UVWASI_EINVAL == uvwasi_pack_open(TEST_IMAGE, NULL, &pack));
+  image_node(0)->size = 6;
+  check_refused();
+  image_node(5)->size = 100;
+  check_refused();
+  image_node(5)->name_offset = 4096;
+  check_refused();
+  image_node(1)->offset = 0;
+  check_refused();
+  image_node(5)->parent = 2;
+  check_refused();
+  image_node(3)->type = UVWASI_FILETYPE_SOCKET_STREAM;
+  check_refused();
+  /* Children must be sorted. */
+  image_node(1)->name_len = 9;
+  image_node(1)->name_offset = image_node(3)->name_offset;
+  check_refused();
+
+  write_image(image_size);
+  assert(0 == uvwasi_pack_open(TEST_IMAGE, NULL, &pack));
+  run(pack);
+  assert(0 == uvwasi_pack_free(pack));
+
+  r = uv_fs_unlink(NULL, &req, TEST_IMAGE, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+  return 0;
+}
@@ -13,6 +13,7 @@ int main(void) {
   uvwasi_t uvwasi;
   uvwasi_fd_t fd;
   uvwasi_options_t init_options;
+  uvwasi_memfs_t* memfs;
   uvwasi_errno_t err;
   uv_fs_t req;
   int r;
@@ -24,10 +25,7 @@ int main(void) {
   assert(r == 0 || r == UV_EEXIST);
 
   uvwasi_options_init(&init_options);
-  init_options.preopenc = 1;
-  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
-  init_options.preopens[0].mapped_path = "/var";
-  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  memfs = test_preopen_init(&init_options, "/var", TEST_TMP_DIR);
 
   err = uvwasi_init(&uvwasi, &init_options);
   assert(err == 0);
@@ -46,7 +44,7 @@ int main(void) {
   assert(err == UVWASI_EINVAL);
 
   uvwasi_destroy(&uvwasi);
-  free(init_options.preopens);
+  test_preopen_free(&init_options, memfs);
 
   return 0;
 }
@@ -28,24 +28,28 @@ static void check_normalize(char* path, char* expected) {
 
 static uvwasi_errno_t check(char* fd_mp, char* fd_rp, char* path, char** res, uvwasi_lookupflags_t flags) {
   struct uvwasi_fd_wrap_t fd;
+  struct uvwasi_fd_cold_t cold;
   uvwasi_errno_t err;
   uvwasi_size_t len;
 
   setup_test_environment();
 
   len = strlen(path);
+  memset(&cold, 0, sizeof(cold));
   fd.id = 3;
   fd.fd = 3;
-  fd.path = fd_mp;
-  fd.real_path = fd_rp;
-  fd.normalized_path = normalized_path_buffer;
+  fd.cold = &cold;
+  cold.sock = NULL;
+  cold.path = fd_mp;
+  cold.real_path = fd_rp;
+  cold.normalized_path = normalized_path_buffer;
   fd.type = UVWASI_FILETYPE_DIRECTORY;
   fd.rights_base = UVWASI__RIGHTS_ALL;
   fd.rights_inheriting = UVWASI__RIGHTS_ALL;
   fd.preopen = 0;
   err = uvwasi__normalize_path(fd_mp,
                                strlen(fd_mp),
-                               fd.normalized_path,
+                               cold.normalized_path,
                                strlen(fd_mp));
   if (err != UVWASI_ESUCCESS)
     return err;
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "test-common.h"
+
+#define SMALL_SIZE 16
+/* 16 bytes at a time, enough to cross the reseed after 1 MiB of output. */
+#define SMALL_COUNT 100000
+#define LARGE_SIZE 4096
+
+static int is_zero(const unsigned char* buf, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    if (buf[i] != 0)
+      return 0;
+  }
+
+  return 1;
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_t uvwasi2;
+  uvwasi_options_t init_options;
+  uvwasi_errno_t err;
+  unsigned char prev[SMALL_SIZE];
+  unsigned char small[SMALL_SIZE];
+  unsigned char other[SMALL_SIZE];
+  unsigned char odd[7];
+  unsigned char* large;
+  unsigned int counts[256];
+  int i;
+
+  setup_test_environment();
+
+  uvwasi_options_init(&init_options);
+  assert(init_options.random_buffer_size == 0);
+  init_options.random_buffer_size = 100;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  err = uvwasi_init(&uvwasi2, &init_options);
+  assert(err == 0);
+
+  /* Many small requests cross several buffer refills and a reseed. */
+  memset(counts, 0, sizeof(counts));
+  memset(prev, 0, sizeof(prev));
+  for (i = 0; i < SMALL_COUNT; i++) {
+    memset(small, 0, sizeof(small));
+    err = uvwasi_random_get(&uvwasi, small, sizeof(small));
+    assert(err == 0);
+    assert(is_zero(small, sizeof(small)) == 0);
+    assert(memcmp(small, prev, sizeof(small)) != 0);
+    memcpy(prev, small, sizeof(small));
+    counts[small[0]]++;
+  }
+
+  /* Every byte value should turn up; the expected count is about 390. */
+  for (i = 0; i < 256; i++)
+    assert(counts[i] > 0);
+
+  /* Separate instances are seeded independently. */
+  err = uvwasi_random_get(&uvwasi2, other, sizeof(other));
+  assert(err == 0);
+  assert(memcmp(small, other, sizeof(small)) != 0);
+
+  /* Sizes that are not a multiple of the block size. */
+  memset(odd, 0, sizeof(odd));
+  err = uvwasi_random_get(&uvwasi, odd, sizeof(odd));
+  assert(err == 0);
+  assert(is_zero(odd, sizeof(odd)) == 0);
+
+  err = uvwasi_random_get(&uvwasi, odd, 0);
+  assert(err == 0);
+
+  /* Buffer sizes too large to round up are clamped. */
+  uvwasi_destroy(&uvwasi2);
+  init_options.random_buffer_size = 0xffffffff;
+  err = uvwasi_init(&uvwasi2, &init_options);
+  assert(err == 0);
+  memset(small, 0, sizeof(small));
+  err = uvwasi_random_get(&uvwasi2, small, sizeof(small));
+  assert(err == 0);
+  assert(is_zero(small, sizeof(small)) == 0);
+
+  /* Large requests go directly to the kernel. */
+  large = calloc(1, LARGE_SIZE);
+  assert(large != NULL);
+  err = uvwasi_random_get(&uvwasi, large, LARGE_SIZE);
+  assert(err == 0);
+  assert(is_zero(large, LARGE_SIZE) == 0);
+  free(large);
+
+  uvwasi_destroy(&uvwasi2);
+  uvwasi_destroy(&uvwasi);
+  return 0;
+}
@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define RECORDING TEST_TMP_DIR "/test-record.bin"
+
+static uint64_t read_u64(const char** pos) {
+  uint64_t value;
+
+  memcpy(&value, *pos, sizeof(value));
+  *pos += sizeof(value);
+  return value;
+}
+
+static uint32_t read_u32(const char** pos) {
+  uint32_t value;
+
+  memcpy(&value, *pos, sizeof(value));
+  *pos += sizeof(value);
+  return value;
+}
+
+static const char* read_entry(FILE* file,
+                              uvwasi_record_entry_t* entry,
+                              char* args,
+                              size_t args_size) {
+  assert(1 == fread(entry, sizeof(*entry), 1, file));
+  assert(entry->size <= args_size);
+  assert(entry->size == fread(args, 1, entry->size, file));
+  return args;
+}
+
+int main(void) {
+  const char* path = "record.txt";
+  const char* data = "hello";
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_record_header_t header;
+  uvwasi_record_entry_t entry;
+  uvwasi_ciovec_t iov;
+  uvwasi_errno_t err;
+  uvwasi_size_t nwritten;
+  uvwasi_fd_t fd;
+  uv_fs_t req;
+  const char* pos;
+  char args[256];
+  FILE* file;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  /* Recording is unavailable unless enabled in the options. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.enable_record == 0);
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_record_start(&uvwasi, RECORDING) == UVWASI_ENOTSUP);
+  assert(uvwasi_record_stop(&uvwasi) == UVWASI_ENOTSUP);
+  uvwasi_destroy(&uvwasi);
+
+  init_options.enable_record = 1;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  assert(uvwasi_record_stop(&uvwasi) == UVWASI_EINVAL);
+  assert(uvwasi_record_start(&uvwasi, RECORDING) == 0);
+  assert(uvwasi_record_start(&uvwasi, RECORDING) == UVWASI_EBUSY);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         0,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_WRITE,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+  iov.buf = data;
+  iov.buf_len = strlen(data);
+  err = uvwasi_fd_write(&uvwasi, fd, &iov, 1, &nwritten);
+  assert(err == 0);
+  assert(nwritten == strlen(data));
+  err = uvwasi_fd_close(&uvwasi, fd);
+  assert(err == 0);
+  err = uvwasi_fd_close(&uvwasi, 100);
+  assert(err == UVWASI_EBADF);
+
+  assert(uvwasi_record_stop(&uvwasi) == 0);
+
+  /* Calls after the recording stops are not recorded. */
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  assert(err == 0);
+
+  file = fopen(RECORDING, "rb");
+  assert(file != NULL);
+  assert(1 == fread(&header, sizeof(header), 1, file));
+  assert(0 == memcmp(header.magic, UVWASI_RECORD_MAGIC, sizeof(header.magic)));
+  assert(header.version == UVWASI_RECORD_VERSION);
+  assert(header.preopenc == 1);
+
+  /* The preopen is stored as its fd and mapped path. */
+  assert(sizeof(uint64_t) + sizeof(uint32_t) + 4 ==
+         fread(args, 1, sizeof(uint64_t) + sizeof(uint32_t) + 4, file));
+  pos = args;
+  assert(read_u64(&pos) == 3);
+  assert(read_u32(&pos) == 4);
+  assert(0 == memcmp(pos, "/var", 4));
+
+  pos = read_entry(file, &entry, args, sizeof(args));
+  assert(entry.syscall == UVWASI_SYSCALL_PATH_OPEN);
+  assert(entry.error == 0);
+  assert(entry.result == fd);
+  assert(read_u64(&pos) == 3);
+  assert(read_u64(&pos) == 0);
+  assert(read_u32(&pos) == strlen(path) + 1);
+  assert(0 == strcmp(pos, path));
+  pos += strlen(path) + 1;
+  assert(read_u64(&pos) == (UVWASI_O_CREAT | UVWASI_O_TRUNC));
+  assert(read_u64(&pos) == UVWASI_RIGHT_FD_WRITE);
+  assert(read_u64(&pos) == 0);
+  assert(read_u64(&pos) == 0);
+  assert(pos == args + entry.size);
+
+  pos = read_entry(file, &entry, args, sizeof(args));
+  assert(entry.syscall == UVWASI_SYSCALL_FD_WRITE);
+  assert(entry.error == 0);
+  assert(entry.result == strlen(data));
+  assert(entry.start_ns > 0);
+  assert(read_u64(&pos) == fd);
+  assert(read_u64(&pos) == 1);
+  assert(read_u32(&pos) == strlen(data));
+  assert(0 == memcmp(pos, data, strlen(data)));
+
+  pos = read_entry(file, &entry, args, sizeof(args));
+  assert(entry.syscall == UVWASI_SYSCALL_FD_CLOSE);
+  assert(entry.error == 0);
+  assert(read_u64(&pos) == fd);
+
+  pos = read_entry(file, &entry, args, sizeof(args));
+  assert(entry.syscall == UVWASI_SYSCALL_FD_CLOSE);
+  assert(entry.error == UVWASI_EBADF);
+  assert(read_u64(&pos) == 100);
+
+  assert(0 == fread(&entry, sizeof(entry), 1, file));
+  fclose(file);
+
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+
+  r = uv_fs_unlink(NULL, &req, RECORDING, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0);
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define WRITE_COUNT 10
+
+static uint64_t histogram_total(const uvwasi_syscall_stats_t* s) {
+  uint64_t total;
+  int i;
+
+  total = 0;
+  for (i = 0; i < UVWASI_STATS_LATENCY_BUCKETS; i++)
+    total += s->latency[i];
+
+  return total;
+}
+
+int main(void) {
+  const char* path = "./test-stats.txt";
+  const char* data = "hello stats";
+  uvwasi_t uvwasi;
+  uvwasi_t uvwasi2;
+  uvwasi_options_t init_options;
+  uvwasi_stats_t stats;
+  uvwasi_syscall_stats_t* s;
+  uvwasi_ciovec_t ciovec;
+  uvwasi_fd_t fd;
+  uvwasi_size_t nwritten;
+  uvwasi_errno_t err;
+  uv_fs_t req;
+  int r;
+  int i;
+
+  setup_test_environment();
+
+  assert(strcmp(uvwasi_embedder_syscall_name(UVWASI_SYSCALL_FD_WRITE),
+                "fd_write") == 0);
+  assert(strcmp(uvwasi_embedder_syscall_name(UVWASI_SYSCALL_SOCK_SHUTDOWN),
+                "sock_shutdown") == 0);
+  assert(strcmp(uvwasi_embedder_syscall_name(UVWASI_SYSCALL_MAX),
+                "unknown") == 0);
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  /* Statistics are off by default. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.enable_stats == 0);
+  err = uvwasi_init(&uvwasi2, &init_options);
+  assert(err == 0);
+  assert(uvwasi_stats_get(&uvwasi2, &stats) == UVWASI_ENOTSUP);
+  assert(uvwasi_stats_reset(&uvwasi2) == UVWASI_ENOTSUP);
+  uvwasi_destroy(&uvwasi2);
+
+  init_options.enable_stats = 1;
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  assert(uvwasi_stats_get(NULL, &stats) == UVWASI_EINVAL);
+  assert(uvwasi_stats_get(&uvwasi, NULL) == UVWASI_EINVAL);
+
+  err = uvwasi_stats_get(&uvwasi, &stats);
+  assert(err == 0);
+  for (i = 0; i < UVWASI_SYSCALL_MAX; i++)
+    assert(stats.syscalls[i].calls == 0);
+
+  err = uvwasi_path_open(&uvwasi,
+                         3,
+                         1,
+                         path,
+                         strlen(path) + 1,
+                         UVWASI_O_CREAT | UVWASI_O_TRUNC,
+                         UVWASI_RIGHT_FD_WRITE | UVWASI_RIGHT_PATH_UNLINK_FILE,
+                         0,
+                         0,
+                         &fd);
+  assert(err == 0);
+
+  ciovec.buf = data;
+  ciovec.buf_len = strlen(data);
+  for (i = 0; i < WRITE_COUNT; i++) {
+    err = uvwasi_fd_write(&uvwasi, fd, &ciovec, 1, &nwritten);
+    assert(err == 0);
+    assert(nwritten == strlen(data));
+  }
+
+  /* Failed calls are counted as errors and transfer no bytes. */
+  err = uvwasi_fd_write(&uvwasi, 100, &ciovec, 1, &nwritten);
+  assert(err == UVWASI_EBADF);
+
+  err = uvwasi_fd_close(&uvwasi, fd);
+  assert(err == 0);
+  err = uvwasi_path_unlink_file(&uvwasi, 3, path, strlen(path) + 1);
+  assert(err == 0);
+
+  err = uvwasi_stats_get(&uvwasi, &stats);
+  assert(err == 0);
+
+  s = &stats.syscalls[UVWASI_SYSCALL_FD_WRITE];
+  assert(s->calls == WRITE_COUNT + 1);
+  assert(s->errors == 1);
+  assert(s->bytes == WRITE_COUNT * strlen(data));
+  assert(s->total_ns > 0);
+  assert(s->max_ns > 0);
+  assert(s->max_ns <= s->total_ns);
+  assert(histogram_total(s) == s->calls);
+
+  s = &stats.syscalls[UVWASI_SYSCALL_PATH_OPEN];
+  assert(s->calls == 1);
+  assert(s->errors == 0);
+  assert(histogram_total(s) == 1);
+
+  assert(stats.syscalls[UVWASI_SYSCALL_FD_CLOSE].calls == 1);
+  assert(stats.syscalls[UVWASI_SYSCALL_PATH_UNLINK_FILE].calls == 1);
+  assert(stats.syscalls[UVWASI_SYSCALL_FD_READ].calls == 0);
+
+  err = uvwasi_stats_reset(&uvwasi);
+  assert(err == 0);
+  err = uvwasi_stats_get(&uvwasi, &stats);
+  assert(err == 0);
+  for (i = 0; i < UVWASI_SYSCALL_MAX; i++) {
+    assert(stats.syscalls[i].calls == 0);
+    assert(stats.syscalls[i].max_ns == 0);
+    assert(histogram_total(&stats.syscalls[i]) == 0);
+  }
+
+  uvwasi_destroy(&uvwasi);
+  free(init_options.preopens);
+  return 0;
+}
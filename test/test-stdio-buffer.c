@@ -0,0 +1,172 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define TEST_OUT TEST_TMP_DIR "/stdio-buffer-out.txt"
+#define TEST_ERR TEST_TMP_DIR "/stdio-buffer-err.txt"
+#define BUFFER_SIZE 16
+
+static uv_file out_fd;
+static uv_file err_fd;
+
+static uv_file open_output(const char* path) {
+  uv_fs_t req;
+  int r;
+
+  r = uv_fs_open(NULL,
+                 &req,
+                 path,
+                 UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                 0644,
+                 NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r >= 0);
+  return r;
+}
+
+static uint64_t host_size(const char* path) {
+  uv_fs_t req;
+  uint64_t size;
+  int r;
+
+  r = uv_fs_stat(NULL, &req, path, NULL);
+  assert(r == 0);
+  size = req.statbuf.st_size;
+  uv_fs_req_cleanup(&req);
+  return size;
+}
+
+static void write_str(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* str) {
+  uvwasi_ciovec_t iov;
+  uvwasi_size_t nwritten;
+  uvwasi_errno_t err;
+
+  iov.buf = str;
+  iov.buf_len = strlen(str);
+  err = uvwasi_fd_write(uvwasi, fd, &iov, 1, &nwritten);
+  assert(err == 0);
+  assert(nwritten == iov.buf_len);
+}
+
+static void init(uvwasi_t* uvwasi, uvwasi_options_t* options) {
+  out_fd = open_output(TEST_OUT);
+  err_fd = open_output(TEST_ERR);
+  options->out = out_fd;
+  options->err = err_fd;
+  options->stdio_buffer_size = BUFFER_SIZE;
+  assert(0 == uvwasi_init(uvwasi, options));
+}
+
+static void finish(uvwasi_t* uvwasi) {
+  uv_fs_t req;
+
+  uvwasi_destroy(uvwasi);
+  uv_fs_close(NULL, &req, out_fd, NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_close(NULL, &req, err_fd, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+int main(void) {
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_filesize_t offset;
+  uv_fs_t req;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  uvwasi_options_init(&init_options);
+  assert(init_options.stdio_buffer_size == 0);
+  assert(init_options.stdio_line_buffered == 0);
+  assert(init_options.stdio_ordered == 0);
+  assert(init_options.stdio_flush_interval == 0);
+
+  /* Flushing without buffering does nothing. */
+  assert(0 == uvwasi_init(&uvwasi, &init_options));
+  assert(0 == uvwasi_stdio_flush(&uvwasi));
+  uvwasi_destroy(&uvwasi);
+  assert(UVWASI_EINVAL == uvwasi_stdio_flush(NULL));
+
+  /* Output is held until the buffer fills or is flushed. */
+  init(&uvwasi, &init_options);
+  write_str(&uvwasi, 1, "abc");
+  write_str(&uvwasi, 2, "defg");
+  assert(host_size(TEST_OUT) == 0);
+  assert(host_size(TEST_ERR) == 0);
+  write_str(&uvwasi, 1, "0123456789abc");
+  assert(host_size(TEST_OUT) == 0);
+  write_str(&uvwasi, 1, "x");
+  assert(host_size(TEST_OUT) == 16);
+  assert(0 == uvwasi_fd_sync(&uvwasi, 1));
+  assert(host_size(TEST_OUT) == 17);
+  assert(0 == uvwasi_fd_datasync(&uvwasi, 2));
+  assert(host_size(TEST_ERR) == 4);
+
+  /* Writes larger than the buffer go straight through. */
+  write_str(&uvwasi, 1, "a");
+  write_str(&uvwasi, 1, "this is longer than the buffer");
+  assert(host_size(TEST_OUT) == 48);
+
+  /* The embedder flushes explicitly, and the position is current. */
+  write_str(&uvwasi, 2, "hij");
+  assert(0 == uvwasi_stdio_flush(&uvwasi));
+  assert(host_size(TEST_ERR) == 7);
+  write_str(&uvwasi, 1, "kl");
+  assert(0 == uvwasi_fd_tell(&uvwasi, 1, &offset));
+  assert(offset == 50);
+
+  /* Closing and destroying flush. */
+  write_str(&uvwasi, 2, "mn");
+  assert(0 == uvwasi_fd_close(&uvwasi, 2));
+  assert(host_size(TEST_ERR) == 9);
+  write_str(&uvwasi, 1, "op");
+  finish(&uvwasi);
+  assert(host_size(TEST_OUT) == 52);
+
+  /* Line buffering flushes on newlines. */
+  init_options.stdio_line_buffered = 1;
+  init(&uvwasi, &init_options);
+  write_str(&uvwasi, 1, "abc");
+  assert(host_size(TEST_OUT) == 0);
+  write_str(&uvwasi, 1, "d\nef");
+  assert(host_size(TEST_OUT) == 7);
+  finish(&uvwasi);
+  init_options.stdio_line_buffered = 0;
+
+  /* Ordered streams flush each other. */
+  init_options.stdio_ordered = 1;
+  init(&uvwasi, &init_options);
+  write_str(&uvwasi, 1, "abc");
+  write_str(&uvwasi, 2, "de");
+  assert(host_size(TEST_OUT) == 3);
+  assert(host_size(TEST_ERR) == 0);
+  write_str(&uvwasi, 1, "f");
+  assert(host_size(TEST_ERR) == 2);
+  finish(&uvwasi);
+  init_options.stdio_ordered = 0;
+
+  /* Output older than the flush interval is written by the next write. */
+  init_options.stdio_flush_interval = 1000000;
+  init(&uvwasi, &init_options);
+  write_str(&uvwasi, 1, "abc");
+  assert(host_size(TEST_OUT) == 0);
+  uv_sleep(5);
+  write_str(&uvwasi, 1, "d");
+  assert(host_size(TEST_OUT) == 4);
+  finish(&uvwasi);
+
+  uv_fs_unlink(NULL, &req, TEST_OUT, NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_unlink(NULL, &req, TEST_ERR, NULL);
+  uv_fs_req_cleanup(&req);
+  return 0;
+}
@@ -0,0 +1,208 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define RING_SIZE 64
+#define THREAD_CALLS 20
+/* More than PTHREAD_KEYS_MAX on Linux. */
+#define MANY_SANDBOXES 1100
+
+static uvwasi_t uvwasi;
+
+static void thread_main(void* arg) {
+  uvwasi_timestamp_t time;
+  uvwasi_errno_t err;
+  int i;
+
+  (void) arg;
+  for (i = 0; i < THREAD_CALLS; i++) {
+    err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_MONOTONIC, 1, &time);
+    assert(err == 0);
+  }
+}
+
+/* Any number of traced sandboxes can be alive, and recorded into by the same
+   thread, at once. */
+static void test_many_sandboxes(uvwasi_options_t* init_options) {
+  uvwasi_trace_event_t event;
+  uvwasi_size_t ndrained;
+  uvwasi_t* sandboxes;
+  unsigned char buf[8];
+  int pass;
+  int i;
+
+  sandboxes = calloc(MANY_SANDBOXES, sizeof(*sandboxes));
+  assert(sandboxes != NULL);
+  for (i = 0; i < MANY_SANDBOXES; i++) {
+    assert(0 == uvwasi_init(&sandboxes[i], init_options));
+    assert(0 == uvwasi_trace_enable(&sandboxes[i]));
+  }
+
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < MANY_SANDBOXES; i++)
+      assert(0 == uvwasi_random_get(&sandboxes[i], buf, sizeof(buf)));
+  }
+
+  for (i = 0; i < MANY_SANDBOXES; i++) {
+    assert(0 == uvwasi_trace_drain(&sandboxes[i], &event, 1, &ndrained));
+    assert(ndrained == 1);
+    assert(event.syscall == UVWASI_SYSCALL_RANDOM_GET);
+    assert(0 == uvwasi_trace_drain(&sandboxes[i], &event, 1, &ndrained));
+    assert(ndrained == 1);
+    assert(0 == uvwasi_trace_drain(&sandboxes[i], &event, 1, &ndrained));
+    assert(ndrained == 0);
+    uvwasi_destroy(&sandboxes[i]);
+  }
+
+  free(sandboxes);
+}
+
+int main(void) {
+  uvwasi_options_t init_options;
+  uvwasi_trace_event_t events[4 * RING_SIZE];
+  uvwasi_trace_event_t* e;
+  uvwasi_timestamp_t time;
+  uvwasi_size_t ndrained;
+  uvwasi_errno_t err;
+  uv_thread_t thread;
+  uint64_t dropped;
+  unsigned char buf[8];
+  uint32_t main_thread;
+  int seen_main;
+  int seen_thread;
+  uvwasi_size_t i;
+
+  setup_test_environment();
+
+  /* Tracing is unavailable unless a buffer size is configured. */
+  uvwasi_options_init(&init_options);
+  assert(init_options.trace_buffer_size == 0);
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_trace_enable(&uvwasi) == UVWASI_ENOTSUP);
+  assert(uvwasi_trace_drain(&uvwasi, events, 1, &ndrained) == UVWASI_ENOTSUP);
+  uvwasi_destroy(&uvwasi);
+
+  init_options.trace_buffer_size = RING_SIZE;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+
+  /* Nothing is recorded until tracing is enabled. */
+  err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+  assert(err == 0);
+  err = uvwasi_trace_drain(&uvwasi, events, RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 0);
+
+  err = uvwasi_trace_enable(&uvwasi);
+  assert(err == 0);
+
+  err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+  assert(err == 0);
+  err = uvwasi_fd_close(&uvwasi, 100);
+  assert(err == UVWASI_EBADF);
+  err = uvwasi_clock_time_get(&uvwasi, UVWASI_CLOCK_REALTIME, 1, &time);
+  assert(err == 0);
+
+  err = uvwasi_trace_drain(&uvwasi, events, RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 3);
+
+  e = &events[0];
+  assert(e->syscall == UVWASI_SYSCALL_RANDOM_GET);
+  assert(e->fd == UVWASI_TRACE_NO_FD);
+  assert(e->arg == sizeof(buf));
+  assert(e->result == sizeof(buf));
+  assert(e->error == UVWASI_ESUCCESS);
+  assert(e->start_ns > 0);
+  assert(e->end_ns >= e->start_ns);
+
+  e = &events[1];
+  assert(e->syscall == UVWASI_SYSCALL_FD_CLOSE);
+  assert(e->fd == 100);
+  assert(e->error == UVWASI_EBADF);
+  assert(e->start_ns >= events[0].end_ns);
+
+  e = &events[2];
+  assert(e->syscall == UVWASI_SYSCALL_CLOCK_TIME_GET);
+  assert(e->arg == UVWASI_CLOCK_REALTIME);
+  assert(e->result == time);
+  assert(e->thread == events[0].thread);
+  main_thread = e->thread;
+
+  /* Draining empties the rings. */
+  err = uvwasi_trace_drain(&uvwasi, events, RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 0);
+
+  /* Other threads record into their own rings. */
+  assert(0 == uv_thread_create(&thread, thread_main, NULL));
+  assert(0 == uv_thread_join(&thread));
+  err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+  assert(err == 0);
+
+  err = uvwasi_trace_drain(&uvwasi, events, RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == THREAD_CALLS + 1);
+  seen_main = 0;
+  seen_thread = 0;
+  for (i = 0; i < ndrained; i++) {
+    if (events[i].syscall == UVWASI_SYSCALL_CLOCK_TIME_GET) {
+      assert(events[i].thread != main_thread);
+      seen_thread++;
+    } else {
+      assert(events[i].syscall == UVWASI_SYSCALL_RANDOM_GET);
+      assert(events[i].thread == main_thread);
+      seen_main++;
+    }
+  }
+  assert(seen_main == 1);
+  assert(seen_thread == THREAD_CALLS);
+
+  /* A full ring drops new events and counts them. */
+  err = uvwasi_trace_dropped(&uvwasi, &dropped);
+  assert(err == 0);
+  assert(dropped == 0);
+  for (i = 0; i < RING_SIZE + 10; i++) {
+    err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+    assert(err == 0);
+  }
+  err = uvwasi_trace_dropped(&uvwasi, &dropped);
+  assert(err == 0);
+  assert(dropped == 10);
+
+  /* Partial drains leave the remaining events in place. */
+  err = uvwasi_trace_drain(&uvwasi, events, 10, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 10);
+  err = uvwasi_trace_drain(&uvwasi, events, 4 * RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == RING_SIZE - 10);
+
+  err = uvwasi_trace_disable(&uvwasi);
+  assert(err == 0);
+  err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+  assert(err == 0);
+  err = uvwasi_trace_drain(&uvwasi, events, RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 0);
+
+  uvwasi_destroy(&uvwasi);
+
+  /* A sandbox at the address of a destroyed one starts with an empty ring. */
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(uvwasi_trace_enable(&uvwasi) == 0);
+  err = uvwasi_random_get(&uvwasi, buf, sizeof(buf));
+  assert(err == 0);
+  err = uvwasi_trace_drain(&uvwasi, events, 4 * RING_SIZE, &ndrained);
+  assert(err == 0);
+  assert(ndrained == 1);
+  uvwasi_destroy(&uvwasi);
+
+  test_many_sandboxes(&init_options);
+  return 0;
+}
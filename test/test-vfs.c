@@ -0,0 +1,543 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+#include "uv.h"
+#include "test-common.h"
+
+#define TEST_TMP_DIR "./out/tmp"
+#define MAX_NODES 16
+#define MAX_PATH 64
+#define MAX_DATA 256
+
+/* A small in-memory file system. Open files are their nodes. */
+typedef struct node_s {
+  int used;
+  char path[MAX_PATH];
+  uvwasi_filetype_t type;
+  char data[MAX_DATA];
+  uvwasi_filesize_t size;
+} node_t;
+
+static node_t nodes[MAX_NODES];
+static int open_files;
+
+static node_t* find(const char* path) {
+  size_t len;
+  int i;
+
+  /* Trailing slashes are left for uvwasi to check. */
+  len = strlen(path);
+  while (len > 1 && path[len - 1] == '/')
+    len--;
+
+  for (i = 0; i < MAX_NODES; i++) {
+    if (nodes[i].used &&
+        strlen(nodes[i].path) == len &&
+        memcmp(nodes[i].path, path, len) == 0) {
+      return &nodes[i];
+    }
+  }
+
+  return NULL;
+}
+
+static node_t* add(const char* path, uvwasi_filetype_t type) {
+  int i;
+
+  for (i = 0; i < MAX_NODES; i++) {
+    if (!nodes[i].used) {
+      memset(&nodes[i], 0, sizeof(nodes[i]));
+      nodes[i].used = 1;
+      strcpy(nodes[i].path, path);
+      nodes[i].type = type;
+      return &nodes[i];
+    }
+  }
+
+  return NULL;
+}
+
+static int is_child(const node_t* node, const char* dir) {
+  const char* slash;
+  size_t len;
+
+  slash = strrchr(node->path, '/');
+  len = strlen(dir);
+  if (node->path[1] == '\0')
+    return 0;
+  if (len == 1)
+    return slash == node->path;
+  return (size_t) (slash - node->path) == len &&
+         memcmp(node->path, dir, len) == 0;
+}
+
+static void fill_stat(const node_t* node, uvwasi_filestat_t* buf) {
+  memset(buf, 0, sizeof(*buf));
+  buf->st_dev = 1;
+  buf->st_ino = (node - nodes) + 1;
+  buf->st_nlink = 1;
+  buf->st_filetype = node->type;
+  buf->st_size = node->size;
+}
+
+static uvwasi_errno_t mem_open(const char* path,
+                               uvwasi_oflags_t oflags,
+                               uvwasi_fdflags_t fdflags,
+                               int writable,
+                               void** file,
+                               void* vfs_user_data) {
+  node_t* node;
+
+  assert(vfs_user_data == nodes);
+  node = find(path);
+  if (node == NULL) {
+    if ((oflags & UVWASI_O_CREAT) == 0)
+      return UVWASI_ENOENT;
+    node = add(path, UVWASI_FILETYPE_REGULAR_FILE);
+    if (node == NULL)
+      return UVWASI_ENOSPC;
+  } else if ((oflags & UVWASI_O_EXCL) != 0) {
+    return UVWASI_EEXIST;
+  }
+
+  if ((oflags & UVWASI_O_TRUNC) != 0)
+    node->size = 0;
+
+  open_files++;
+  *file = node;
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_close(void* file, void* vfs_user_data) {
+  open_files--;
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_fstat(void* file,
+                                uvwasi_filestat_t* buf,
+                                void* vfs_user_data) {
+  fill_stat(file, buf);
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_stat(const char* path,
+                               uvwasi_filestat_t* buf,
+                               void* vfs_user_data) {
+  node_t* node;
+
+  node = find(path);
+  if (node == NULL)
+    return UVWASI_ENOENT;
+
+  fill_stat(node, buf);
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_pread(void* file,
+                                const uvwasi_iovec_t* iovs,
+                                uvwasi_size_t iovs_len,
+                                uvwasi_filesize_t offset,
+                                uvwasi_size_t* nread,
+                                void* vfs_user_data) {
+  node_t* node;
+  uvwasi_size_t i;
+  size_t len;
+
+  node = file;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_EISDIR;
+
+  *nread = 0;
+  for (i = 0; i < iovs_len && offset < node->size; i++) {
+    len = iovs[i].buf_len;
+    if (len > node->size - offset)
+      len = node->size - offset;
+    memcpy(iovs[i].buf, node->data + offset, len);
+    offset += len;
+    *nread += len;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_pwrite(void* file,
+                                 const uvwasi_ciovec_t* iovs,
+                                 uvwasi_size_t iovs_len,
+                                 uvwasi_filesize_t offset,
+                                 uvwasi_size_t* nwritten,
+                                 void* vfs_user_data) {
+  node_t* node;
+  uvwasi_size_t i;
+
+  node = file;
+  *nwritten = 0;
+  for (i = 0; i < iovs_len; i++) {
+    if (offset + iovs[i].buf_len > MAX_DATA)
+      return UVWASI_EFBIG;
+    if (offset > node->size)
+      memset(node->data + node->size, 0, offset - node->size);
+    memcpy(node->data + offset, iovs[i].buf, iovs[i].buf_len);
+    offset += iovs[i].buf_len;
+    *nwritten += iovs[i].buf_len;
+    if (offset > node->size)
+      node->size = offset;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_set_size(void* file,
+                                   uvwasi_filesize_t size,
+                                   void* vfs_user_data) {
+  node_t* node;
+
+  node = file;
+  if (size > MAX_DATA)
+    return UVWASI_EFBIG;
+  if (size > node->size)
+    memset(node->data + node->size, 0, size - node->size);
+  node->size = size;
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_readdir(void* file,
+                                  uvwasi_dircookie_t cookie,
+                                  uvwasi_dirent_t* dirent,
+                                  char* name,
+                                  uvwasi_size_t name_size,
+                                  void* vfs_user_data) {
+  node_t* dir;
+  const char* base;
+  int i;
+
+  dir = file;
+  dirent->d_namlen = 0;
+  for (i = 0; i < MAX_NODES; i++) {
+    if (!nodes[i].used || !is_child(&nodes[i], dir->path))
+      continue;
+
+    if (cookie-- == 0) {
+      base = strrchr(nodes[i].path, '/') + 1;
+      dirent->d_ino = i + 1;
+      dirent->d_type = nodes[i].type;
+      dirent->d_namlen = strlen(base);
+      memcpy(name,
+             base,
+             dirent->d_namlen < name_size ? dirent->d_namlen : name_size);
+      break;
+    }
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_mkdir(const char* path, void* vfs_user_data) {
+  if (find(path) != NULL)
+    return UVWASI_EEXIST;
+  return add(path, UVWASI_FILETYPE_DIRECTORY) ? 0 : UVWASI_ENOSPC;
+}
+
+static uvwasi_errno_t mem_unlink(const char* path, void* vfs_user_data) {
+  node_t* node;
+
+  node = find(path);
+  if (node == NULL)
+    return UVWASI_ENOENT;
+  if (node->type == UVWASI_FILETYPE_DIRECTORY)
+    return UVWASI_EISDIR;
+
+  node->used = 0;
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_rename(const char* old_path,
+                                 const char* new_path,
+                                 void* vfs_user_data) {
+  node_t* node;
+
+  node = find(old_path);
+  if (node == NULL)
+    return UVWASI_ENOENT;
+  if (find(new_path) != NULL)
+    return UVWASI_EEXIST;
+
+  strcpy(node->path, new_path);
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_readlink(const char* path,
+                                   char* buf,
+                                   uvwasi_size_t buf_len,
+                                   uvwasi_size_t* bufused,
+                                   void* vfs_user_data) {
+  node_t* node;
+
+  node = find(path);
+  if (node == NULL)
+    return UVWASI_ENOENT;
+  if (node->type != UVWASI_FILETYPE_SYMBOLIC_LINK)
+    return UVWASI_EINVAL;
+
+  *bufused = node->size < buf_len ? node->size : buf_len;
+  memcpy(buf, node->data, *bufused);
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_errno_t mem_symlink(const char* target,
+                                  const char* path,
+                                  void* vfs_user_data) {
+  node_t* node;
+
+  if (find(path) != NULL)
+    return UVWASI_EEXIST;
+
+  node = add(path, UVWASI_FILETYPE_SYMBOLIC_LINK);
+  if (node == NULL)
+    return UVWASI_ENOSPC;
+
+  node->size = strlen(target);
+  memcpy(node->data, target, node->size);
+  return UVWASI_ESUCCESS;
+}
+
+static uvwasi_fd_t open_file(uvwasi_t* uvwasi,
+                             const char* path,
+                             uvwasi_lookupflags_t dirflags,
+                             uvwasi_oflags_t oflags,
+                             uvwasi_fdflags_t fdflags,
+                             uvwasi_errno_t expected) {
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+
+  err = uvwasi_path_open(uvwasi,
+                         4,
+                         dirflags,
+                         path,
+                         strlen(path) + 1,
+                         oflags,
+                         UVWASI_RIGHT_FD_READ | UVWASI_RIGHT_FD_WRITE |
+                         UVWASI_RIGHT_FD_SEEK | UVWASI_RIGHT_FD_TELL |
+                         UVWASI_RIGHT_FD_FILESTAT_GET |
+                         UVWASI_RIGHT_FD_FILESTAT_SET_SIZE |
+                         UVWASI_RIGHT_FD_READDIR | UVWASI_RIGHT_FD_ALLOCATE,
+                         0,
+                         fdflags,
+                         &fd);
+  assert(err == expected);
+  return fd;
+}
+
+static void check_read(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* expected) {
+  uvwasi_iovec_t iov;
+  uvwasi_size_t nread;
+  char buf[MAX_DATA];
+
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_read(uvwasi, fd, &iov, 1, &nread));
+  assert(nread == strlen(expected));
+  assert(memcmp(buf, expected, nread) == 0);
+}
+
+static void write_str(uvwasi_t* uvwasi, uvwasi_fd_t fd, const char* str) {
+  uvwasi_ciovec_t ciov;
+  uvwasi_size_t nwritten;
+
+  ciov.buf = str;
+  ciov.buf_len = strlen(str);
+  assert(0 == uvwasi_fd_write(uvwasi, fd, &ciov, 1, &nwritten));
+  assert(nwritten == strlen(str));
+}
+
+int main(void) {
+  uvwasi_vfs_t vfs;
+  uvwasi_t uvwasi;
+  uvwasi_options_t init_options;
+  uvwasi_filestat_t stat;
+  uvwasi_fdstat_t fdstat;
+  uvwasi_filesize_t pos;
+  uvwasi_prestat_t prestat;
+  uvwasi_ciovec_t ciov;
+  uvwasi_iovec_t iov;
+  uvwasi_dirent_t dirent;
+  uvwasi_size_t nwritten;
+  uvwasi_size_t nread;
+  uvwasi_size_t bufused;
+  uvwasi_errno_t err;
+  uvwasi_fd_t fd;
+  uvwasi_fd_t fd2;
+  uv_fs_t req;
+  char buf[256];
+  node_t* node;
+  int r;
+
+  setup_test_environment();
+
+  r = uv_fs_mkdir(NULL, &req, TEST_TMP_DIR, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  assert(r == 0 || r == UV_EEXIST);
+
+  add("/", UVWASI_FILETYPE_DIRECTORY);
+  node = add("/hello.txt", UVWASI_FILETYPE_REGULAR_FILE);
+  memcpy(node->data, "hello", 5);
+  node->size = 5;
+
+  memset(&vfs, 0, sizeof(vfs));
+  vfs.vfs_user_data = nodes;
+  vfs.open = mem_open;
+  vfs.close = mem_close;
+  vfs.fstat = mem_fstat;
+  vfs.stat = mem_stat;
+  vfs.pread = mem_pread;
+  vfs.pwrite = mem_pwrite;
+  vfs.set_size = mem_set_size;
+  vfs.readdir = mem_readdir;
+  vfs.mkdir = mem_mkdir;
+  vfs.unlink = mem_unlink;
+  vfs.rename = mem_rename;
+  vfs.readlink = mem_readlink;
+  vfs.symlink = mem_symlink;
+
+  uvwasi_options_init(&init_options);
+  init_options.preopenc = 1;
+  init_options.preopens = calloc(1, sizeof(uvwasi_preopen_t));
+  init_options.preopens[0].mapped_path = "/var";
+  init_options.preopens[0].real_path = TEST_TMP_DIR;
+  init_options.preopen_vfsc = 1;
+  init_options.preopen_vfs = calloc(1, sizeof(uvwasi_preopen_vfs_t));
+  init_options.preopen_vfs[0].mapped_path = "/mem";
+  assert(UVWASI_EINVAL == uvwasi_init(&uvwasi, &init_options));
+  init_options.preopen_vfs[0].vfs = &vfs;
+  err = uvwasi_init(&uvwasi, &init_options);
+  assert(err == 0);
+  assert(open_files == 1);
+
+  err = uvwasi_fd_prestat_get(&uvwasi, 4, &prestat);
+  assert(err == 0);
+  assert(prestat.u.dir.pr_name_len == 4);
+  err = uvwasi_path_filestat_get(&uvwasi, 4, 0, ".", 2, &stat);
+  assert(err == 0);
+  assert(stat.st_filetype == UVWASI_FILETYPE_DIRECTORY);
+
+  /* Reads and seeks track the position in uvwasi. */
+  fd = open_file(&uvwasi, "hello.txt", 0, 0, 0, 0);
+  check_read(&uvwasi, fd, "hello");
+  check_read(&uvwasi, fd, "");
+  assert(0 == uvwasi_fd_tell(&uvwasi, fd, &pos));
+  assert(pos == 5);
+  assert(0 == uvwasi_fd_seek(&uvwasi, fd, -3, UVWASI_WHENCE_END, &pos));
+  assert(pos == 2);
+  check_read(&uvwasi, fd, "llo");
+  iov.buf = buf;
+  iov.buf_len = 2;
+  assert(0 == uvwasi_fd_pread(&uvwasi, fd, &iov, 1, 1, &nread));
+  assert(nread == 2 && memcmp(buf, "el", 2) == 0);
+  assert(0 == uvwasi_fd_tell(&uvwasi, fd, &pos));
+  assert(pos == 5);
+  assert(UVWASI_EINVAL ==
+         uvwasi_fd_seek(&uvwasi, fd, -1, UVWASI_WHENCE_SET, &pos));
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 5);
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 0, 3));
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 5);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+
+  /* Created files, positioned and appending writes. */
+  fd = open_file(&uvwasi, "new.txt", 0, UVWASI_O_CREAT, 0, 0);
+  write_str(&uvwasi, fd, "abc");
+  ciov.buf = "xy";
+  ciov.buf_len = 2;
+  assert(0 == uvwasi_fd_pwrite(&uvwasi, fd, &ciov, 1, 5, &nwritten));
+  assert(nwritten == 2);
+  assert(0 == uvwasi_fd_tell(&uvwasi, fd, &pos));
+  assert(pos == 3);
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 7);
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi, fd, 4));
+  assert(0 == uvwasi_fd_allocate(&uvwasi, fd, 4, 4));
+  assert(0 == uvwasi_fd_filestat_get(&uvwasi, fd, &stat));
+  assert(stat.st_size == 8);
+  assert(0 == uvwasi_fd_filestat_set_size(&uvwasi, fd, 4));
+  fd2 = open_file(&uvwasi, "new.txt", 0, 0, UVWASI_FDFLAG_APPEND, 0);
+  assert(0 == uvwasi_fd_fdstat_get(&uvwasi, fd2, &fdstat));
+  assert(fdstat.fs_flags == UVWASI_FDFLAG_APPEND);
+  write_str(&uvwasi, fd2, "de");
+  assert(0 == uvwasi_fd_close(&uvwasi, fd2));
+  assert(0 == uvwasi_fd_seek(&uvwasi, fd, 0, UVWASI_WHENCE_SET, &pos));
+  iov.buf = buf;
+  iov.buf_len = sizeof(buf);
+  assert(0 == uvwasi_fd_read(&uvwasi, fd, &iov, 1, &nread));
+  assert(nread == 6 && memcmp(buf, "abc\0de", 6) == 0);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  open_file(&uvwasi, "new.txt", 0, UVWASI_O_CREAT | UVWASI_O_EXCL, 0,
+            UVWASI_EEXIST);
+
+  /* Directories and their listings. */
+  assert(0 == uvwasi_path_create_directory(&uvwasi, 4, "dir", 4));
+  open_file(&uvwasi, "hello.txt", 0, UVWASI_O_DIRECTORY, 0, UVWASI_ENOTDIR);
+  open_file(&uvwasi, "hello.txt/", 0, 0, 0, UVWASI_ENOTDIR);
+  open_file(&uvwasi, "missing", 0, 0, 0, UVWASI_ENOENT);
+  open_file(&uvwasi, "../escape", 0, 0, 0, UVWASI_ENOTCAPABLE);
+  assert(0 == uvwasi_path_rename(&uvwasi, 4, "new.txt", 8, 4, "dir/n.txt", 10));
+  fd = open_file(&uvwasi, "dir", 0, UVWASI_O_DIRECTORY, 0, 0);
+  assert(0 == uvwasi_fd_readdir(&uvwasi, fd, buf, sizeof(buf), 0, &bufused));
+  assert(bufused == UVWASI_SERDES_SIZE_dirent_t + 5);
+  uvwasi_serdes_read_dirent_t(buf, 0, &dirent);
+  assert(dirent.d_next == 1);
+  assert(dirent.d_namlen == 5);
+  assert(dirent.d_type == UVWASI_FILETYPE_REGULAR_FILE);
+  assert(memcmp(buf + UVWASI_SERDES_SIZE_dirent_t, "n.txt", 5) == 0);
+  assert(0 == uvwasi_fd_readdir(&uvwasi, fd, buf, sizeof(buf), 1, &bufused));
+  assert(bufused == 0);
+  /* A full buffer means that there are more entries. */
+  assert(0 == uvwasi_fd_readdir(&uvwasi, 4, buf, 30, 0, &bufused));
+  assert(bufused == 30);
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  assert(UVWASI_ENOTSUP == uvwasi_path_remove_directory(&uvwasi, 4, "dir", 4));
+
+  /* Symbolic links are resolved through readlink(). */
+  assert(0 == uvwasi_path_symlink(&uvwasi, "hello.txt", 10, 4, "link", 5));
+  assert(0 == uvwasi_path_readlink(&uvwasi, 4, "link", 5, buf, 10, &bufused));
+  assert(bufused == 9 && strcmp(buf, "hello.txt") == 0);
+  assert(UVWASI_ENOBUFS ==
+         uvwasi_path_readlink(&uvwasi, 4, "link", 5, buf, 9, &bufused));
+  assert(0 == uvwasi_path_filestat_get(&uvwasi, 4, 0, "link", 5, &stat));
+  assert(stat.st_filetype == UVWASI_FILETYPE_SYMBOLIC_LINK);
+  assert(0 == uvwasi_path_filestat_get(&uvwasi,
+                                       4,
+                                       UVWASI_LOOKUP_SYMLINK_FOLLOW,
+                                       "link",
+                                       5,
+                                       &stat));
+  assert(stat.st_filetype == UVWASI_FILETYPE_REGULAR_FILE);
+  fd = open_file(&uvwasi, "link", UVWASI_LOOKUP_SYMLINK_FOLLOW, 0, 0, 0);
+  check_read(&uvwasi, fd, "hello");
+  assert(0 == uvwasi_fd_close(&uvwasi, fd));
+  node = add("/out", UVWASI_FILETYPE_SYMBOLIC_LINK);
+  memcpy(node->data, "/etc", 4);
+  node->size = 4;
+  open_file(&uvwasi, "out", UVWASI_LOOKUP_SYMLINK_FOLLOW, 0, 0,
+            UVWASI_ENOTCAPABLE);
+  assert(UVWASI_ENOTSUP ==
+         uvwasi_path_link(&uvwasi, 4, 0, "hello.txt", 10, 4, "hard", 5));
+
+  /* Nothing crosses between the file system and the host. */
+  assert(UVWASI_EXDEV ==
+         uvwasi_path_rename(&uvwasi, 4, "hello.txt", 10, 3, "hello.txt", 10));
+  assert(0 == uvwasi_path_unlink_file(&uvwasi, 4, "link", 5));
+  assert(UVWASI_ENOENT ==
+         uvwasi_path_filestat_get(&uvwasi, 4, 0, "link", 5, &stat));
+
+  /* Files that are still open are closed with the sandbox. */
+  fd = open_file(&uvwasi, "hello.txt", 0, 0, 0, 0);
+  assert(0 == uvwasi_fd_renumber(&uvwasi, fd, 4));
+  assert(open_files == 1);
+  uvwasi_destroy(&uvwasi);
+  assert(open_files == 0);
+  free(init_options.preopens);
+  free(init_options.preopen_vfs);
+  return 0;
+}
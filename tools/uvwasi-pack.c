@@ -0,0 +1,274 @@
+/* Packs a directory tree into an image for uvwasi_pack_open(). Regular
+   files, directories and symbolic links are stored. Anything else is skipped
+   with a warning. Symbolic links are stored as they are, so targets that are
+   absolute or leave the tree will not resolve beneath the preopen.
+
+   Usage: uvwasi-pack <directory> <image> */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uv.h"
+#include "uvwasi.h"
+
+typedef struct entry_s {
+  char* path;
+  char* name;
+  char* target;
+  uvwasi_pack_node_t node;
+} entry_t;
+
+static entry_t* entries;
+static size_t entry_count;
+static size_t entry_capacity;
+
+
+static void* xrealloc(void* ptr, size_t size) {
+  ptr = realloc(ptr, size == 0 ? 1 : size);
+  if (ptr == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  return ptr;
+}
+
+
+static char* xstrdup(const char* str) {
+  char* copy;
+
+  copy = xrealloc(NULL, strlen(str) + 1);
+  strcpy(copy, str);
+  return copy;
+}
+
+
+static int compare_names(const void* a, const void* b) {
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+
+/* Appends the file at path. Returns 0 if it was skipped. */
+static int add_entry(const char* path, const char* name, uint32_t parent) {
+  entry_t* entry;
+  uv_fs_t req;
+  uvwasi_filetype_t type;
+  uint64_t mode;
+  int r;
+
+  r = uv_fs_lstat(NULL, &req, path, NULL);
+  if (r != 0) {
+    fprintf(stderr, "%s: %s\n", path, uv_strerror(r));
+    exit(1);
+  }
+
+  mode = req.statbuf.st_mode & S_IFMT;
+  if (mode == S_IFDIR) {
+    type = UVWASI_FILETYPE_DIRECTORY;
+  } else if (mode == S_IFREG) {
+    type = UVWASI_FILETYPE_REGULAR_FILE;
+#ifdef S_IFLNK
+  } else if (mode == S_IFLNK) {
+    type = UVWASI_FILETYPE_SYMBOLIC_LINK;
+#endif /* S_IFLNK */
+  } else {
+    fprintf(stderr, "%s: skipped, not a file, directory or link\n", path);
+    uv_fs_req_cleanup(&req);
+    return 0;
+  }
+
+  if (entry_count == UINT32_MAX) {
+    fprintf(stderr, "too many files\n");
+    exit(1);
+  }
+
+  if (entry_count == entry_capacity) {
+    entry_capacity = entry_capacity == 0 ? 256 : entry_capacity * 2;
+    entries = xrealloc(entries, entry_capacity * sizeof(*entries));
+  }
+
+  entry = &entries[entry_count++];
+  memset(entry, 0, sizeof(*entry));
+  entry->path = xstrdup(path);
+  entry->name = xstrdup(name);
+  entry->node.type = type;
+  entry->node.parent = parent;
+  entry->node.size = type == UVWASI_FILETYPE_REGULAR_FILE ?
+                         req.statbuf.st_size : 0;
+  entry->node.mtim = (uvwasi_timestamp_t) req.statbuf.st_mtim.tv_sec *
+                         1000000000 + req.statbuf.st_mtim.tv_nsec;
+  uv_fs_req_cleanup(&req);
+
+  if (type == UVWASI_FILETYPE_SYMBOLIC_LINK) {
+    r = uv_fs_readlink(NULL, &req, path, NULL);
+    if (r != 0) {
+      fprintf(stderr, "%s: %s\n", path, uv_strerror(r));
+      exit(1);
+    }
+
+    entry->target = xstrdup(req.ptr);
+    entry->node.size = strlen(entry->target);
+    uv_fs_req_cleanup(&req);
+  }
+
+  return 1;
+}
+
+
+/* Appends the children of directory index, sorted by name. */
+static void add_children(uint32_t index) {
+  uv_dirent_t dirent;
+  uv_fs_t req;
+  char** names;
+  char* path;
+  size_t count;
+  size_t added;
+  size_t i;
+  int r;
+
+  r = uv_fs_scandir(NULL, &req, entries[index].path, 0, NULL);
+  if (r < 0) {
+    fprintf(stderr, "%s: %s\n", entries[index].path, uv_strerror(r));
+    exit(1);
+  }
+
+  names = NULL;
+  count = 0;
+  while (uv_fs_scandir_next(&req, &dirent) != UV_EOF) {
+    names = xrealloc(names, (count + 1) * sizeof(*names));
+    names[count++] = xstrdup(dirent.name);
+  }
+
+  uv_fs_req_cleanup(&req);
+  qsort(names, count, sizeof(*names), compare_names);
+
+  entries[index].node.offset = entry_count;
+  added = 0;
+  for (i = 0; i < count; i++) {
+    path = xrealloc(NULL, strlen(entries[index].path) + strlen(names[i]) + 2);
+    sprintf(path, "%s/%s", entries[index].path, names[i]);
+    added += add_entry(path, names[i], index);
+    free(path);
+    free(names[i]);
+  }
+
+  /* entries may have moved. */
+  entries[index].node.size = added;
+  free(names);
+}
+
+
+static void write_all(FILE* out, const void* data, size_t size) {
+  if (size != 0 && fwrite(data, 1, size, out) != size) {
+    fprintf(stderr, "write error\n");
+    exit(1);
+  }
+}
+
+
+static void copy_file(FILE* out, const entry_t* entry) {
+  char buf[65536];
+  uint64_t left;
+  size_t n;
+  FILE* in;
+
+  in = fopen(entry->path, "rb");
+  if (in == NULL) {
+    fprintf(stderr, "%s: cannot open\n", entry->path);
+    exit(1);
+  }
+
+  for (left = entry->node.size; left > 0; left -= n) {
+    n = fread(buf, 1, left < sizeof(buf) ? (size_t) left : sizeof(buf), in);
+    if (n == 0) {
+      fprintf(stderr, "%s: changed while packing\n", entry->path);
+      exit(1);
+    }
+
+    write_all(out, buf, n);
+  }
+
+  if (fgetc(in) != EOF) {
+    fprintf(stderr, "%s: changed while packing\n", entry->path);
+    exit(1);
+  }
+
+  fclose(in);
+}
+
+
+int main(int argc, char** argv) {
+  uvwasi_pack_header_t header;
+  uint64_t offset;
+  uint32_t i;
+  FILE* out;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <directory> <image>\n", argv[0]);
+    return 1;
+  }
+
+  if (!add_entry(argv[1], "", 0) ||
+      entries[0].node.type != UVWASI_FILETYPE_DIRECTORY) {
+    fprintf(stderr, "%s: not a directory\n", argv[1]);
+    return 1;
+  }
+
+  /* Breadth first, so that the children of every directory are adjacent. */
+  for (i = 0; i < entry_count; i++) {
+    if (entries[i].node.type == UVWASI_FILETYPE_DIRECTORY)
+      add_children(i);
+  }
+
+  /* The nodes are followed by the names and then by the contents. */
+  offset = sizeof(header) + (uint64_t) entry_count * sizeof(entries[0].node);
+  for (i = 0; i < entry_count; i++) {
+    entries[i].node.name_offset = (uint32_t) offset;
+    entries[i].node.name_len = (uint32_t) strlen(entries[i].name);
+    offset += entries[i].node.name_len;
+    if (offset > UINT32_MAX) {
+      fprintf(stderr, "too many names\n");
+      return 1;
+    }
+  }
+
+  for (i = 0; i < entry_count; i++) {
+    if (entries[i].node.type != UVWASI_FILETYPE_DIRECTORY) {
+      entries[i].node.offset = offset;
+      offset += entries[i].node.size;
+    }
+  }
+
+  out = fopen(argv[2], "wb");
+  if (out == NULL) {
+    fprintf(stderr, "%s: cannot create\n", argv[2]);
+    return 1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, UVWASI_PACK_MAGIC, sizeof(header.magic));
+  header.version = UVWASI_PACK_VERSION;
+  header.node_count = (uint32_t) entry_count;
+  write_all(out, &header, sizeof(header));
+  for (i = 0; i < entry_count; i++)
+    write_all(out, &entries[i].node, sizeof(entries[i].node));
+  for (i = 0; i < entry_count; i++)
+    write_all(out, entries[i].name, entries[i].node.name_len);
+  for (i = 0; i < entry_count; i++) {
+    if (entries[i].node.type == UVWASI_FILETYPE_REGULAR_FILE)
+      copy_file(out, &entries[i]);
+    else if (entries[i].node.type == UVWASI_FILETYPE_SYMBOLIC_LINK)
+      write_all(out, entries[i].target, (size_t) entries[i].node.size);
+  }
+
+  if (fclose(out) != 0) {
+    fprintf(stderr, "%s: write error\n", argv[2]);
+    return 1;
+  }
+
+  printf("%s: %u nodes, %" PRIu64 " bytes\n",
+         argv[2],
+         (unsigned) entry_count,
+         offset);
+  return 0;
+}
@@ -0,0 +1,782 @@
+/* Replays a recording written by uvwasi_record_start() against a fresh
+   sandbox and reports how long each system call took compared to the
+   recording. Preopened directory i is mapped to <scratch-dir>/<i>, which is
+   created if needed and can be populated beforehand with the files the
+   recorded program expects. Standard input and output are redirected to the
+   null device. proc_exit() and proc_raise() are not replayed. Calls whose
+   errno differs from the recording are counted as mismatches.
+
+   Usage: uvwasi-replay <recording> <scratch-dir> */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uv.h"
+#include "uvwasi.h"
+
+#ifdef _WIN32
+# define NULL_DEVICE "NUL"
+#else
+# define NULL_DEVICE "/dev/null"
+#endif
+
+#define NO_FD ((uvwasi_fd_t) -1)
+
+typedef struct reader_s {
+  const char* pos;
+  const char* end;
+  int bad;
+} reader_t;
+
+typedef struct syscall_totals_s {
+  uint64_t calls;
+  uint64_t skipped;
+  uint64_t mismatches;
+  uint64_t recorded_ns;
+  uint64_t replay_ns;
+} syscall_totals_t;
+
+static syscall_totals_t totals[UVWASI_SYSCALL_MAX];
+
+/* Recorded fds are mapped to the fds of the replay sandbox. Unmapped fds are
+   used as they are. */
+static uvwasi_fd_t* fd_map;
+static size_t fd_map_size;
+
+/* Scratch space for output buffers and iovec arrays. */
+static char* out_buf;
+static size_t out_size;
+static uvwasi_iovec_t* iov_buf;
+static uvwasi_ciovec_t* ciov_buf;
+static size_t iov_size;
+
+
+static void* xrealloc(void* ptr, size_t size) {
+  ptr = realloc(ptr, size == 0 ? 1 : size);
+  if (ptr == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  return ptr;
+}
+
+
+static uvwasi_fd_t map_fd(uint64_t fd) {
+  if (fd < fd_map_size && fd_map[fd] != NO_FD)
+    return fd_map[fd];
+  return (uvwasi_fd_t) fd;
+}
+
+
+static void set_fd(uint64_t fd, uvwasi_fd_t live) {
+  size_t size;
+
+  if (fd >= fd_map_size) {
+    if (fd >= UINT32_MAX)
+      return;
+    size = fd_map_size == 0 ? 64 : fd_map_size;
+    while (size <= fd)
+      size *= 2;
+    fd_map = xrealloc(fd_map, size * sizeof(*fd_map));
+    while (fd_map_size < size)
+      fd_map[fd_map_size++] = NO_FD;
+  }
+
+  fd_map[fd] = live;
+}
+
+
+static uint64_t get_u64(reader_t* r) {
+  uint64_t value;
+
+  if ((size_t) (r->end - r->pos) < sizeof(value)) {
+    r->bad = 1;
+    return 0;
+  }
+
+  memcpy(&value, r->pos, sizeof(value));
+  r->pos += sizeof(value);
+  return value;
+}
+
+
+static const char* get_buf(reader_t* r, uvwasi_size_t* len) {
+  const char* buf;
+  uint32_t len32;
+
+  *len = 0;
+  if ((size_t) (r->end - r->pos) < sizeof(len32)) {
+    r->bad = 1;
+    return NULL;
+  }
+
+  memcpy(&len32, r->pos, sizeof(len32));
+  r->pos += sizeof(len32);
+  if ((size_t) (r->end - r->pos) < len32) {
+    r->bad = 1;
+    return NULL;
+  }
+
+  buf = r->pos;
+  r->pos += len32;
+  *len = len32;
+  return buf;
+}
+
+
+/* Returns an output buffer of the recorded length. */
+static char* get_out(reader_t* r, uvwasi_size_t* len) {
+  uint64_t size;
+
+  size = get_u64(r);
+  if (size > UINT32_MAX) {
+    r->bad = 1;
+    size = 0;
+  }
+
+  if (size > out_size) {
+    out_buf = xrealloc(out_buf, size);
+    out_size = size;
+  }
+
+  *len = (uvwasi_size_t) size;
+  return out_buf;
+}
+
+
+static void reserve_iovs(size_t count) {
+  if (count > iov_size) {
+    iov_buf = xrealloc(iov_buf, count * sizeof(*iov_buf));
+    ciov_buf = xrealloc(ciov_buf, count * sizeof(*ciov_buf));
+    iov_size = count;
+  }
+}
+
+
+/* Read iovecs all point into one output buffer. */
+static uvwasi_iovec_t* get_iovs(reader_t* r, uvwasi_size_t* count) {
+  uint64_t n;
+  uint64_t total;
+  uint64_t i;
+  size_t offset;
+
+  n = get_u64(r);
+  if (n > (size_t) (r->end - r->pos) / sizeof(uint64_t)) {
+    r->bad = 1;
+    n = 0;
+  }
+
+  reserve_iovs(n);
+  total = 0;
+  for (i = 0; i < n; i++) {
+    iov_buf[i].buf_len = (uvwasi_size_t) get_u64(r);
+    total += iov_buf[i].buf_len;
+  }
+
+  if (total > out_size) {
+    out_buf = xrealloc(out_buf, total);
+    out_size = total;
+  }
+
+  offset = 0;
+  for (i = 0; i < n; i++) {
+    iov_buf[i].buf = out_buf + offset;
+    offset += iov_buf[i].buf_len;
+  }
+
+  *count = (uvwasi_size_t) n;
+  return iov_buf;
+}
+
+
+static uvwasi_ciovec_t* get_ciovs(reader_t* r, uvwasi_size_t* count) {
+  uint64_t n;
+  uint64_t i;
+
+  n = get_u64(r);
+  if (n > (size_t) (r->end - r->pos) / sizeof(uint32_t)) {
+    r->bad = 1;
+    n = 0;
+  }
+
+  reserve_iovs(n);
+  for (i = 0; i < n; i++)
+    ciov_buf[i].buf = get_buf(r, &ciov_buf[i].buf_len);
+
+  *count = (uvwasi_size_t) n;
+  return ciov_buf;
+}
+
+
+static uvwasi_errno_t replay_poll_oneoff(uvwasi_t* uvwasi,
+                                         reader_t* r,
+                                         uvwasi_size_t* nevents) {
+  uvwasi_subscription_t* in;
+  uvwasi_event_t* out;
+  uvwasi_errno_t err;
+  uvwasi_size_t len;
+  uvwasi_size_t n;
+  uvwasi_size_t i;
+  const char* buf;
+
+  buf = get_buf(r, &len);
+  get_u64(r);
+  n = (uvwasi_size_t) get_u64(r);
+  if (r->bad || len != n * sizeof(*in))
+    return UVWASI_EINVAL;
+
+  /* Copy the subscriptions so that they are aligned and can be remapped. */
+  in = xrealloc(NULL, len);
+  out = xrealloc(NULL, n * sizeof(*out));
+  memcpy(in, buf, len);
+  for (i = 0; i < n; i++) {
+    if (in[i].type == UVWASI_EVENTTYPE_FD_READ ||
+        in[i].type == UVWASI_EVENTTYPE_FD_WRITE) {
+      in[i].u.fd_readwrite.fd = map_fd(in[i].u.fd_readwrite.fd);
+    }
+  }
+
+  err = uvwasi_poll_oneoff(uvwasi, in, out, n, nevents);
+  free(in);
+  free(out);
+  return err;
+}
+
+
+/* Replays one entry. Returns the errno of the replayed call and stores a new
+   fd or other scalar result in result. */
+static uvwasi_errno_t replay(uvwasi_t* uvwasi,
+                             const uvwasi_record_entry_t* entry,
+                             reader_t* r,
+                             uint64_t* result) {
+  uvwasi_iovec_t* iovs;
+  uvwasi_ciovec_t* ciovs;
+  uvwasi_fdstat_t fdstat;
+  uvwasi_filestat_t filestat;
+  uvwasi_prestat_t prestat;
+  uvwasi_timestamp_t ts;
+  uvwasi_filesize_t size;
+  uvwasi_roflags_t roflags;
+  uvwasi_size_t count;
+  uvwasi_size_t count2;
+  uvwasi_size_t len;
+  uvwasi_size_t len2;
+  uvwasi_fd_t fd;
+  uvwasi_fd_t fd2;
+  uint64_t a;
+  uint64_t b;
+  uint64_t c;
+  uint64_t d;
+  const char* path;
+  const char* path2;
+  char** ptrs;
+  char* buf;
+  uvwasi_errno_t err;
+
+  count = 0;
+  fd = NO_FD;
+  switch (entry->syscall) {
+    case UVWASI_SYSCALL_ARGS_GET:
+    case UVWASI_SYSCALL_ENVIRON_GET:
+      if (entry->syscall == UVWASI_SYSCALL_ARGS_GET)
+        uvwasi_args_sizes_get(uvwasi, &count, &len);
+      else
+        uvwasi_environ_sizes_get(uvwasi, &count, &len);
+      ptrs = xrealloc(NULL, (count + 1) * sizeof(*ptrs));
+      buf = xrealloc(NULL, len);
+      if (entry->syscall == UVWASI_SYSCALL_ARGS_GET)
+        err = uvwasi_args_get(uvwasi, ptrs, buf);
+      else
+        err = uvwasi_environ_get(uvwasi, ptrs, buf);
+      free(ptrs);
+      free(buf);
+      return err;
+    case UVWASI_SYSCALL_ARGS_SIZES_GET:
+      err = uvwasi_args_sizes_get(uvwasi, &count, &len);
+      *result = count;
+      return err;
+    case UVWASI_SYSCALL_CLOCK_RES_GET:
+      err = uvwasi_clock_res_get(uvwasi, (uvwasi_clockid_t) get_u64(r), &ts);
+      *result = ts;
+      return err;
+    case UVWASI_SYSCALL_CLOCK_TIME_GET:
+      a = get_u64(r);
+      b = get_u64(r);
+      err = uvwasi_clock_time_get(uvwasi, (uvwasi_clockid_t) a, b, &ts);
+      *result = ts;
+      return err;
+    case UVWASI_SYSCALL_ENVIRON_SIZES_GET:
+      err = uvwasi_environ_sizes_get(uvwasi, &count, &len);
+      *result = count;
+      return err;
+    case UVWASI_SYSCALL_FD_ADVISE:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      b = get_u64(r);
+      c = get_u64(r);
+      return uvwasi_fd_advise(uvwasi, fd, a, b, (uvwasi_advice_t) c);
+    case UVWASI_SYSCALL_FD_ALLOCATE:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      b = get_u64(r);
+      return uvwasi_fd_allocate(uvwasi, fd, a, b);
+    case UVWASI_SYSCALL_FD_CLOSE:
+      a = get_u64(r);
+      err = uvwasi_fd_close(uvwasi, map_fd(a));
+      if (err == UVWASI_ESUCCESS)
+        set_fd(a, NO_FD);
+      return err;
+    case UVWASI_SYSCALL_FD_DATASYNC:
+      return uvwasi_fd_datasync(uvwasi, map_fd(get_u64(r)));
+    case UVWASI_SYSCALL_FD_FDSTAT_GET:
+      return uvwasi_fd_fdstat_get(uvwasi, map_fd(get_u64(r)), &fdstat);
+    case UVWASI_SYSCALL_FD_FDSTAT_SET_FLAGS:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      return uvwasi_fd_fdstat_set_flags(uvwasi, fd, (uvwasi_fdflags_t) a);
+    case UVWASI_SYSCALL_FD_FDSTAT_SET_RIGHTS:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      b = get_u64(r);
+      return uvwasi_fd_fdstat_set_rights(uvwasi, fd, a, b);
+    case UVWASI_SYSCALL_FD_FILESTAT_GET:
+      return uvwasi_fd_filestat_get(uvwasi, map_fd(get_u64(r)), &filestat);
+    case UVWASI_SYSCALL_FD_FILESTAT_SET_SIZE:
+      fd = map_fd(get_u64(r));
+      return uvwasi_fd_filestat_set_size(uvwasi, fd, get_u64(r));
+    case UVWASI_SYSCALL_FD_FILESTAT_SET_TIMES:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      b = get_u64(r);
+      c = get_u64(r);
+      return uvwasi_fd_filestat_set_times(uvwasi,
+                                          fd,
+                                          a,
+                                          b,
+                                          (uvwasi_fstflags_t) c);
+    case UVWASI_SYSCALL_FD_PREAD:
+      fd = map_fd(get_u64(r));
+      iovs = get_iovs(r, &count);
+      a = get_u64(r);
+      err = uvwasi_fd_pread(uvwasi, fd, iovs, count, a, &len);
+      *result = len;
+      return err;
+    case UVWASI_SYSCALL_FD_PRESTAT_GET:
+      return uvwasi_fd_prestat_get(uvwasi, map_fd(get_u64(r)), &prestat);
+    case UVWASI_SYSCALL_FD_PRESTAT_DIR_NAME:
+      fd = map_fd(get_u64(r));
+      buf = get_out(r, &len);
+      return uvwasi_fd_prestat_dir_name(uvwasi, fd, buf, len);
+    case UVWASI_SYSCALL_FD_PWRITE:
+      fd = map_fd(get_u64(r));
+      ciovs = get_ciovs(r, &count);
+      a = get_u64(r);
+      err = uvwasi_fd_pwrite(uvwasi, fd, ciovs, count, a, &len);
+      *result = len;
+      return err;
+    case UVWASI_SYSCALL_FD_READ:
+      fd = map_fd(get_u64(r));
+      iovs = get_iovs(r, &count);
+      err = uvwasi_fd_read(uvwasi, fd, iovs, count, &len);
+      *result = len;
+      return err;
+    case UVWASI_SYSCALL_FD_READDIR:
+      fd = map_fd(get_u64(r));
+      buf = get_out(r, &len);
+      a = get_u64(r);
+      err = uvwasi_fd_readdir(uvwasi, fd, buf, len, a, &len2);
+      *result = len2;
+      return err;
+    case UVWASI_SYSCALL_FD_RENUMBER:
+      a = get_u64(r);
+      b = get_u64(r);
+      err = uvwasi_fd_renumber(uvwasi, map_fd(a), map_fd(b));
+      if (err == UVWASI_ESUCCESS) {
+        set_fd(b, map_fd(b));
+        set_fd(a, NO_FD);
+      }
+      return err;
+    case UVWASI_SYSCALL_FD_SEEK:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      b = get_u64(r);
+      err = uvwasi_fd_seek(uvwasi,
+                           fd,
+                           (uvwasi_filedelta_t) a,
+                           (uvwasi_whence_t) b,
+                           &size);
+      *result = size;
+      return err;
+    case UVWASI_SYSCALL_FD_SYNC:
+      return uvwasi_fd_sync(uvwasi, map_fd(get_u64(r)));
+    case UVWASI_SYSCALL_FD_TELL:
+      err = uvwasi_fd_tell(uvwasi, map_fd(get_u64(r)), &size);
+      *result = size;
+      return err;
+    case UVWASI_SYSCALL_FD_WRITE:
+      fd = map_fd(get_u64(r));
+      ciovs = get_ciovs(r, &count);
+      err = uvwasi_fd_write(uvwasi, fd, ciovs, count, &len);
+      *result = len;
+      return err;
+    case UVWASI_SYSCALL_PATH_CREATE_DIRECTORY:
+      fd = map_fd(get_u64(r));
+      path = get_buf(r, &len);
+      return uvwasi_path_create_directory(uvwasi, fd, path, len);
+    case UVWASI_SYSCALL_PATH_FILESTAT_GET:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      path = get_buf(r, &len);
+      return uvwasi_path_filestat_get(uvwasi,
+                                      fd,
+                                      (uvwasi_lookupflags_t) a,
+                                      path,
+                                      len,
+                                      &filestat);
+    case UVWASI_SYSCALL_PATH_FILESTAT_SET_TIMES:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      path = get_buf(r, &len);
+      b = get_u64(r);
+      c = get_u64(r);
+      d = get_u64(r);
+      return uvwasi_path_filestat_set_times(uvwasi,
+                                            fd,
+                                            (uvwasi_lookupflags_t) a,
+                                            path,
+                                            len,
+                                            b,
+                                            c,
+                                            (uvwasi_fstflags_t) d);
+    case UVWASI_SYSCALL_PATH_LINK:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      path = get_buf(r, &len);
+      fd2 = map_fd(get_u64(r));
+      path2 = get_buf(r, &len2);
+      return uvwasi_path_link(uvwasi,
+                              fd,
+                              (uvwasi_lookupflags_t) a,
+                              path,
+                              len,
+                              fd2,
+                              path2,
+                              len2);
+    case UVWASI_SYSCALL_PATH_OPEN:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      path = get_buf(r, &len);
+      b = get_u64(r);
+      c = get_u64(r);
+      d = get_u64(r);
+      err = uvwasi_path_open(uvwasi,
+                             fd,
+                             (uvwasi_lookupflags_t) a,
+                             path,
+                             len,
+                             (uvwasi_oflags_t) b,
+                             c,
+                             d,
+                             (uvwasi_fdflags_t) get_u64(r),
+                             &fd2);
+      if (err == UVWASI_ESUCCESS) {
+        if (entry->error == UVWASI_ESUCCESS)
+          set_fd(entry->result, fd2);
+        *result = fd2;
+      }
+      return err;
+    case UVWASI_SYSCALL_PATH_READLINK:
+      fd = map_fd(get_u64(r));
+      path = get_buf(r, &len);
+      buf = get_out(r, &len2);
+      err = uvwasi_path_readlink(uvwasi, fd, path, len, buf, len2, &count);
+      *result = count;
+      return err;
+    case UVWASI_SYSCALL_PATH_REMOVE_DIRECTORY:
+      fd = map_fd(get_u64(r));
+      path = get_buf(r, &len);
+      return uvwasi_path_remove_directory(uvwasi, fd, path, len);
+    case UVWASI_SYSCALL_PATH_RENAME:
+      fd = map_fd(get_u64(r));
+      path = get_buf(r, &len);
+      fd2 = map_fd(get_u64(r));
+      path2 = get_buf(r, &len2);
+      return uvwasi_path_rename(uvwasi, fd, path, len, fd2, path2, len2);
+    case UVWASI_SYSCALL_PATH_SYMLINK:
+      path = get_buf(r, &len);
+      fd = map_fd(get_u64(r));
+      path2 = get_buf(r, &len2);
+      return uvwasi_path_symlink(uvwasi, path, len, fd, path2, len2);
+    case UVWASI_SYSCALL_PATH_UNLINK_FILE:
+      fd = map_fd(get_u64(r));
+      path = get_buf(r, &len);
+      return uvwasi_path_unlink_file(uvwasi, fd, path, len);
+    case UVWASI_SYSCALL_POLL_ONEOFF:
+      err = replay_poll_oneoff(uvwasi, r, &count);
+      *result = count;
+      return err;
+    case UVWASI_SYSCALL_RANDOM_GET:
+      buf = get_out(r, &len);
+      return uvwasi_random_get(uvwasi, buf, len);
+    case UVWASI_SYSCALL_SCHED_YIELD:
+      return uvwasi_sched_yield(uvwasi);
+    case UVWASI_SYSCALL_SOCK_ACCEPT:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      err = uvwasi_sock_accept(uvwasi, fd, (uvwasi_fdflags_t) a, &fd2);
+      if (err == UVWASI_ESUCCESS) {
+        if (entry->error == UVWASI_ESUCCESS)
+          set_fd(entry->result, fd2);
+        *result = fd2;
+      }
+      return err;
+    case UVWASI_SYSCALL_SOCK_RECV:
+      fd = map_fd(get_u64(r));
+      iovs = get_iovs(r, &count);
+      a = get_u64(r);
+      err = uvwasi_sock_recv(uvwasi,
+                             fd,
+                             iovs,
+                             count,
+                             (uvwasi_riflags_t) a,
+                             &count2,
+                             &roflags);
+      *result = count2;
+      return err;
+    case UVWASI_SYSCALL_SOCK_SEND:
+      fd = map_fd(get_u64(r));
+      ciovs = get_ciovs(r, &count);
+      a = get_u64(r);
+      err = uvwasi_sock_send(uvwasi,
+                             fd,
+                             ciovs,
+                             count,
+                             (uvwasi_siflags_t) a,
+                             &count2);
+      *result = count2;
+      return err;
+    case UVWASI_SYSCALL_SOCK_SHUTDOWN:
+      fd = map_fd(get_u64(r));
+      a = get_u64(r);
+      return uvwasi_sock_shutdown(uvwasi, fd, (uvwasi_sdflags_t) a);
+    default:
+      return UVWASI_ENOSYS;
+  }
+}
+
+
+static int open_null_device(void) {
+  uv_fs_t req;
+  int r;
+
+  r = uv_fs_open(NULL, &req, NULL_DEVICE, UV_FS_O_RDWR, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  return r;
+}
+
+
+static int make_dir(const char* path) {
+  uv_fs_t req;
+  int r;
+
+  r = uv_fs_mkdir(NULL, &req, path, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+  return r == 0 || r == UV_EEXIST ? 0 : r;
+}
+
+
+int main(int argc, char** argv) {
+  uvwasi_record_header_t header;
+  uvwasi_record_entry_t entry;
+  uvwasi_options_t options;
+  uvwasi_preopen_t* preopens;
+  uvwasi_t uvwasi;
+  uvwasi_errno_t err;
+  syscall_totals_t* t;
+  syscall_totals_t sum;
+  reader_t r;
+  uint64_t fd;
+  uint64_t start;
+  uint64_t elapsed;
+  uint64_t result;
+  uint32_t len;
+  uint32_t i;
+  size_t args_size;
+  char* args;
+  char* path;
+  int null_fd;
+  int ret;
+  FILE* file;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <recording> <scratch-dir>\n", argv[0]);
+    return 2;
+  }
+
+  file = fopen(argv[1], "rb");
+  if (file == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, UVWASI_RECORD_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s: not a uvwasi recording\n", argv[1]);
+    fclose(file);
+    return 1;
+  }
+
+  if (header.version != UVWASI_RECORD_VERSION) {
+    fprintf(stderr,
+            "%s: unsupported recording version %" PRIu32 "\n",
+            argv[1],
+            header.version);
+    fclose(file);
+    return 1;
+  }
+
+  if (make_dir(argv[2]) != 0) {
+    fprintf(stderr, "%s: cannot create scratch directory\n", argv[2]);
+    fclose(file);
+    return 1;
+  }
+
+  /* Preopen i is mapped to <scratch-dir>/<i>, and recorded at fd
+     3 + i in the replay sandbox. */
+  preopens = xrealloc(NULL, header.preopenc * sizeof(*preopens));
+  for (i = 0; i < header.preopenc; i++) {
+    if (fread(&fd, sizeof(fd), 1, file) != 1 ||
+        fread(&len, sizeof(len), 1, file) != 1) {
+      fprintf(stderr, "%s: truncated header\n", argv[1]);
+      return 1;
+    }
+
+    path = xrealloc(NULL, len + 1);
+    if (fread(path, 1, len, file) != len) {
+      fprintf(stderr, "%s: truncated header\n", argv[1]);
+      return 1;
+    }
+    path[len] = '\0';
+    preopens[i].mapped_path = path;
+
+    path = xrealloc(NULL, strlen(argv[2]) + 16);
+    snprintf(path, strlen(argv[2]) + 16, "%s/%" PRIu32, argv[2], i);
+    if (make_dir(path) != 0) {
+      fprintf(stderr, "%s: cannot create scratch directory\n", path);
+      return 1;
+    }
+    preopens[i].real_path = path;
+    set_fd(fd, 3 + i);
+  }
+
+  null_fd = open_null_device();
+  if (null_fd < 0) {
+    fprintf(stderr, "cannot open %s\n", NULL_DEVICE);
+    return 1;
+  }
+
+  uvwasi_options_init(&options);
+  options.in = null_fd;
+  options.out = null_fd;
+  options.err = null_fd;
+  options.preopenc = header.preopenc;
+  options.preopens = preopens;
+  err = uvwasi_init(&uvwasi, &options);
+  if (err != UVWASI_ESUCCESS) {
+    fprintf(stderr,
+            "uvwasi_init() failed: %s\n",
+            uvwasi_embedder_err_code_to_string(err));
+    return 1;
+  }
+
+  ret = 0;
+  args = NULL;
+  args_size = 0;
+  memset(&sum, 0, sizeof(sum));
+  while (fread(&entry, sizeof(entry), 1, file) == 1) {
+    if (entry.size > args_size) {
+      args = xrealloc(args, entry.size);
+      args_size = entry.size;
+    }
+
+    if (fread(args, 1, entry.size, file) != entry.size ||
+        entry.syscall >= UVWASI_SYSCALL_MAX) {
+      fprintf(stderr, "%s: truncated or corrupt entry\n", argv[1]);
+      ret = 1;
+      break;
+    }
+
+    t = &totals[entry.syscall];
+    t->calls++;
+    t->recorded_ns += entry.duration_ns;
+    if (entry.syscall == UVWASI_SYSCALL_PROC_EXIT ||
+        entry.syscall == UVWASI_SYSCALL_PROC_RAISE) {
+      t->skipped++;
+      continue;
+    }
+
+    r.pos = args;
+    r.end = args + entry.size;
+    r.bad = 0;
+    result = 0;
+    start = uv_hrtime();
+    err = replay(&uvwasi, &entry, &r, &result);
+    elapsed = uv_hrtime() - start;
+    t->replay_ns += elapsed;
+    if (r.bad) {
+      fprintf(stderr, "%s: corrupt arguments\n", argv[1]);
+      ret = 1;
+      break;
+    }
+
+    if (err != entry.error)
+      t->mismatches++;
+  }
+
+  printf("%-24s %10s %8s %10s %14s %14s %8s\n",
+         "syscall",
+         "calls",
+         "skipped",
+         "mismatch",
+         "recorded_ns",
+         "replay_ns",
+         "ratio");
+
+  for (i = 0; i < UVWASI_SYSCALL_MAX; i++) {
+    t = &totals[i];
+    if (t->calls == 0)
+      continue;
+
+    printf("%-24s %10" PRIu64 " %8" PRIu64 " %10" PRIu64 " %14" PRIu64
+           " %14" PRIu64 " %8.2f\n",
+           uvwasi_embedder_syscall_name((uvwasi_syscall_t) i),
+           t->calls,
+           t->skipped,
+           t->mismatches,
+           t->recorded_ns,
+           t->replay_ns,
+           t->recorded_ns == 0 ? 0 :
+             (double) t->replay_ns / (double) t->recorded_ns);
+    sum.calls += t->calls;
+    sum.skipped += t->skipped;
+    sum.mismatches += t->mismatches;
+    sum.recorded_ns += t->recorded_ns;
+    sum.replay_ns += t->replay_ns;
+  }
+
+  printf("%-24s %10" PRIu64 " %8" PRIu64 " %10" PRIu64 " %14" PRIu64
+         " %14" PRIu64 " %8.2f\n",
+         "total",
+         sum.calls,
+         sum.skipped,
+         sum.mismatches,
+         sum.recorded_ns,
+         sum.replay_ns,
+         sum.recorded_ns == 0 ? 0 :
+           (double) sum.replay_ns / (double) sum.recorded_ns);
+
+  uvwasi_destroy(&uvwasi);
+  fclose(file);
+  return ret;
+}
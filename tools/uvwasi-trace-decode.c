@@ -0,0 +1,123 @@
+/* Decodes a binary trace file written by an embedder from the events returned
+   by uvwasi_trace_drain(). Events are printed one per line, sorted by start
+   time, with times relative to the first event.
+
+   Usage: uvwasi-trace-decode <trace-file> */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uvwasi.h"
+
+static int compare_events(const void* a, const void* b) {
+  const uvwasi_trace_event_t* x = a;
+  const uvwasi_trace_event_t* y = b;
+
+  if (x->start_ns < y->start_ns)
+    return -1;
+  if (x->start_ns > y->start_ns)
+    return 1;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  uvwasi_trace_header_t header;
+  uvwasi_trace_event_t* events;
+  uvwasi_trace_event_t* e;
+  size_t nevents;
+  size_t capacity;
+  size_t i;
+  uint64_t base;
+  FILE* file;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <trace-file>\n", argv[0]);
+    return 2;
+  }
+
+  file = fopen(argv[1], "rb");
+  if (file == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, UVWASI_TRACE_MAGIC, sizeof(header.magic)) != 0) {
+    fprintf(stderr, "%s: not a uvwasi trace file\n", argv[1]);
+    fclose(file);
+    return 1;
+  }
+
+  if (header.version != UVWASI_TRACE_VERSION ||
+      header.event_size != sizeof(uvwasi_trace_event_t)) {
+    fprintf(stderr,
+            "%s: unsupported trace version %" PRIu32 " (event size %" PRIu32
+            ")\n",
+            argv[1],
+            header.version,
+            header.event_size);
+    fclose(file);
+    return 1;
+  }
+
+  nevents = 0;
+  capacity = 1024;
+  events = malloc(capacity * sizeof(*events));
+  if (events == NULL) {
+    fclose(file);
+    return 1;
+  }
+
+  for (;;) {
+    if (nevents == capacity) {
+      capacity *= 2;
+      e = realloc(events, capacity * sizeof(*events));
+      if (e == NULL) {
+        free(events);
+        fclose(file);
+        return 1;
+      }
+      events = e;
+    }
+
+    if (fread(&events[nevents], sizeof(*events), 1, file) != 1)
+      break;
+    nevents++;
+  }
+
+  fclose(file);
+  qsort(events, nevents, sizeof(*events), compare_events);
+  base = nevents > 0 ? events[0].start_ns : 0;
+
+  printf("%12s %10s %6s %-24s %10s %20s %20s %s\n",
+         "start_us",
+         "dur_ns",
+         "thread",
+         "syscall",
+         "fd",
+         "arg",
+         "result",
+         "errno");
+
+  for (i = 0; i < nevents; i++) {
+    e = &events[i];
+    printf("%12.3f %10" PRIu64 " %6" PRIu32 " %-24s ",
+           (double) (e->start_ns - base) / 1000.0,
+           e->end_ns - e->start_ns,
+           e->thread,
+           uvwasi_embedder_syscall_name((uvwasi_syscall_t) e->syscall));
+
+    if (e->fd == UVWASI_TRACE_NO_FD)
+      printf("%10s ", "-");
+    else
+      printf("%10" PRIu32 " ", e->fd);
+
+    printf("%20" PRIu64 " %20" PRIu64 " %s\n",
+           e->arg,
+           e->result,
+           uvwasi_embedder_err_code_to_string(e->error));
+  }
+
+  free(events);
+  return 0;
+}